@@ -0,0 +1,415 @@
+#include "BezierPatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BEZIER_SSE2
+#endif
+
+namespace {
+
+const int kMaxTess = 64;
+// patches per job at least
+const size_t kMinPatchesPerJob = 4;
+
+// a point in the lanes x, y, z (w unused)
+#ifdef BEZIER_SSE2
+using Vec = __m128;
+
+inline Vec Load(const float p[3]) {
+    return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+}
+inline Vec Splat(float s) {
+    return _mm_set1_ps(s);
+}
+inline Vec Zero() {
+    return _mm_setzero_ps();
+}
+inline Vec Add(Vec a, Vec b) {
+    return _mm_add_ps(a, b);
+}
+inline Vec Mul(Vec a, Vec b) {
+    return _mm_mul_ps(a, b);
+}
+inline void Store(Vec a, float p[3]) {
+    alignas(16) float v[4];
+    _mm_store_ps(v, a);
+    p[0] = v[0];
+    p[1] = v[1];
+    p[2] = v[2];
+}
+#else
+struct Vec {
+    float v[3];
+};
+
+inline Vec Load(const float p[3]) {
+    return { { p[0], p[1], p[2] } };
+}
+inline Vec Splat(float s) {
+    return { { s, s, s } };
+}
+inline Vec Zero() {
+    return Splat(0.0f);
+}
+inline Vec Add(Vec a, Vec b) {
+    return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2] } };
+}
+inline Vec Mul(Vec a, Vec b) {
+    return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2] } };
+}
+inline void Store(Vec a, float p[3]) {
+    p[0] = a.v[0];
+    p[1] = a.v[1];
+    p[2] = a.v[2];
+}
+#endif
+
+// a * (1 - t) + b * t, exact at t = 0 and t = 1
+inline Vec Lerp(Vec a, Vec b, float t) {
+    return Add(Mul(a, Splat(1.0f - t)), Mul(b, Splat(t)));
+}
+
+// point and derivative of a cubic curve
+void DeCasteljau(const Vec p[4], float t, Vec &pos, Vec &deriv) {
+    const Vec a = Lerp(p[0], p[1], t);
+    const Vec b = Lerp(p[1], p[2], t);
+    const Vec c = Lerp(p[2], p[3], t);
+    const Vec d = Lerp(a, b, t);
+    const Vec e = Lerp(b, c, t);
+    pos = Lerp(d, e, t);
+    // 3 * (e - d)
+    deriv = Mul(Add(e, Mul(d, Splat(-1.0f))), Splat(3.0f));
+}
+
+// Bernstein bases and their derivatives at i / n for i = 0..n and n = 1..kMaxTess
+struct Basis {
+    float b[4];
+    float db[4];
+};
+
+class BasisTable {
+  public:
+    BasisTable() {
+        start[0] = 0;
+        for (int n = 1; n <= kMaxTess; n++) {
+            start[n] = (int) bases.size();
+            for (int i = 0; i <= n; i++) {
+                const float t = (float) i / n;
+                const float s = 1.0f - t;
+                bases.push_back({
+                    { s * s * s, 3.0f * s * s * t, 3.0f * s * t * t, t * t * t },
+                    { -3.0f * s * s, 3.0f * s * s - 6.0f * s * t, 6.0f * s * t - 3.0f * t * t, 3.0f * t * t }
+                });
+            }
+        }
+    }
+
+    const Basis &At(int n, int i) const {
+        return bases[start[n] + i];
+    }
+
+  private:
+    int start[kMaxTess + 1];
+    std::vector<Basis> bases;
+};
+
+const BasisTable &Bases() {
+    static const BasisTable table;
+    return table;
+}
+
+// control point indices of the edges, in the order of PatchTessFactors
+const int kEdgeCp[4][4] = {
+    { 0, 4, 8, 12 },   // u = 0, along v
+    { 0, 1, 2, 3 },    // v = 0, along u
+    { 3, 7, 11, 15 },  // u = 1, along v
+    { 12, 13, 14, 15 } // v = 1, along u
+};
+
+// control points of an edge in an order only depending on the points, returns whether it is reversed
+bool CanonicalEdge(const BezierPatch &patch, int edge, Vec p[4]) {
+    const int *ids = kEdgeCp[edge];
+    const float *first = patch.cp[ids[0]];
+    const float *last = patch.cp[ids[3]];
+    bool reversed = std::lexicographical_compare(last, last + 3, first, first + 3);
+    if (!reversed && std::equal(first, first + 3, last)) {
+        // closed edge, decide by the inner points
+        reversed = std::lexicographical_compare(patch.cp[ids[2]], patch.cp[ids[2]] + 3,
+            patch.cp[ids[1]], patch.cp[ids[1]] + 3);
+    }
+    for (int k = 0; k < 4; k++) {
+        p[k] = Load(patch.cp[ids[reversed ? 3 - k : k]]);
+    }
+    return reversed;
+}
+
+int TessLevel(float factor) {
+    return std::clamp((int) std::ceil(factor), 1, kMaxTess);
+}
+
+// grid vertex i of n on an edge of level e goes to the nearest of the e + 1 edge vertices
+int Snap(int i, int n, int e) {
+    return (2 * i * e + n) / (2 * n);
+}
+
+struct PatchLayout {
+    int n_u;
+    int n_v;
+    int edge[4];
+
+    size_t VertexCount() const {
+        return (size_t) (n_u + 1) * (n_v + 1);
+    }
+};
+
+PatchLayout Layout(const PatchTessFactors &factors) {
+    PatchLayout layout;
+    for (int k = 0; k < 4; k++) {
+        layout.edge[k] = TessLevel(factors.edge[k]);
+    }
+    // the grid is never coarser than its edges
+    layout.n_u = std::max({ TessLevel(factors.inside[0]), layout.edge[1], layout.edge[3] });
+    layout.n_v = std::max({ TessLevel(factors.inside[1]), layout.edge[0], layout.edge[2] });
+    return layout;
+}
+
+// writes the indices if out is not nullptr, returns the index count
+size_t EmitIndices(const PatchLayout &layout, uint32_t base, uint32_t *out) {
+    const int n_u = layout.n_u;
+    const int n_v = layout.n_v;
+    // grid vertices snapped to the same edge vertex all use the first of them,
+    // or the corner for the last edge vertex, corners are shared with the other edges
+    int rep[4][kMaxTess + 1];
+    for (int k = 0; k < 4; k++) {
+        const int n = (k % 2 == 0) ? n_v : n_u;
+        const int e = layout.edge[k];
+        for (int i = 0; i <= n; i++) {
+            if (Snap(i, n, e) == e) {
+                rep[k][i] = n;
+            } else {
+                rep[k][i] = (i > 0 && Snap(i, n, e) == Snap(i - 1, n, e)) ? rep[k][i - 1] : i;
+            }
+        }
+    }
+    auto vid = [&](int r, int c) {
+        if (r == 0) {
+            c = rep[1][c];
+        } else if (r == n_v) {
+            c = rep[3][c];
+        }
+        if (c == 0) {
+            r = rep[0][r];
+        } else if (c == n_u) {
+            r = rep[2][r];
+        }
+        return base + (uint32_t) (r * (n_u + 1) + c);
+    };
+    size_t count = 0;
+    auto emit = [&](uint32_t a, uint32_t b, uint32_t c) {
+        if (a != b && b != c && a != c) {
+            if (out != nullptr) {
+                out[count] = a;
+                out[count + 1] = b;
+                out[count + 2] = c;
+            }
+            count += 3;
+        }
+    };
+    for (int r = 0; r < n_v; r++) {
+        for (int c = 0; c < n_u; c++) {
+            // same triangulation as GeometryGenerator::Grid
+            emit(vid(r, c), vid(r, c + 1), vid(r + 1, c));
+            emit(vid(r, c + 1), vid(r + 1, c + 1), vid(r + 1, c));
+        }
+    }
+    return count;
+}
+
+void MakeVertex(Vec pos, Vec dpdu, Vec dpdv, float u, float v, BezierVertex &out) {
+    float du[3], dv[3];
+    Store(pos, out.pos);
+    Store(dpdu, du);
+    Store(dpdv, dv);
+    float n[3] = {
+        du[1] * dv[2] - du[2] * dv[1],
+        du[2] * dv[0] - du[0] * dv[2],
+        du[0] * dv[1] - du[1] * dv[0]
+    };
+    const float n_len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const float t_len = std::sqrt(du[0] * du[0] + du[1] * du[1] + du[2] * du[2]);
+    // collapsed corners have no normal
+    for (int k = 0; k < 3; k++) {
+        out.norm[k] = n_len > 0.0f ? n[k] / n_len : (k == 1 ? 1.0f : 0.0f);
+        out.tan[k] = t_len > 0.0f ? du[k] / t_len : (k == 0 ? 1.0f : 0.0f);
+    }
+    out.texc[0] = u;
+    out.texc[1] = v;
+}
+
+// sum over the control points with bases along u and v
+Vec BasisSum(const Vec cp[16], const float bu[4], const float bv[4]) {
+    Vec sum = Zero();
+    for (int j = 0; j < 4; j++) {
+        Vec row = Zero();
+        for (int i = 0; i < 4; i++) {
+            row = Add(row, Mul(cp[4 * j + i], Splat(bu[i])));
+        }
+        sum = Add(sum, Mul(row, Splat(bv[j])));
+    }
+    return sum;
+}
+
+void EmitVertices(const BezierPatch &patch, const PatchLayout &layout, BezierVertex *out) {
+    const BasisTable &bases = Bases();
+    const int n_u = layout.n_u;
+    const int n_v = layout.n_v;
+    Vec cp[16];
+    for (int k = 0; k < 16; k++) {
+        cp[k] = Load(patch.cp[k]);
+    }
+
+    // rows: collapse the control points along v first, then every vertex is a sum of 4 points
+    for (int r = 0; r <= n_v; r++) {
+        const Basis &bv = bases.At(n_v, r);
+        Vec q[4], dq[4];
+        for (int i = 0; i < 4; i++) {
+            q[i] = Zero();
+            dq[i] = Zero();
+            for (int j = 0; j < 4; j++) {
+                q[i] = Add(q[i], Mul(cp[4 * j + i], Splat(bv.b[j])));
+                dq[i] = Add(dq[i], Mul(cp[4 * j + i], Splat(bv.db[j])));
+            }
+        }
+        for (int c = 0; c <= n_u; c++) {
+            const Basis &bu = bases.At(n_u, c);
+            Vec pos = Zero();
+            Vec dpdu = Zero();
+            Vec dpdv = Zero();
+            for (int i = 0; i < 4; i++) {
+                pos = Add(pos, Mul(q[i], Splat(bu.b[i])));
+                dpdu = Add(dpdu, Mul(q[i], Splat(bu.db[i])));
+                dpdv = Add(dpdv, Mul(dq[i], Splat(bu.b[i])));
+            }
+            MakeVertex(pos, dpdu, dpdv, (float) c / n_u, (float) r / n_v, out[(size_t) r * (n_u + 1) + c]);
+        }
+    }
+
+    // boundary vertices move onto their edge vertex, positions come from the edge curve alone
+    for (int k = 0; k < 4; k++) {
+        Vec edge[4];
+        const bool reversed = CanonicalEdge(patch, k, edge);
+        const int e = layout.edge[k];
+        const bool along_v = k % 2 == 0;
+        const int n = along_v ? n_v : n_u;
+        for (int i = 0; i <= n; i++) {
+            const int j = Snap(i, n, e);
+            const int r = along_v ? i : (k == 1 ? 0 : n_v);
+            const int c = along_v ? (k == 0 ? 0 : n_u) : i;
+            const int canonical = reversed ? e - j : j;
+            Vec pos, deriv;
+            DeCasteljau(edge, (float) canonical / e, pos, deriv);
+
+            // derivatives (for the normal) on the patch at the snapped parameter
+            const float t = (float) j / e;
+            const Basis &b_edge = bases.At(e, j);
+            const Basis &b_side = along_v ? bases.At(1, k == 0 ? 0 : 1) : bases.At(1, k == 1 ? 0 : 1);
+            const Basis &bu = along_v ? b_side : b_edge;
+            const Basis &bv = along_v ? b_edge : b_side;
+            const Vec dpdu = BasisSum(cp, bu.db, bv.b);
+            const Vec dpdv = BasisSum(cp, bu.b, bv.db);
+            MakeVertex(pos, dpdu, dpdv, along_v ? (k == 0 ? 0.0f : 1.0f) : t, along_v ? t : (k == 1 ? 0.0f : 1.0f),
+                out[(size_t) r * (n_u + 1) + c]);
+        }
+    }
+}
+
+}
+
+void EvaluateBezierPatch(const BezierPatch &patch, float u, float v, float pos[3], float dpdu[3], float dpdv[3]) {
+    // curves along u of every row, then the curve along v through their points
+    Vec row_pos[4], row_du[4];
+    for (int j = 0; j < 4; j++) {
+        const Vec row[4] = {
+            Load(patch.cp[4 * j]), Load(patch.cp[4 * j + 1]), Load(patch.cp[4 * j + 2]), Load(patch.cp[4 * j + 3])
+        };
+        DeCasteljau(row, u, row_pos[j], row_du[j]);
+    }
+    Vec p, dv, du, unused;
+    DeCasteljau(row_pos, v, p, dv);
+    DeCasteljau(row_du, v, du, unused);
+    if (pos != nullptr) {
+        Store(p, pos);
+    }
+    if (dpdu != nullptr) {
+        Store(du, dpdu);
+    }
+    if (dpdv != nullptr) {
+        Store(dv, dpdv);
+    }
+}
+
+PatchTessFactors ComputeBezierTessFactors(const BezierPatch &patch, const float eye[3], const TessDistanceRule &rule) {
+    PatchTessFactors factors;
+    for (int k = 0; k < 4; k++) {
+        Vec edge[4], mid, deriv;
+        CanonicalEdge(patch, k, edge);
+        DeCasteljau(edge, 0.5f, mid, deriv);
+        float m[3];
+        Store(mid, m);
+        const float dx = m[0] - eye[0];
+        const float dy = m[1] - eye[1];
+        const float dz = m[2] - eye[2];
+        factors.edge[k] = rule.Factor(std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    factors.inside[0] = std::max(factors.edge[1], factors.edge[3]);
+    factors.inside[1] = std::max(factors.edge[0], factors.edge[2]);
+    return factors;
+}
+
+void TessellateBezierPatch(const BezierPatch &patch, const PatchTessFactors &factors, BezierMesh &mesh) {
+    const PatchLayout layout = Layout(factors);
+    const size_t base = mesh.vertices.size();
+    mesh.vertices.resize(base + layout.VertexCount());
+    EmitVertices(patch, layout, mesh.vertices.data() + base);
+    const size_t index_base = mesh.indices.size();
+    mesh.indices.resize(index_base + EmitIndices(layout, (uint32_t) base, nullptr));
+    EmitIndices(layout, (uint32_t) base, mesh.indices.data() + index_base);
+}
+
+void TessellateBezierPatches(JobSystem &jobs, const BezierPatch *patches, size_t n, const float eye[3],
+        const TessDistanceRule &rule, BezierMesh &mesh) {
+    struct Placement {
+        PatchLayout layout;
+        size_t vertex_offset;
+        size_t index_offset;
+        size_t n_index;
+    };
+    std::vector<Placement> placements(n);
+    jobs.ParallelFor(0, n, [&](size_t i) {
+        placements[i].layout = Layout(ComputeBezierTessFactors(patches[i], eye, rule));
+        placements[i].n_index = EmitIndices(placements[i].layout, 0, nullptr);
+    }, kMinPatchesPerJob);
+
+    size_t n_vertex = mesh.vertices.size();
+    size_t n_index = mesh.indices.size();
+    for (auto &placement : placements) {
+        placement.vertex_offset = n_vertex;
+        placement.index_offset = n_index;
+        n_vertex += placement.layout.VertexCount();
+        n_index += placement.n_index;
+    }
+    mesh.vertices.resize(n_vertex);
+    mesh.indices.resize(n_index);
+
+    jobs.ParallelFor(0, n, [&](size_t i) {
+        const Placement &placement = placements[i];
+        EmitVertices(patches[i], placement.layout, mesh.vertices.data() + placement.vertex_offset);
+        EmitIndices(placement.layout, (uint32_t) placement.vertex_offset,
+            mesh.indices.data() + placement.index_offset);
+    }, kMinPatchesPerJob);
+}
\ No newline at end of file
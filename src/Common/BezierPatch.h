@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+#include "TessFactors.h"
+
+// cpu version of the bicubic bezier patches of ch14_tessellation_bezier, for picking, collision and
+// drawing without a tessellator
+// control points are row by row, cp[4 * j + i] is the i-th point along u on the j-th row along v
+
+struct BezierPatch {
+    float cp[16][3];
+};
+
+// plain floats so the tessellator doesn't depend on DirectXMath, fields as GeometryGenerator::Vertex without bitan
+struct BezierVertex {
+    float pos[3];
+    float norm[3];
+    float tan[3];
+    float texc[2];
+};
+
+struct BezierMesh {
+    std::vector<BezierVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// position and partial derivatives at (u, v), by de Casteljau, any output may be nullptr
+void EvaluateBezierPatch(const BezierPatch &patch, float u, float v, float pos[3], float dpdu[3], float dpdv[3]);
+
+// every edge gets the factor of the distance to its middle point, inside factors are the max of the edges
+// along the same direction, the edge is evaluated in an order not depending on the patch,
+// so patches sharing an edge get the same factor for it
+PatchTessFactors ComputeBezierTessFactors(const BezierPatch &patch, const float eye[3], const TessDistanceRule &rule);
+
+// triangles of one patch appended to mesh, factors are rounded up to integers ("integer" partitioning)
+// the inside is a grid of inside[0] x inside[1] quads, a coarser edge moves the grid vertices on it onto its own
+// vertices and drops triangles becoming degenerate, edge vertices are evaluated on the edge curve in an order not
+// depending on the patch, so neighbors with the same factor on a shared edge have bitwise equal vertices there
+// texc is (u, v), triangles are ccw seen from the side of cross(dp/du, dp/dv) like Grid
+void TessellateBezierPatch(const BezierPatch &patch, const PatchTessFactors &factors, BezierMesh &mesh);
+
+// factors from the distance rule and tessellation of all patches in parallel, into one mesh
+void TessellateBezierPatches(JobSystem &jobs, const BezierPatch *patches, size_t n, const float eye[3],
+    const TessDistanceRule &rule, BezierMesh &mesh);
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "Billboard.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BILLBOARD_SSE2
+#endif
+
+namespace {
+
+// sprites per job at least
+const size_t kMinSpritesPerJob = 1024;
+// eye right above a sprite leaves no horizontal look direction
+const float kMinLookLengthSq = 1e-12f;
+
+const float kTexc[4][2] = {
+    { 0.0f, 0.0f },
+    { 0.0f, 1.0f },
+    { 1.0f, 0.0f },
+    { 1.0f, 1.0f }
+};
+// sign of right and up of each corner
+const float kCorner[4][2] = {
+    { 1.0f, 1.0f },
+    { 1.0f, -1.0f },
+    { -1.0f, 1.0f },
+    { -1.0f, -1.0f }
+};
+
+void EmitQuad(const SpriteInstance &sprite, float look_x, float look_z, BillboardVertex *out) {
+    // right = cross(look, up) with look.y = 0
+    const float right_x = -look_z;
+    const float right_z = look_x;
+    const float hw = 0.5f * sprite.size[0];
+    const float hh = 0.5f * sprite.size[1];
+    for (int i = 0; i < 4; i++) {
+        BillboardVertex v;
+        v.pos[0] = sprite.pos[0] + kCorner[i][0] * hw * right_x;
+        v.pos[1] = sprite.pos[1] + kCorner[i][1] * hh;
+        v.pos[2] = sprite.pos[2] + kCorner[i][0] * hw * right_z;
+        v.norm[0] = look_x;
+        v.norm[1] = 0.0f;
+        v.norm[2] = look_z;
+        v.texc[0] = kTexc[i][0];
+        v.texc[1] = kTexc[i][1];
+        v.variant = sprite.variant;
+        std::memcpy(out + i, &v, sizeof(v));
+    }
+}
+
+void ExpandRange(const SpriteInstance *sprites, size_t begin, size_t end, const float eye[3],
+        BillboardVertex *out) {
+    size_t i = begin;
+#ifdef BILLBOARD_SSE2
+    // look directions of 4 sprites at once
+    const __m128 eye_x = _mm_set1_ps(eye[0]);
+    const __m128 eye_z = _mm_set1_ps(eye[2]);
+    const __m128 min_len_sq = _mm_set1_ps(kMinLookLengthSq);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= end; i += 4) {
+        const SpriteInstance *s = sprites + i;
+        __m128 dx = _mm_sub_ps(eye_x, _mm_setr_ps(s[0].pos[0], s[1].pos[0], s[2].pos[0], s[3].pos[0]));
+        __m128 dz = _mm_sub_ps(eye_z, _mm_setr_ps(s[0].pos[2], s[1].pos[2], s[2].pos[2], s[3].pos[2]));
+        __m128 len_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+        __m128 valid = _mm_cmpgt_ps(len_sq, min_len_sq);
+        __m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(len_sq, min_len_sq)));
+        // degenerate sprites look along +z
+        __m128 look_x = _mm_and_ps(valid, _mm_mul_ps(dx, inv_len));
+        __m128 look_z = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(dz, inv_len)), _mm_andnot_ps(valid, one));
+        alignas(16) float lx[4], lz[4];
+        _mm_store_ps(lx, look_x);
+        _mm_store_ps(lz, look_z);
+        for (int k = 0; k < 4; k++) {
+            EmitQuad(s[k], lx[k], lz[k], out + (i + k) * kBillboardVertexCount);
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        const SpriteInstance &s = sprites[i];
+        float dx = eye[0] - s.pos[0];
+        float dz = eye[2] - s.pos[2];
+        float len_sq = dx * dx + dz * dz;
+        float look_x = 0.0f;
+        float look_z = 1.0f;
+        if (len_sq > kMinLookLengthSq) {
+            float inv_len = 1.0f / std::sqrt(len_sq);
+            look_x = dx * inv_len;
+            look_z = dz * inv_len;
+        }
+        EmitQuad(s, look_x, look_z, out + i * kBillboardVertexCount);
+    }
+}
+
+}
+
+void BuildBillboardIndices(size_t n_sprite, uint32_t *out) {
+    const uint32_t quad[kBillboardIndexCount] = { 0, 1, 2, 2, 1, 3 };
+    for (size_t i = 0; i < n_sprite; i++) {
+        for (size_t k = 0; k < kBillboardIndexCount; k++) {
+            out[i * kBillboardIndexCount + k] = static_cast<uint32_t>(i * kBillboardVertexCount) + quad[k];
+        }
+    }
+}
+
+void ExpandBillboards(JobSystem &jobs, const SpriteInstance *sprites, size_t n, const float eye[3],
+        BillboardVertex *out) {
+    jobs.ParallelForRange(0, n, [&](size_t begin, size_t end) {
+        ExpandRange(sprites, begin, end, eye, out);
+    }, kMinSpritesPerJob);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "JobSystem.h"
+#include "SpriteField.h"
+
+// cpu version of the billboard geometry shader (tree_sprite.hlsl GS)
+// every sprite becomes 4 vertices of a quad facing the eye around y axis, in the order the GS emits them:
+// (+right, +up), (+right, -up), (-right, +up), (-right, -up), drawn as triangles 0 1 2, 2 1 3
+
+struct BillboardVertex {
+    float pos[3];
+    float norm[3];
+    float texc[2];
+    uint32_t variant;
+};
+
+const size_t kBillboardVertexCount = 4;
+const size_t kBillboardIndexCount = 6;
+
+// indices of n quads, for a static index buffer
+void BuildBillboardIndices(size_t n_sprite, uint32_t *out);
+
+// out must have room for kBillboardVertexCount * n vertices, it may be mapped (write-combined) memory,
+// it is only written sequentially
+void ExpandBillboards(JobSystem &jobs, const SpriteInstance *sprites, size_t n, const float eye[3],
+    BillboardVertex *out);
\ No newline at end of file
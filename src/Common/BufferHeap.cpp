@@ -0,0 +1,146 @@
+#include "BufferHeap.h"
+
+#include <algorithm>
+#include <cassert>
+
+BufferHeap::BufferHeap(ID3D12Device *device, UINT64 block_size) : device(device), block_size(block_size) {}
+
+void BufferHeap::CreateBlock(UINT64 size, Block &block) {
+    const UINT64 align = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    size = (size + align - 1) & ~(align - 1);
+    CD3DX12_HEAP_DESC heap_desc(size, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+    ThrowIfFailed(device->CreateHeap(&heap_desc, IID_PPV_ARGS(&block.heap)));
+    auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    ThrowIfFailed(device->CreatePlacedResource(block.heap.Get(), 0, &buffer_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&block.buffer)));
+    block.allocator.Reset(size, kDefaultAlign);
+}
+
+BufferAllocation BufferHeap::Create(UploadManager &uploads, const void *data, UINT64 size, UINT64 align) {
+    BufferAllocation alloc;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b]->allocator.Allocate(size, align, alloc.handle)) {
+            alloc.block = b;
+            break;
+        }
+    }
+    if (alloc.block == UINT32_MAX) {
+        auto block = std::make_unique<Block>();
+        CreateBlock(std::max(block_size, size), *block);
+        [[maybe_unused]] bool b_allocated = block->allocator.Allocate(size, align, alloc.handle);
+        assert(b_allocated);
+        alloc.block = (uint32_t) blocks.size();
+        blocks.push_back(std::move(block));
+    }
+    uploads.Upload(Resource(alloc), Offset(alloc), data, size, D3D12_RESOURCE_STATE_GENERIC_READ);
+    return alloc;
+}
+
+BufferAllocation BufferHeap::CreateDedicated(UINT64 size) {
+    auto block = std::make_unique<Block>();
+    CreateBlock(size, *block);
+    BufferAllocation alloc;
+    [[maybe_unused]] bool b_allocated = block->allocator.Allocate(block->allocator.Capacity(), kDefaultAlign,
+        alloc.handle);
+    assert(b_allocated);
+    alloc.block = (uint32_t) blocks.size();
+    blocks.push_back(std::move(block));
+    return alloc;
+}
+
+void BufferHeap::Free(const BufferAllocation &alloc) {
+    assert(alloc.block < blocks.size());
+    blocks[alloc.block]->allocator.Free(alloc.handle);
+}
+
+ID3D12Resource *BufferHeap::Resource(const BufferAllocation &alloc) const {
+    assert(alloc.block < blocks.size());
+    return blocks[alloc.block]->buffer.Get();
+}
+
+UINT64 BufferHeap::Offset(const BufferAllocation &alloc) const {
+    assert(alloc.block < blocks.size());
+    return blocks[alloc.block]->allocator.Offset(alloc.handle);
+}
+
+int BufferHeap::Defragment(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, float max_fragmentation) {
+    int n_packed = 0;
+    std::vector<TlsfAllocator::Move> moves;
+    for (auto &block : blocks) {
+        const TlsfAllocator::Stats stats = block->allocator.GetStats();
+        if (stats.n_allocation == 0 || stats.Fragmentation() <= max_fragmentation) {
+            continue;
+        }
+        moves.clear();
+        block->allocator.Defragment(moves);
+        RepackBlock(cmd_list, fence, *block, moves);
+        ++n_packed;
+    }
+    return n_packed;
+}
+
+void BufferHeap::Repack(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, const BufferAllocation &alloc,
+        const std::vector<TlsfAllocator::Move> &moves) {
+    assert(alloc.block < blocks.size());
+    Block &block = *blocks[alloc.block];
+    // the new buffer only gets the moves, nothing else may live in the block
+    assert(block.allocator.GetStats().n_allocation == 1);
+    const UINT64 base = block.allocator.Offset(alloc.handle);
+    std::vector<TlsfAllocator::Move> block_moves(moves);
+    for (TlsfAllocator::Move &move : block_moves) {
+        assert(move.src + move.size <= block.allocator.Size(alloc.handle));
+        assert(move.dst + move.size <= block.allocator.Size(alloc.handle));
+        move.src += base;
+        move.dst += base;
+    }
+    RepackBlock(cmd_list, fence, block, block_moves);
+}
+
+void BufferHeap::RepackBlock(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, Block &block,
+        const std::vector<TlsfAllocator::Move> &moves) {
+    // a move may overlap its own source, GPU copies can't, so the data goes to a new buffer
+    Block packed;
+    CreateBlock(block.allocator.Capacity(), packed);
+    D3D12_RESOURCE_BARRIER to_copy[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(block.buffer.Get(),
+            D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(packed.buffer.Get(),
+            D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST)
+    };
+    cmd_list->ResourceBarrier(2, to_copy);
+    for (const TlsfAllocator::Move &move : moves) {
+        if (move.size > 0) {
+            cmd_list->CopyBufferRegion(packed.buffer.Get(), move.dst, block.buffer.Get(), move.src, move.size);
+        }
+    }
+    D3D12_RESOURCE_BARRIER to_read[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(block.buffer.Get(),
+            D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_GENERIC_READ),
+        CD3DX12_RESOURCE_BARRIER::Transition(packed.buffer.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ)
+    };
+    cmd_list->ResourceBarrier(2, to_read);
+
+    retired.push_back({ fence, std::move(block.heap), std::move(block.buffer) });
+    block.heap = std::move(packed.heap);
+    block.buffer = std::move(packed.buffer);
+}
+
+void BufferHeap::Retire(UINT64 completed_fence) {
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [completed_fence](const RetiredBlock &block) {
+        return block.fence <= completed_fence;
+    }), retired.end());
+}
+
+TlsfAllocator::Stats BufferHeap::GetStats() const {
+    TlsfAllocator::Stats stats;
+    for (const auto &block : blocks) {
+        const TlsfAllocator::Stats block_stats = block->allocator.GetStats();
+        stats.capacity += block_stats.capacity;
+        stats.used += block_stats.used;
+        stats.largest_free = std::max(stats.largest_free, block_stats.largest_free);
+        stats.n_allocation += block_stats.n_allocation;
+        stats.n_free_block += block_stats.n_free_block;
+    }
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "D3DUtil.h"
+#include "Tlsf.h"
+#include "UploadManager.h"
+
+// default-heap buffers suballocated from a few large heaps, instead of a committed resource each
+// every heap holds one placed buffer covering all of it, an allocation is a range of that buffer,
+// which is what vertex/index buffer views need (placed buffers themselves are 64KB aligned, too coarse for meshes)
+
+struct BufferAllocation {
+    uint32_t block = UINT32_MAX;
+    TlsfAllocator::Handle handle = TlsfAllocator::kInvalidHandle;
+};
+
+class BufferHeap {
+  public:
+    BufferHeap(ID3D12Device *device, UINT64 block_size = 32 * 1024 * 1024);
+    BufferHeap(const BufferHeap &rhs) = delete;
+    BufferHeap &operator=(const BufferHeap &rhs) = delete;
+
+    // data is copied when uploads is flushed, buffers larger than the block size get a heap of their own
+    BufferAllocation Create(UploadManager &uploads, const void *data, UINT64 size, UINT64 align = kDefaultAlign);
+    // a heap of its own taken whole by the allocation, for callers placing data in it themselves (GeometryArena),
+    // Create() doesn't put anything else there and Defragment() leaves it alone
+    BufferAllocation CreateDedicated(UINT64 size);
+    void Free(const BufferAllocation &alloc);
+
+    // the buffer holding alloc and the byte offset in it, they change in Defragment()
+    ID3D12Resource *Resource(const BufferAllocation &alloc) const;
+    UINT64 Offset(const BufferAllocation &alloc) const;
+    D3D12_GPU_VIRTUAL_ADDRESS GpuAddress(const BufferAllocation &alloc) const {
+        return Resource(alloc)->GetGPUVirtualAddress() + Offset(alloc);
+    }
+
+    // blocks whose fragmentation is above max_fragmentation are packed into a new heap, copies are recorded to cmd_list
+    // old heaps are kept until Retire() is called with a fence at least `fence`, the one signaled after cmd_list
+    // returns the number of blocks packed, resources and offsets of their allocations have to be queried again
+    int Defragment(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, float max_fragmentation = 0.25f);
+    // copy the byte ranges of moves, relative to a dedicated allocation, into a new buffer that replaces its own,
+    // the rest of the allocation is not kept, the old buffer is dropped like those of Defragment()
+    void Repack(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, const BufferAllocation &alloc,
+        const std::vector<TlsfAllocator::Move> &moves);
+    void Retire(UINT64 completed_fence);
+
+    // summed over all blocks
+    TlsfAllocator::Stats GetStats() const;
+
+    static constexpr UINT64 kDefaultAlign = 256;
+
+  private:
+    struct Block {
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+        TlsfAllocator allocator;
+    };
+    struct RetiredBlock {
+        UINT64 fence;
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    };
+
+    void CreateBlock(UINT64 size, Block &block);
+    // moves are byte offsets in the block
+    void RepackBlock(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, Block &block,
+        const std::vector<TlsfAllocator::Move> &moves);
+
+    ID3D12Device *device;
+    UINT64 block_size;
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<RetiredBlock> retired;
+};
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "D3DUtil.h"
+#include "CommandStream.h"
+
+// forward calls to a command list and, if a writer is given, record them into a CommandStream
+// it has the same method names as ID3D12GraphicsCommandList, so drawing code only changes the type it takes
+class CapturedCommandList {
+  public:
+    CapturedCommandList(ID3D12GraphicsCommandList *cmd_list, CommandStreamWriter *writer = nullptr)
+        : cmd_list(cmd_list), writer(writer) {}
+
+    ID3D12GraphicsCommandList *Get() const {
+        return cmd_list;
+    }
+
+    // a list starts with no state but the initial pso
+    HRESULT Reset(ID3D12CommandAllocator *cmd_alloc, ID3D12PipelineState *pso) {
+        HRESULT hr = cmd_list->Reset(cmd_alloc, pso);
+        Record(CommandOp::BeginList);
+        if (pso != nullptr) {
+            Record(CommandOp::SetPipelineState, 0, (uint64_t) pso);
+        }
+        return hr;
+    }
+    HRESULT Close() {
+        return cmd_list->Close();
+    }
+
+    // only recorded, name the following group of draws
+    void BeginLayer(const char *name) {
+        if (writer != nullptr) {
+            CommandEvent event;
+            event.op = CommandOp::BeginLayer;
+            event.name = name;
+            writer->Record(event);
+        }
+    }
+
+    void RSSetViewports(UINT n, const D3D12_VIEWPORT *viewports) {
+        cmd_list->RSSetViewports(n, viewports);
+        for (UINT i = 0; i < n; i++) {
+            Record(CommandOp::SetViewport, 0, 0, { (int64_t) viewports[i].TopLeftX, (int64_t) viewports[i].TopLeftY,
+                (int64_t) viewports[i].Width, (int64_t) viewports[i].Height });
+        }
+    }
+    void RSSetScissorRects(UINT n, const D3D12_RECT *rects) {
+        cmd_list->RSSetScissorRects(n, rects);
+        for (UINT i = 0; i < n; i++) {
+            Record(CommandOp::SetScissor, 0, 0, { rects[i].left, rects[i].top, rects[i].right, rects[i].bottom });
+        }
+    }
+    void ResourceBarrier(UINT n, const D3D12_RESOURCE_BARRIER *barriers) {
+        cmd_list->ResourceBarrier(n, barriers);
+        for (UINT i = 0; i < n; i++) {
+            if (barriers[i].Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION) {
+                const auto &t = barriers[i].Transition;
+                Record(CommandOp::Barrier, 0, (uint64_t) t.pResource, { t.StateBefore, t.StateAfter });
+            } else {
+                Record(CommandOp::Barrier, 0, 0, { -1, -1 });
+            }
+        }
+    }
+    void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4], UINT n_rect,
+            const D3D12_RECT *rects) {
+        cmd_list->ClearRenderTargetView(rtv, color, n_rect, rects);
+        Record(CommandOp::ClearRenderTarget, 0, rtv.ptr);
+    }
+    void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE dsv, D3D12_CLEAR_FLAGS flags, FLOAT depth,
+            UINT8 stencil, UINT n_rect, const D3D12_RECT *rects) {
+        cmd_list->ClearDepthStencilView(dsv, flags, depth, stencil, n_rect, rects);
+        Record(CommandOp::ClearDepthStencil, 0, dsv.ptr);
+    }
+    void OMSetRenderTargets(UINT n_rt, const D3D12_CPU_DESCRIPTOR_HANDLE *rtvs, BOOL single_handle,
+            const D3D12_CPU_DESCRIPTOR_HANDLE *dsv) {
+        cmd_list->OMSetRenderTargets(n_rt, rtvs, single_handle, dsv);
+        Record(CommandOp::SetRenderTargets, 0, n_rt > 0 ? rtvs[0].ptr : 0, { n_rt, dsv != nullptr });
+    }
+    void SetGraphicsRootSignature(ID3D12RootSignature *rt_sig) {
+        cmd_list->SetGraphicsRootSignature(rt_sig);
+        Record(CommandOp::SetRootSignature, 0, (uint64_t) rt_sig);
+    }
+    void SetDescriptorHeaps(UINT n, ID3D12DescriptorHeap *const *heaps) {
+        cmd_list->SetDescriptorHeaps(n, heaps);
+        Record(CommandOp::SetDescriptorHeaps, 0, n > 0 ? (uint64_t) heaps[0] : 0, { n });
+    }
+    void SetPipelineState(ID3D12PipelineState *pso) {
+        cmd_list->SetPipelineState(pso);
+        Record(CommandOp::SetPipelineState, 0, (uint64_t) pso);
+    }
+    void IASetVertexBuffers(UINT start_slot, UINT n, const D3D12_VERTEX_BUFFER_VIEW *views) {
+        cmd_list->IASetVertexBuffers(start_slot, n, views);
+        for (UINT i = 0; i < n; i++) {
+            Record(CommandOp::SetVertexBuffer, start_slot + i, views[i].BufferLocation,
+                { views[i].SizeInBytes, views[i].StrideInBytes });
+        }
+    }
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW *view) {
+        cmd_list->IASetIndexBuffer(view);
+        Record(CommandOp::SetIndexBuffer, 0, view->BufferLocation, { view->SizeInBytes, view->Format });
+    }
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY prim_ty) {
+        cmd_list->IASetPrimitiveTopology(prim_ty);
+        Record(CommandOp::SetTopology, 0, 0, { prim_ty });
+    }
+    void SetGraphicsRootConstantBufferView(UINT param, D3D12_GPU_VIRTUAL_ADDRESS addr) {
+        cmd_list->SetGraphicsRootConstantBufferView(param, addr);
+        Record(CommandOp::SetRootCbv, param, addr);
+    }
+    void SetGraphicsRootDescriptorTable(UINT param, D3D12_GPU_DESCRIPTOR_HANDLE handle) {
+        cmd_list->SetGraphicsRootDescriptorTable(param, handle);
+        Record(CommandOp::SetRootTable, param, handle.ptr);
+    }
+    void SetGraphicsRootShaderResourceView(UINT param, D3D12_GPU_VIRTUAL_ADDRESS addr) {
+        cmd_list->SetGraphicsRootShaderResourceView(param, addr);
+        Record(CommandOp::SetRootSrv, param, addr);
+    }
+    void SetGraphicsRoot32BitConstant(UINT param, UINT value, UINT offset) {
+        cmd_list->SetGraphicsRoot32BitConstant(param, value, offset);
+        Record(CommandOp::SetRootConstant, param, value, { offset });
+    }
+    void DrawIndexedInstanced(UINT n_index, UINT n_instance, UINT start_index, INT base_vertex,
+            UINT start_instance) {
+        cmd_list->DrawIndexedInstanced(n_index, n_instance, start_index, base_vertex, start_instance);
+        Record(CommandOp::DrawIndexed, 0, 0, { n_index, n_instance, start_index, base_vertex, start_instance });
+    }
+    void DrawInstanced(UINT n_vertex, UINT n_instance, UINT start_vertex, UINT start_instance) {
+        cmd_list->DrawInstanced(n_vertex, n_instance, start_vertex, start_instance);
+        Record(CommandOp::Draw, 0, 0, { n_vertex, n_instance, start_vertex, start_instance });
+    }
+
+  private:
+    void Record(CommandOp op, UINT slot = 0, uint64_t value = 0, std::initializer_list<int64_t> args = {}) {
+        if (writer == nullptr) {
+            return;
+        }
+        CommandEvent event;
+        event.op = op;
+        event.slot = static_cast<uint8_t>(slot);
+        event.value = value;
+        int i = 0;
+        for (auto arg : args) {
+            event.args[i++] = arg;
+        }
+        writer->Record(event);
+    }
+
+    ID3D12GraphicsCommandList *cmd_list;
+    CommandStreamWriter *writer;
+};
\ No newline at end of file
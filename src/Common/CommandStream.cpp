@@ -0,0 +1,212 @@
+#include "CommandStream.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+const char kMagic[4] = { 'C', 'M', 'D', 'S' };
+const uint8_t kVersion = 1;
+const size_t kFieldCount = 1 + CommandEvent::kMaxArgs;
+
+struct OpInfo {
+    const char *name;
+    bool has_slot;
+    bool has_value;
+    int n_arg;
+    bool is_state;
+};
+
+const OpInfo kOpInfo[] = {
+    { "BeginList", false, false, 0, false },
+    { "BeginLayer", false, false, 0, false },
+    { "SetPipelineState", false, true, 0, true },
+    { "SetRootSignature", false, true, 0, true },
+    { "SetDescriptorHeaps", false, true, 1, true },
+    { "SetViewport", false, false, 4, true },
+    { "SetScissor", false, false, 4, true },
+    { "SetRenderTargets", false, true, 2, true },
+    { "ClearRenderTarget", false, true, 0, false },
+    { "ClearDepthStencil", false, true, 0, false },
+    { "Barrier", false, true, 2, false },
+    { "SetVertexBuffer", true, true, 2, true },
+    { "SetIndexBuffer", false, true, 2, true },
+    { "SetTopology", false, false, 1, true },
+    { "SetRootCbv", true, true, 0, true },
+    { "SetRootTable", true, true, 0, true },
+    { "DrawIndexed", false, false, 5, false },
+    { "Draw", false, false, 4, false },
+    { "SetRootSrv", true, true, 0, true },
+    { "SetRootConstant", true, true, 1, true },
+};
+static_assert(sizeof(kOpInfo) / sizeof(kOpInfo[0]) == (size_t) CommandOp::Count);
+
+size_t PrevIndex(CommandOp op, uint8_t slot) {
+    return ((size_t) op * CommandEvent::kMaxSlot + slot) * kFieldCount;
+}
+
+uint64_t ZigZag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+int64_t UnZigZag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+}
+
+const char *CommandOpName(CommandOp op) {
+    return op < CommandOp::Count ? kOpInfo[(size_t) op].name : "Unknown";
+}
+
+bool IsStateOp(CommandOp op) {
+    return op < CommandOp::Count && kOpInfo[(size_t) op].is_state;
+}
+
+CommandStreamWriter::CommandStreamWriter() {
+    Clear();
+}
+
+void CommandStreamWriter::Clear() {
+    data.clear();
+    n_command = 0;
+    prev.assign((size_t) CommandOp::Count * CommandEvent::kMaxSlot * kFieldCount, 0);
+}
+
+void CommandStreamWriter::PutVarint(uint64_t v) {
+    while (v >= 0x80) {
+        data.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(v));
+}
+
+void CommandStreamWriter::PutDelta(int64_t &prev_v, int64_t v) {
+    // wrap-around difference, valid for addresses as well
+    PutVarint(ZigZag(static_cast<int64_t>(static_cast<uint64_t>(v) - static_cast<uint64_t>(prev_v))));
+    prev_v = v;
+}
+
+void CommandStreamWriter::Record(const CommandEvent &event) {
+    const OpInfo &info = kOpInfo[(size_t) event.op];
+    uint8_t slot = info.has_slot ? event.slot % CommandEvent::kMaxSlot : 0;
+
+    data.push_back(static_cast<uint8_t>(event.op));
+    if (info.has_slot) {
+        data.push_back(slot);
+    }
+    if (event.op == CommandOp::BeginLayer) {
+        PutVarint(event.name.size());
+        data.insert(data.end(), event.name.begin(), event.name.end());
+    }
+
+    int64_t *p = &prev[PrevIndex(event.op, slot)];
+    if (info.has_value) {
+        PutDelta(p[0], static_cast<int64_t>(event.value));
+    }
+    for (int i = 0; i < info.n_arg; i++) {
+        PutDelta(p[1 + i], event.args[i]);
+    }
+    ++n_command;
+}
+
+bool CommandStreamWriter::Save(const std::filesystem::path &filename) const {
+    std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+    fout.write(kMagic, sizeof(kMagic));
+    fout.put(static_cast<char>(kVersion));
+    fout.write(reinterpret_cast<const char *>(data.data()), data.size());
+    return static_cast<bool>(fout);
+}
+
+CommandStreamReader::CommandStreamReader(std::vector<uint8_t> data) : data(std::move(data)) {
+    prev.assign((size_t) CommandOp::Count * CommandEvent::kMaxSlot * kFieldCount, 0);
+}
+
+bool CommandStreamReader::Load(const std::filesystem::path &filename, std::vector<uint8_t> &data) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin) {
+        return false;
+    }
+    char magic[sizeof(kMagic)];
+    fin.read(magic, sizeof(magic));
+    int version = fin.get();
+    if (!fin || !std::equal(magic, magic + sizeof(magic), kMagic) || version != kVersion) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool CommandStreamReader::GetVarint(uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        uint8_t b = data[pos++];
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandStreamReader::GetDelta(int64_t &prev_v, int64_t &v) {
+    uint64_t zz;
+    if (!GetVarint(zz)) {
+        return false;
+    }
+    v = static_cast<int64_t>(static_cast<uint64_t>(prev_v) + static_cast<uint64_t>(UnZigZag(zz)));
+    prev_v = v;
+    return true;
+}
+
+bool CommandStreamReader::Next(CommandEvent &event) {
+    if (corrupted || pos >= data.size()) {
+        return false;
+    }
+
+    uint8_t op = data[pos++];
+    if (op >= (uint8_t) CommandOp::Count) {
+        corrupted = true;
+        return false;
+    }
+    event = CommandEvent();
+    event.op = static_cast<CommandOp>(op);
+    const OpInfo &info = kOpInfo[op];
+
+    if (info.has_slot) {
+        if (pos >= data.size()) {
+            corrupted = true;
+            return false;
+        }
+        event.slot = data[pos++] % CommandEvent::kMaxSlot;
+    }
+    if (event.op == CommandOp::BeginLayer) {
+        uint64_t len;
+        if (!GetVarint(len) || len > data.size() - pos) {
+            corrupted = true;
+            return false;
+        }
+        event.name.assign(data.begin() + pos, data.begin() + pos + len);
+        pos += len;
+    }
+
+    int64_t *p = &prev[PrevIndex(event.op, event.slot)];
+    int64_t v;
+    if (info.has_value) {
+        if (!GetDelta(p[0], v)) {
+            corrupted = true;
+            return false;
+        }
+        event.value = static_cast<uint64_t>(v);
+    }
+    for (int i = 0; i < info.n_arg; i++) {
+        if (!GetDelta(p[1 + i], event.args[i])) {
+            corrupted = true;
+            return false;
+        }
+    }
+    return true;
+}
\ No newline at end of file
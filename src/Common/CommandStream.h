@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+// compact binary stream of command list calls, for offline analysis of what a frame submits
+// every command is | op (1 byte) | slot (1 byte, only for root parameters & vb) | fields |
+// fields are zigzag varints of the difference to the same field of the previous command with same op & slot,
+// so repeated & sequential values (addresses, draw offsets) take one or two bytes
+
+enum class CommandOp : uint8_t {
+    BeginList,         // a new command list, no state is inherited
+    BeginLayer,        // name of the following group of commands (render layer)
+    SetPipelineState,  // value = pso
+    SetRootSignature,  // value = root signature
+    SetDescriptorHeaps, // value = first heap, args[0] = heap count
+    SetViewport,       // args = x, y, width, height
+    SetScissor,        // args = left, top, right, bottom
+    SetRenderTargets,  // value = first rtv, args[0] = rtv count, args[1] = has dsv
+    ClearRenderTarget, // value = rtv
+    ClearDepthStencil, // value = dsv
+    Barrier,           // value = resource, args = state before, state after
+    SetVertexBuffer,   // slot = input slot, value = address, args = size, stride
+    SetIndexBuffer,    // value = address, args = size, format
+    SetTopology,       // args[0] = topology
+    SetRootCbv,        // slot = root parameter, value = address
+    SetRootTable,      // slot = root parameter, value = gpu descriptor handle
+    DrawIndexed,       // args = index count, instance count, start index, base vertex, start instance
+    Draw,              // args = vertex count, instance count, start vertex, start instance
+    SetRootSrv,        // slot = root parameter, value = address
+    SetRootConstant,   // slot = root parameter, value = constant, args[0] = offset in 32-bit values
+    Count
+};
+
+struct CommandEvent {
+    static const int kMaxArgs = 5;
+    static const int kMaxSlot = 64;
+
+    CommandOp op = CommandOp::BeginList;
+    uint8_t slot = 0;
+    uint64_t value = 0;
+    int64_t args[kMaxArgs] = {};
+    std::string name; // BeginLayer only
+};
+
+const char *CommandOpName(CommandOp op);
+// whether the op sets a pipeline state (and may be redundant)
+bool IsStateOp(CommandOp op);
+
+class CommandStreamWriter {
+  public:
+    CommandStreamWriter();
+
+    void Record(const CommandEvent &event);
+    void Clear();
+
+    const std::vector<uint8_t> &Data() const {
+        return data;
+    }
+    size_t CommandCount() const {
+        return n_command;
+    }
+    bool Save(const std::filesystem::path &filename) const;
+
+  private:
+    void PutVarint(uint64_t v);
+    void PutDelta(int64_t &prev_v, int64_t v);
+
+    std::vector<uint8_t> data;
+    size_t n_command = 0;
+    // previous value & args for each (op, slot)
+    std::vector<int64_t> prev;
+};
+
+class CommandStreamReader {
+  public:
+    explicit CommandStreamReader(std::vector<uint8_t> data);
+
+    static bool Load(const std::filesystem::path &filename, std::vector<uint8_t> &data);
+
+    // false at the end of stream or if stream is corrupted
+    bool Next(CommandEvent &event);
+    // bytes consumed so far
+    size_t Offset() const {
+        return pos;
+    }
+    bool Corrupted() const {
+        return corrupted;
+    }
+
+  private:
+    bool GetVarint(uint64_t &v);
+    bool GetDelta(int64_t &prev_v, int64_t &v);
+
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    bool corrupted = false;
+    std::vector<int64_t> prev;
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "D3DApp.h"
 
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include <windowsx.h>
@@ -18,6 +21,7 @@ MainWndProc(HWND win, UINT msg, WPARAM w_param, LPARAM l_param) {
 D3DApp::D3DApp(HINSTANCE h_inst) : h_appinst(h_inst) {
     assert(g_app == nullptr);
     g_app = this;
+    exit_after_first_frame = std::strstr(GetCommandLineA(), "--first-frame") != nullptr;
 }
 
 D3DApp::~D3DApp() {
@@ -56,6 +60,9 @@ int D3DApp::Run() {
                 CalcFrameStats();
                 Update(timer);
                 Draw(timer);
+                if (first_frame_ms == 0.0) {
+                    ReportFirstFrame();
+                }
             } else {
                 Sleep(100);
             }
@@ -65,6 +72,18 @@ int D3DApp::Run() {
     return msg.wParam;
 }
 
+void D3DApp::ReportFirstFrame() {
+    first_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    const std::string line = "[init] time to first frame: " + std::to_string(first_frame_ms) + " ms\n";
+    OutputDebugStringA(line.c_str());
+    if (exit_after_first_frame) {
+        // stdout only reaches a script when redirected, the window has no console
+        std::fputs(line.c_str(), stdout);
+        std::fflush(stdout);
+        PostQuitMessage(0);
+    }
+}
+
 LRESULT D3DApp::MsgProc(HWND win, UINT msg, WPARAM w_param, LPARAM l_param) {
     switch (msg) {
         case WM_ACTIVATE: {
@@ -248,6 +267,8 @@ bool D3DApp::InitDirect3D() {
     CreateCommandObjects();
     CreateSwapChain();
     CreateDescriptorHeaps();
+    back_buffer_rtvs = p_rtv_heap->Allocate(kSwapChainBufferCnt);
+    depth_stencil_dsv = p_dsv_heap->Allocate(1);
 
     return true;
 }
@@ -292,19 +313,10 @@ void D3DApp::CreateSwapChain() {
 
 void D3DApp::CreateDescriptorHeaps() {
     // rtv
-    D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc;
-    rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-    rtv_heap_desc.NumDescriptors = kSwapChainBufferCnt;
-    rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-    rtv_heap_desc.NodeMask = 0;
-    ThrowIfFailed(p_device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&p_rtv_heap)));
+    p_rtv_heap = std::make_unique<DescriptorHeap>(p_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
+        kSwapChainBufferCnt, 0, false);
     // dsv
-    D3D12_DESCRIPTOR_HEAP_DESC dsv_heap_desc;
-    dsv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-    dsv_heap_desc.NumDescriptors = 1;
-    dsv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-    dsv_heap_desc.NodeMask = 0;
-    ThrowIfFailed(p_device->CreateDescriptorHeap(&dsv_heap_desc, IID_PPV_ARGS(&p_dsv_heap)));
+    p_dsv_heap = std::make_unique<DescriptorHeap>(p_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, 0, false);
 }
 
 void D3DApp::OnResize() {
@@ -326,11 +338,10 @@ void D3DApp::OnResize() {
         DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH));
     curr_back_buffer = 0;
     // create rtv
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_heap_handle(p_rtv_heap->GetCPUDescriptorHandleForHeapStart());
     for (int i = 0; i < kSwapChainBufferCnt; i++) {
         ThrowIfFailed(p_swap_chain->GetBuffer(i, IID_PPV_ARGS(&swap_chain_buffers[i])));
-        p_device->CreateRenderTargetView(swap_chain_buffers[i].Get(), nullptr, rtv_heap_handle);
-        rtv_heap_handle.Offset(1, rtv_descriptor_size);
+        p_device->CreateRenderTargetView(swap_chain_buffers[i].Get(), nullptr,
+            p_rtv_heap->CpuHandle(back_buffer_rtvs.offset + i));
     }
 
     // create depth/stencil buffer resource
@@ -415,11 +426,10 @@ ID3D12Resource *D3DApp::CurrBackBuffer() const {
     return swap_chain_buffers[curr_back_buffer].Get();
 }
 D3D12_CPU_DESCRIPTOR_HANDLE D3DApp::CurrBackBufferView() const {
-    return CD3DX12_CPU_DESCRIPTOR_HANDLE(
-        p_rtv_heap->GetCPUDescriptorHandleForHeapStart(), curr_back_buffer, rtv_descriptor_size);
+    return p_rtv_heap->CpuHandle(back_buffer_rtvs.offset + curr_back_buffer);
 }
 D3D12_CPU_DESCRIPTOR_HANDLE D3DApp::DepthStencilView() const {
-    return p_dsv_heap->GetCPUDescriptorHandleForHeapStart();
+    return p_dsv_heap->CpuHandle(depth_stencil_dsv);
 }
 
 void D3DApp::LogAdapters() {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <string>
 
 #if defined(DEBUG) || defined(_DEBUG)
@@ -12,6 +14,7 @@
 #include <dxgi1_5.h>
 #include <d3d12.h>
 
+#include "DescriptorHeap.h"
 #include "Timer.h"
 
 class D3DApp {
@@ -28,6 +31,8 @@ class D3DApp {
 
     virtual bool Initialize();
 
+    // with '--first-frame' on the command line, quit after the first frame and print its time (ms) to stdout,
+    // e.g. for timing startup of a chapter from a script
     int Run();
     virtual LRESULT MsgProc(HWND win, UINT msg, WPARAM w_param, LPARAM l_param);
 
@@ -51,6 +56,8 @@ class D3DApp {
 
     void FlushCommandQueue();
     void CalcFrameStats();
+    // time from construction of the app to the end of the first Draw(), written to the debug output
+    void ReportFirstFrame();
 
     ID3D12Resource *CurrBackBuffer() const;
     D3D12_CPU_DESCRIPTOR_HANDLE CurrBackBufferView() const;
@@ -88,8 +95,11 @@ class D3DApp {
     DXGI_FORMAT back_buffer_fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
     DXGI_FORMAT depth_stencil_fmt = DXGI_FORMAT_D24_UNORM_S8_UINT;
 
-    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> p_rtv_heap;
-    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> p_dsv_heap;
+    // a chapter needing more rtvs or dsvs makes larger heaps in CreateDescriptorHeaps() and allocates the rest
+    std::unique_ptr<DescriptorHeap> p_rtv_heap;
+    std::unique_ptr<DescriptorHeap> p_dsv_heap;
+    DescriptorRange back_buffer_rtvs;
+    DescriptorRange depth_stencil_dsv;
     UINT rtv_descriptor_size = 0;
     UINT dsv_descriptor_size = 0;
     UINT cbv_srv_uav_descriptor_size = 0;
@@ -103,4 +113,8 @@ class D3DApp {
     int client_width = 960;
     int client_height = 540;
     Timer timer;
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    double first_frame_ms = 0.0;
+    bool exit_after_first_frame = false;
 };
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "D3DUtil.h"
+
+// command list with its own allocator, the d3d implementation of List used by ParallelRecorder
+class D3DCommandList {
+  public:
+    D3DCommandList(ID3D12Device *device, D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT) {
+        ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&p_cmd_alloc)));
+        ThrowIfFailed(device->CreateCommandList(0, type, p_cmd_alloc.Get(), nullptr,
+            IID_PPV_ARGS(&p_cmd_list)));
+        // start in closed state so that Reset() can be called
+        ThrowIfFailed(p_cmd_list->Close());
+    }
+    D3DCommandList(const D3DCommandList &rhs) = delete;
+    D3DCommandList &operator=(const D3DCommandList &rhs) = delete;
+
+    // caller guarantees that gpu has finished previously recorded commands
+    void Reset(ID3D12PipelineState *pso = nullptr) {
+        ThrowIfFailed(p_cmd_alloc->Reset());
+        ThrowIfFailed(p_cmd_list->Reset(p_cmd_alloc.Get(), pso));
+    }
+    void Close() {
+        ThrowIfFailed(p_cmd_list->Close());
+    }
+
+    ID3D12GraphicsCommandList *Get() const {
+        return p_cmd_list.Get();
+    }
+
+  private:
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> p_cmd_alloc;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> p_cmd_list;
+};
\ No newline at end of file
@@ -4,8 +4,20 @@
 
 #include <d3dcompiler.h>
 
+#include "../defines.h"
+#include "ShaderCache.h"
+
 using Microsoft::WRL::ComPtr;
 
+namespace {
+
+ShaderCache &GetShaderCache() {
+    static ShaderCache cache(shader_cache_path);
+    return cache;
+}
+
+}
+
 ComPtr<ID3DBlob> D3DUtil::LoadBinary(const std::wstring &filename) {
     std::ifstream fin(filename, std::ios::binary);
 
@@ -22,6 +34,24 @@ ComPtr<ID3DBlob> D3DUtil::LoadBinary(const std::wstring &filename) {
     return blob;
 }
 
+ComPtr<ID3DBlob> D3DUtil::LoadBinary(const std::wstring &filename, UINT64 offset, UINT64 size) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin || !fin.seekg(offset, std::ios::beg)) {
+        return nullptr;
+    }
+
+    ComPtr<ID3DBlob> blob;
+    ThrowIfFailed(D3DCreateBlob(size, &blob));
+
+    fin.read((char *) blob->GetBufferPointer(), size);
+    if (fin.gcount() != (std::streamsize) size) {
+        return nullptr;
+    }
+    fin.close();
+
+    return blob;
+}
+
 ComPtr<ID3DBlob> D3DUtil::CompileShader(const std::wstring &filename,
         const D3D_SHADER_MACRO *defines, const std::string &entry,
         const std::string &target) {
@@ -30,6 +60,21 @@ ComPtr<ID3DBlob> D3DUtil::CompileShader(const std::wstring &filename,
     compile_flag = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
+    ShaderCache::Defines cache_defines;
+    for (auto def = defines; def != nullptr && def->Name != nullptr; def++) {
+        cache_defines.emplace_back(def->Name, def->Definition != nullptr ? def->Definition : "");
+    }
+    auto &cache = GetShaderCache();
+    UINT64 key = cache.Key(filename, cache_defines, entry, target, compile_flag);
+    ShaderCache::Entry cached;
+    if (cache.Find(key, cached)) {
+        // a blob that can't be read back intact is a miss, it is compiled and stored again
+        auto blob = LoadBinary(cache.File().wstring(), cached.offset, cached.size);
+        if (blob != nullptr && ShaderCache::Hash(blob->GetBufferPointer(), blob->GetBufferSize()) == cached.hash) {
+            return blob;
+        }
+    }
+
     HRESULT hr = S_OK;
 
     ComPtr<ID3DBlob> code = nullptr;
@@ -44,6 +89,8 @@ ComPtr<ID3DBlob> D3DUtil::CompileShader(const std::wstring &filename,
 
     ThrowIfFailed(hr);
 
+    cache.Store(key, code->GetBufferPointer(), code->GetBufferSize());
+
     return code;
 }
 
@@ -85,7 +132,7 @@ ComPtr<ID3D12Resource> D3DUtil::CreateDefaultBuffer(ID3D12Device *device,
 
 D3D12_VERTEX_BUFFER_VIEW MeshGeometry::VertexBufferView() const {
     D3D12_VERTEX_BUFFER_VIEW vbv;
-    vbv.BufferLocation = vb_gpu->GetGPUVirtualAddress();
+    vbv.BufferLocation = vb_gpu->GetGPUVirtualAddress() + vb_offset;
     vbv.SizeInBytes = vb_size;
     vbv.StrideInBytes = vb_stride;
     return vbv;
@@ -93,7 +140,7 @@ D3D12_VERTEX_BUFFER_VIEW MeshGeometry::VertexBufferView() const {
 
 D3D12_INDEX_BUFFER_VIEW MeshGeometry::IndexBufferView() const {
     D3D12_INDEX_BUFFER_VIEW ibv;
-    ibv.BufferLocation = ib_gpu->GetGPUVirtualAddress();
+    ibv.BufferLocation = ib_gpu->GetGPUVirtualAddress() + ib_offset;
     ibv.Format = index_fmt;
     ibv.SizeInBytes = ib_size;
     return ibv;
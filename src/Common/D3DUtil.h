@@ -25,7 +25,11 @@ class D3DUtil {
 
     // load shader from cso(compiled shader object) binary file
     static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring &filename);
+    // load a part of binary file, used to read bytecode from shader cache file
+    // null if the file can't be opened or ends before offset + size
+    static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring &filename, UINT64 offset, UINT64 size);
     // compiler shader from hlsl file
+    // compiled bytecode is cached on disk (see ShaderCache) and reused if source and its includes are unchanged
     static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(const std::wstring &filename,
         const D3D_SHADER_MACRO *defines, const std::string &entry, const std::string &target);
 
@@ -61,6 +65,9 @@ struct MeshGeometry {
     UINT vb_size = 0;
     DXGI_FORMAT index_fmt = DXGI_FORMAT_R16_UINT;
     UINT ib_size = 0;
+    // byte offset of data in x_gpu, which is shared by meshes when it comes from a BufferHeap
+    UINT64 vb_offset = 0;
+    UINT64 ib_offset = 0;
 
     std::unordered_map<std::string, SubmeshGeometry> draw_args;
 
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <random>
+#include <cmath>
+
+#include "Random.h"
 
 #include <DirectXMath.h>
 #include <DirectXPackedVector.h>
@@ -17,21 +19,12 @@ class DXMath {
         return eye;
     }
 
+    // thread-safe, each thread draws from its own stream
     static int RandI(int l, int r) {
-        if (!rnd_init) {
-            rnd_gen.seed(rnd_dv());
-            rnd_init = true;
-        }
-        std::uniform_int_distribution<> rnd_int(l, r);
-        return rnd_int(rnd_gen);
+        return Random::ThreadLocal().RandI(l, r);
     }
     static float RandF(float l, float r) {
-        if (!rnd_init) {
-            rnd_gen.seed(rnd_dv());
-            rnd_init = true;
-        }
-        std::uniform_real_distribution<> rnd_real(l, r);
-        return rnd_real(rnd_gen);
+        return Random::ThreadLocal().RandF(l, r);
     }
 
     static DirectX::XMVECTOR Spherical2Cartesian(float radius, float theta, float phi) {
@@ -42,9 +35,4 @@ class DXMath {
             1.0f
         );
     }
-
-  private:
-    inline static bool rnd_init = false;
-    inline static std::random_device rnd_dv;
-    inline static std::mt19937 rnd_gen;
 };
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "DepthSort.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DEPTHSORT_SSE2
+#endif
+
+namespace {
+
+// items per block at least, a block is the unit of work of every stage
+const size_t kMinItemsPerBlock = 4096;
+// key = depth (24 bits) | material (16 bits) | index (24 bits), index bits need no sorting
+const int kMaterialShift = 24;
+const int kDepthShift = 40;
+const uint64_t kIndexMask = (uint64_t(1) << kMaterialShift) - 1;
+const float kMaxQuantized = static_cast<float>((1 << kDepthSortBits) - 1);
+
+void ComputeDepths(const float (*centers)[3], size_t begin, size_t end, const float eye[3], const float look[3],
+        float *depths, float &min_depth, float &max_depth) {
+    // depth = dot(center, look) - dot(eye, look)
+    const float base = eye[0] * look[0] + eye[1] * look[1] + eye[2] * look[2];
+    float min_d = FLT_MAX;
+    float max_d = -FLT_MAX;
+    size_t i = begin;
+#ifdef DEPTHSORT_SSE2
+    const __m128 lx = _mm_set1_ps(look[0]);
+    const __m128 ly = _mm_set1_ps(look[1]);
+    const __m128 lz = _mm_set1_ps(look[2]);
+    const __m128 b = _mm_set1_ps(base);
+    __m128 min4 = _mm_set1_ps(FLT_MAX);
+    __m128 max4 = _mm_set1_ps(-FLT_MAX);
+    for (; i + 4 <= end; i += 4) {
+        const float (*c)[3] = centers + i;
+        const __m128 cx = _mm_setr_ps(c[0][0], c[1][0], c[2][0], c[3][0]);
+        const __m128 cy = _mm_setr_ps(c[0][1], c[1][1], c[2][1], c[3][1]);
+        const __m128 cz = _mm_setr_ps(c[0][2], c[1][2], c[2][2], c[3][2]);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, lx), _mm_mul_ps(cy, ly)), _mm_mul_ps(cz, lz));
+        d = _mm_sub_ps(d, b);
+        _mm_storeu_ps(depths + i, d);
+        min4 = _mm_min_ps(min4, d);
+        max4 = _mm_max_ps(max4, d);
+    }
+    alignas(16) float mins[4], maxs[4];
+    _mm_store_ps(mins, min4);
+    _mm_store_ps(maxs, max4);
+    for (int k = 0; k < 4; k++) {
+        min_d = std::min(min_d, mins[k]);
+        max_d = std::max(max_d, maxs[k]);
+    }
+#endif
+    for (; i < end; i++) {
+        const float *c = centers[i];
+        const float d = (c[0] * look[0] + c[1] * look[1]) + c[2] * look[2] - base;
+        depths[i] = d;
+        min_d = std::min(min_d, d);
+        max_d = std::max(max_d, d);
+    }
+    min_depth = min_d;
+    max_depth = max_d;
+}
+
+void BuildKeys(const float *depths, const uint32_t *materials, size_t begin, size_t end, float max_depth,
+        float scale, uint64_t *keys) {
+    auto key = [&](size_t i, uint32_t q) {
+        const uint64_t mat = materials != nullptr ? materials[i] : 0;
+        assert(mat < kDepthSortMaxMaterial);
+        return ((uint64_t) q << kDepthShift) | (mat << kMaterialShift) | (uint64_t) i;
+    };
+    size_t i = begin;
+#ifdef DEPTHSORT_SSE2
+    // far items get small keys
+    const __m128 max4 = _mm_set1_ps(max_depth);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 limit = _mm_set1_ps(kMaxQuantized);
+    for (; i + 4 <= end; i += 4) {
+        __m128 q = _mm_mul_ps(_mm_sub_ps(max4, _mm_loadu_ps(depths + i)), scale4);
+        q = _mm_min_ps(q, limit);
+        alignas(16) uint32_t qs[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(qs), _mm_cvttps_epi32(q));
+        for (int k = 0; k < 4; k++) {
+            keys[i + k] = key(i + k, qs[k]);
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        const float q = std::min((max_depth - depths[i]) * scale, kMaxQuantized);
+        keys[i] = key(i, static_cast<uint32_t>(q));
+    }
+}
+
+}
+
+void DepthSorter::Sort(JobSystem &jobs, const float (*centers)[3], const uint32_t *materials, size_t n,
+        const float eye[3], const float look[3], uint32_t *order) {
+    assert(n <= kDepthSortMaxItems);
+    if (n == 0) {
+        return;
+    }
+
+    const size_t n_block = std::clamp<size_t>(n / kMinItemsPerBlock, 1, 4 * jobs.ThreadCount());
+    blocks.resize(n_block);
+    for (size_t b = 0; b < n_block; b++) {
+        blocks[b].begin = n * b / n_block;
+        blocks[b].end = n * (b + 1) / n_block;
+    }
+    depths.resize(n);
+    keys.resize(n);
+    keys_tmp.resize(n);
+
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        Block &block = blocks[b];
+        ComputeDepths(centers, block.begin, block.end, eye, look, depths.data(), block.min_depth, block.max_depth);
+    });
+    float min_depth = FLT_MAX;
+    float max_depth = -FLT_MAX;
+    for (const Block &block : blocks) {
+        min_depth = std::min(min_depth, block.min_depth);
+        max_depth = std::max(max_depth, block.max_depth);
+    }
+    const float scale = max_depth > min_depth ? kMaxQuantized / (max_depth - min_depth) : 0.0f;
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        BuildKeys(depths.data(), materials, blocks[b].begin, blocks[b].end, max_depth, scale, keys.data());
+    });
+
+    // index bits are unique and already in order, only material & depth digits are sorted
+    uint64_t *src = keys.data();
+    uint64_t *dst = keys_tmp.data();
+    for (int shift = kMaterialShift; shift < 64; shift += 8) {
+        jobs.ParallelFor(0, n_block, [&](size_t b) {
+            Block &block = blocks[b];
+            std::fill(std::begin(block.count), std::end(block.count), 0);
+            for (size_t i = block.begin; i < block.end; i++) {
+                ++block.count[(src[i] >> shift) & 0xff];
+            }
+        });
+        // a digit shared by all keys leaves the order as it is
+        bool b_skip = false;
+        uint32_t offset = 0;
+        for (int d = 0; d < 256 && !b_skip; d++) {
+            uint32_t n_digit = 0;
+            for (Block &block : blocks) {
+                const uint32_t count = block.count[d];
+                block.count[d] = offset + n_digit;
+                n_digit += count;
+            }
+            b_skip = n_digit == n;
+            offset += n_digit;
+        }
+        if (b_skip) {
+            continue;
+        }
+        jobs.ParallelFor(0, n_block, [&](size_t b) {
+            Block &block = blocks[b];
+            for (size_t i = block.begin; i < block.end; i++) {
+                const uint64_t key = src[i];
+                dst[block.count[(key >> shift) & 0xff]++] = key;
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            order[i] = static_cast<uint32_t>(src[i] & kIndexMask);
+        }
+    });
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+// back-to-front order of transparent draws
+// depth of an item is the distance of its center along the look direction, quantized to kDepthSortBits
+// over the depth range of the items of the call, items of the same quantized depth are ordered by material
+// (so draws of a material stay together), then by their index, i.e. the sort is stable
+// keys (depth, material, index) are sorted by a parallel LSD radix sort with 8-bit digits
+
+const int kDepthSortBits = 24;
+const size_t kDepthSortMaxItems = size_t(1) << 24;
+const uint32_t kDepthSortMaxMaterial = 1u << 16;
+
+class DepthSorter {
+  public:
+    // order gets n indices, the farthest item first
+    // look needs not to be normalized, materials may be nullptr, every material must be < kDepthSortMaxMaterial
+    // scratch memory is kept between calls
+    void Sort(JobSystem &jobs, const float (*centers)[3], const uint32_t *materials, size_t n, const float eye[3],
+        const float look[3], uint32_t *order);
+
+  private:
+    struct Block {
+        size_t begin;
+        size_t end;
+        float min_depth;
+        float max_depth;
+        uint32_t count[256]; // histogram of the digit, then where its items go
+    };
+
+    std::vector<Block> blocks;
+    std::vector<float> depths;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> keys_tmp;
+};
\ No newline at end of file
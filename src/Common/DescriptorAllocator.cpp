@@ -0,0 +1,130 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+void DescriptorAllocator::Reset(uint32_t n_persistent, uint32_t n_transient) {
+    assert((uint64_t) n_persistent + n_transient <= UINT32_MAX);
+    this->n_persistent = n_persistent;
+    this->n_transient = n_transient;
+    free_ranges.clear();
+    if (n_persistent > 0) {
+        free_ranges.push_back({ 0, n_persistent });
+    }
+    n_persistent_free = n_persistent;
+    head = 0;
+    n_transient_used = 0;
+    n_frame_used = 0;
+    frames.clear();
+}
+
+bool DescriptorAllocator::Allocate(uint32_t count, DescriptorRange &range) {
+    assert(count > 0);
+    auto it = std::find_if(free_ranges.begin(), free_ranges.end(), [count](const DescriptorRange &r) {
+        return r.count >= count;
+    });
+    if (it == free_ranges.end()) {
+        return false;
+    }
+    range = { it->offset, count };
+    if (it->count == count) {
+        free_ranges.erase(it);
+    } else {
+        it->offset += count;
+        it->count -= count;
+    }
+    n_persistent_free -= count;
+    return true;
+}
+
+DescriptorRange DescriptorAllocator::Allocate(uint32_t count) {
+    DescriptorRange range;
+    if (!Allocate(count, range)) {
+        throw std::runtime_error("out of persistent descriptors: no free range of " + std::to_string(count) + ", " +
+            std::to_string(n_persistent_free) + " of " + std::to_string(n_persistent) + " free");
+    }
+    return range;
+}
+
+void DescriptorAllocator::Free(const DescriptorRange &range) {
+    if (range.count == 0) {
+        return;
+    }
+    assert(range.offset + range.count <= n_persistent);
+    auto next = std::lower_bound(free_ranges.begin(), free_ranges.end(), range.offset,
+        [](const DescriptorRange &r, uint32_t offset) {
+            return r.offset < offset;
+        });
+    // freeing a range twice or one that was never allocated
+    assert(next == free_ranges.end() || range.offset + range.count <= next->offset);
+    assert(next == free_ranges.begin() || std::prev(next)->offset + std::prev(next)->count <= range.offset);
+    n_persistent_free += range.count;
+
+    const bool b_merge_prev = next != free_ranges.begin()
+        && std::prev(next)->offset + std::prev(next)->count == range.offset;
+    const bool b_merge_next = next != free_ranges.end() && range.offset + range.count == next->offset;
+    if (b_merge_prev && b_merge_next) {
+        std::prev(next)->count += range.count + next->count;
+        free_ranges.erase(next);
+    } else if (b_merge_prev) {
+        std::prev(next)->count += range.count;
+    } else if (b_merge_next) {
+        next->offset = range.offset;
+        next->count += range.count;
+    } else {
+        free_ranges.insert(next, range);
+    }
+}
+
+bool DescriptorAllocator::AllocateTransient(uint32_t count, DescriptorRange &range) {
+    assert(count > 0);
+    const uint32_t n_free = n_transient - n_transient_used;
+    if (head + count > n_transient) {
+        // a range never wraps around, the rest of the ring is skipped and comes back with this frame
+        const uint32_t n_skip = n_transient - head;
+        if (count > n_transient || n_skip + count > n_free) {
+            return false;
+        }
+        n_transient_used += n_skip;
+        n_frame_used += n_skip;
+        head = 0;
+    } else if (count > n_free) {
+        return false;
+    }
+    range = { n_persistent + head, count };
+    head = head + count == n_transient ? 0 : head + count;
+    n_transient_used += count;
+    n_frame_used += count;
+    return true;
+}
+
+DescriptorRange DescriptorAllocator::AllocateTransient(uint32_t count) {
+    DescriptorRange range;
+    if (!AllocateTransient(count, range)) {
+        throw std::runtime_error("out of transient descriptors: no room for " + std::to_string(count) + ", " +
+            std::to_string(n_transient_used) + " of " + std::to_string(n_transient) + " in flight");
+    }
+    return range;
+}
+
+void DescriptorAllocator::EndFrame(uint64_t fence) {
+    if (n_frame_used == 0) {
+        return;
+    }
+    assert(frames.empty() || frames.back().fence <= fence);
+    frames.push_back({ fence, n_frame_used });
+    n_frame_used = 0;
+}
+
+void DescriptorAllocator::Retire(uint64_t completed_fence) {
+    while (!frames.empty() && frames.front().fence <= completed_fence) {
+        n_transient_used -= frames.front().n_used;
+        frames.pop_front();
+    }
+    if (n_transient_used == 0) {
+        // an empty ring starts over, so large ranges fit again
+        head = 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// index bookkeeping of a descriptor heap, nothing here touches D3D (see DescriptorHeap.h for that)
+// the heap is split into two regions:
+//   [0, n_persistent)                          persistent, first fit in a free list, freed ranges are coalesced
+//   [n_persistent, n_persistent + n_transient) transient, a ring for views that live for one frame,
+//                                              reclaimed when the fence of the frame that used them completes
+// every allocation is a contiguous range, so it can be bound as a descriptor table
+
+// descriptors [offset, offset + count) of the heap
+struct DescriptorRange {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
+class DescriptorAllocator {
+  public:
+    explicit DescriptorAllocator(uint32_t n_persistent = 0, uint32_t n_transient = 0) {
+        Reset(n_persistent, n_transient);
+    }
+
+    // forget all allocations
+    void Reset(uint32_t n_persistent, uint32_t n_transient);
+
+    // false if there is no free range of count descriptors
+    bool Allocate(uint32_t count, DescriptorRange &range);
+    // throws std::runtime_error instead, for heaps sized up front, where running out is a bug of the sizes
+    DescriptorRange Allocate(uint32_t count);
+    void Free(const DescriptorRange &range);
+
+    // valid until the fence passed to the next EndFrame() completes
+    bool AllocateTransient(uint32_t count, DescriptorRange &range);
+    DescriptorRange AllocateTransient(uint32_t count);
+    // transient ranges allocated since the last EndFrame() belong to the frame signaling fence
+    void EndFrame(uint64_t fence);
+    // reclaim transient ranges of frames whose fence is at most completed_fence
+    void Retire(uint64_t completed_fence);
+
+    uint32_t Capacity() const {
+        return n_persistent + n_transient;
+    }
+    uint32_t PersistentCapacity() const {
+        return n_persistent;
+    }
+    uint32_t TransientCapacity() const {
+        return n_transient;
+    }
+    // free persistent descriptors, maybe not contiguous
+    uint32_t PersistentFreeCount() const {
+        return n_persistent_free;
+    }
+    uint32_t TransientUsedCount() const {
+        return n_transient_used;
+    }
+
+  private:
+    // transient descriptors used by a frame
+    struct Frame {
+        uint64_t fence;
+        uint32_t n_used;
+    };
+
+    uint32_t n_persistent = 0;
+    uint32_t n_transient = 0;
+
+    // sorted by offset, never adjacent
+    std::vector<DescriptorRange> free_ranges;
+    uint32_t n_persistent_free = 0;
+
+    // ring positions are relative to the transient region, allocations go from head on,
+    // the n_transient_used descriptors before head are in use, so frames are reclaimed in order
+    uint32_t head = 0;
+    uint32_t n_transient_used = 0;
+    // used by the current frame, skipped space at the end of the ring included
+    uint32_t n_frame_used = 0;
+    std::deque<Frame> frames;
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cassert>
+
+#include "D3DUtil.h"
+#include "DescriptorAllocator.h"
+
+// a descriptor heap whose descriptors are handed out by a DescriptorAllocator
+class DescriptorHeap {
+  public:
+    DescriptorHeap(ID3D12Device *device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT n_persistent, UINT n_transient,
+            bool shader_visible) : allocator(n_persistent, n_transient) {
+        D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
+        heap_desc.NumDescriptors = n_persistent + n_transient;
+        heap_desc.Type = type;
+        heap_desc.Flags = shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE
+            : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        ThrowIfFailed(device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+        inc_size = device->GetDescriptorHandleIncrementSize(type);
+        this->shader_visible = shader_visible;
+    }
+    DescriptorHeap(const DescriptorHeap &rhs) = delete;
+    DescriptorHeap &operator=(const DescriptorHeap &rhs) = delete;
+
+    ID3D12DescriptorHeap *Heap() const {
+        return heap.Get();
+    }
+    UINT IncrementSize() const {
+        return inc_size;
+    }
+
+    // running out of descriptors is a bug of the sizes given to the ctor, it throws std::runtime_error
+    DescriptorRange Allocate(UINT count) {
+        return allocator.Allocate(count);
+    }
+    void Free(const DescriptorRange &range) {
+        allocator.Free(range);
+    }
+    DescriptorRange AllocateTransient(UINT count) {
+        return allocator.AllocateTransient(count);
+    }
+    void EndFrame(UINT64 fence) {
+        allocator.EndFrame(fence);
+    }
+    void Retire(UINT64 completed_fence) {
+        allocator.Retire(completed_fence);
+    }
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index) const {
+        return CD3DX12_CPU_DESCRIPTOR_HANDLE(heap->GetCPUDescriptorHandleForHeapStart(), index, inc_size);
+    }
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index) const {
+        assert(shader_visible);
+        return CD3DX12_GPU_DESCRIPTOR_HANDLE(heap->GetGPUDescriptorHandleForHeapStart(), index, inc_size);
+    }
+    CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(const DescriptorRange &range) const {
+        return CpuHandle(range.offset);
+    }
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(const DescriptorRange &range) const {
+        return GpuHandle(range.offset);
+    }
+
+    const DescriptorAllocator &Allocator() const {
+        return allocator;
+    }
+
+  private:
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+    UINT inc_size = 0;
+    bool shader_visible = false;
+    DescriptorAllocator allocator;
+};
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "Fft.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FFT_SSE2
+#endif
+
+namespace {
+
+// 4 floats, a register with SSE2 and a plain array without, both give the same results
+#ifdef FFT_SSE2
+using Lane = __m128;
+
+inline Lane Load(const float *p) {
+    return _mm_loadu_ps(p);
+}
+inline void Store(float *p, Lane v) {
+    _mm_storeu_ps(p, v);
+}
+inline Lane Splat(float f) {
+    return _mm_set1_ps(f);
+}
+inline Lane Add(Lane a, Lane b) {
+    return _mm_add_ps(a, b);
+}
+inline Lane Sub(Lane a, Lane b) {
+    return _mm_sub_ps(a, b);
+}
+inline Lane Mul(Lane a, Lane b) {
+    return _mm_mul_ps(a, b);
+}
+#else
+struct Lane {
+    float v[4];
+};
+
+inline Lane Load(const float *p) {
+    return { { p[0], p[1], p[2], p[3] } };
+}
+inline void Store(float *p, Lane v) {
+    std::copy_n(v.v, 4, p);
+}
+inline Lane Splat(float f) {
+    return { { f, f, f, f } };
+}
+inline Lane Add(Lane a, Lane b) {
+    return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+}
+inline Lane Sub(Lane a, Lane b) {
+    return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+}
+inline Lane Mul(Lane a, Lane b) {
+    return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+}
+#endif
+
+struct Complex4 {
+    Lane re;
+    Lane im;
+};
+
+inline Complex4 LoadComplex(const float *re, const float *im) {
+    return { Load(re), Load(im) };
+}
+inline Complex4 SplatComplex(float re, float im) {
+    return { Splat(re), Splat(im) };
+}
+inline void StoreComplex(float *re, float *im, const Complex4 &c) {
+    Store(re, c.re);
+    Store(im, c.im);
+}
+inline Complex4 Add(const Complex4 &a, const Complex4 &b) {
+    return { Add(a.re, b.re), Add(a.im, b.im) };
+}
+inline Complex4 Sub(const Complex4 &a, const Complex4 &b) {
+    return { Sub(a.re, b.re), Sub(a.im, b.im) };
+}
+inline Complex4 Mul(const Complex4 &a, const Complex4 &b) {
+    return { Sub(Mul(a.re, b.re), Mul(a.im, b.im)), Add(Mul(a.re, b.im), Mul(a.im, b.re)) };
+}
+
+// two radix-2 stages on x0..x3 at p, p + stride, p + 2 stride & p + 3 stride, 4 butterflies side by side
+// w1 twiddles both pairs of the first stage, w2 & w3 the pairs (x0, x2) & (x1, x3) of the second
+inline void Radix4(float *re, float *im, size_t stride, const Complex4 &w1, const Complex4 &w2, const Complex4 &w3) {
+    const Complex4 x0 = LoadComplex(re, im);
+    const Complex4 x1 = Mul(w1, LoadComplex(re + stride, im + stride));
+    const Complex4 x2 = LoadComplex(re + 2 * stride, im + 2 * stride);
+    const Complex4 x3 = Mul(w1, LoadComplex(re + 3 * stride, im + 3 * stride));
+    const Complex4 a0 = Add(x0, x1);
+    const Complex4 a1 = Sub(x0, x1);
+    const Complex4 a2 = Mul(w2, Add(x2, x3));
+    const Complex4 a3 = Mul(w3, Sub(x2, x3));
+    StoreComplex(re, im, Add(a0, a2));
+    StoreComplex(re + stride, im + stride, Add(a1, a3));
+    StoreComplex(re + 2 * stride, im + 2 * stride, Sub(a0, a2));
+    StoreComplex(re + 3 * stride, im + 3 * stride, Sub(a1, a3));
+}
+
+inline void Radix2(float *re, float *im, size_t stride, const Complex4 &w) {
+    const Complex4 x0 = LoadComplex(re, im);
+    const Complex4 x1 = Mul(w, LoadComplex(re + stride, im + stride));
+    StoreComplex(re, im, Add(x0, x1));
+    StoreComplex(re + stride, im + stride, Sub(x0, x1));
+}
+
+}
+
+Fft2D::Fft2D(uint32_t n) : n(n) {
+    assert(n >= 4 && (n & (n - 1)) == 0);
+
+    twiddle_re.resize(n);
+    twiddle_im.resize(n);
+    const double pi = 3.14159265358979323846;
+    for (uint32_t h = 1; h < n; h *= 2) {
+        for (uint32_t j = 0; j < h; j++) {
+            const double angle = -pi * j / h;
+            twiddle_re[h + j] = (float) std::cos(angle);
+            twiddle_im[h + j] = (float) std::sin(angle);
+        }
+    }
+
+    uint32_t log2_n = 0;
+    while ((1u << log2_n) < n) {
+        log2_n++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t rev = 0;
+        for (uint32_t b = 0; b < log2_n; b++) {
+            rev |= ((i >> b) & 1) << (log2_n - 1 - b);
+        }
+        if (i < rev) {
+            swaps.push_back(i);
+            swaps.push_back(rev);
+        }
+    }
+}
+
+void Fft2D::TransformRow(float *re, float *im) const {
+    for (size_t s = 0; s < swaps.size(); s += 2) {
+        std::swap(re[swaps[s]], re[swaps[s + 1]]);
+        std::swap(im[swaps[s]], im[swaps[s + 1]]);
+    }
+
+    // stages of half size 1 & 2, all twiddles are 1 but the last one, -i
+    for (uint32_t g = 0; g < n; g += 4) {
+        const float a0_re = re[g] + re[g + 1], a0_im = im[g] + im[g + 1];
+        const float a1_re = re[g] - re[g + 1], a1_im = im[g] - im[g + 1];
+        const float a2_re = re[g + 2] + re[g + 3], a2_im = im[g + 2] + im[g + 3];
+        const float a3_re = re[g + 2] - re[g + 3], a3_im = im[g + 2] - im[g + 3];
+        re[g] = a0_re + a2_re;
+        im[g] = a0_im + a2_im;
+        re[g + 1] = a1_re + a3_im;
+        im[g + 1] = a1_im - a3_re;
+        re[g + 2] = a0_re - a2_re;
+        im[g + 2] = a0_im - a2_im;
+        re[g + 3] = a1_re - a3_im;
+        im[g + 3] = a1_im + a3_re;
+    }
+
+    // h is at least 4 from here on, so 4 butterflies with consecutive twiddles go together
+    uint32_t h = 4;
+    for (; 4 * h <= n; h *= 4) {
+        for (uint32_t g = 0; g < n; g += 4 * h) {
+            for (uint32_t j = 0; j < h; j += 4) {
+                const Complex4 w1 = LoadComplex(&twiddle_re[h + j], &twiddle_im[h + j]);
+                const Complex4 w2 = LoadComplex(&twiddle_re[2 * h + j], &twiddle_im[2 * h + j]);
+                const Complex4 w3 = LoadComplex(&twiddle_re[3 * h + j], &twiddle_im[3 * h + j]);
+                Radix4(re + g + j, im + g + j, h, w1, w2, w3);
+            }
+        }
+    }
+    if (h < n) {
+        for (uint32_t j = 0; j < h; j += 4) {
+            Radix2(re + j, im + j, h, LoadComplex(&twiddle_re[h + j], &twiddle_im[h + j]));
+        }
+    }
+}
+
+void Fft2D::TransformColumns(float *re, float *im, uint32_t col, uint32_t n_col) const {
+    // the same passes as rows, every butterfly runs across the columns of the block with one twiddle
+    for (size_t s = 0; s < swaps.size(); s += 2) {
+        float *re_a = re + (size_t) swaps[s] * n + col, *re_b = re + (size_t) swaps[s + 1] * n + col;
+        float *im_a = im + (size_t) swaps[s] * n + col, *im_b = im + (size_t) swaps[s + 1] * n + col;
+        std::swap_ranges(re_a, re_a + n_col, re_b);
+        std::swap_ranges(im_a, im_a + n_col, im_b);
+    }
+
+    const Complex4 one = SplatComplex(1.0f, 0.0f);
+    const Complex4 minus_i = SplatComplex(0.0f, -1.0f);
+    uint32_t h = 1;
+    for (; 4 * h <= n; h *= 4) {
+        const size_t stride = (size_t) h * n;
+        for (uint32_t g = 0; g < n; g += 4 * h) {
+            for (uint32_t j = 0; j < h; j++) {
+                const Complex4 w1 = h == 1 ? one : SplatComplex(twiddle_re[h + j], twiddle_im[h + j]);
+                const Complex4 w2 = h == 1 ? one : SplatComplex(twiddle_re[2 * h + j], twiddle_im[2 * h + j]);
+                const Complex4 w3 = h == 1 ? minus_i : SplatComplex(twiddle_re[3 * h + j], twiddle_im[3 * h + j]);
+                const size_t offset = (size_t) (g + j) * n + col;
+                for (uint32_t c = 0; c < n_col; c += 4) {
+                    Radix4(re + offset + c, im + offset + c, stride, w1, w2, w3);
+                }
+            }
+        }
+    }
+    if (h < n) {
+        const size_t stride = (size_t) h * n;
+        for (uint32_t j = 0; j < h; j++) {
+            const Complex4 w = SplatComplex(twiddle_re[h + j], twiddle_im[h + j]);
+            const size_t offset = (size_t) j * n + col;
+            for (uint32_t c = 0; c < n_col; c += 4) {
+                Radix2(re + offset + c, im + offset + c, stride, w);
+            }
+        }
+    }
+}
+
+void Fft2D::Transform(JobSystem &jobs, float *re, float *im, bool inverse) const {
+    // swapping the planes maps x to i conj(x), and forward(i conj(x)) is i conj(inverse(x)),
+    // so the inverse is the forward transform of the swapped planes
+    if (inverse) {
+        std::swap(re, im);
+    }
+
+    jobs.ParallelFor(0, n, [this, re, im](size_t row) {
+        TransformRow(re + row * n, im + row * n);
+    }, std::max<size_t>(1, 4096 / n));
+
+    const uint32_t n_col = std::min(n, kBlockSize);
+    jobs.ParallelFor(0, n / n_col, [this, re, im, n_col](size_t block) {
+        TransformColumns(re, im, (uint32_t) block * n_col, n_col);
+    });
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+// 2d fft of n x n complex arrays kept as separate real & imaginary planes, row by row, n a power of 2
+// every line is bit reversed and goes through radix-4 passes (and a radix-2 one last if log2(n) is odd)
+// rows do 4 butterflies at a time along the row with SSE2, columns are done in blocks of 16 columns,
+// a cache line of each plane, with the butterflies across the block; rows and blocks are spread over the jobs
+
+class Fft2D {
+  public:
+    // n is a power of 2 and at least 4
+    explicit Fft2D(uint32_t n);
+    Fft2D(const Fft2D &rhs) = delete;
+    Fft2D &operator=(const Fft2D &rhs) = delete;
+
+    uint32_t Size() const {
+        return n;
+    }
+
+    // in place, forward is X(u, v) = sum x(r, c) e^(-2 pi i (u r + v c) / n), inverse is the same with e^(+...)
+    // and without the 1 / n^2, results don't depend on the thread count
+    void Transform(JobSystem &jobs, float *re, float *im, bool inverse) const;
+
+  private:
+    // columns per block of the column pass
+    static constexpr uint32_t kBlockSize = 16;
+
+    void TransformRow(float *re, float *im) const;
+    void TransformColumns(float *re, float *im, uint32_t col, uint32_t n_col) const;
+
+    uint32_t n;
+    // e^(-pi i j / h) of the stage of half size h at [h, 2h)
+    std::vector<float> twiddle_re;
+    std::vector<float> twiddle_im;
+    std::vector<uint32_t> swaps; // pairs (i, bit reverse of i) with i < its reverse
+};
\ No newline at end of file
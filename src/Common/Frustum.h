@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+
+// view frustum as 6 planes (a, b, c, d), a point p is inside a plane if a * p.x + b * p.y + c * p.z + d >= 0
+// plain floats so cpu culling code doesn't depend on d3d or DirectXMath
+struct Frustum {
+    enum class Result {
+        Outside,
+        Intersect,
+        Inside
+    };
+
+    float planes[6][4] = {};
+
+    // m is a row-major view-projection matrix used with row vectors (DirectXMath convention, clip z in [0, 1])
+    static Frustum FromViewProj(const float m[4][4]) {
+        auto column = [&m](int c, float out[4]) {
+            for (int r = 0; r < 4; r++) {
+                out[r] = m[r][c];
+            }
+        };
+        float c0[4], c1[4], c2[4], c3[4];
+        column(0, c0);
+        column(1, c1);
+        column(2, c2);
+        column(3, c3);
+
+        Frustum frustum;
+        for (int i = 0; i < 4; i++) {
+            frustum.planes[0][i] = c3[i] + c0[i]; // left
+            frustum.planes[1][i] = c3[i] - c0[i]; // right
+            frustum.planes[2][i] = c3[i] + c1[i]; // bottom
+            frustum.planes[3][i] = c3[i] - c1[i]; // top
+            frustum.planes[4][i] = c2[i];         // near
+            frustum.planes[5][i] = c3[i] - c2[i]; // far
+        }
+        for (auto &p : frustum.planes) {
+            float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            if (len > 0.0f) {
+                for (int i = 0; i < 4; i++) {
+                    p[i] /= len;
+                }
+            }
+        }
+        return frustum;
+    }
+
+    Result TestAabb(const float min[3], const float max[3]) const {
+        Result res = Result::Inside;
+        for (const auto &p : planes) {
+            // the corner furthest along the normal and the one furthest against it
+            float far_d = p[3], near_d = p[3];
+            for (int i = 0; i < 3; i++) {
+                far_d += p[i] * (p[i] >= 0.0f ? max[i] : min[i]);
+                near_d += p[i] * (p[i] >= 0.0f ? min[i] : max[i]);
+            }
+            if (far_d < 0.0f) {
+                return Result::Outside;
+            }
+            if (near_d < 0.0f) {
+                res = Result::Intersect;
+            }
+        }
+        return res;
+    }
+
+    bool TestSphere(const float center[3], float radius) const {
+        for (const auto &p : planes) {
+            if (p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3] < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+GeometryArena::GeometryArena(BufferHeap &heap, UINT n_pool_vertex, UINT n_pool_index) :
+    heap(heap), n_pool_vertex(n_pool_vertex), n_pool_index(n_pool_index) {}
+
+MeshArena::Mesh GeometryArena::Add(UploadManager &uploads, const void *vertices, UINT n_vertex, UINT stride,
+        const void *indices, UINT n_index, DXGI_FORMAT index_fmt) {
+    assert(index_fmt == DXGI_FORMAT_R16_UINT || index_fmt == DXGI_FORMAT_R32_UINT);
+    const uint64_t layout = Layout(stride, index_fmt);
+    MeshArena::Mesh mesh;
+    if (!arena.Allocate(layout, n_vertex, n_index, mesh)) {
+        Pool pool;
+        pool.stride = stride;
+        pool.index_fmt = index_fmt;
+        pool.n_vertex = std::max(n_pool_vertex, n_vertex);
+        pool.n_index = std::max(n_pool_index, n_index);
+        pool.vb = heap.CreateDedicated((UINT64) pool.n_vertex * stride);
+        pool.ib = heap.CreateDedicated((UINT64) pool.n_index * IndexSize(index_fmt));
+        arena.AddPool(layout, pool.n_vertex, pool.n_index);
+        pools.push_back(pool);
+        [[maybe_unused]] bool b_allocated = arena.Allocate(layout, n_vertex, n_index, mesh);
+        assert(b_allocated);
+    }
+
+    const Pool &pool = pools[mesh.pool];
+    const MeshArena::Range range = arena.GetRange(mesh);
+    const UINT index_size = IndexSize(index_fmt);
+    uploads.Upload(heap.Resource(pool.vb), heap.Offset(pool.vb) + (UINT64) range.base_vertex * stride, vertices,
+        (UINT64) n_vertex * stride);
+    uploads.Upload(heap.Resource(pool.ib), heap.Offset(pool.ib) + (UINT64) range.start_index * index_size, indices,
+        (UINT64) n_index * index_size);
+    return mesh;
+}
+
+void GeometryArena::Free(const MeshArena::Mesh &mesh) {
+    arena.Free(mesh);
+}
+
+void GeometryArena::Bind(const MeshArena::Mesh &mesh, MeshGeometry &geo) const {
+    assert(mesh.pool < pools.size());
+    const Pool &pool = pools[mesh.pool];
+    geo.vb_gpu = heap.Resource(pool.vb);
+    geo.ib_gpu = heap.Resource(pool.ib);
+    geo.vb_offset = heap.Offset(pool.vb);
+    geo.ib_offset = heap.Offset(pool.ib);
+    geo.vb_stride = pool.stride;
+    geo.vb_size = pool.n_vertex * pool.stride;
+    geo.index_fmt = pool.index_fmt;
+    geo.ib_size = pool.n_index * IndexSize(pool.index_fmt);
+}
+
+int GeometryArena::Compact(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, float max_fragmentation) {
+    int n_packed = 0;
+    std::vector<TlsfAllocator::Move> vertex_moves;
+    std::vector<TlsfAllocator::Move> index_moves;
+    for (uint32_t p = 0; p < pools.size(); p++) {
+        const MeshArena::PoolStats stats = arena.GetStats(p);
+        if (stats.vertices.n_allocation == 0 || std::max(stats.vertices.Fragmentation(),
+                stats.indices.Fragmentation()) <= max_fragmentation) {
+            continue;
+        }
+        vertex_moves.clear();
+        index_moves.clear();
+        arena.Compact(p, vertex_moves, index_moves);
+
+        // moves are in vertices & indices, the heap copies bytes
+        const Pool &pool = pools[p];
+        for (TlsfAllocator::Move &move : vertex_moves) {
+            move.src *= pool.stride;
+            move.dst *= pool.stride;
+            move.size *= pool.stride;
+        }
+        const UINT index_size = IndexSize(pool.index_fmt);
+        for (TlsfAllocator::Move &move : index_moves) {
+            move.src *= index_size;
+            move.dst *= index_size;
+            move.size *= index_size;
+        }
+        heap.Repack(cmd_list, fence, pool.vb, vertex_moves);
+        heap.Repack(cmd_list, fence, pool.ib, index_moves);
+        ++n_packed;
+    }
+    return n_packed;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "BufferHeap.h"
+#include "MeshArena.h"
+
+// static meshes appended into a few large vertex & index buffers, one pair per vertex layout
+// all meshes of a pool have the same buffer views, so draws sorted by geometry don't rebind the input assembler
+// a pool's buffers are dedicated allocations of a BufferHeap, which also keeps the buffers replaced by Compact()
+// until its Retire()
+class GeometryArena {
+  public:
+    // capacity of a pool, in vertices & indices, a larger mesh gets a pool of its own
+    // size it for the meshes to be added, a pool is created whole
+    GeometryArena(BufferHeap &heap, UINT n_pool_vertex, UINT n_pool_index);
+    GeometryArena(const GeometryArena &rhs) = delete;
+    GeometryArena &operator=(const GeometryArena &rhs) = delete;
+
+    // data is copied when uploads is flushed, index_fmt is DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+    MeshArena::Mesh Add(UploadManager &uploads, const void *vertices, UINT n_vertex, UINT stride,
+        const void *indices, UINT n_index, DXGI_FORMAT index_fmt);
+    void Free(const MeshArena::Mesh &mesh);
+
+    // point geo at the buffers of mesh, views span the whole pool,
+    // so base_vertex & start_index of Range() are added to the submeshes of the mesh
+    void Bind(const MeshArena::Mesh &mesh, MeshGeometry &geo) const;
+    MeshArena::Range Range(const MeshArena::Mesh &mesh) const {
+        return arena.GetRange(mesh);
+    }
+
+    // pools whose fragmentation is above max_fragmentation are packed into new buffers, copies are recorded to
+    // cmd_list and old buffers are kept until the heap's Retire() is called with a fence at least `fence`
+    // returns the number of pools packed, meshes in them have to be bound again
+    int Compact(ID3D12GraphicsCommandList *cmd_list, UINT64 fence, float max_fragmentation = 0.25f);
+
+    const MeshArena &Arena() const {
+        return arena;
+    }
+
+  private:
+    struct Pool {
+        BufferAllocation vb;
+        BufferAllocation ib;
+        UINT stride;
+        DXGI_FORMAT index_fmt;
+        UINT n_vertex;
+        UINT n_index;
+    };
+
+    static UINT IndexSize(DXGI_FORMAT index_fmt) {
+        return index_fmt == DXGI_FORMAT_R16_UINT ? 2 : 4;
+    }
+    static uint64_t Layout(UINT stride, DXGI_FORMAT index_fmt) {
+        return ((uint64_t) stride << 32) | index_fmt;
+    }
+
+    BufferHeap &heap;
+    UINT n_pool_vertex;
+    UINT n_pool_index;
+    MeshArena arena;
+    std::vector<Pool> pools;
+};
\ No newline at end of file
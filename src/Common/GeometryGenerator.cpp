@@ -5,6 +5,8 @@
 
 #include <iostream>
 
+#include "GridMesh.h"
+
 using namespace DirectX;
 
 GeometryGenerator::MeshData
@@ -241,43 +243,15 @@ GeometryGenerator::MeshData
 GeometryGenerator::Grid(float w, float d, int n, int m) {
     MeshData mesh;
 
-    int n_vertex = n * m;
-    int n_face = 2 * (n - 1) * (m - 1);
-
-    float hw = 0.5f * w;
-    float hd = 0.5f * d;
-    float du = 1.0f / (n - 1);
-    float dv = 1.0f / (m - 1);
-    float dx = w * du;
-    float dz = d * dv;
-
-    mesh.vertices.resize(n_vertex);
-    for (int i = 0; i < m; i++) {
-        float z = hd - dz * i;
-        for (int j = 0; j < n; j++) {
-            float x = -hw + dx * j;
-
-            int id = i * n + j;
-            mesh.vertices[id].pos = XMFLOAT3(x, 0.0f, z);
-            mesh.vertices[id].norm = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mesh.vertices[id].tan = XMFLOAT3(1.0f, 0.0f, 0.0f);
-            mesh.vertices[id].texc = XMFLOAT2(j * du, i * dv);
-        }
-    }
-
-    mesh.indices32.resize(n_face * 3);
-    int k = 0;
-    for (int i = 0; i < m - 1; i++) {
-        for (int j = 0; j < n - 1; j++) {
-            mesh.indices32[k] = i * n + j;
-            mesh.indices32[k + 1] = i * n + j + 1;
-            mesh.indices32[k + 2] = (i + 1) * n + j;
-            mesh.indices32[k + 3] = i * n + j + 1;
-            mesh.indices32[k + 4] = (i + 1) * n + j + 1;
-            mesh.indices32[k + 5] = (i + 1) * n + j;
-            k += 6;
-        }
-    }
+    // shared with portable code through GridMesh.h
+    mesh.vertices.resize(n * m);
+    GridVertices(w, d, n, m, [&mesh](int id, float x, float z, float u, float v) {
+        mesh.vertices[id].pos = XMFLOAT3(x, 0.0f, z);
+        mesh.vertices[id].norm = XMFLOAT3(0.0f, 1.0f, 0.0f);
+        mesh.vertices[id].tan = XMFLOAT3(1.0f, 0.0f, 0.0f);
+        mesh.vertices[id].texc = XMFLOAT2(u, v);
+    });
+    mesh.indices32 = GridIndices(n, m);
 
     return mesh;
 }
@@ -405,4 +379,26 @@ void GeometryGenerator::BuildCylinderTopCap(float br, float tr, float h, int n_s
         mesh.indices32.push_back(base + i + 1);
         mesh.indices32.push_back(base + i);
     }
+}
+
+void GeometryGenerator::ApplyHeightField(MeshData &mesh, const HeightFieldFn &height) {
+    // in batches, so the height field can work on a few vertices at once
+    const size_t kBatch = 256;
+    float xs[kBatch], zs[kBatch], hs[kBatch], ns[3 * kBatch];
+    for (size_t begin = 0; begin < mesh.vertices.size(); begin += kBatch) {
+        const size_t n = std::min(kBatch, mesh.vertices.size() - begin);
+        for (size_t i = 0; i < n; i++) {
+            xs[i] = mesh.vertices[begin + i].pos.x;
+            zs[i] = mesh.vertices[begin + i].pos.z;
+        }
+        height(xs, zs, n, hs, ns);
+        for (size_t i = 0; i < n; i++) {
+            Vertex &v = mesh.vertices[begin + i];
+            v.pos.y = hs[i];
+            v.norm = XMFLOAT3(ns[3 * i], ns[3 * i + 1], ns[3 * i + 2]);
+            // n ~ (-dh/dx, 1, -dh/dz), so t ~ (1, dh/dx, 0)
+            XMVECTOR tan = XMVectorSet(ns[3 * i + 1], -ns[3 * i], 0.0f, 0.0f);
+            XMStoreFloat3(&v.tan, XMVector3Normalize(tan));
+        }
+    }
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 #include <DirectXMath.h>
 
+#include "HeightField.h"
+
 class GeometryGenerator {
   public:
     struct Vertex {
@@ -44,6 +46,9 @@ class GeometryGenerator {
     MeshData Grid(float w, float d, int n, int m);
     MeshData Quad(float x, float y, float w, float h, float d);
 
+    // move vertices (e.g. of Grid) onto a height field, replacing y, normals and tangents (along +x)
+    void ApplyHeightField(MeshData &mesh, const HeightFieldFn &height);
+
   private:
     void Subdivide(MeshData &mesh);
     Vertex Midpoint(const Vertex &v0, const Vertex &v1);
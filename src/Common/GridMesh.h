@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// the grid of GeometryGenerator::Grid(w, d, n, m), without DirectXMath so that portable code builds the same mesh:
+// n x m vertices over [-w / 2, w / 2] x [-d / 2, d / 2] in xz at y = 0, row i at z = d / 2 - i * d / (m - 1),
+// column j at x = -w / 2 + j * w / (n - 1), texture coordinates (j / (n - 1), i / (m - 1))
+
+// set_vertex(i * n + j, x, z, u, v) for every vertex
+template <typename Fn>
+void GridVertices(float w, float d, int n, int m, const Fn &set_vertex) {
+    const float hw = 0.5f * w;
+    const float hd = 0.5f * d;
+    const float du = 1.0f / (n - 1);
+    const float dv = 1.0f / (m - 1);
+    const float dx = w * du;
+    const float dz = d * dv;
+    for (int i = 0; i < m; i++) {
+        const float z = hd - dz * i;
+        for (int j = 0; j < n; j++) {
+            set_vertex(i * n + j, -hw + dx * j, z, j * du, i * dv);
+        }
+    }
+}
+
+// two triangles per cell
+inline std::vector<uint32_t> GridIndices(int n, int m) {
+    std::vector<uint32_t> indices;
+    indices.reserve(6 * (size_t) (n - 1) * (m - 1));
+    for (int i = 0; i < m - 1; i++) {
+        for (int j = 0; j < n - 1; j++) {
+            const uint32_t quad[6] = {
+                (uint32_t) (i * n + j), (uint32_t) (i * n + j + 1), (uint32_t) ((i + 1) * n + j),
+                (uint32_t) (i * n + j + 1), (uint32_t) ((i + 1) * n + j + 1), (uint32_t) ((i + 1) * n + j)
+            };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    return indices;
+}
\ No newline at end of file
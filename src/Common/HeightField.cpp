@@ -0,0 +1,112 @@
+#include "HeightField.h"
+
+#include <cmath>
+
+#include "SinCos.h"
+
+namespace {
+
+const float kFreq = 0.1f;
+const float kAmp = 0.3f;
+
+// n = (-dh/dx, 1, -dh/dz) normalized with
+// dh/dx = amp * (freq * z * cos(freq x) + cos(freq z)), dh/dz = amp * (sin(freq x) - freq * x * sin(freq z))
+void Hill(float x, float z, float sx, float cx, float sz, float cz, float *height, float *normal) {
+    if (height != nullptr) {
+        *height = kAmp * (z * sx + x * cz);
+    }
+    if (normal != nullptr) {
+        const float nx = -kAmp * (kFreq * z * cx + cz);
+        const float nz = -kAmp * (sx - kFreq * x * sz);
+        const float inv_len = 1.0f / std::sqrt(nx * nx + 1.0f + nz * nz);
+        normal[0] = nx * inv_len;
+        normal[1] = inv_len;
+        normal[2] = nz * inv_len;
+    }
+}
+
+#ifdef SINCOS_SSE2
+void Hill4(__m128 x, __m128 z, __m128 sx, __m128 cx, __m128 sz, __m128 cz, float *height, float *normal) {
+    const __m128 amp = _mm_set1_ps(kAmp);
+    const __m128 freq = _mm_set1_ps(kFreq);
+    if (height != nullptr) {
+        _mm_storeu_ps(height, _mm_mul_ps(amp, _mm_add_ps(_mm_mul_ps(z, sx), _mm_mul_ps(x, cz))));
+    }
+    if (normal != nullptr) {
+        const __m128 neg_amp = _mm_set1_ps(-kAmp);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 nx = _mm_mul_ps(neg_amp, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(freq, z), cx), cz));
+        const __m128 nz = _mm_mul_ps(neg_amp, _mm_sub_ps(sx, _mm_mul_ps(_mm_mul_ps(freq, x), sz)));
+        // same operation order as the scalar path, and a true division rather than rcp to match it
+        const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), one), _mm_mul_ps(nz, nz)));
+        const __m128 inv_len = _mm_div_ps(one, len);
+        alignas(16) float ox[4], oy[4], oz[4];
+        _mm_store_ps(ox, _mm_mul_ps(nx, inv_len));
+        _mm_store_ps(oy, inv_len);
+        _mm_store_ps(oz, _mm_mul_ps(nz, inv_len));
+        for (int k = 0; k < 4; k++) {
+            normal[3 * k] = ox[k];
+            normal[3 * k + 1] = oy[k];
+            normal[3 * k + 2] = oz[k];
+        }
+    }
+}
+#endif
+
+}
+
+float HillField::Height(float x, float z) {
+    float h;
+    Evaluate(&x, &z, 1, &h, nullptr);
+    return h;
+}
+
+void HillField::Normal(float x, float z, float out[3]) {
+    Evaluate(&x, &z, 1, nullptr, out);
+}
+
+void HillField::Evaluate(const float *x, const float *z, size_t n, float *heights, float *normals) {
+    size_t i = 0;
+#ifdef SINCOS_SSE2
+    const __m128 freq = _mm_set1_ps(kFreq);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        __m128 sx, cx, sz, cz;
+        FastSinCos4(_mm_mul_ps(freq, px), sx, cx);
+        FastSinCos4(_mm_mul_ps(freq, pz), sz, cz);
+        Hill4(px, pz, sx, cx, sz, cz, heights ? heights + i : nullptr, normals ? normals + 3 * i : nullptr);
+    }
+#endif
+    for (; i < n; i++) {
+        float sx, cx, sz, cz;
+        FastSinCos(kFreq * x[i], sx, cx);
+        FastSinCos(kFreq * z[i], sz, cz);
+        Hill(x[i], z[i], sx, cx, sz, cz, heights ? heights + i : nullptr, normals ? normals + 3 * i : nullptr);
+    }
+}
+
+void HillField::EvaluateRow(float x0, float dx, float z, size_t n, float *heights, float *normals) {
+    float sz, cz;
+    FastSinCos(kFreq * z, sz, cz);
+    size_t i = 0;
+#ifdef SINCOS_SSE2
+    const __m128 freq = _mm_set1_ps(kFreq);
+    const __m128 pz = _mm_set1_ps(z);
+    const __m128 vsz = _mm_set1_ps(sz);
+    const __m128 vcz = _mm_set1_ps(cz);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 steps = _mm_setr_ps((float) i, (float) (i + 1), (float) (i + 2), (float) (i + 3));
+        const __m128 px = _mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(steps, _mm_set1_ps(dx)));
+        __m128 sx, cx;
+        FastSinCos4(_mm_mul_ps(freq, px), sx, cx);
+        Hill4(px, pz, sx, cx, vsz, vcz, heights ? heights + i : nullptr, normals ? normals + 3 * i : nullptr);
+    }
+#endif
+    for (; i < n; i++) {
+        const float x = x0 + (float) i * dx;
+        float sx, cx;
+        FastSinCos(kFreq * x, sx, cx);
+        Hill(x, z, sx, cx, sz, cz, heights ? heights + i : nullptr, normals ? normals + 3 * i : nullptr);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// heights and normals of n points (x[i], z[i]), normals are xyz interleaved, either output may be nullptr
+using HeightFieldFn = std::function<void(const float *x, const float *z, size_t n, float *heights, float *normals)>;
+
+// the hills of the land in the chapters, h = 0.3 * (z * sin(0.1 x) + x * cos(0.1 z))
+// normals are analytic, sin & cos come from FastSinCos, all paths (scalar, batch, sse or not) give the same results
+// as long as the compiler doesn't contract multiply-adds into fma (see SinCos.h)
+class HillField {
+  public:
+    static float Height(float x, float z);
+    static void Normal(float x, float z, float out[3]);
+
+    // fits HeightFieldFn
+    static void Evaluate(const float *x, const float *z, size_t n, float *heights, float *normals);
+    // n points from (x0, z) with step dx along x, sin & cos of z are only taken once
+    static void EvaluateRow(float x0, float dx, float z, size_t n, float *heights, float *normals);
+};
\ No newline at end of file
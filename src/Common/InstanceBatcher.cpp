@@ -0,0 +1,73 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+
+void InstanceBatcher::Build(JobSystem &jobs, const uint64_t *keys, uint32_t n) {
+    batches.clear();
+    items.resize(n);
+    local_keys.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    const uint32_t n_block = std::clamp<uint32_t>((n + kBlockSize - 1) / kBlockSize, 1, 4 * jobs.ThreadCount());
+    const uint32_t block_size = (n + n_block - 1) / n_block;
+    blocks.resize(n_block);
+
+    // count items of every key in each block
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        Block &block = blocks[b];
+        block.lookup.clear();
+        block.keys.clear();
+        block.counts.clear();
+        const uint32_t begin = (uint32_t) b * block_size;
+        const uint32_t end = std::min(n, begin + block_size);
+        for (uint32_t i = begin; i < end; i++) {
+            auto [it, inserted] = block.lookup.try_emplace(keys[i], (uint32_t) block.keys.size());
+            if (inserted) {
+                block.keys.push_back(keys[i]);
+                block.counts.push_back(0);
+            }
+            local_keys[i] = it->second;
+            ++block.counts[it->second];
+        }
+    });
+
+    // merge blocks in order, a block's items of a key go after those of earlier blocks
+    lookup.clear();
+    for (Block &block : blocks) {
+        block.batches.resize(block.keys.size());
+        block.cursors.resize(block.keys.size());
+        for (uint32_t k = 0; k < block.keys.size(); k++) {
+            auto [it, inserted] = lookup.try_emplace(block.keys[k], (uint32_t) batches.size());
+            if (inserted) {
+                batches.push_back({ block.keys[k], 0, 0, 0 });
+            }
+            Batch &batch = batches[it->second];
+            block.batches[k] = it->second;
+            block.cursors[k] = batch.n_instance;
+            batch.n_instance += block.counts[k];
+        }
+    }
+    uint32_t n_instance = 0;
+    for (Batch &batch : batches) {
+        batch.first_instance = n_instance;
+        n_instance += batch.n_instance;
+    }
+
+    // scatter items to their instances
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        Block &block = blocks[b];
+        for (uint32_t k = 0; k < block.keys.size(); k++) {
+            block.cursors[k] += batches[block.batches[k]].first_instance;
+        }
+        const uint32_t begin = (uint32_t) b * block_size;
+        const uint32_t end = std::min(n, begin + block_size);
+        for (uint32_t i = begin; i < end; i++) {
+            items[block.cursors[local_keys[i]]++] = i;
+        }
+    });
+    for (Batch &batch : batches) {
+        batch.item = items[batch.first_instance];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+
+// render items merged into instanced draws, nothing here touches D3D
+// items are grouped by a 64-bit key of everything that has to match to share a draw (geometry, submesh, material, pso),
+// batches are in order of their first item and items keep their order inside a batch,
+// so the result doesn't depend on the thread count
+class InstanceBatcher {
+  public:
+    struct Batch {
+        uint64_t key;
+        uint32_t item; // first item of the batch, draw arguments are taken from it
+        uint32_t first_instance;
+        uint32_t n_instance;
+    };
+
+    static uint64_t MakeKey(uint16_t geometry, uint16_t submesh, uint16_t material, uint16_t pso) {
+        return ((uint64_t) geometry << 48) | ((uint64_t) submesh << 32) | ((uint64_t) material << 16) | pso;
+    }
+
+    // group items [0, n) by keys[i]
+    void Build(JobSystem &jobs, const uint64_t *keys, uint32_t n);
+
+    const std::vector<Batch> &Batches() const {
+        return batches;
+    }
+    // items in instance order, a batch draws Items()[first_instance, first_instance + n_instance)
+    const std::vector<uint32_t> &Items() const {
+        return items;
+    }
+
+    // pack(instance, item) for every instance, in parallel, to fill the instance buffer
+    template <typename Fn>
+    void Pack(JobSystem &jobs, const Fn &pack) const {
+        jobs.ParallelForRange(0, items.size(), [this, &pack](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                pack((uint32_t) i, items[i]);
+            }
+        }, kPackGrain);
+    }
+
+  private:
+    // keys of a block of items, in order of their first item
+    struct Block {
+        std::unordered_map<uint64_t, uint32_t> lookup;
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> batches;
+        std::vector<uint32_t> cursors;
+    };
+
+    static constexpr uint32_t kBlockSize = 4096;
+    static constexpr size_t kPackGrain = 1024;
+
+    std::vector<Batch> batches;
+    std::vector<uint32_t> items;
+    std::vector<uint32_t> local_keys; // index of the key of item i in its block
+    std::vector<Block> blocks;
+    std::unordered_map<uint64_t, uint32_t> lookup;
+};
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "JobSystem.h"
+
+JobSystem::JobSystem(unsigned n_thread) {
+    n_thread = std::max(1u, n_thread);
+    for (unsigned i = 0; i < n_thread; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 1; i < n_thread; i++) {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        quit = true;
+    }
+    sleep_cv.notify_all();
+    for (auto &t : workers) {
+        t.join();
+    }
+}
+
+unsigned JobSystem::ThreadIndex() const {
+    return tls_owner == this ? tls_index : 0;
+}
+
+void JobSystem::Run(Job job, Counter *counter) {
+    if (counter != nullptr) {
+        counter->n_pending.fetch_add(1);
+    }
+    {
+        Queue &q = *queues[ThreadIndex()];
+        std::lock_guard<std::mutex> lock(q.mtx);
+        q.tasks.push_back({ std::move(job), counter });
+    }
+    n_queued.fetch_add(1);
+    {
+        // make sure a worker between checking n_queued and sleeping doesn't miss the notification
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+    }
+    sleep_cv.notify_one();
+}
+
+bool JobSystem::Pop(unsigned index, Task &task) {
+    Queue &q = *queues[index];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (q.tasks.empty()) {
+        return false;
+    }
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool JobSystem::Steal(unsigned index, Task &task) {
+    const unsigned n = ThreadCount();
+    for (unsigned k = 1; k < n; k++) {
+        Queue &q = *queues[(index + k) % n];
+        std::unique_lock<std::mutex> lock(q.mtx, std::try_to_lock);
+        if (!lock.owns_lock() || q.tasks.empty()) {
+            continue;
+        }
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(Task &task) {
+    n_queued.fetch_sub(1);
+    try {
+        task.job();
+    } catch (...) {
+        if (task.counter != nullptr && !task.counter->has_error.exchange(true)) {
+            task.counter->error = std::current_exception();
+        }
+    }
+    if (task.counter != nullptr) {
+        task.counter->n_pending.fetch_sub(1);
+    }
+}
+
+bool JobSystem::TryRunOne(unsigned index) {
+    Task task;
+    if (Pop(index, task) || Steal(index, task)) {
+        Execute(task);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Wait(Counter &counter) {
+    const unsigned index = ThreadIndex();
+    while (counter.n_pending.load() > 0) {
+        if (!TryRunOne(index)) {
+            std::this_thread::yield();
+        }
+    }
+    if (counter.has_error) {
+        std::rethrow_exception(counter.error);
+    }
+}
+
+void JobSystem::WorkerLoop(unsigned index) {
+    tls_owner = this;
+    tls_index = index;
+
+    const int kSpinCount = 64;
+    int n_idle = 0;
+    while (!quit) {
+        if (TryRunOne(index)) {
+            n_idle = 0;
+            continue;
+        }
+        // a stealing attempt may fail on a contended lock, so spin a little before sleeping
+        if (++n_idle < kSpinCount) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mtx);
+        sleep_cv.wait(lock, [this]() {
+            return quit || n_queued.load() > 0;
+        });
+        n_idle = 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// work-stealing job scheduler
+// every thread owns a deque, it pushes & pops jobs at the back and idle threads steal from the front
+// dependency is expressed with Counter: jobs started with a counter increase it and decrease it when finished,
+// Wait() on a counter runs other jobs until it drops to zero, so it is fine to wait inside a job
+class JobSystem {
+  public:
+    using Job = std::function<void()>;
+
+    struct Counter {
+        std::atomic<size_t> n_pending = 0;
+        std::atomic<bool> has_error = false;
+        std::exception_ptr error = nullptr; // first exception thrown by jobs of this counter
+    };
+
+    // n_thread counts the calling thread, which executes jobs in Wait()
+    explicit JobSystem(unsigned n_thread = std::thread::hardware_concurrency());
+    JobSystem(const JobSystem &rhs) = delete;
+    JobSystem &operator=(const JobSystem &rhs) = delete;
+    ~JobSystem();
+
+    unsigned ThreadCount() const {
+        return static_cast<unsigned>(queues.size());
+    }
+
+    void Run(Job job, Counter *counter = nullptr);
+    // help executing jobs until counter drops to zero, re-throw the first exception of its jobs
+    void Wait(Counter &counter);
+
+    // fn(b, e) is called on disjoint sub-ranges that cover [begin, end)
+    // range is split in halves until it is not larger than the grain,
+    // grain adapts to range size and thread count but is never smaller than min_grain
+    template <typename Fn>
+    void ParallelForRange(size_t begin, size_t end, const Fn &fn, size_t min_grain = 1) {
+        if (begin >= end) {
+            return;
+        }
+        size_t grain = std::max<size_t>({ min_grain, (end - begin) / (8 * ThreadCount()), 1 });
+        if (end - begin <= grain) {
+            fn(begin, end);
+            return;
+        }
+        // the slices already queued point at counter & fn, so they must finish even if this thread's slice throws
+        Counter counter;
+        try {
+            SplitRange(begin, end, grain, fn, counter);
+        } catch (...) {
+            if (!counter.has_error.exchange(true)) {
+                counter.error = std::current_exception();
+            }
+        }
+        Wait(counter);
+    }
+    // fn(i) for every i in [begin, end)
+    template <typename Fn>
+    void ParallelFor(size_t begin, size_t end, const Fn &fn, size_t min_grain = 1) {
+        ParallelForRange(begin, end, [&fn](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                fn(i);
+            }
+        }, min_grain);
+    }
+
+  private:
+    struct Task {
+        Job job;
+        Counter *counter = nullptr;
+    };
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    template <typename Fn>
+    void SplitRange(size_t begin, size_t end, size_t grain, const Fn &fn, Counter &counter) {
+        // keep the left half, push the right half for others to steal
+        while (end - begin > grain) {
+            size_t mid = begin + (end - begin) / 2;
+            Run([this, mid, end, grain, &fn, &counter]() {
+                SplitRange(mid, end, grain, fn, counter);
+            }, &counter);
+            end = mid;
+        }
+        fn(begin, end);
+    }
+
+    unsigned ThreadIndex() const;
+    bool Pop(unsigned index, Task &task);
+    bool Steal(unsigned index, Task &task);
+    bool TryRunOne(unsigned index);
+    void Execute(Task &task);
+    void WorkerLoop(unsigned index);
+
+    // queues[0] is shared by all threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> n_queued = 0;
+    std::atomic<bool> quit = false;
+    std::mutex sleep_mtx;
+    std::condition_variable sleep_cv;
+
+    inline static thread_local const JobSystem *tls_owner = nullptr;
+    inline static thread_local unsigned tls_index = 0;
+};
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "LightCluster.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LIGHTCLUSTER_SSE2
+#endif
+
+namespace {
+
+// lights per job at least when they are moved to view space
+const size_t kMinLightsPerJob = 1024;
+
+}
+
+void LightClusters::Resize(const ClusterDesc &desc) {
+    assert(desc.n_x > 0 && desc.n_y > 0 && desc.n_z > 0);
+    assert(desc.near_z > 0.0f && desc.far_z > desc.near_z);
+    this->desc = desc;
+    const float log_ratio = std::log(desc.far_z / desc.near_z);
+    slice_scale = desc.n_z / log_ratio;
+    slice_bias = -(desc.n_z * std::log(desc.near_z)) / log_ratio;
+
+    const size_t n_cluster = ClusterCount();
+    for (int k = 0; k < 3; k++) {
+        bound_min[k].resize(n_cluster);
+        bound_max[k].resize(n_cluster);
+    }
+    const float tan_y = std::tan(0.5f * desc.fov_y);
+    const float tan_x = tan_y * desc.aspect;
+    for (uint32_t z = 0; z < desc.n_z; z++) {
+        const float d0 = desc.near_z * std::pow(desc.far_z / desc.near_z, (float) z / desc.n_z);
+        const float d1 = z + 1 == desc.n_z ? desc.far_z
+            : desc.near_z * std::pow(desc.far_z / desc.near_z, (float) (z + 1) / desc.n_z);
+        for (uint32_t y = 0; y < desc.n_y; y++) {
+            // tiles go down the screen
+            const float y0 = tan_y * (1.0f - 2.0f * (y + 1) / desc.n_y);
+            const float y1 = tan_y * (1.0f - 2.0f * y / desc.n_y);
+            for (uint32_t x = 0; x < desc.n_x; x++) {
+                const float x0 = tan_x * (-1.0f + 2.0f * x / desc.n_x);
+                const float x1 = tan_x * (-1.0f + 2.0f * (x + 1) / desc.n_x);
+                // sides of a cluster are planes through the eye, its box is spanned by the near and far faces
+                const size_t c = ((size_t) z * desc.n_y + y) * desc.n_x + x;
+                bound_min[0][c] = std::min(x0 * d0, x0 * d1);
+                bound_max[0][c] = std::max(x1 * d0, x1 * d1);
+                bound_min[1][c] = std::min(y0 * d0, y0 * d1);
+                bound_max[1][c] = std::max(y1 * d0, y1 * d1);
+                bound_min[2][c] = d0;
+                bound_max[2][c] = d1;
+            }
+        }
+    }
+    slices.resize(desc.n_z);
+    ranges.resize(n_cluster);
+}
+
+void LightClusters::ClusterBounds(size_t cluster, float min[3], float max[3]) const {
+    for (int k = 0; k < 3; k++) {
+        min[k] = bound_min[k][cluster];
+        max[k] = bound_max[k][cluster];
+    }
+}
+
+int LightClusters::SliceOf(float depth) const {
+    const float s = std::floor(std::log(depth) * slice_scale + slice_bias);
+    return (int) std::clamp(s, 0.0f, (float) (desc.n_z - 1));
+}
+
+void LightClusters::Assign(JobSystem &jobs, const float view[4][4], const ClusterLight *lights, size_t n_point,
+        size_t n_spot) {
+    const size_t n_light = n_point + n_spot;
+    assert(n_light <= UINT32_MAX);
+    for (int k = 0; k < 3; k++) {
+        light_pos[k].resize(n_light);
+    }
+    light_radius.resize(n_light);
+    light_first_slice.resize(n_light);
+    light_last_slice.resize(n_light);
+
+    jobs.ParallelForRange(0, n_light, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float *p = lights[i].position;
+            const float x = p[0] * view[0][0] + p[1] * view[1][0] + p[2] * view[2][0] + view[3][0];
+            const float y = p[0] * view[0][1] + p[1] * view[1][1] + p[2] * view[2][1] + view[3][1];
+            const float d = -(p[0] * view[0][2] + p[1] * view[1][2] + p[2] * view[2][2] + view[3][2]);
+            const float r = lights[i].falloff_end;
+            light_pos[0][i] = x;
+            light_pos[1][i] = y;
+            light_pos[2][i] = d;
+            light_radius[i] = r;
+            if (d + r < desc.near_z || d - r > desc.far_z) {
+                light_first_slice[i] = 1;
+                light_last_slice[i] = 0;
+                continue;
+            }
+            // one more slice on both sides, slice borders of SliceOf() and of the bounds may round differently
+            light_first_slice[i] = std::max(SliceOf(std::max(d - r, desc.near_z)) - 1, 0);
+            light_last_slice[i] = std::min(SliceOf(std::min(d + r, desc.far_z)) + 1, (int) desc.n_z - 1);
+        }
+    }, kMinLightsPerJob);
+
+    jobs.ParallelFor(0, desc.n_z, [&](size_t z) {
+        AssignSlice((int) z);
+    });
+
+    size_t n_index = 0;
+    for (const Slice &slice : slices) {
+        n_index += slice.indices.size();
+    }
+    indices.resize(n_index);
+    std::vector<size_t> slice_offset(desc.n_z);
+    for (size_t z = 0, offset = 0; z < desc.n_z; z++) {
+        slice_offset[z] = offset;
+        offset += slices[z].indices.size();
+    }
+    const size_t n_tile = (size_t) desc.n_x * desc.n_y;
+    jobs.ParallelFor(0, desc.n_z, [&](size_t z) {
+        const Slice &slice = slices[z];
+        std::copy(slice.indices.begin(), slice.indices.end(), indices.begin() + slice_offset[z]);
+        for (size_t c = z * n_tile; c < (z + 1) * n_tile; c++) {
+            ranges[c].offset += (uint32_t) slice_offset[z];
+        }
+    });
+}
+
+void LightClusters::AssignSlice(int z) {
+    Slice &slice = slices[z];
+    const size_t n_tile = (size_t) desc.n_x * desc.n_y;
+    const size_t base = z * n_tile;
+    slice.cluster_lights.resize(n_tile);
+    for (auto &lights : slice.cluster_lights) {
+        lights.clear();
+    }
+
+    for (size_t i = 0; i < light_radius.size(); i++) {
+        if (z < light_first_slice[i] || z > light_last_slice[i]) {
+            continue;
+        }
+        const float p[3] = { light_pos[0][i], light_pos[1][i], light_pos[2][i] };
+        const float r = light_radius[i];
+        // y bounds only depend on the row and x bounds on the column in a slice,
+        // rows and columns whose bounds the sphere overlaps limit the clusters to test
+        uint32_t y0 = desc.n_y, y1 = 0;
+        for (uint32_t y = 0; y < desc.n_y; y++) {
+            const size_t c = base + y * desc.n_x;
+            if (p[1] - r <= bound_max[1][c] && p[1] + r >= bound_min[1][c]) {
+                y0 = std::min(y0, y);
+                y1 = y;
+            }
+        }
+        uint32_t x0 = desc.n_x, x1 = 0;
+        for (uint32_t x = 0; x < desc.n_x; x++) {
+            const size_t c = base + x;
+            if (p[0] - r <= bound_max[0][c] && p[0] + r >= bound_min[0][c]) {
+                x0 = std::min(x0, x);
+                x1 = x;
+            }
+        }
+        const float r_sq = r * r;
+        for (uint32_t y = y0; y <= y1 && y0 <= y1; y++) {
+            // squared distance from the light to the boxes, summed over axes
+            const size_t row = base + y * desc.n_x;
+            uint32_t x = x0;
+#ifdef LIGHTCLUSTER_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            for (; x + 4 <= x1 + 1; x += 4) {
+                __m128 dist_sq = zero;
+                for (int k = 0; k < 3; k++) {
+                    const __m128 p4 = _mm_set1_ps(p[k]);
+                    const __m128 min4 = _mm_loadu_ps(bound_min[k].data() + row + x);
+                    const __m128 max4 = _mm_loadu_ps(bound_max[k].data() + row + x);
+                    const __m128 e = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min4, p4), _mm_sub_ps(p4, max4)), zero);
+                    dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(e, e));
+                }
+                const int mask = _mm_movemask_ps(_mm_cmple_ps(dist_sq, _mm_set1_ps(r_sq)));
+                for (int l = 0; l < 4; l++) {
+                    auto &lights = slice.cluster_lights[y * desc.n_x + x + l];
+                    if ((mask >> l & 1) && lights.size() < desc.max_lights_per_cluster) {
+                        lights.push_back((uint32_t) i);
+                    }
+                }
+            }
+#endif
+            for (; x <= x1; x++) {
+                float dist_sq = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    const float e = std::max(std::max(bound_min[k][row + x] - p[k], p[k] - bound_max[k][row + x]),
+                        0.0f);
+                    dist_sq += e * e;
+                }
+                auto &lights = slice.cluster_lights[y * desc.n_x + x];
+                if (dist_sq <= r_sq && lights.size() < desc.max_lights_per_cluster) {
+                    lights.push_back((uint32_t) i);
+                }
+            }
+        }
+    }
+
+    slice.indices.clear();
+    for (size_t t = 0; t < n_tile; t++) {
+        const auto &lights = slice.cluster_lights[t];
+        ranges[base + t] = { (uint32_t) slice.indices.size(), (uint32_t) lights.size() };
+        slice.indices.insert(slice.indices.end(), lights.begin(), lights.end());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+// clustered forward light assignment
+// the view frustum is split into n_x * n_y tiles on screen and n_z slices in depth, exponentially from near to far,
+// a point or spot light is a sphere of radius falloff_end and goes to every cluster whose view space AABB it touches
+// views are right-handed (looking at -z) as in the chapters, depth is -z, tile (0, 0) is the top left one
+// cluster index = (z * n_y + y) * n_x + x
+
+// same layout as Light of D3DUtil.h and light.hlsl
+struct ClusterLight {
+    float strength[3];
+    float falloff_start;
+    float direction[3];
+    float falloff_end;
+    float position[3];
+    float spot_power;
+};
+
+struct ClusterDesc {
+    uint32_t n_x = 16;
+    uint32_t n_y = 9;
+    uint32_t n_z = 24;
+    float fov_y = 0.785398163f;
+    float aspect = 16.0f / 9.0f;
+    float near_z = 0.1f;
+    float far_z = 1000.0f;
+    uint32_t max_lights_per_cluster = 64; // lights beyond are dropped, those with larger indices first
+};
+
+// lights of a cluster are indices[offset, offset + count)
+struct ClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+class LightClusters {
+  public:
+    explicit LightClusters(const ClusterDesc &desc = {}) {
+        Resize(desc);
+    }
+
+    // e.g. when the aspect changes
+    void Resize(const ClusterDesc &desc);
+
+    // lights[0, n_point) are point lights and lights[n_point, n_point + n_spot) spot lights, in world space
+    // view is the world to view matrix of row vectors (an XMFLOAT4X4 as it is)
+    // indices point into lights, in ascending order in every cluster
+    void Assign(JobSystem &jobs, const float view[4][4], const ClusterLight *lights, size_t n_point, size_t n_spot);
+
+    const std::vector<ClusterRange> &Ranges() const {
+        return ranges;
+    }
+    const std::vector<uint32_t> &Indices() const {
+        return indices;
+    }
+    const ClusterDesc &Desc() const {
+        return desc;
+    }
+    size_t ClusterCount() const {
+        return (size_t) desc.n_x * desc.n_y * desc.n_z;
+    }
+    // Indices() never holds more than this
+    size_t MaxIndexCount() const {
+        return ClusterCount() * desc.max_lights_per_cluster;
+    }
+    // slice of a depth is floor(log(depth) * SliceScale() + SliceBias()), clamped to [0, n_z)
+    float SliceScale() const {
+        return slice_scale;
+    }
+    float SliceBias() const {
+        return slice_bias;
+    }
+    // view space AABB of a cluster as (x, y, depth)
+    void ClusterBounds(size_t cluster, float min[3], float max[3]) const;
+
+  private:
+    // lights of every cluster of a slice, then all of them in cluster order
+    struct Slice {
+        std::vector<std::vector<uint32_t>> cluster_lights;
+        std::vector<uint32_t> indices;
+    };
+
+    void AssignSlice(int z);
+    int SliceOf(float depth) const;
+
+    ClusterDesc desc;
+    float slice_scale = 0.0f;
+    float slice_bias = 0.0f;
+    // cluster bounds, one array per component
+    std::vector<float> bound_min[3];
+    std::vector<float> bound_max[3];
+
+    // lights in view space, (x, y, depth) and radius, and the slices they may touch
+    std::vector<float> light_pos[3];
+    std::vector<float> light_radius;
+    std::vector<int> light_first_slice;
+    std::vector<int> light_last_slice;
+
+    std::vector<Slice> slices;
+    std::vector<ClusterRange> ranges;
+    std::vector<uint32_t> indices;
+};
\ No newline at end of file
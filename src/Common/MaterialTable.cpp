@@ -0,0 +1,75 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+int LowestBit(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int) index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+}
+
+void DirtyBits::Resize(size_t n) {
+    const size_t old_n = n_bit;
+    words.resize((n + 63) / 64, 0);
+    n_bit = n;
+    if (n > old_n) {
+        SetRange(old_n, n);
+    } else if (n % 64 != 0) {
+        // bits beyond the end stay clear, so Collect() never sees them
+        words.back() &= (uint64_t(1) << (n % 64)) - 1;
+    }
+}
+
+void DirtyBits::SetRange(size_t begin, size_t end) {
+    assert(begin <= end && end <= n_bit);
+    for (size_t i = begin; i < end;) {
+        const size_t bit = i % 64;
+        const size_t n = std::min<size_t>(64 - bit, end - i);
+        const uint64_t mask = n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1) << bit;
+        words[i / 64] |= mask;
+        i += n;
+    }
+}
+
+void DirtyBits::ClearAll() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+bool DirtyBits::Any() const {
+    return std::any_of(words.begin(), words.end(), [](uint64_t w) {
+        return w != 0;
+    });
+}
+
+void DirtyBits::Collect(std::vector<DirtyRange> &ranges, size_t max_gap) const {
+    ranges.clear();
+    for (size_t w = 0; w < words.size(); w++) {
+        uint64_t bits = words[w];
+        while (bits != 0) {
+            // a run of ones starts at the lowest set bit and ends at the lowest clear bit above it
+            const int begin = LowestBit(bits);
+            const uint64_t filled = bits | ((uint64_t(1) << begin) - 1);
+            const int end = ~filled == 0 ? 64 : LowestBit(~filled);
+            const size_t run_begin = w * 64 + begin;
+            const size_t run_end = w * 64 + end;
+            if (!ranges.empty() && run_begin - ranges.back().end <= max_gap) {
+                ranges.back().end = run_end;
+            } else {
+                ranges.push_back({ run_begin, run_end });
+            }
+            bits = end == 64 ? 0 : bits & (~uint64_t(0) << end);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// materials packed one after another in a structured buffer, instead of one 256-byte constant buffer slot each
+// every frame resource has its own copy of the buffer, so a change is pending once for each of them,
+// which records are pending is a bitset per frame resource and only those are copied, in contiguous spans
+
+// records [begin, end)
+struct DirtyRange {
+    size_t begin;
+    size_t end;
+};
+
+// one bit per record
+class DirtyBits {
+  public:
+    explicit DirtyBits(size_t n = 0) {
+        Resize(n);
+    }
+
+    // records added are dirty
+    void Resize(size_t n);
+    void Set(size_t i) {
+        assert(i < n_bit);
+        words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    void SetRange(size_t begin, size_t end);
+    void SetAll() {
+        SetRange(0, n_bit);
+    }
+    void ClearAll();
+    bool Test(size_t i) const {
+        assert(i < n_bit);
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+    bool Any() const;
+    size_t Size() const {
+        return n_bit;
+    }
+
+    // runs of dirty records in order, runs with at most max_gap clean records between them are merged into one
+    void Collect(std::vector<DirtyRange> &ranges, size_t max_gap = 0) const;
+
+  private:
+    std::vector<uint64_t> words;
+    size_t n_bit = 0;
+};
+
+// T is the record as the shaders read it, e.g. MaterialConst
+template <typename T>
+class MaterialTable {
+  public:
+    // max_gap as in DirtyBits::Collect(), copying a few clean records is cheaper than another copy
+    explicit MaterialTable(size_t n_frame, size_t max_gap = 2) : dirty(n_frame), max_gap(max_gap) {}
+
+    size_t Add(const T &record) {
+        records.push_back(record);
+        for (auto &bits : dirty) {
+            bits.Resize(records.size());
+        }
+        return records.size() - 1;
+    }
+    void Set(size_t i, const T &record) {
+        records[i] = record;
+        for (auto &bits : dirty) {
+            bits.Set(i);
+        }
+    }
+    const T &Get(size_t i) const {
+        return records[i];
+    }
+    size_t Size() const {
+        return records.size();
+    }
+
+    // copy what frame resource `frame` has not got yet into dst, a buffer of Size() records
+    // returns number of copies
+    size_t Upload(size_t frame, T *dst) {
+        DirtyBits &bits = dirty[frame];
+        bits.Collect(ranges, max_gap);
+        for (const DirtyRange &range : ranges) {
+            std::memcpy(dst + range.begin, records.data() + range.begin, (range.end - range.begin) * sizeof(T));
+        }
+        bits.ClearAll();
+        return ranges.size();
+    }
+    // ranges of the last Upload()
+    const std::vector<DirtyRange> &LastRanges() const {
+        return ranges;
+    }
+
+  private:
+    std::vector<T> records;
+    std::vector<DirtyBits> dirty;
+    std::vector<DirtyRange> ranges;
+    size_t max_gap;
+};
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "MeshArena.h"
+
+#include <cassert>
+
+uint32_t MeshArena::AddPool(uint64_t layout, uint32_t n_vertex, uint32_t n_index) {
+    Pool pool;
+    pool.layout = layout;
+    // one unit is one vertex or one index
+    pool.vertices.Reset(n_vertex, 1);
+    pool.indices.Reset(n_index, 1);
+    pools.push_back(std::move(pool));
+    return (uint32_t) pools.size() - 1;
+}
+
+bool MeshArena::Allocate(uint64_t layout, uint32_t n_vertex, uint32_t n_index, Mesh &mesh) {
+    for (uint32_t p = 0; p < pools.size(); p++) {
+        Pool &pool = pools[p];
+        if (pool.layout != layout) {
+            continue;
+        }
+        TlsfAllocator::Handle vertices, indices;
+        if (!pool.vertices.Allocate(n_vertex, 1, vertices)) {
+            continue;
+        }
+        if (!pool.indices.Allocate(n_index, 1, indices)) {
+            pool.vertices.Free(vertices);
+            continue;
+        }
+        mesh = { p, vertices, indices };
+        return true;
+    }
+    return false;
+}
+
+void MeshArena::Free(const Mesh &mesh) {
+    assert(mesh.pool < pools.size());
+    pools[mesh.pool].vertices.Free(mesh.vertices);
+    pools[mesh.pool].indices.Free(mesh.indices);
+}
+
+MeshArena::Range MeshArena::GetRange(const Mesh &mesh) const {
+    assert(mesh.pool < pools.size());
+    const Pool &pool = pools[mesh.pool];
+    Range range;
+    range.base_vertex = (uint32_t) pool.vertices.Offset(mesh.vertices);
+    range.n_vertex = (uint32_t) pool.vertices.Size(mesh.vertices);
+    range.start_index = (uint32_t) pool.indices.Offset(mesh.indices);
+    range.n_index = (uint32_t) pool.indices.Size(mesh.indices);
+    return range;
+}
+
+void MeshArena::Compact(uint32_t pool, std::vector<TlsfAllocator::Move> &vertex_moves,
+        std::vector<TlsfAllocator::Move> &index_moves) {
+    assert(pool < pools.size());
+    pools[pool].vertices.Defragment(vertex_moves);
+    pools[pool].indices.Defragment(index_moves);
+}
+
+MeshArena::PoolStats MeshArena::GetStats(uint32_t pool) const {
+    assert(pool < pools.size());
+    return { pools[pool].vertices.GetStats(), pools[pool].indices.GetStats() };
+}
\ No newline at end of file
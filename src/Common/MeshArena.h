@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Tlsf.h"
+
+// ranges of shared vertex & index buffers taken by meshes, nothing here touches D3D (see GeometryArena.h for that)
+// a pool is a vertex buffer and an index buffer of one vertex layout, counted in vertices and indices,
+// a mesh is a range of each, so it's drawn with base_vertex & start_index into the shared buffers
+class MeshArena {
+  public:
+    struct Mesh {
+        uint32_t pool = UINT32_MAX;
+        TlsfAllocator::Handle vertices = TlsfAllocator::kInvalidHandle;
+        TlsfAllocator::Handle indices = TlsfAllocator::kInvalidHandle;
+    };
+    struct Range {
+        uint32_t base_vertex;
+        uint32_t n_vertex;
+        uint32_t start_index;
+        uint32_t n_index;
+    };
+    struct PoolStats {
+        TlsfAllocator::Stats vertices;
+        TlsfAllocator::Stats indices;
+    };
+
+    // layout is anything telling layouts apart, e.g. stride and index format packed
+    uint32_t AddPool(uint64_t layout, uint32_t n_vertex, uint32_t n_index);
+    uint32_t PoolCount() const {
+        return (uint32_t) pools.size();
+    }
+    uint64_t PoolLayout(uint32_t pool) const {
+        return pools[pool].layout;
+    }
+
+    // in the first pool of the layout with room, false if there is none
+    bool Allocate(uint64_t layout, uint32_t n_vertex, uint32_t n_index, Mesh &mesh);
+    void Free(const Mesh &mesh);
+    Range GetRange(const Mesh &mesh) const;
+
+    // pack meshes of a pool to the beginning of its buffers, moves are in vertices and indices
+    // ranges of meshes in the pool change, handles don't
+    void Compact(uint32_t pool, std::vector<TlsfAllocator::Move> &vertex_moves,
+        std::vector<TlsfAllocator::Move> &index_moves);
+    PoolStats GetStats(uint32_t pool) const;
+
+  private:
+    struct Pool {
+        uint64_t layout;
+        TlsfAllocator vertices;
+        TlsfAllocator indices;
+    };
+
+    std::vector<Pool> pools;
+};
\ No newline at end of file
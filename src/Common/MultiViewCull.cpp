@@ -0,0 +1,125 @@
+#include "MultiViewCull.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MULTI_VIEW_CULL_SSE2
+#endif
+
+CullBox CullBox::Transform(const float center[3], const float extents[3], const float model[4][4]) {
+    // row vectors, the extents along each world axis are the sum of the scaled object axes projected on it
+    CullBox box;
+    for (int c = 0; c < 3; c++) {
+        box.center[c] = center[0] * model[0][c] + center[1] * model[1][c] + center[2] * model[2][c] + model[3][c];
+        box.extents[c] = extents[0] * std::abs(model[0][c]) + extents[1] * std::abs(model[1][c]) +
+            extents[2] * std::abs(model[2][c]);
+    }
+    return box;
+}
+
+uint32_t MultiViewCull::AddView(const Frustum &frustum) {
+    assert(views.size() < kMaxCullViews);
+    views.push_back(frustum);
+    return (uint32_t) views.size() - 1;
+}
+
+void MultiViewCull::TestBlock(const CullBox *boxes, size_t block, size_t n) {
+    const size_t begin = block * kBlockSize;
+    const size_t end = std::min(n, begin + kBlockSize);
+    const size_t n_view = views.size();
+    uint32_t *counts = block_counts.data() + block * n_view;
+    std::fill(counts, counts + n_view, 0);
+
+    size_t i = begin;
+#ifdef MULTI_VIEW_CULL_SSE2
+    // a box is outside a plane if its corner furthest along the normal is behind it, as Frustum::TestAabb,
+    // that is p . center + |p| . extents + d < 0
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (; i + 4 <= end; i += 4) {
+        const CullBox *b = boxes + i;
+        const __m128 cx = _mm_set_ps(b[3].center[0], b[2].center[0], b[1].center[0], b[0].center[0]);
+        const __m128 cy = _mm_set_ps(b[3].center[1], b[2].center[1], b[1].center[1], b[0].center[1]);
+        const __m128 cz = _mm_set_ps(b[3].center[2], b[2].center[2], b[1].center[2], b[0].center[2]);
+        const __m128 ex = _mm_set_ps(b[3].extents[0], b[2].extents[0], b[1].extents[0], b[0].extents[0]);
+        const __m128 ey = _mm_set_ps(b[3].extents[1], b[2].extents[1], b[1].extents[1], b[0].extents[1]);
+        const __m128 ez = _mm_set_ps(b[3].extents[2], b[2].extents[2], b[1].extents[2], b[0].extents[2]);
+        uint32_t lane_masks[4] = { 0, 0, 0, 0 };
+        for (size_t v = 0; v < n_view; v++) {
+            __m128 outside = _mm_setzero_ps();
+            for (const float *p : views[v].planes) {
+                const __m128 px = _mm_set1_ps(p[0]);
+                const __m128 py = _mm_set1_ps(p[1]);
+                const __m128 pz = _mm_set1_ps(p[2]);
+                const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+                    _mm_add_ps(_mm_mul_ps(pz, cz), _mm_set1_ps(p[3])));
+                const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, sign_mask), ex),
+                    _mm_mul_ps(_mm_and_ps(py, sign_mask), ey)), _mm_mul_ps(_mm_and_ps(pz, sign_mask), ez));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+            }
+            const int inside = ~_mm_movemask_ps(outside) & 0xf;
+            for (int lane = 0; lane < 4; lane++) {
+                const uint32_t bit = (inside >> lane) & 1;
+                lane_masks[lane] |= bit << v;
+                counts[v] += bit;
+            }
+        }
+        std::copy_n(lane_masks, 4, masks.data() + i);
+    }
+#endif
+    for (; i < end; i++) {
+        const CullBox &b = boxes[i];
+        uint32_t mask = 0;
+        for (size_t v = 0; v < n_view; v++) {
+            bool inside = true;
+            for (const float *p : views[v].planes) {
+                const float d = p[0] * b.center[0] + p[1] * b.center[1] + p[2] * b.center[2] + p[3];
+                const float r = std::abs(p[0]) * b.extents[0] + std::abs(p[1]) * b.extents[1] +
+                    std::abs(p[2]) * b.extents[2];
+                inside = inside && d + r >= 0.0f;
+            }
+            mask |= (uint32_t) inside << v;
+            counts[v] += inside;
+        }
+        masks[i] = mask;
+    }
+}
+
+void MultiViewCull::Cull(JobSystem &jobs, const CullBox *boxes, size_t n) {
+    const size_t n_view = views.size();
+    const size_t n_block = (n + kBlockSize - 1) / kBlockSize;
+    masks.resize(n);
+    visible.resize(n_view);
+    block_counts.resize(n_block * n_view);
+
+    // one pass over the boxes for all views
+    jobs.ParallelFor(0, n_block, [this, boxes, n](size_t block) {
+        TestBlock(boxes, block, n);
+    });
+
+    // offsets of the blocks in the draw list of each view
+    for (size_t v = 0; v < n_view; v++) {
+        uint32_t offset = 0;
+        for (size_t block = 0; block < n_block; block++) {
+            const uint32_t count = block_counts[block * n_view + v];
+            block_counts[block * n_view + v] = offset;
+            offset += count;
+        }
+        visible[v].resize(offset);
+    }
+
+    // compact each block into the draw lists
+    jobs.ParallelFor(0, n_block, [this, n, n_view](size_t block) {
+        const size_t end = std::min(n, (block + 1) * kBlockSize);
+        for (size_t v = 0; v < n_view; v++) {
+            uint32_t *out = visible[v].data() + block_counts[block * n_view + v];
+            for (size_t i = block * kBlockSize; i < end; i++) {
+                if (masks[i] & (1u << v)) {
+                    *out++ = (uint32_t) i;
+                }
+            }
+        }
+    });
+}
\ No newline at end of file
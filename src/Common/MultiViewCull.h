@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+
+// frustum culling of the same objects for several views at once (main camera, mirror, shadow cascades),
+// every box is loaded once and tested against the planes of all views, 4 boxes at a time with SSE2
+// a view drawing objects through a matrix (the reflection of a mirror) culls them with Frustum::FromViewProj of
+// that matrix times its view-projection, so its items share the boxes of the originals
+
+const uint32_t kMaxCullViews = 32;
+
+// world space aabb
+struct CullBox {
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    float extents[3] = { 0.0f, 0.0f, 0.0f };
+
+    // box of object space center & extents (as SubmeshGeometry::bbox) placed by a row-major model matrix
+    static CullBox Transform(const float center[3], const float extents[3], const float model[4][4]);
+};
+
+class MultiViewCull {
+  public:
+    void ClearViews() {
+        views.clear();
+    }
+    // returns the index of the view, which is its bit in Masks()
+    uint32_t AddView(const Frustum &frustum);
+    uint32_t ViewCount() const {
+        return (uint32_t) views.size();
+    }
+
+    // test boxes [0, n) against all views, results don't depend on the thread count
+    void Cull(JobSystem &jobs, const CullBox *boxes, size_t n);
+
+    // bit v of Masks()[i] is set if box i intersects view v
+    const std::vector<uint32_t> &Masks() const {
+        return masks;
+    }
+    // the draw list of a view, boxes intersecting it in increasing order
+    const std::vector<uint32_t> &Visible(uint32_t view) const {
+        return visible[view];
+    }
+
+  private:
+    // boxes per block, blocks are tested in parallel and then compacted in parallel, a multiple of 4
+    static constexpr size_t kBlockSize = 256;
+
+    // masks of the boxes of a block and their counts per view
+    void TestBlock(const CullBox *boxes, size_t block, size_t n);
+
+    std::vector<Frustum> views;
+    std::vector<uint32_t> masks;
+    std::vector<std::vector<uint32_t>> visible;
+    std::vector<uint32_t> block_counts; // boxes of each view in each block, then their offsets
+};
\ No newline at end of file
@@ -0,0 +1,391 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2
+#endif
+
+namespace {
+
+struct ClipVertex {
+    float v[4];
+};
+
+void Multiply(const float a[4][4], const float b[4][4], float out[4][4]) {
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+        }
+    }
+}
+
+ClipVertex Transform(const float p[3], const float m[4][4]) {
+    ClipVertex out;
+    for (int c = 0; c < 4; c++) {
+        out.v[c] = p[0] * m[0][c] + p[1] * m[1][c] + p[2] * m[2][c] + m[3][c];
+    }
+    return out;
+}
+
+// floor & ceil of v clamped to [0, max], without calls to floor() & ceil()
+int32_t FloorClamped(float v, float max) {
+    return (int32_t) std::clamp(v, 0.0f, max);
+}
+int32_t CeilClamped(float v, float max) {
+    v = std::clamp(v, 0.0f, max);
+    const int32_t i = (int32_t) v;
+    return (float) i < v ? i + 1 : i;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) : width(width), height(height) {
+    assert(width % kOcclusionTileSize == 0 && height % kOcclusionTileSize == 0);
+    n_tile_x = width / kOcclusionTileSize;
+    depth.resize((size_t) width * height, 1.0f);
+    tile_max.resize((size_t) n_tile_x * (height / kOcclusionTileSize), 1.0f);
+    std::memset(view_proj, 0, sizeof(view_proj));
+}
+
+void OcclusionBuffer::SetupTriangle(const float mvp[4][4], const Occluder &occluder, size_t triangle,
+        Triangle out[2]) const {
+    out[0].y0 = out[0].y1 = 0;
+    out[1].y0 = out[1].y1 = 0;
+
+    ClipVertex verts[3];
+    for (int i = 0; i < 3; i++) {
+        const size_t index_pos = occluder.start_index + 3 * triangle + i;
+        const uint32_t index = occluder.index32 ? static_cast<const uint32_t *>(occluder.indices)[index_pos]
+            : static_cast<const uint16_t *>(occluder.indices)[index_pos];
+        const float *pos = reinterpret_cast<const float *>(static_cast<const uint8_t *>(occluder.vertices) +
+            (size_t) ((int64_t) occluder.base_vertex + index) * occluder.stride);
+        verts[i] = Transform(pos, mvp);
+    }
+
+    // clip by the near plane (z >= 0), a triangle becomes a triangle or a quad
+    ClipVertex poly[4];
+    int n_poly = 0;
+    for (int i = 0; i < 3; i++) {
+        const ClipVertex &a = verts[i];
+        const ClipVertex &b = verts[(i + 1) % 3];
+        if (a.v[2] >= 0.0f) {
+            poly[n_poly++] = a;
+        }
+        if ((a.v[2] >= 0.0f) != (b.v[2] >= 0.0f)) {
+            const float t = a.v[2] / (a.v[2] - b.v[2]);
+            ClipVertex &p = poly[n_poly++];
+            for (int c = 0; c < 4; c++) {
+                p.v[c] = a.v[c] + t * (b.v[c] - a.v[c]);
+            }
+            p.v[2] = 0.0f;
+        }
+    }
+    if (n_poly < 3) {
+        return;
+    }
+
+    float screen[4][3];
+    for (int i = 0; i < n_poly; i++) {
+        const float w_inv = 1.0f / poly[i].v[3];
+        screen[i][0] = (poly[i].v[0] * w_inv * 0.5f + 0.5f) * width;
+        screen[i][1] = (0.5f - poly[i].v[1] * w_inv * 0.5f) * height;
+        screen[i][2] = poly[i].v[2] * w_inv;
+    }
+
+    for (int t = 0; t + 2 < n_poly; t++) {
+        const float *p[3] = { screen[0], screen[t + 1], screen[t + 2] };
+        float area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]);
+        if (area == 0.0f) {
+            continue;
+        }
+        // both faces are drawn
+        if (area < 0.0f) {
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+
+        Triangle &tri = out[t];
+        const float area_inv = 1.0f / area;
+        for (int e = 0; e < 3; e++) {
+            // edge e is opposite to vertex e, so it is zero on the other two and area at vertex e
+            const float *pa = p[(e + 1) % 3];
+            const float *pb = p[(e + 2) % 3];
+            tri.edges[e][0] = pa[1] - pb[1];
+            tri.edges[e][1] = pb[0] - pa[0];
+            tri.edges[e][2] = -(tri.edges[e][0] * pa[0] + tri.edges[e][1] * pa[1]);
+        }
+        // the depth plane goes through the vertex nearest the screen center, near-clipped vertices may be far
+        // off screen and a plane through them loses its constant term to cancellation
+        int o = 0;
+        float o_dist = (float) (width + height) * 1e6f;
+        for (int i = 0; i < 3; i++) {
+            const float dist = std::max(std::abs(p[i][0] - 0.5f * width), std::abs(p[i][1] - 0.5f * height));
+            if (dist < o_dist) {
+                o = i;
+                o_dist = dist;
+            }
+        }
+        const float *po = p[o], *pu = p[(o + 1) % 3], *pv = p[(o + 2) % 3];
+        tri.z[0] = ((pu[2] - po[2]) * (pv[1] - po[1]) - (pv[2] - po[2]) * (pu[1] - po[1])) * area_inv;
+        tri.z[1] = ((pv[2] - po[2]) * (pu[0] - po[0]) - (pu[2] - po[2]) * (pv[0] - po[0])) * area_inv;
+        tri.z[2] = po[2] - tri.z[0] * po[0] - tri.z[1] * po[1];
+
+        const float min_x = std::min({ p[0][0], p[1][0], p[2][0] });
+        const float max_x = std::max({ p[0][0], p[1][0], p[2][0] });
+        const float min_y = std::min({ p[0][1], p[1][1], p[2][1] });
+        const float max_y = std::max({ p[0][1], p[1][1], p[2][1] });
+        tri.x0 = FloorClamped(min_x, (float) width);
+        tri.x1 = CeilClamped(max_x, (float) width);
+        tri.y0 = FloorClamped(min_y, (float) height);
+        tri.y1 = CeilClamped(max_y, (float) height);
+        if (tri.x0 >= tri.x1) {
+            tri.y1 = tri.y0;
+        }
+    }
+}
+
+void OcclusionBuffer::SetupChunk(const Occluder *occluders, size_t chunk_index) {
+    Chunk &chunk = chunks[chunk_index];
+    chunk.triangles.clear();
+    const size_t begin = chunk_index * kChunkSize;
+    const size_t end = std::min(first_triangles.back(), begin + kChunkSize);
+    size_t occluder = std::upper_bound(first_triangles.begin(), first_triangles.end(), begin) -
+        first_triangles.begin() - 1;
+    for (size_t t = begin; t < end; t++) {
+        while (t >= first_triangles[occluder + 1]) {
+            ++occluder;
+        }
+        Triangle setup[2];
+        SetupTriangle(reinterpret_cast<const float (*)[4]>(mvps.data() + 16 * occluder), occluders[occluder],
+            t - first_triangles[occluder], setup);
+        for (const Triangle &tri : setup) {
+            if (tri.y0 < tri.y1) {
+                chunk.triangles.push_back(tri);
+            }
+        }
+    }
+
+    // bin triangles to the bands they touch
+    const uint32_t n_band = height / kOcclusionTileSize;
+    const int32_t tile = kOcclusionTileSize;
+    chunk.first_binned.assign(n_band + 1, 0);
+    for (const Triangle &tri : chunk.triangles) {
+        for (int32_t band = tri.y0 / tile; band <= (tri.y1 - 1) / tile; band++) {
+            ++chunk.first_binned[band + 1];
+        }
+    }
+    for (uint32_t band = 0; band < n_band; band++) {
+        chunk.first_binned[band + 1] += chunk.first_binned[band];
+    }
+    chunk.binned.resize(chunk.first_binned[n_band]);
+    for (uint32_t i = 0; i < chunk.triangles.size(); i++) {
+        const Triangle &tri = chunk.triangles[i];
+        for (int32_t band = tri.y0 / tile; band <= (tri.y1 - 1) / tile; band++) {
+            chunk.binned[chunk.first_binned[band]++] = i;
+        }
+    }
+    // first_binned[band] ended at the first of the next band
+    for (uint32_t band = n_band; band > 0; band--) {
+        chunk.first_binned[band] = chunk.first_binned[band - 1];
+    }
+    chunk.first_binned[0] = 0;
+}
+
+void OcclusionBuffer::RasterizeRows(const Triangle &tri, int32_t y0, int32_t y1) {
+    // groups of 4 pixels start at multiples of 4, width is one too
+    const int32_t x_begin = tri.x0 & ~3;
+    for (int32_t y = y0; y < y1; y++) {
+        const float fy = y + 0.5f;
+        float *row = depth.data() + (size_t) y * width;
+        const float c0 = tri.edges[0][1] * fy + tri.edges[0][2];
+        const float c1 = tri.edges[1][1] * fy + tri.edges[1][2];
+        const float c2 = tri.edges[2][1] * fy + tri.edges[2][2];
+        const float cz = tri.z[1] * fy + tri.z[2];
+        int32_t x = x_begin;
+#ifdef OCCLUSION_SSE2
+        const __m128 a0 = _mm_set1_ps(tri.edges[0][0]);
+        const __m128 a1 = _mm_set1_ps(tri.edges[1][0]);
+        const __m128 a2 = _mm_set1_ps(tri.edges[2][0]);
+        const __m128 az = _mm_set1_ps(tri.z[0]);
+        const __m128 c0_4 = _mm_set1_ps(c0);
+        const __m128 c1_4 = _mm_set1_ps(c1);
+        const __m128 c2_4 = _mm_set1_ps(c2);
+        const __m128 cz_4 = _mm_set1_ps(cz);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 fx = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        const __m128 step = _mm_set1_ps(4.0f);
+        for (; x < tri.x1; x += 4, fx = _mm_add_ps(fx, step)) {
+            const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, fx), c0_4);
+            const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, fx), c1_4);
+            const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, fx), c2_4);
+            const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            const __m128 z = _mm_add_ps(_mm_mul_ps(az, fx), cz_4);
+            const __m128 old_z = _mm_loadu_ps(row + x);
+            const __m128 new_z = _mm_min_ps(old_z, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+        }
+#else
+        for (; x < tri.x1; x++) {
+            const float fx = x + 0.5f;
+            if (tri.edges[0][0] * fx + c0 >= 0.0f && tri.edges[1][0] * fx + c1 >= 0.0f &&
+                    tri.edges[2][0] * fx + c2 >= 0.0f) {
+                row[x] = std::min(row[x], tri.z[0] * fx + cz);
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionBuffer::RasterizeBand(uint32_t band) {
+    const int32_t band_y0 = band * kOcclusionTileSize;
+    const int32_t band_y1 = band_y0 + kOcclusionTileSize;
+    for (const Chunk &chunk : chunks) {
+        for (uint32_t i = chunk.first_binned[band]; i < chunk.first_binned[band + 1]; i++) {
+            const Triangle &tri = chunk.triangles[chunk.binned[i]];
+            RasterizeRows(tri, std::max(tri.y0, band_y0), std::min(tri.y1, band_y1));
+        }
+    }
+
+    // farthest depth of the tiles of the band
+    for (uint32_t tx = 0; tx < n_tile_x; tx++) {
+        float max_z = 0.0f;
+        for (int32_t y = band_y0; y < band_y1; y++) {
+            const float *row = depth.data() + (size_t) y * width + tx * kOcclusionTileSize;
+            for (uint32_t x = 0; x < kOcclusionTileSize; x++) {
+                max_z = std::max(max_z, row[x]);
+            }
+        }
+        tile_max[band * n_tile_x + tx] = max_z;
+    }
+}
+
+void OcclusionBuffer::Render(JobSystem &jobs, const float view_proj[4][4], const Occluder *occluders, size_t n) {
+    const auto begin = std::chrono::steady_clock::now();
+    std::memcpy(this->view_proj, view_proj, sizeof(this->view_proj));
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    first_triangles.resize(n + 1);
+    mvps.resize(16 * n);
+    first_triangles[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        first_triangles[i + 1] = first_triangles[i] + occluders[i].n_index / 3;
+        Multiply(occluders[i].model, view_proj, reinterpret_cast<float (*)[4]>(mvps.data() + 16 * i));
+    }
+    const size_t n_triangle = first_triangles[n];
+    chunks.resize((n_triangle + kChunkSize - 1) / kChunkSize);
+    jobs.ParallelFor(0, chunks.size(), [this, occluders](size_t chunk) {
+        SetupChunk(occluders, chunk);
+    });
+    jobs.ParallelFor(0, height / kOcclusionTileSize, [this](size_t band) {
+        RasterizeBand((uint32_t) band);
+    });
+
+    size_t n_rasterized = 0;
+    for (const Chunk &chunk : chunks) {
+        n_rasterized += chunk.triangles.size();
+    }
+    stats = {};
+    stats.n_triangle = n_triangle;
+    stats.n_rasterized = n_rasterized;
+    stats.raster_ms = Milliseconds(begin);
+}
+
+bool OcclusionBuffer::IsVisible(const Occludee &occludee) const {
+    float mvp[4][4];
+    Multiply(occludee.model, view_proj, mvp);
+
+    float min_x = (float) width, max_x = 0.0f;
+    float min_y = (float) height, max_y = 0.0f;
+    float min_z = 1.0f;
+    int n_behind = 0;
+    for (int i = 0; i < 8; i++) {
+        const float corner[3] = {
+            occludee.center[0] + ((i & 1) ? occludee.extents[0] : -occludee.extents[0]),
+            occludee.center[1] + ((i & 2) ? occludee.extents[1] : -occludee.extents[1]),
+            occludee.center[2] + ((i & 4) ? occludee.extents[2] : -occludee.extents[2])
+        };
+        const ClipVertex clip = Transform(corner, mvp);
+        if (clip.v[2] < 0.0f) {
+            ++n_behind;
+            continue;
+        }
+        const float w_inv = 1.0f / clip.v[3];
+        const float x = (clip.v[0] * w_inv * 0.5f + 0.5f) * width;
+        const float y = (0.5f - clip.v[1] * w_inv * 0.5f) * height;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, clip.v[2] * w_inv);
+    }
+    if (n_behind > 0) {
+        return n_behind < 8;
+    }
+
+    const int32_t x0 = FloorClamped(min_x, (float) width);
+    const int32_t x1 = CeilClamped(max_x, (float) width);
+    const int32_t y0 = FloorClamped(min_y, (float) height);
+    const int32_t y1 = CeilClamped(max_y, (float) height);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+
+    const int32_t tile = kOcclusionTileSize;
+    for (int32_t ty = y0 / tile; ty <= (y1 - 1) / tile; ty++) {
+        for (int32_t tx = x0 / tile; tx <= (x1 - 1) / tile; tx++) {
+            if (tile_max[ty * n_tile_x + tx] < min_z) {
+                continue;
+            }
+            // the box may show in this tile, look at the pixels it covers
+            const int32_t px0 = std::max(x0, tx * tile);
+            const int32_t px1 = std::min(x1, (tx + 1) * tile);
+            const int32_t py0 = std::max(y0, ty * tile);
+            const int32_t py1 = std::min(y1, (ty + 1) * tile);
+            for (int32_t y = py0; y < py1; y++) {
+                const float *row = depth.data() + (size_t) y * width;
+                int32_t x = px0;
+#ifdef OCCLUSION_SSE2
+                const __m128 min_z4 = _mm_set1_ps(min_z);
+                for (; x + 4 <= px1; x += 4) {
+                    if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), min_z4)) != 0) {
+                        return true;
+                    }
+                }
+#endif
+                for (; x < px1; x++) {
+                    if (row[x] >= min_z) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+size_t OcclusionBuffer::Test(JobSystem &jobs, const Occludee *occludees, size_t n, bool *visible) {
+    const auto begin = std::chrono::steady_clock::now();
+    jobs.ParallelFor(0, n, [this, occludees, visible](size_t i) {
+        visible[i] = IsVisible(occludees[i]);
+    }, 16);
+    const size_t n_visible = std::count(visible, visible + n, true);
+
+    stats.n_tested = n;
+    stats.n_occluded = n - n_visible;
+    stats.test_ms = Milliseconds(begin);
+    return n_visible;
+}
\ No newline at end of file
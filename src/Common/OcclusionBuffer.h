@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+// cpu occlusion culling: occluder meshes are rasterized into a small depth buffer and bounding boxes of occludees
+// are tested against it, so draws hidden behind walls or terrain can be skipped
+// matrices are row-major and used with row vectors (DirectXMath convention, clip z in [0, 1]), as in Frustum.h
+// the buffer is split into kOcclusionTileSize^2 tiles that keep their farthest depth, a box behind it is hidden in
+// the whole tile without looking at its pixels, each row of tiles is rasterized by one job
+// occluders are double-sided, their triangles are clipped by the near plane
+
+const uint32_t kOcclusionTileSize = 8;
+
+// a range of an indexed triangle list, e.g. MeshGeometry::vb_cpu & ib_cpu with one of its submeshes
+struct Occluder {
+    const void *vertices = nullptr; // position is the first 3 floats of a vertex
+    uint32_t stride = 12; // in bytes
+    const void *indices = nullptr;
+    bool index32 = false;
+    uint32_t n_index = 0;
+    uint32_t start_index = 0;
+    int32_t base_vertex = 0;
+    float model[4][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+};
+
+// box in object space, as SubmeshGeometry::bbox, placed by model
+struct Occludee {
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    float extents[3] = { 0.0f, 0.0f, 0.0f };
+    float model[4][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+};
+
+struct OcclusionStats {
+    size_t n_triangle = 0; // occluder triangles given
+    size_t n_rasterized = 0; // triangles left after clipping that touch the buffer
+    size_t n_tested = 0;
+    size_t n_occluded = 0;
+    double raster_ms = 0.0;
+    double test_ms = 0.0;
+
+    float CullRate() const {
+        return n_tested == 0 ? 0.0f : (float) n_occluded / n_tested;
+    }
+};
+
+class OcclusionBuffer {
+  public:
+    // width & height are multiples of kOcclusionTileSize
+    OcclusionBuffer(uint32_t width = 320, uint32_t height = 192);
+
+    // clear the buffer and rasterize occluders as seen through view_proj
+    void Render(JobSystem &jobs, const float view_proj[4][4], const Occluder *occluders, size_t n);
+    // false if the box is hidden behind the occluders or off screen (behind the eye included),
+    // a box crossing the near plane is visible
+    bool IsVisible(const Occludee &occludee) const;
+    // visible[i] = IsVisible(occludees[i]), returns the number of visible ones
+    size_t Test(JobSystem &jobs, const Occludee *occludees, size_t n, bool *visible);
+
+    uint32_t Width() const {
+        return width;
+    }
+    uint32_t Height() const {
+        return height;
+    }
+    // row by row from the top, 1 is the far plane
+    const float *Depth() const {
+        return depth.data();
+    }
+    // of the last Render() and Test()
+    const OcclusionStats &Stats() const {
+        return stats;
+    }
+
+  private:
+    // edge functions a * x + b * y + c are positive inside, depth is a plane over the screen too
+    struct Triangle {
+        float edges[3][3];
+        float z[3];
+        int32_t x0, y0, x1, y1; // pixels [x0, x1) x [y0, y1), none if y0 >= y1
+    };
+
+    // triangles set up and binned to bands by one job
+    struct Chunk {
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> first_binned; // of each band, and the total count at the end
+        std::vector<uint32_t> binned;
+    };
+
+    static constexpr size_t kChunkSize = 4096;
+
+    void SetupTriangle(const float mvp[4][4], const Occluder &occluder, size_t triangle, Triangle out[2]) const;
+    void SetupChunk(const Occluder *occluders, size_t chunk_index);
+    void RasterizeRows(const Triangle &tri, int32_t y0, int32_t y1);
+    void RasterizeBand(uint32_t band);
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t n_tile_x;
+    std::vector<float> depth;
+    std::vector<float> tile_max;
+
+    float view_proj[4][4];
+    std::vector<size_t> first_triangles; // of each occluder, and the total count at the end
+    std::vector<float> mvps; // 16 floats per occluder
+    std::vector<Chunk> chunks; // kChunkSize occluder triangles each
+
+    OcclusionStats stats;
+};
\ No newline at end of file
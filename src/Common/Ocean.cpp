@@ -0,0 +1,226 @@
+#include "Ocean.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#include "Random.h"
+#include "SinCos.h"
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+const float kGravity = 9.81f;
+// phillips constant
+const float kPhillipsAlpha = 0.0081f;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// directional spectral density of the wave vector (kx, kz) times the area of a frequency cell,
+// which is the expected |h~0(k)|^2 + |h~0(-k)|^2 of the cell
+float Spectrum(const OceanSettings &settings, float wind_x, float wind_z, float kx, float kz) {
+    const float k = std::sqrt(kx * kx + kz * kz);
+    if (k < 1e-6f) {
+        return 0.0f;
+    }
+    const float dk = 2.0f * kPi / settings.length;
+    const float cos_theta = (kx * wind_x + kz * wind_z) / k;
+    const float damping = std::exp(-k * k * settings.small_wave * settings.small_wave);
+
+    if (settings.spectrum == OceanSpectrum::Phillips) {
+        // largest waves the wind makes
+        const float l = settings.wind_speed * settings.wind_speed / kGravity;
+        return settings.amplitude * kPhillipsAlpha * std::exp(-1.0f / (k * l * k * l)) / (k * k * k * k) *
+            cos_theta * cos_theta * damping * dk * dk;
+    }
+
+    // jonswap in frequency, spread by cos^2 over the half plane along the wind, and S(k) = S(w) dw/dk / k
+    if (cos_theta <= 0.0f) {
+        return 0.0f;
+    }
+    const float u = settings.wind_speed;
+    const float w = std::sqrt(kGravity * k);
+    const float wp = 22.0f * std::cbrt(kGravity * kGravity / (u * settings.fetch));
+    const float alpha = 0.076f * std::pow(u * u / (settings.fetch * kGravity), 0.22f);
+    const float sigma = w <= wp ? 0.07f : 0.09f;
+    const float r = std::exp(-(w - wp) * (w - wp) / (2.0f * sigma * sigma * wp * wp));
+    const float wp_w = wp / w;
+    const float s_w = alpha * kGravity * kGravity / (w * w * w * w * w) *
+        std::exp(-1.25f * wp_w * wp_w * wp_w * wp_w) * std::pow(settings.gamma, r);
+    const float spread = 2.0f / kPi * cos_theta * cos_theta;
+    return settings.amplitude * s_w * kGravity / (2.0f * w) / k * spread * damping * dk * dk;
+}
+
+}
+
+Ocean::Ocean(JobSystem &jobs, const OceanSettings &settings) : jobs(jobs), fft(settings.n), n(settings.n),
+    length(settings.length), choppiness(settings.choppiness), loop_time(settings.loop_time) {
+    assert(n >= 4 && n <= 1024 && (n & (n - 1)) == 0);
+
+    const size_t n_cell = (size_t) n * n;
+    kx.resize(n);
+    kz.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        // cycles over the patch, column v is v and row u is -u
+        const int32_t p = i < n / 2 ? (int32_t) i : (int32_t) i - (int32_t) n;
+        const int32_t q = i == 0 ? 0 : (n - i < n / 2 ? (int32_t) (n - i) : (int32_t) (n - i) - (int32_t) n);
+        kx[i] = 2.0f * kPi * p / length;
+        kz[i] = 2.0f * kPi * q / length;
+    }
+
+    float wind_x = settings.wind_dir[0], wind_z = settings.wind_dir[1];
+    const float wind_len = std::sqrt(wind_x * wind_x + wind_z * wind_z);
+    wind_x /= wind_len;
+    wind_z /= wind_len;
+
+    // h~0 = (xi_r + i xi_i) sqrt(spectrum) / 2 with normal xi, one random stream per row
+    // the nyquist row & column have no -k on the grid, so they are left out to keep the fields real
+    std::vector<float> h0_re(n_cell), h0_im(n_cell);
+    jobs.ParallelFor(0, n, [&](size_t row) {
+        Random rng(settings.seed, row);
+        for (uint32_t col = 0; col < n; col++) {
+            const float u1 = 1.0f - rng.NextF();
+            const float u2 = rng.NextF();
+            const float radius = std::sqrt(-2.0f * std::log(u1));
+            const float amp = 0.5f * std::sqrt(Spectrum(settings, wind_x, wind_z, kx[col], kz[row]));
+            const bool nyquist = row == n / 2 || col == n / 2;
+            h0_re[row * n + col] = nyquist ? 0.0f : amp * radius * std::cos(2.0f * kPi * u2);
+            h0_im[row * n + col] = nyquist ? 0.0f : amp * radius * std::sin(2.0f * kPi * u2);
+        }
+    });
+
+    k_inv.resize(n_cell);
+    omega.resize(n_cell);
+    sum_re.resize(n_cell);
+    sum_im.resize(n_cell);
+    diff_re.resize(n_cell);
+    diff_im.resize(n_cell);
+    const float spacing = length / n;
+    const float half = 0.5f * (n - 1) * spacing;
+    const float omega_step = 2.0f * kPi / loop_time;
+    jobs.ParallelFor(0, n, [&](size_t row) {
+        const size_t neg_row = (n - row) % n;
+        for (uint32_t col = 0; col < n; col++) {
+            const size_t i = row * n + col;
+            const size_t neg = neg_row * n + (n - col) % n;
+            const float k = std::sqrt(kx[col] * kx[col] + kz[row] * kz[row]);
+            k_inv[i] = k > 0.0f ? 1.0f / k : 0.0f;
+            omega[i] = std::floor(std::sqrt(kGravity * k) / omega_step) * omega_step;
+
+            // e^(i k . x) of the first sample (-half, half), the rest of the grid is the fft
+            const float phase = -kx[col] * half + kz[row] * half;
+            const float c = std::cos(phase), s = std::sin(phase);
+            const float a_re = h0_re[i] * c - h0_im[i] * s;
+            const float a_im = h0_re[i] * s + h0_im[i] * c;
+            const float b_re = h0_re[neg] * c + h0_im[neg] * s;
+            const float b_im = h0_re[neg] * s - h0_im[neg] * c;
+            sum_re[i] = a_re + b_re;
+            sum_im[i] = a_im + b_im;
+            diff_re[i] = a_re - b_re;
+            diff_im[i] = a_im - b_im;
+        }
+    });
+
+    for (int f = 0; f < 3; f++) {
+        field_re[f].resize(n_cell);
+        field_im[f].resize(n_cell);
+    }
+    positions.resize(n_cell);
+    normals.resize(n_cell);
+    tangents.resize(n_cell);
+    Update(0.0f);
+}
+
+void Ocean::EvaluateRow(uint32_t row) {
+    // h~ = sum cos(w t) + i diff sin(w t), then
+    // height + i slope x = (1 - kx) h~, slope z + i displacement x = (kx / k + i kz) h~, displacement z = -i kz / k h~
+    const size_t offset = (size_t) row * n;
+    uint32_t col = 0;
+#ifdef SINCOS_SSE2
+    const __m128 t = _mm_set1_ps(time);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 kz_row = _mm_set1_ps(kz[row]);
+    for (; col < n; col += 4) {
+        const size_t i = offset + col;
+        __m128 s, c;
+        FastSinCos4(_mm_mul_ps(_mm_loadu_ps(&omega[i]), t), s, c);
+        const __m128 h_re = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&sum_re[i]), c),
+            _mm_mul_ps(_mm_loadu_ps(&diff_im[i]), s));
+        const __m128 h_im = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&sum_im[i]), c),
+            _mm_mul_ps(_mm_loadu_ps(&diff_re[i]), s));
+        const __m128 kx_col = _mm_loadu_ps(&kx[col]);
+        const __m128 k_inv_i = _mm_loadu_ps(&k_inv[i]);
+        const __m128 ux = _mm_mul_ps(kx_col, k_inv_i);
+        const __m128 uz = _mm_mul_ps(kz_row, k_inv_i);
+        const __m128 a = _mm_sub_ps(one, kx_col);
+        _mm_storeu_ps(&field_re[0][i], _mm_mul_ps(a, h_re));
+        _mm_storeu_ps(&field_im[0][i], _mm_mul_ps(a, h_im));
+        _mm_storeu_ps(&field_re[1][i], _mm_sub_ps(_mm_mul_ps(ux, h_re), _mm_mul_ps(kz_row, h_im)));
+        _mm_storeu_ps(&field_im[1][i], _mm_add_ps(_mm_mul_ps(ux, h_im), _mm_mul_ps(kz_row, h_re)));
+        _mm_storeu_ps(&field_re[2][i], _mm_mul_ps(uz, h_im));
+        _mm_storeu_ps(&field_im[2][i], _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(uz, h_re)));
+    }
+#endif
+    for (; col < n; col++) {
+        const size_t i = offset + col;
+        float s, c;
+        FastSinCos(omega[i] * time, s, c);
+        const float h_re = sum_re[i] * c - diff_im[i] * s;
+        const float h_im = sum_im[i] * c + diff_re[i] * s;
+        const float ux = kx[col] * k_inv[i];
+        const float uz = kz[row] * k_inv[i];
+        const float a = 1.0f - kx[col];
+        field_re[0][i] = a * h_re;
+        field_im[0][i] = a * h_im;
+        field_re[1][i] = ux * h_re - kz[row] * h_im;
+        field_im[1][i] = ux * h_im + kz[row] * h_re;
+        field_re[2][i] = uz * h_im;
+        field_im[2][i] = 0.0f - uz * h_re;
+    }
+}
+
+void Ocean::BuildRow(uint32_t row) {
+    const float spacing = length / n;
+    const float half = 0.5f * (n - 1) * spacing;
+    const float z = half - row * spacing;
+    for (uint32_t col = 0; col < n; col++) {
+        const size_t i = (size_t) row * n + col;
+        const float height = field_re[0][i];
+        const float slope_x = field_im[0][i];
+        const float slope_z = field_re[1][i];
+        const float disp_x = field_im[1][i];
+        const float disp_z = field_re[2][i];
+
+        positions[i] = { -half + col * spacing + choppiness * disp_x, height, z + choppiness * disp_z };
+        const float n_len_inv = 1.0f / std::sqrt(slope_x * slope_x + 1.0f + slope_z * slope_z);
+        normals[i] = { -slope_x * n_len_inv, n_len_inv, -slope_z * n_len_inv };
+        const float t_len_inv = 1.0f / std::sqrt(1.0f + slope_x * slope_x);
+        tangents[i] = { t_len_inv, slope_x * t_len_inv, 0.0f };
+    }
+}
+
+void Ocean::Update(float dt) {
+    // frequencies are multiples of 2 pi / loop_time, so wrapping the time keeps the phases small
+    time = std::fmod(time + dt, loop_time);
+
+    auto begin = std::chrono::steady_clock::now();
+    jobs.ParallelFor(0, n, [this](size_t row) {
+        EvaluateRow((uint32_t) row);
+    }, std::max<size_t>(1, 4096 / n));
+    stats.spectrum_ms = Milliseconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    for (int f = 0; f < 3; f++) {
+        fft.Transform(jobs, field_re[f].data(), field_im[f].data(), true);
+    }
+    stats.fft_ms = Milliseconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    jobs.ParallelFor(0, n, [this](size_t row) {
+        BuildRow((uint32_t) row);
+    }, std::max<size_t>(1, 4096 / n));
+    stats.vertex_ms = Milliseconds(begin);
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <DirectXMath.h>
+#endif
+
+#include "Fft.h"
+#include "JobSystem.h"
+
+// spectral ocean of Tessendorf's "Simulating Ocean Water", a periodic patch of side length sampled n x n
+// h(x, t) = sum h~(k, t) e^(i k . x) with h~(k, t) = h~0(k) e^(i w t) + conj(h~0(-k)) e^(-i w t), w^2 = g |k|,
+// the height, its slopes and the horizontal displacement -i k / |k| h~ come from 3 inverse Fft2D per Update()
+// the grid is laid out as Wave's and the accessors are the same, so a chapter can use either of them
+
+#ifdef _WIN32
+using OceanFloat3 = DirectX::XMFLOAT3;
+#else
+struct OceanFloat3 {
+    float x;
+    float y;
+    float z;
+};
+#endif
+
+enum class OceanSpectrum : uint32_t {
+    Phillips,
+    Jonswap
+};
+
+struct OceanSettings {
+    uint32_t n = 128; // samples along each side, a power of 2 in [4, 1024]
+    float length = 128.0f; // side of the patch in meters, the surface tiles with this period
+    float wind_dir[2] = { 1.0f, 0.0f }; // x & z, needn't be normalized
+    float wind_speed = 10.0f; // in m/s
+    float amplitude = 1.0f; // scales the spectrum
+    float choppiness = 1.0f; // scale of the horizontal displacement, 0 leaves the grid in place
+    float small_wave = 0.5f; // waves much shorter than this (in meters) are damped
+    OceanSpectrum spectrum = OceanSpectrum::Phillips;
+    float fetch = 100000.0f; // in meters, jonswap only
+    float gamma = 3.3f; // peak enhancement, jonswap only
+    float loop_time = 200.0f; // frequencies are rounded so the surface repeats after this many seconds
+    uint64_t seed = 1;
+};
+
+struct OceanStats {
+    double spectrum_ms = 0.0;
+    double fft_ms = 0.0;
+    double vertex_ms = 0.0;
+
+    double TotalMs() const {
+        return spectrum_ms + fft_ms + vertex_ms;
+    }
+};
+
+class Ocean {
+  public:
+    Ocean(JobSystem &jobs, const OceanSettings &settings);
+    Ocean(const Ocean &rhs) = delete;
+    Ocean &operator=(const Ocean &rhs) = delete;
+
+    int RowCount() const {
+        return (int) n;
+    }
+    int ColumnCount() const {
+        return (int) n;
+    }
+    int VertexCount() const {
+        return (int) (n * n);
+    }
+    int TriangleCount() const {
+        return (int) (2 * (n - 1) * (n - 1));
+    }
+    float Width() const {
+        return length;
+    }
+    float Depth() const {
+        return length;
+    }
+
+    const OceanFloat3 &Position(int i) const {
+        return positions[i];
+    }
+    const OceanFloat3 &Normal(int i) const {
+        return normals[i];
+    }
+    const OceanFloat3 &Tanget(int i) const {
+        return tangents[i];
+    }
+
+    // advance the time and evaluate the surface, results don't depend on the thread count
+    void Update(float dt);
+
+    float Time() const {
+        return time;
+    }
+    // of the last Update()
+    const OceanStats &Stats() const {
+        return stats;
+    }
+
+  private:
+    // the 3 spectra to transform at the current time
+    void EvaluateRow(uint32_t row);
+    void BuildRow(uint32_t row);
+
+    JobSystem &jobs;
+    Fft2D fft;
+    uint32_t n;
+    float length;
+    float choppiness;
+    float loop_time;
+    float time = 0.0f;
+
+    // frequency (u, v) of the ffts holds the wave vector of (-u, v) cycles over the patch (wrapped to [-n/2, n/2)),
+    // so that the inverse transform samples the surface at grid rows going to -z as Wave's
+    std::vector<float> kx; // of each column
+    std::vector<float> kz; // of each row
+    std::vector<float> k_inv; // 1 / |k|, 0 at k = 0
+    std::vector<float> omega;
+    // h~0(k) + conj(h~0(-k)) & h~0(k) - conj(h~0(-k)), with the phase of the first grid sample
+    std::vector<float> sum_re;
+    std::vector<float> sum_im;
+    std::vector<float> diff_re;
+    std::vector<float> diff_im;
+
+    // height + i slope x, slope z + i displacement x, displacement z
+    std::vector<float> field_re[3];
+    std::vector<float> field_im[3];
+
+    std::vector<OceanFloat3> positions;
+    std::vector<OceanFloat3> normals;
+    std::vector<OceanFloat3> tangents;
+
+    OceanStats stats;
+};
\ No newline at end of file
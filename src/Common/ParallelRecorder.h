@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+#include "JobSystem.h"
+
+// record a sorted draw list into several command lists in parallel
+// List is anything with Reset() (reset its own allocator and reopen) and Close(),
+// D3DCommandList in D3DCommandList.h for d3d, or a mock that logs calls
+
+struct RecordChunk {
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// split [0, n_item) into at most max_chunk contiguous chunks of at least min_chunk_size items
+// (except when there are fewer items), order of items is kept
+inline std::vector<RecordChunk> PartitionDraws(size_t n_item, size_t max_chunk, size_t min_chunk_size) {
+    std::vector<RecordChunk> chunks;
+    if (n_item == 0) {
+        return chunks;
+    }
+    min_chunk_size = std::max<size_t>(min_chunk_size, 1);
+    size_t n_chunk = std::clamp<size_t>(n_item / min_chunk_size, 1, std::max<size_t>(max_chunk, 1));
+    for (size_t c = 0; c < n_chunk; c++) {
+        chunks.push_back({ n_item * c / n_chunk, n_item * (c + 1) / n_chunk });
+    }
+    return chunks;
+}
+
+// command lists owned by one frame resource
+// lists are handed out in order and reused next time the frame resource comes around,
+// the frame fence guarantees gpu has finished with them then
+template <typename List>
+class CommandListPool {
+  public:
+    using Factory = std::function<std::unique_ptr<List>()>;
+
+    explicit CommandListPool(Factory factory) : factory(std::move(factory)) {}
+    CommandListPool(const CommandListPool &rhs) = delete;
+    CommandListPool &operator=(const CommandListPool &rhs) = delete;
+
+    void BeginFrame() {
+        n_used = 0;
+    }
+    // not thread-safe, acquire lists before dispatching recording jobs
+    List *Acquire() {
+        if (n_used == lists.size()) {
+            lists.push_back(factory());
+        }
+        List *list = lists[n_used++].get();
+        list->Reset();
+        return list;
+    }
+
+    size_t Size() const {
+        return lists.size();
+    }
+    size_t UsedCount() const {
+        return n_used;
+    }
+
+  private:
+    Factory factory;
+    std::vector<std::unique_ptr<List>> lists;
+    size_t n_used = 0;
+};
+
+// record n_item draws into lists from pool, one list per chunk
+// setup(list) sets states that don't carry over between command lists (viewport, rtv, root signature, ...)
+// record(list, begin, end) records draws of the chunk
+// returned lists are closed and in submission order
+template <typename List, typename SetupFn, typename RecordFn>
+std::vector<List *> RecordParallel(JobSystem &jobs, CommandListPool<List> &pool, size_t n_item,
+        size_t min_chunk_size, const SetupFn &setup, const RecordFn &record) {
+    auto chunks = PartitionDraws(n_item, jobs.ThreadCount(), min_chunk_size);
+    std::vector<List *> lists(chunks.size());
+    for (size_t c = 0; c < chunks.size(); c++) {
+        lists[c] = pool.Acquire();
+    }
+    jobs.ParallelFor(0, chunks.size(), [&](size_t c) {
+        List &list = *lists[c];
+        setup(list);
+        record(list, chunks[c].begin, chunks[c].end);
+        list.Close();
+    });
+    return lists;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "PatchCull.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "BezierPatch.h"
+
+namespace {
+
+// patches per chunk, chunks are tested in parallel and then compacted in parallel
+const size_t kPatchesPerChunk = 256;
+
+// control points at the ends of each edge of a 2 x 2 patch, in the order of PatchTessFactors
+const int kBilinearEdgeCp[4][2] = {
+    { 0, 2 }, // u = 0
+    { 0, 1 }, // v = 0
+    { 1, 3 }, // u = 1
+    { 2, 3 }  // v = 1
+};
+
+bool PatchVisible(const PatchList &patches, size_t patch, const Frustum &frustum) {
+    const float (*cp)[3] = patches.cp + patch * patches.n_cp;
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < patches.n_cp; i++) {
+        for (int k = 0; k < 3; k++) {
+            min[k] = std::min(min[k], cp[i][k]);
+            max[k] = std::max(max[k], cp[i][k]);
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        min[k] -= patches.bound_pad[k];
+        max[k] += patches.bound_pad[k];
+    }
+    return frustum.TestAabb(min, max) != Frustum::Result::Outside;
+}
+
+}
+
+PatchTessFactors ComputePatchTessFactors(const PatchList &patches, size_t patch, const float eye[3],
+        const TessDistanceRule &rule) {
+    const float (*cp)[3] = patches.cp + patch * patches.n_cp;
+    if (patches.n_cp == 16) {
+        BezierPatch bezier;
+        std::copy(&cp[0][0], &cp[0][0] + 48, &bezier.cp[0][0]);
+        return ComputeBezierTessFactors(bezier, eye, rule);
+    }
+
+    assert(patches.n_cp == 4);
+    PatchTessFactors factors;
+    for (int k = 0; k < 4; k++) {
+        // a + b is the same for both orders, so is the middle point
+        const float *a = cp[kBilinearEdgeCp[k][0]];
+        const float *b = cp[kBilinearEdgeCp[k][1]];
+        const float dx = 0.5f * (a[0] + b[0]) - eye[0];
+        const float dy = 0.5f * (a[1] + b[1]) - eye[1];
+        const float dz = 0.5f * (a[2] + b[2]) - eye[2];
+        factors.edge[k] = rule.Factor(std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    factors.inside[0] = std::max(factors.edge[1], factors.edge[3]);
+    factors.inside[1] = std::max(factors.edge[0], factors.edge[2]);
+    return factors;
+}
+
+size_t CullPatches(JobSystem &jobs, const PatchList &patches, const Frustum &frustum, const float eye[3],
+        const TessDistanceRule &rule, uint32_t *visible, PatchTessFactors *factors) {
+    const size_t n_chunk = (patches.n_patch + kPatchesPerChunk - 1) / kPatchesPerChunk;
+    std::vector<uint8_t> is_visible(patches.n_patch);
+    std::vector<size_t> offsets(n_chunk + 1, 0);
+    jobs.ParallelFor(0, n_chunk, [&](size_t c) {
+        const size_t end = std::min(patches.n_patch, (c + 1) * kPatchesPerChunk);
+        size_t count = 0;
+        for (size_t i = c * kPatchesPerChunk; i < end; i++) {
+            is_visible[i] = PatchVisible(patches, i, frustum);
+            count += is_visible[i];
+        }
+        offsets[c + 1] = count;
+    });
+    for (size_t c = 0; c < n_chunk; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+
+    // factors only for visible patches, written in order, so factors may be mapped (write-combined) memory
+    jobs.ParallelFor(0, n_chunk, [&](size_t c) {
+        const size_t end = std::min(patches.n_patch, (c + 1) * kPatchesPerChunk);
+        size_t out = offsets[c];
+        for (size_t i = c * kPatchesPerChunk; i < end; i++) {
+            if (is_visible[i]) {
+                visible[out] = static_cast<uint32_t>(i);
+                factors[out] = ComputePatchTessFactors(patches, i, eye, rule);
+                ++out;
+            }
+        }
+    });
+    return offsets[n_chunk];
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "TessFactors.h"
+
+// cpu pre-pass of the hull shaders: drop patches outside the frustum and compute tess factors of the others,
+// so only visible patches are drawn and the constant hull shader only reads its factors
+
+// patches as fed to the input assembler, n_cp control points each, a k x k grid row by row (k = 2 or 4)
+// with 2 x 2 the patch is bilinear in (u, v), cp[0] at (0, 0), cp[1] at (1, 0), cp[2] at (0, 1), as the ch14 DS lerp
+// with 4 x 4 it is the bicubic bezier patch of BezierPatch
+struct PatchList {
+    const float (*cp)[3] = nullptr; // n_patch * n_cp points
+    size_t n_cp = 4;
+    size_t n_patch = 0;
+    // the bounds of the control points contain the patch, widen them by this if the DS displaces it
+    float bound_pad[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// factors of one patch, edges from the distance to their middle points as in BezierPatch,
+// so neighbors sharing an edge get the same factor for it
+PatchTessFactors ComputePatchTessFactors(const PatchList &patches, size_t patch, const float eye[3],
+    const TessDistanceRule &rule);
+
+// frustum and eye are in the space of the control points
+// visible gets indices of patches intersecting the frustum in increasing order, factors gets their factors in the
+// same order (a factor buffer indexed by SV_PrimitiveID if visible patches are drawn in this order),
+// both need room for n_patch entries, returns number of visible patches
+size_t CullPatches(JobSystem &jobs, const PatchList &patches, const Frustum &frustum, const float eye[3],
+    const TessDistanceRule &rule, uint32_t *visible, PatchTessFactors *factors);
\ No newline at end of file
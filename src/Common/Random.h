@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RANDOM_SSE2
+#endif
+
+// xoshiro128** generator, one independent stream per (seed, stream) pair
+// it is a small value type, give each thread / job its own one instead of sharing
+// bulk fills run 4 xoshiro128+ lanes side by side (SSE2 when available, same results without it)
+class Random {
+  public:
+    // a fresh stream of the global seed
+    Random() : Random(GlobalSeed(), NextStreamId()) {}
+    Random(uint64_t seed, uint64_t stream) {
+        Seed(seed, stream);
+    }
+
+    void Seed(uint64_t seed, uint64_t stream) {
+        // splitmix64 over seed and stream gives well mixed, never all-zero states
+        uint64_t x = seed ^ (stream * 0xd1342543de82ef95ull);
+        for (int i = 0; i < 2; i++) {
+            uint64_t v = SplitMix64(x);
+            s[2 * i] = static_cast<uint32_t>(v);
+            s[2 * i + 1] = static_cast<uint32_t>(v >> 32);
+        }
+        for (int i = 0; i < 4; i++) {
+            for (int l = 0; l < 4; l += 2) {
+                uint64_t v = SplitMix64(x);
+                lane[i][l] = static_cast<uint32_t>(v);
+                lane[i][l + 1] = static_cast<uint32_t>(v >> 32);
+            }
+        }
+    }
+
+    uint32_t NextU32() {
+        const uint32_t result = Rotl(s[1] * 5, 7) * 9;
+        const uint32_t t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 11);
+        return result;
+    }
+    // [0, 1)
+    float NextF() {
+        return (NextU32() >> 8) * kInv24;
+    }
+
+    // [l, r], l <= r
+    int RandI(int l, int r) {
+        const uint32_t range = static_cast<uint32_t>(r) - static_cast<uint32_t>(l) + 1;
+        if (range == 0) {
+            return static_cast<int>(NextU32());
+        }
+        // Lemire's multiply-shift with rejection, unbiased
+        uint64_t m = static_cast<uint64_t>(NextU32()) * range;
+        if (static_cast<uint32_t>(m) < range) {
+            const uint32_t threshold = (0u - range) % range;
+            while (static_cast<uint32_t>(m) < threshold) {
+                m = static_cast<uint64_t>(NextU32()) * range;
+            }
+        }
+        return static_cast<int>(static_cast<uint32_t>(l) + static_cast<uint32_t>(m >> 32));
+    }
+    // [l, r), l <= r
+    // l + (r - l) * u rounds up to r when r - l is small next to l, so it's clamped to the float below r
+    float RandF(float l, float r) {
+        const float x = l + (r - l) * NextF();
+        return x < r ? x : std::nextafter(r, l);
+    }
+
+    // fill out[0, n) with uniform floats in [l, r), l <= r, clamped like RandF()
+    void FillF(float *out, size_t n, float l, float r) {
+        const float scale = (r - l) * kInv24;
+        const float max_x = std::nextafter(r, l);
+        size_t i = 0;
+#ifdef RANDOM_SSE2
+        __m128i st[4];
+        LoadLanes(st);
+        const __m128 v_scale = _mm_set1_ps(scale);
+        const __m128 v_l = _mm_set1_ps(l);
+        const __m128 v_max = _mm_set1_ps(max_x);
+        for (; i + 4 <= n; i += 4) {
+            __m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(NextLanes(st), 8));
+            _mm_storeu_ps(out + i, _mm_min_ps(_mm_add_ps(v_l, _mm_mul_ps(f, v_scale)), v_max));
+        }
+        StoreLanes(st);
+#endif
+        uint32_t v[4];
+        for (; i < n; i += 4) {
+            NextLanes(v);
+            for (size_t k = 0; k < 4 && i + k < n; k++) {
+                const float x = l + (v[k] >> 8) * scale;
+                out[i + k] = x < max_x ? x : max_x;
+            }
+        }
+    }
+    // fill out[0, n) with integers in [l, r], l <= r
+    // bias is at most range / 2^32, fine for anything but huge ranges
+    void FillI(int *out, size_t n, int l, int r) {
+        const uint32_t range = static_cast<uint32_t>(r) - static_cast<uint32_t>(l) + 1;
+        size_t i = 0;
+#ifdef RANDOM_SSE2
+        if (range != 0) {
+            __m128i st[4];
+            LoadLanes(st);
+            const __m128i v_range = _mm_set1_epi32(static_cast<int>(range));
+            const __m128i v_l = _mm_set1_epi32(l);
+            const __m128i hi_mask = _mm_set_epi32(-1, 0, -1, 0);
+            for (; i + 4 <= n; i += 4) {
+                __m128i x = NextLanes(st);
+                // high 32 bits of the 32x32 products, even lanes then odd lanes
+                __m128i even = _mm_srli_epi64(_mm_mul_epu32(x, v_range), 32);
+                __m128i odd = _mm_and_si128(_mm_mul_epu32(_mm_srli_epi64(x, 32), v_range), hi_mask);
+                __m128i hi = _mm_or_si128(even, odd);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_add_epi32(v_l, hi));
+            }
+            StoreLanes(st);
+        }
+#endif
+        uint32_t v[4];
+        for (; i < n; i += 4) {
+            NextLanes(v);
+            for (size_t k = 0; k < 4 && i + k < n; k++) {
+                const uint32_t hi = range == 0 ? v[k] : static_cast<uint32_t>((static_cast<uint64_t>(v[k]) * range) >> 32);
+                out[i + k] = static_cast<int>(static_cast<uint32_t>(l) + hi);
+            }
+        }
+    }
+
+    // generator of the calling thread, the n-th thread asking for one gets stream n of the global seed
+    static Random &ThreadLocal() {
+        thread_local Random rnd(GlobalSeed(), NextStreamId());
+        return rnd;
+    }
+    // seed from the clock unless set before the first use, for replay set it at startup
+    // and use explicitly seeded generators (e.g. stream = job index) where thread assignment may vary
+    static void SetGlobalSeed(uint64_t seed) {
+        GlobalSeedRef() = seed;
+    }
+    static uint64_t GlobalSeed() {
+        return GlobalSeedRef();
+    }
+
+  private:
+    static constexpr float kInv24 = 1.0f / 16777216.0f;
+
+    static uint32_t Rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+    static uint64_t SplitMix64(uint64_t &x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro128+ on 4 lanes, lane[i][l] is word i of lane l
+    void NextLanes(uint32_t out[4]) {
+        for (int l = 0; l < 4; l++) {
+            out[l] = lane[0][l] + lane[3][l];
+            const uint32_t t = lane[1][l] << 9;
+            lane[2][l] ^= lane[0][l];
+            lane[3][l] ^= lane[1][l];
+            lane[1][l] ^= lane[2][l];
+            lane[0][l] ^= lane[3][l];
+            lane[2][l] ^= t;
+            lane[3][l] = Rotl(lane[3][l], 11);
+        }
+    }
+#ifdef RANDOM_SSE2
+    void LoadLanes(__m128i st[4]) const {
+        for (int i = 0; i < 4; i++) {
+            st[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lane[i]));
+        }
+    }
+    void StoreLanes(const __m128i st[4]) {
+        for (int i = 0; i < 4; i++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lane[i]), st[i]);
+        }
+    }
+    static __m128i NextLanes(__m128i st[4]) {
+        const __m128i result = _mm_add_epi32(st[0], st[3]);
+        const __m128i t = _mm_slli_epi32(st[1], 9);
+        st[2] = _mm_xor_si128(st[2], st[0]);
+        st[3] = _mm_xor_si128(st[3], st[1]);
+        st[1] = _mm_xor_si128(st[1], st[2]);
+        st[0] = _mm_xor_si128(st[0], st[3]);
+        st[2] = _mm_xor_si128(st[2], t);
+        st[3] = _mm_or_si128(_mm_slli_epi32(st[3], 11), _mm_srli_epi32(st[3], 21));
+        return result;
+    }
+#endif
+
+    static uint64_t NextStreamId() {
+        static std::atomic<uint64_t> n_stream { 0 };
+        return n_stream.fetch_add(1);
+    }
+    static std::atomic<uint64_t> &GlobalSeedRef() {
+        static std::atomic<uint64_t> seed {
+            static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+        };
+        return seed;
+    }
+
+    uint32_t s[4];
+    uint32_t lane[4][4];
+};
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <unordered_set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t n_entry;
+    uint64_t index_offset; // blobs are in [sizeof(Header), index_offset), index follows them
+};
+
+bool ReadFile(const fs::path &filename, std::string &content) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin) {
+        return false;
+    }
+    std::ostringstream ss;
+    ss << fin.rdbuf();
+    content = ss.str();
+    return true;
+}
+
+// exclusive lock of a file across processes, released when destroyed
+// blocks until the lock is taken, Locked() is false if the file can't be opened or locked
+class FileLock {
+  public:
+    explicit FileLock(const fs::path &filename) {
+#ifdef _WIN32
+        handle = CreateFileW(filename.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        OVERLAPPED overlapped = {};
+        b_locked = handle != INVALID_HANDLE_VALUE &&
+            LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+        fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        b_locked = fd >= 0 && flock(fd, LOCK_EX) == 0;
+#endif
+    }
+    ~FileLock() {
+#ifdef _WIN32
+        if (b_locked) {
+            OVERLAPPED overlapped = {};
+            UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+        }
+        if (handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle);
+        }
+#else
+        if (fd >= 0) {
+            close(fd); // drops the lock too
+        }
+#endif
+    }
+    FileLock(const FileLock &rhs) = delete;
+    FileLock &operator=(const FileLock &rhs) = delete;
+
+    bool Locked() const {
+        return b_locked;
+    }
+
+  private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool b_locked = false;
+};
+
+// return included file name if line is '#include "xxx"' or '#include <xxx>'
+bool ParseInclude(const std::string &line, std::string &inc) {
+    size_t p = line.find_first_not_of(" \t");
+    if (p == std::string::npos || line[p] != '#') {
+        return false;
+    }
+    p = line.find_first_not_of(" \t", p + 1);
+    if (p == std::string::npos || line.compare(p, 7, "include") != 0) {
+        return false;
+    }
+    p = line.find_first_not_of(" \t", p + 7);
+    if (p == std::string::npos || (line[p] != '"' && line[p] != '<')) {
+        return false;
+    }
+    char close = line[p] == '"' ? '"' : '>';
+    size_t q = line.find(close, p + 1);
+    if (q == std::string::npos) {
+        return false;
+    }
+    inc = line.substr(p + 1, q - p - 1);
+    return true;
+}
+
+void ScanDependenciesImpl(const fs::path &filename, std::unordered_set<std::string> &visited,
+        std::vector<fs::path> &deps) {
+    std::error_code ec;
+    fs::path canonical = fs::weakly_canonical(filename, ec);
+    if (ec) {
+        canonical = filename;
+    }
+    if (!visited.insert(canonical.generic_string()).second) {
+        return;
+    }
+    deps.push_back(canonical);
+
+    std::ifstream fin(canonical);
+    std::string line, inc;
+    while (std::getline(fin, line)) {
+        if (ParseInclude(line, inc)) {
+            ScanDependenciesImpl(canonical.parent_path() / inc, visited, deps);
+        }
+    }
+}
+
+}
+
+ShaderCache::ShaderCache(const fs::path &cache_file) : cache_file(cache_file) {
+    ReadIndex();
+}
+
+uint64_t ShaderCache::Hash(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+std::vector<fs::path> ShaderCache::ScanDependencies(const fs::path &filename) {
+    std::unordered_set<std::string> visited;
+    std::vector<fs::path> deps;
+    ScanDependenciesImpl(filename, visited, deps);
+    return deps;
+}
+
+uint64_t ShaderCache::Key(const fs::path &filename, const Defines &defines,
+        const std::string &entry, const std::string &target, uint32_t flags) const {
+    uint64_t h = kHashSeed;
+    std::string content;
+    for (const auto &dep : ScanDependencies(filename)) {
+        // only file name & content, so that the cache stays valid if the whole tree is moved
+        h = Hash(dep.filename().generic_string(), h);
+        if (ReadFile(dep, content)) {
+            h = Hash(content, h);
+        }
+        h = Hash("\n", 1, h);
+    }
+    for (const auto &[name, value] : defines) {
+        h = Hash(name + "=" + value + ";", h);
+    }
+    h = Hash(entry + "\n" + target + "\n", h);
+    h = Hash(&flags, sizeof(flags), h);
+    return h;
+}
+
+void ShaderCache::ReadIndex() {
+    index.clear();
+    index_offset = 0;
+
+    std::ifstream fin(cache_file, std::ios::binary | std::ios::ate);
+    if (!fin) {
+        return;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(fin.tellg());
+    fin.seekg(0, std::ios::beg);
+    Header header = {};
+    fin.read(reinterpret_cast<char *>(&header), sizeof(header));
+    // a header that doesn't fit the file counts as no file, the next Store rewrites it
+    if (!fin || header.magic != kMagic || header.version != kVersion || header.index_offset < sizeof(Header) ||
+            header.index_offset > file_size || header.n_entry > (file_size - header.index_offset) / sizeof(Entry)) {
+        return;
+    }
+    fin.seekg(header.index_offset, std::ios::beg);
+    std::vector<Entry> entries(header.n_entry);
+    fin.read(reinterpret_cast<char *>(entries.data()), entries.size() * sizeof(Entry));
+    if (!fin) {
+        return;
+    }
+    for (const auto &entry : entries) {
+        if (entry.offset >= sizeof(Header) && entry.offset <= header.index_offset &&
+                entry.size <= header.index_offset - entry.offset) {
+            index[entry.key] = entry;
+        }
+    }
+    index_offset = header.index_offset;
+}
+
+bool ShaderCache::ReadBlob(const Entry &entry, std::vector<char> &data) const {
+    data.resize(entry.size);
+    std::ifstream fin(cache_file, std::ios::binary);
+    if (!fin || !fin.seekg(entry.offset, std::ios::beg)) {
+        return false;
+    }
+    fin.read(data.data(), data.size());
+    return fin.gcount() == static_cast<std::streamsize>(data.size()) && Hash(data.data(), data.size()) == entry.hash;
+}
+
+bool ShaderCache::Find(uint64_t key, Entry &entry) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+std::vector<char> ShaderCache::Load(uint64_t key) const {
+    Entry entry;
+    std::vector<char> data;
+    if (!Find(key, entry) || !ReadBlob(entry, data)) {
+        return {};
+    }
+    return data;
+}
+
+void ShaderCache::Store(uint64_t key, const void *data, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mtx);
+    // other processes may store into the same file, without the lock two appends can land at the same offset
+    fs::path lock_file = cache_file;
+    lock_file += ".lock";
+    FileLock file_lock(lock_file);
+    if (!file_lock.Locked()) {
+        // cache is optional, go on without storing
+        return;
+    }
+
+    // pick up entries written by other processes since the last read
+    ReadIndex();
+    std::vector<char> old_data;
+    auto it = index.find(key);
+    if (it != index.end() && ReadBlob(it->second, old_data)) {
+        return;
+    }
+
+    // blobs of replaced entries and all indices but the last one are stale
+    uint64_t live = 0;
+    for (const auto &[k, entry] : index) {
+        live += k == key ? 0 : entry.size;
+    }
+    const uint64_t blob_space = index_offset > sizeof(Header) ? index_offset - sizeof(Header) : 0;
+    const uint64_t stale = blob_space > live ? blob_space - live : 0;
+
+    Entry &new_entry = index[key];
+    new_entry.key = key;
+    new_entry.size = size;
+    new_entry.hash = Hash(data, size);
+    const bool compact = index_offset == 0 || stale > std::max(kMinCompactSize, live);
+    if (!(compact ? Rewrite(new_entry, data) : Append(new_entry, data))) {
+        // cache is optional, go on with what is on disk
+        ReadIndex();
+    }
+}
+
+bool ShaderCache::Append(Entry &entry, const void *data) {
+    std::fstream file(cache_file, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file || !file.seekp(0, std::ios::end)) {
+        return false;
+    }
+    entry.offset = static_cast<uint64_t>(file.tellp());
+    file.write(static_cast<const char *>(data), entry.size);
+    for (const auto &[_, e] : index) {
+        file.write(reinterpret_cast<const char *>(&e), sizeof(e));
+    }
+
+    // header goes last, until then readers see the old index
+    Header header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.n_entry = index.size();
+    header.index_offset = entry.offset + entry.size;
+    file.seekp(0, std::ios::beg);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.flush();
+    if (!file) {
+        return false;
+    }
+    index_offset = header.index_offset;
+    return true;
+}
+
+bool ShaderCache::Rewrite(Entry &entry, const void *data) {
+    std::string old_content;
+    if (index.size() > 1 && !ReadFile(cache_file, old_content)) {
+        return false;
+    }
+
+    auto tid = std::hash<std::thread::id>()(std::this_thread::get_id());
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    fs::path tmp_file = cache_file;
+    tmp_file += ".tmp" + std::to_string(tid ^ static_cast<size_t>(now));
+
+    Header header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.index_offset = sizeof(Header);
+    {
+        std::ofstream fout(tmp_file, std::ios::binary | std::ios::trunc);
+        fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        // live blobs are packed in the order of the index, entries whose blob is gone are dropped
+        for (auto it = index.begin(); it != index.end();) {
+            Entry &e = it->second;
+            const char *src = &e == &entry ? static_cast<const char *>(data) : nullptr;
+            if (src == nullptr && e.offset <= old_content.size() && e.size <= old_content.size() - e.offset) {
+                src = old_content.data() + e.offset;
+            }
+            if (src == nullptr) {
+                it = index.erase(it);
+                continue;
+            }
+            fout.write(src, e.size);
+            e.offset = header.index_offset;
+            header.index_offset += e.size;
+            ++it;
+        }
+        for (const auto &[_, e] : index) {
+            fout.write(reinterpret_cast<const char *>(&e), sizeof(e));
+        }
+        header.n_entry = index.size();
+        fout.seekp(0, std::ios::beg);
+        fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!fout) {
+            fout.close();
+            std::error_code ec;
+            fs::remove(tmp_file, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_file, cache_file, ec);
+    if (ec) {
+        fs::remove(tmp_file, ec);
+        return false;
+    }
+    index_offset = header.index_offset;
+    return true;
+}
+
+std::vector<char> ShaderCache::GetOrCompile(const fs::path &filename, const Defines &defines,
+        const std::string &entry, const std::string &target, uint32_t flags, const Compiler &compiler) {
+    uint64_t key = Key(filename, defines, entry, target, flags);
+    auto code = Load(key);
+    if (!code.empty()) {
+        return code;
+    }
+
+    code = compiler(filename, defines, entry, target);
+    if (!code.empty()) {
+        Store(key, code.data(), code.size());
+    }
+    return code;
+}
\ No newline at end of file
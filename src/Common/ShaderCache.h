@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+// on-disk cache of compiled shader bytecode
+// all entries live in one file: | header | blobs | index entries |
+// key = hash(source + transitive #include files, defines, entry, target, flags)
+// a new blob and the whole index are appended after the current index, then the header is switched to them, so readers
+// of the old header still find the old index; stale indices are dropped by rewriting the file to a temp file and renaming
+// it once they take more space than the blobs
+// stores of all processes take an exclusive lock of '<cache file>.lock' in turn, loads go without it
+// blobs are checked against their hash when read, a blob that is cut short or overwritten is a miss
+class ShaderCache {
+  public:
+    using Defines = std::vector<std::pair<std::string, std::string>>;
+    // compile filename with defines, entry & target, return bytecode (empty on failure)
+    using Compiler = std::function<std::vector<char>(const std::filesystem::path &filename,
+        const Defines &defines, const std::string &entry, const std::string &target)>;
+
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t offset = 0; // offset of blob from the beginning of cache file
+        uint64_t size = 0;
+        uint64_t hash = 0; // of blob
+    };
+
+    explicit ShaderCache(const std::filesystem::path &cache_file);
+    ShaderCache(const ShaderCache &rhs) = delete;
+    ShaderCache &operator=(const ShaderCache &rhs) = delete;
+
+    // 64-bit FNV-1a
+    static uint64_t Hash(const void *data, size_t size, uint64_t seed = kHashSeed);
+    static uint64_t Hash(const std::string &str, uint64_t seed = kHashSeed) {
+        return Hash(str.data(), str.size(), seed);
+    }
+    // filename itself followed by all files reached by '#include' (depth first, no duplication)
+    // includes are resolved relative to the including file, like D3D_COMPILE_STANDARD_FILE_INCLUDE
+    static std::vector<std::filesystem::path> ScanDependencies(const std::filesystem::path &filename);
+
+    uint64_t Key(const std::filesystem::path &filename, const Defines &defines,
+        const std::string &entry, const std::string &target, uint32_t flags = 0) const;
+
+    bool Find(uint64_t key, Entry &entry) const;
+    // empty if key is not found or its blob can't be read back intact
+    std::vector<char> Load(uint64_t key) const;
+    // an existing entry of key is only replaced if its blob can't be read back intact
+    void Store(uint64_t key, const void *data, uint64_t size);
+
+    // Find + Load on hit, compiler + Store on miss
+    std::vector<char> GetOrCompile(const std::filesystem::path &filename, const Defines &defines,
+        const std::string &entry, const std::string &target, uint32_t flags, const Compiler &compiler);
+
+    const std::filesystem::path &File() const {
+        return cache_file;
+    }
+
+    static constexpr uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+  private:
+    static constexpr uint32_t kMagic = 0x43524853; // 'SHRC'
+    static constexpr uint32_t kVersion = 2;
+    // stale indices are kept until they take more than this and more than the blobs
+    static constexpr uint64_t kMinCompactSize = 64 * 1024;
+
+    void ReadIndex();
+    bool ReadBlob(const Entry &entry, std::vector<char> &data) const;
+    bool Append(Entry &entry, const void *data);
+    bool Rewrite(Entry &entry, const void *data);
+
+    std::filesystem::path cache_file;
+    std::unordered_map<uint64_t, Entry> index;
+    uint64_t index_offset = 0; // of the file when it was last read, 0 if there is no valid file
+    mutable std::mutex mtx;
+};
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SINCOS_SSE2
+#endif
+
+// sin & cos with one range reduction and minimax polynomials on [-pi/4, pi/4] (cephes sinf/cosf coefficients)
+// absolute error is below 1e-7 for |x| < 8192 and 1e-6 for |x| < 65536, pi/2 is split in 3 parts only,
+// so the reduction loses precision slowly beyond
+// scalar and sse versions round the same operations in the same order and give the same results, unless the
+// compiler contracts the scalar multiply-adds into fma, which it can only do when targeting fma (e.g. -mfma,
+// /arch:AVX2) with contraction allowed, then they differ by a few ulp
+
+namespace SinCosDetail {
+
+const float kTwoOverPi = 0.636619772367581343f;
+// pi/2 = kPio2A + kPio2B + kPio2C
+const float kPio2A = 1.5703125f;
+const float kPio2B = 4.837512969970703125e-4f;
+const float kPio2C = 7.54978995489188216e-8f;
+
+const float kS1 = -1.6666654611e-1f;
+const float kS2 = 8.3321608736e-3f;
+const float kS3 = -1.9515295891e-4f;
+const float kC1 = 4.166664568298827e-2f;
+const float kC2 = -1.388731625493765e-3f;
+const float kC3 = 2.443315711809948e-5f;
+
+}
+
+inline void FastSinCos(float x, float &s, float &c) {
+    using namespace SinCosDetail;
+    // nearest quadrant, ties to even as cvtps2dq does
+    const float q = std::nearbyint(x * kTwoOverPi);
+    const int quadrant = static_cast<int>(q);
+    const float r = ((x - q * kPio2A) - q * kPio2B) - q * kPio2C;
+    const float r2 = r * r;
+    const float sr = r + r * r2 * (kS1 + r2 * (kS2 + r2 * kS3));
+    const float cr = 1.0f - 0.5f * r2 + r2 * r2 * (kC1 + r2 * (kC2 + r2 * kC3));
+    switch (quadrant & 3) {
+        case 0:
+            s = sr;
+            c = cr;
+            break;
+        case 1:
+            s = cr;
+            c = -sr;
+            break;
+        case 2:
+            s = -sr;
+            c = -cr;
+            break;
+        default:
+            s = -cr;
+            c = sr;
+            break;
+    }
+}
+
+#ifdef SINCOS_SSE2
+inline void FastSinCos4(__m128 x, __m128 &s, __m128 &c) {
+    using namespace SinCosDetail;
+    const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kTwoOverPi)));
+    const __m128 q = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(kPio2A)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(kPio2B)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(kPio2C)));
+    const __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 sp = _mm_add_ps(_mm_set1_ps(kS2), _mm_mul_ps(r2, _mm_set1_ps(kS3)));
+    sp = _mm_add_ps(_mm_set1_ps(kS1), _mm_mul_ps(r2, sp));
+    const __m128 sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+    __m128 cp = _mm_add_ps(_mm_set1_ps(kC2), _mm_mul_ps(r2, _mm_set1_ps(kC3)));
+    cp = _mm_add_ps(_mm_set1_ps(kC1), _mm_mul_ps(r2, cp));
+    const __m128 cr = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+        _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+
+    // odd quadrants swap sin & cos, sin is negated in quadrants 2 & 3, cos in quadrants 1 & 2
+    const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)),
+        _mm_set1_epi32(1)));
+    const __m128 sign_bit = _mm_castsi128_ps(_mm_set1_epi32(INT32_MIN));
+    const __m128 s_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    const __m128 c_sign = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    s = _mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr));
+    c = _mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr));
+    s = _mm_xor_ps(s, _mm_and_ps(s_sign, sign_bit));
+    c = _mm_xor_ps(c, _mm_and_ps(c_sign, sign_bit));
+}
+#endif
\ No newline at end of file
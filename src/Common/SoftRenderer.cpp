@@ -0,0 +1,696 @@
+#include "SoftRenderer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SOFT_SSE2
+#endif
+
+namespace {
+
+// 4 lanes of floats, one pixel each, and a mask of lanes
+#ifdef SOFT_SSE2
+struct Float4 {
+    __m128 v;
+};
+struct Mask4 {
+    __m128 v;
+};
+
+inline Float4 Set1(float f) {
+    return { _mm_set1_ps(f) };
+}
+inline Float4 Ramp() {
+    return { _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f) };
+}
+inline Float4 Load(const float *p) {
+    return { _mm_loadu_ps(p) };
+}
+inline Float4 operator+(Float4 a, Float4 b) {
+    return { _mm_add_ps(a.v, b.v) };
+}
+inline Float4 operator-(Float4 a, Float4 b) {
+    return { _mm_sub_ps(a.v, b.v) };
+}
+inline Float4 operator*(Float4 a, Float4 b) {
+    return { _mm_mul_ps(a.v, b.v) };
+}
+inline Float4 operator/(Float4 a, Float4 b) {
+    return { _mm_div_ps(a.v, b.v) };
+}
+inline Float4 Min(Float4 a, Float4 b) {
+    return { _mm_min_ps(a.v, b.v) };
+}
+inline Float4 Max(Float4 a, Float4 b) {
+    return { _mm_max_ps(a.v, b.v) };
+}
+inline Float4 Sqrt(Float4 a) {
+    return { _mm_sqrt_ps(a.v) };
+}
+inline Mask4 GreaterEqual(Float4 a, Float4 b) {
+    return { _mm_cmpge_ps(a.v, b.v) };
+}
+inline Mask4 Less(Float4 a, Float4 b) {
+    return { _mm_cmplt_ps(a.v, b.v) };
+}
+inline Mask4 operator&(Mask4 a, Mask4 b) {
+    return { _mm_and_ps(a.v, b.v) };
+}
+inline bool Any(Mask4 m) {
+    return _mm_movemask_ps(m.v) != 0;
+}
+inline Float4 Select(Mask4 m, Float4 a, Float4 b) {
+    return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) };
+}
+
+// log2 of x > 0 from the exponent and log2(mantissa) = 2 / ln(2) * atanh((mantissa - 1) / (mantissa + 1))
+inline Float4 Log2(Float4 x) {
+    const __m128i bits = _mm_castps_si128(x.v);
+    const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    const Float4 mantissa = { _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff))),
+        _mm_set1_ps(1.0f)) };
+    const Float4 t = (mantissa - Set1(1.0f)) / (mantissa + Set1(1.0f));
+    const Float4 t2 = t * t;
+    const Float4 series = Set1(1.0f) + t2 * (Set1(1.0f / 3.0f) + t2 * (Set1(1.0f / 5.0f) +
+        t2 * (Set1(1.0f / 7.0f) + t2 * Set1(1.0f / 9.0f))));
+    return Float4 { exponent } + t * series * Set1(2.8853900818f);
+}
+// 2^x from the integer part put into the exponent and a polynomial of the fraction
+inline Float4 Exp2(Float4 x) {
+    x = Min(Max(x, Set1(-126.0f)), Set1(126.0f));
+    __m128i i = _mm_cvttps_epi32(x.v);
+    __m128 fi = _mm_cvtepi32_ps(i);
+    const __m128 round_down = _mm_cmpgt_ps(fi, x.v);
+    i = _mm_add_epi32(i, _mm_castps_si128(round_down)); // -1 where truncation went up
+    fi = _mm_sub_ps(fi, _mm_and_ps(round_down, _mm_set1_ps(1.0f)));
+    const Float4 f = x - Float4 { fi };
+    const Float4 p = Set1(1.0f) + f * (Set1(0.6931471806f) + f * (Set1(0.2402265070f) + f * (Set1(0.0555041087f) +
+        f * (Set1(0.0096181291f) + f * (Set1(0.0013333558f) + f * Set1(0.0001540353f))))));
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+    return { _mm_mul_ps(p.v, scale) };
+}
+// x >= 0, close enough to pow() to not show in 8-bit colors
+inline Float4 Pow(Float4 x, Float4 y) {
+    return Exp2(Log2(x) * y);
+}
+
+inline void StoreDepth(float *dst, Mask4 mask, Float4 z) {
+    _mm_storeu_ps(dst, Select(mask, z, Load(dst)).v);
+}
+inline __m128i Quantize(Float4 c) {
+    const Float4 saturated = Min(Max(c, Set1(0.0f)), Set1(1.0f));
+    return _mm_cvttps_epi32((saturated * Set1(255.0f) + Set1(0.5f)).v);
+}
+inline void StoreColor(uint32_t *dst, Mask4 mask, Float4 r, Float4 g, Float4 b, Float4 a) {
+    const __m128i color = _mm_or_si128(_mm_or_si128(Quantize(r), _mm_slli_epi32(Quantize(g), 8)),
+        _mm_or_si128(_mm_slli_epi32(Quantize(b), 16), _mm_slli_epi32(Quantize(a), 24)));
+    __m128i *p = reinterpret_cast<__m128i *>(dst);
+    const __m128i m = _mm_castps_si128(mask.v);
+    _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(m, color), _mm_andnot_si128(m, _mm_loadu_si128(p))));
+}
+#else
+struct Float4 {
+    float v[4];
+};
+struct Mask4 {
+    bool v[4];
+};
+
+#define SOFT_LANES(expr) \
+    Float4 r; \
+    for (int i = 0; i < 4; i++) { \
+        r.v[i] = (expr); \
+    } \
+    return r;
+
+inline Float4 Set1(float f) {
+    SOFT_LANES(f)
+}
+inline Float4 Ramp() {
+    SOFT_LANES((float) i)
+}
+inline Float4 Load(const float *p) {
+    SOFT_LANES(p[i])
+}
+inline Float4 operator+(Float4 a, Float4 b) {
+    SOFT_LANES(a.v[i] + b.v[i])
+}
+inline Float4 operator-(Float4 a, Float4 b) {
+    SOFT_LANES(a.v[i] - b.v[i])
+}
+inline Float4 operator*(Float4 a, Float4 b) {
+    SOFT_LANES(a.v[i] * b.v[i])
+}
+inline Float4 operator/(Float4 a, Float4 b) {
+    SOFT_LANES(a.v[i] / b.v[i])
+}
+inline Float4 Min(Float4 a, Float4 b) {
+    SOFT_LANES(std::min(a.v[i], b.v[i]))
+}
+inline Float4 Max(Float4 a, Float4 b) {
+    SOFT_LANES(std::max(a.v[i], b.v[i]))
+}
+inline Float4 Sqrt(Float4 a) {
+    SOFT_LANES(std::sqrt(a.v[i]))
+}
+inline Float4 Select(Mask4 m, Float4 a, Float4 b) {
+    SOFT_LANES(m.v[i] ? a.v[i] : b.v[i])
+}
+inline Float4 Pow(Float4 x, Float4 y) {
+    SOFT_LANES(std::pow(x.v[i], y.v[i]))
+}
+
+#undef SOFT_LANES
+
+inline Mask4 GreaterEqual(Float4 a, Float4 b) {
+    return { { a.v[0] >= b.v[0], a.v[1] >= b.v[1], a.v[2] >= b.v[2], a.v[3] >= b.v[3] } };
+}
+inline Mask4 Less(Float4 a, Float4 b) {
+    return { { a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3] } };
+}
+inline Mask4 operator&(Mask4 a, Mask4 b) {
+    return { { a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3] } };
+}
+inline bool Any(Mask4 m) {
+    return m.v[0] || m.v[1] || m.v[2] || m.v[3];
+}
+
+inline void StoreDepth(float *dst, Mask4 mask, Float4 z) {
+    for (int i = 0; i < 4; i++) {
+        if (mask.v[i]) {
+            dst[i] = z.v[i];
+        }
+    }
+}
+inline uint32_t Quantize(float c) {
+    return (uint32_t) (std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+inline void StoreColor(uint32_t *dst, Mask4 mask, Float4 r, Float4 g, Float4 b, Float4 a) {
+    for (int i = 0; i < 4; i++) {
+        if (mask.v[i]) {
+            dst[i] = Quantize(r.v[i]) | (Quantize(g.v[i]) << 8) | (Quantize(b.v[i]) << 16) |
+                (Quantize(a.v[i]) << 24);
+        }
+    }
+}
+#endif
+
+struct Vec3 {
+    Float4 x, y, z;
+};
+
+inline Vec3 Set1(const float v[3]) {
+    return { Set1(v[0]), Set1(v[1]), Set1(v[2]) };
+}
+inline Vec3 operator+(const Vec3 &a, const Vec3 &b) {
+    return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+inline Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+inline Vec3 operator*(const Vec3 &a, Float4 s) {
+    return { a.x * s, a.y * s, a.z * s };
+}
+inline Float4 Dot(const Vec3 &a, const Vec3 &b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline Vec3 Normalize(const Vec3 &a) {
+    return a * (Set1(1.0f) / Sqrt(Dot(a, a)));
+}
+inline Float4 Saturate(Float4 a) {
+    return Min(Max(a, Set1(0.0f)), Set1(1.0f));
+}
+
+// light.hlsl for 4 pixels, material and lights stay the same over a triangle
+class Shading {
+  public:
+    Shading(const SoftPass &pass, const SoftLightCounts &counts, const SoftMaterial &mat) : pass(pass),
+            counts(counts) {
+        albedo = Set1(mat.albedo);
+        alpha = Set1(mat.albedo[3]);
+        fresnel_r0 = Set1(mat.fresnel_r0);
+        m = Set1((1.0f - mat.roughness) * 256.0f);
+        ambient = {
+            Set1(pass.ambient[0] * mat.albedo[0]),
+            Set1(pass.ambient[1] * mat.albedo[1]),
+            Set1(pass.ambient[2] * mat.albedo[2])
+        };
+    }
+
+    Vec3 Shade(const Vec3 &pos, const Vec3 &normal, Float4 &out_alpha) const {
+        const Vec3 view = Normalize(Set1(pass.eye) - pos);
+        Vec3 res = ambient;
+        const int n_light = std::min(counts.n_dir + counts.n_point + counts.n_spot, kSoftMaxLights);
+        for (int i = 0; i < n_light; i++) {
+            const SoftLight &L = pass.lights[i];
+            if (i < counts.n_dir) {
+                const Vec3 light = Set1(L.direction) * Set1(-1.0f);
+                const Float4 ndotl = Max(Dot(normal, light), Set1(0.0f));
+                res = res + BlinnPhong(Set1(L.strength) * ndotl, light, normal, view);
+                continue;
+            }
+            Vec3 light = Set1(L.position) - pos;
+            const Float4 d = Sqrt(Dot(light, light));
+            light = light * (Set1(1.0f) / d);
+            const Float4 ndotl = Max(Dot(normal, light), Set1(0.0f));
+            // the attenuation is 0 beyond falloff_end
+            Float4 factor = ndotl * Saturate((Set1(L.falloff_end) - d) / Set1(L.falloff_end - L.falloff_start));
+            if (i >= counts.n_dir + counts.n_point) {
+                factor = factor * Pow(Max(Dot(light, Set1(L.direction)) * Set1(-1.0f), Set1(0.0f)),
+                    Set1(L.spot_power));
+            }
+            res = res + BlinnPhong(Set1(L.strength) * factor, light, normal, view);
+        }
+        out_alpha = alpha;
+        return res;
+    }
+
+  private:
+    Vec3 BlinnPhong(const Vec3 &strength, const Vec3 &light, const Vec3 &normal, const Vec3 &view) const {
+        const Vec3 halfway = Normalize(view + light);
+        const Float4 roughness_factor = (m + Set1(8.0f)) * Pow(Max(Dot(halfway, normal), Set1(0.0f)), m) *
+            Set1(1.0f / 8.0f);
+        const Float4 f0 = Set1(1.0f) - Max(Dot(halfway, light), Set1(0.0f));
+        const Float4 f5 = f0 * f0 * f0 * f0 * f0;
+        const Vec3 fresnel_factor = fresnel_r0 + (Vec3 { Set1(1.0f), Set1(1.0f), Set1(1.0f) } - fresnel_r0) * f5;
+        Vec3 spec = fresnel_factor * roughness_factor;
+        spec = { spec.x / (spec.x + Set1(1.0f)), spec.y / (spec.y + Set1(1.0f)), spec.z / (spec.z + Set1(1.0f)) };
+        const Vec3 color = albedo + spec;
+        return { color.x * strength.x, color.y * strength.y, color.z * strength.z };
+    }
+
+    const SoftPass &pass;
+    const SoftLightCounts &counts;
+    Vec3 albedo;
+    Float4 alpha;
+    Vec3 fresnel_r0;
+    Float4 m;
+    Vec3 ambient;
+};
+
+// a plane a * x + b * y + c along a row at y
+struct RowPlane {
+    RowPlane(const float plane[3], float y) : a(Set1(plane[0])), c(Set1(plane[1] * y + plane[2])) {}
+
+    Float4 At(Float4 x) const {
+        return a * x + c;
+    }
+
+    Float4 a;
+    Float4 c;
+};
+
+// floor & ceil of v clamped to [0, max], without calls to floor() & ceil()
+int32_t FloorClamped(float v, float max) {
+    return (int32_t) std::clamp(v, 0.0f, max);
+}
+int32_t CeilClamped(float v, float max) {
+    v = std::clamp(v, 0.0f, max);
+    const int32_t i = (int32_t) v;
+    return (float) i < v ? i + 1 : i;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// triangles are clipped to the near plane and to a guard band of kGuardBand times the viewport,
+// the rest off screen is left to the bounding box and the edge functions
+constexpr float kGuardBand = 4.0f;
+constexpr int kClipPlanes = 5;
+constexpr size_t kVertexGrain = 1024;
+
+uint32_t PackColor(const float color[4]) {
+    uint32_t packed = 0;
+    for (int c = 0; c < 4; c++) {
+        packed |= (uint32_t) (std::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f) << (8 * c);
+    }
+    return packed;
+}
+
+}
+
+SoftRenderer::SoftRenderer(uint32_t width, uint32_t height) : width(width), height(height) {
+    assert(width % 4 == 0);
+    n_tile_x = (width + kSoftTileSize - 1) / kSoftTileSize;
+    n_tile_y = (height + kSoftTileSize - 1) / kSoftTileSize;
+    pixels.resize((size_t) width * height, 0);
+    depth.resize((size_t) width * height, 1.0f);
+}
+
+void SoftRenderer::Clear(const float color[4]) {
+    std::fill(pixels.begin(), pixels.end(), PackColor(color));
+    std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+void SoftRenderer::TransformVertices(size_t draw, size_t begin, size_t end) {
+    const SoftMesh &mesh = draws[draw].mesh;
+    const SoftObject &object = draws[draw].object;
+    const Float4 model[4] = { Load(object.model[0]), Load(object.model[1]), Load(object.model[2]),
+        Load(object.model[3]) };
+    const Float4 model_it[3] = { Load(object.model_it[0]), Load(object.model_it[1]), Load(object.model_it[2]) };
+    const Float4 vp[4] = { Load(pass->vp[0]), Load(pass->vp[1]), Load(pass->vp[2]), Load(pass->vp[3]) };
+
+    const uint8_t *src = static_cast<const uint8_t *>(mesh.vertices) +
+        ((int64_t) mesh.base_vertex + (int64_t) (begin - first_vertices[draw])) * mesh.stride;
+    for (size_t i = begin; i < end; i++, src += mesh.stride) {
+        const float *pos = reinterpret_cast<const float *>(src);
+        const float *norm = reinterpret_cast<const float *>(src + mesh.normal_offset);
+        float pos_w[4];
+        float norm_w[4];
+        Vertex &v = vertices[i];
+        // row vectors, out = x * m[0] + y * m[1] + z * m[2] (+ m[3])
+        const Float4 p = Set1(pos[0]) * model[0] + Set1(pos[1]) * model[1] + Set1(pos[2]) * model[2] + model[3];
+        const Float4 n = Set1(norm[0]) * model_it[0] + Set1(norm[1]) * model_it[1] + Set1(norm[2]) * model_it[2];
+        std::memcpy(pos_w, &p, sizeof(pos_w));
+        std::memcpy(norm_w, &n, sizeof(norm_w));
+        const Float4 clip = Set1(pos_w[0]) * vp[0] + Set1(pos_w[1]) * vp[1] + Set1(pos_w[2]) * vp[2] +
+            Set1(pos_w[3]) * vp[3];
+        std::memcpy(v.clip, &clip, sizeof(v.clip));
+        std::memcpy(v.pos_w, pos_w, sizeof(v.pos_w));
+        std::memcpy(v.norm_w, norm_w, sizeof(v.norm_w));
+    }
+}
+
+void SoftRenderer::SetupTriangle(const Vertex *verts[3], uint32_t draw, std::vector<Triangle> &out) const {
+    // signed distances to the clip planes, inside if >= 0
+    const auto distance = [](const Vertex &v, int plane) {
+        switch (plane) {
+            case 0:
+                return v.clip[2];
+            case 1:
+                return kGuardBand * v.clip[3] - v.clip[0];
+            case 2:
+                return kGuardBand * v.clip[3] + v.clip[0];
+            case 3:
+                return kGuardBand * v.clip[3] - v.clip[1];
+            default:
+                return kGuardBand * v.clip[3] + v.clip[1];
+        }
+    };
+
+    // each plane adds one vertex at most
+    Vertex poly[2][3 + kClipPlanes];
+    int n_poly = 3;
+    int cur = 0;
+    for (int i = 0; i < 3; i++) {
+        poly[0][i] = *verts[i];
+    }
+    for (int plane = 0; plane < kClipPlanes && n_poly >= 3; plane++) {
+        bool all_inside = true;
+        for (int i = 0; i < n_poly; i++) {
+            all_inside = all_inside && distance(poly[cur][i], plane) >= 0.0f;
+        }
+        if (all_inside) {
+            continue;
+        }
+        const Vertex *in = poly[cur];
+        Vertex *clipped = poly[cur ^ 1];
+        int n_clipped = 0;
+        for (int i = 0; i < n_poly; i++) {
+            const Vertex &a = in[i];
+            const Vertex &b = in[(i + 1) % n_poly];
+            const float da = distance(a, plane);
+            const float db = distance(b, plane);
+            if (da >= 0.0f) {
+                clipped[n_clipped++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                const float t = da / (da - db);
+                const float *fa = reinterpret_cast<const float *>(&a);
+                const float *fb = reinterpret_cast<const float *>(&b);
+                float *fp = reinterpret_cast<float *>(&clipped[n_clipped++]);
+                for (size_t c = 0; c < sizeof(Vertex) / sizeof(float); c++) {
+                    fp[c] = fa[c] + t * (fb[c] - fa[c]);
+                }
+            }
+        }
+        n_poly = n_clipped;
+        cur ^= 1;
+    }
+    if (n_poly < 3) {
+        return;
+    }
+
+    // x, y on the screen, then z, 1 / w, pos_w / w & norm_w / w
+    float screen[3 + kClipPlanes][10];
+    for (int i = 0; i < n_poly; i++) {
+        const Vertex &v = poly[cur][i];
+        const float w_inv = 1.0f / v.clip[3];
+        screen[i][0] = (v.clip[0] * w_inv * 0.5f + 0.5f) * width;
+        screen[i][1] = (0.5f - v.clip[1] * w_inv * 0.5f) * height;
+        screen[i][2] = v.clip[2] * w_inv;
+        screen[i][3] = w_inv;
+        for (int c = 0; c < 3; c++) {
+            screen[i][4 + c] = v.pos_w[c] * w_inv;
+            screen[i][7 + c] = v.norm_w[c] * w_inv;
+        }
+    }
+
+    for (int t = 0; t + 2 < n_poly; t++) {
+        const float *p[3] = { screen[0], screen[t + 1], screen[t + 2] };
+        float area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]);
+        // y goes down on the screen, so counter-clockwise front faces have a negative area
+        if (area >= 0.0f) {
+            continue;
+        }
+        std::swap(p[1], p[2]);
+        area = -area;
+
+        const float min_x = std::min({ p[0][0], p[1][0], p[2][0] });
+        const float max_x = std::max({ p[0][0], p[1][0], p[2][0] });
+        const float min_y = std::min({ p[0][1], p[1][1], p[2][1] });
+        const float max_y = std::max({ p[0][1], p[1][1], p[2][1] });
+        Triangle tri;
+        tri.x0 = FloorClamped(min_x, (float) width);
+        tri.x1 = CeilClamped(max_x, (float) width);
+        tri.y0 = FloorClamped(min_y, (float) height);
+        tri.y1 = CeilClamped(max_y, (float) height);
+        if (tri.x0 >= tri.x1 || tri.y0 >= tri.y1) {
+            continue;
+        }
+        tri.draw = draw;
+
+        // planes are relative to the corner of the bounding box to keep their precision on large screens
+        tri.origin[0] = min_x;
+        tri.origin[1] = min_y;
+        float local[3][2];
+        for (int i = 0; i < 3; i++) {
+            local[i][0] = p[i][0] - min_x;
+            local[i][1] = p[i][1] - min_y;
+        }
+        const float area_inv = 1.0f / area;
+        for (int e = 0; e < 3; e++) {
+            // edge e is opposite to vertex e, so it is zero on the other two and area at vertex e
+            const float *pa = local[(e + 1) % 3];
+            const float *pb = local[(e + 2) % 3];
+            tri.edges[e][0] = pa[1] - pb[1];
+            tri.edges[e][1] = pb[0] - pa[0];
+            tri.edges[e][2] = -(tri.edges[e][0] * pa[0] + tri.edges[e][1] * pa[1]);
+        }
+        const auto plane = [&](int attrib, float out_plane[3]) {
+            for (int c = 0; c < 3; c++) {
+                out_plane[c] = (tri.edges[0][c] * p[0][attrib] + tri.edges[1][c] * p[1][attrib] +
+                    tri.edges[2][c] * p[2][attrib]) * area_inv;
+            }
+        };
+        plane(2, tri.z);
+        plane(3, tri.w_inv);
+        for (int c = 0; c < 3; c++) {
+            plane(4 + c, tri.pos_w[c]);
+            plane(7 + c, tri.norm_w[c]);
+        }
+        out.push_back(tri);
+    }
+}
+
+void SoftRenderer::SetupChunk(size_t chunk_index) {
+    Chunk &chunk = chunks[chunk_index];
+    chunk.triangles.clear();
+    const size_t begin = chunk_index * kChunkSize;
+    const size_t end = std::min(first_triangles.back(), begin + kChunkSize);
+    size_t draw = std::upper_bound(first_triangles.begin(), first_triangles.end(), begin) -
+        first_triangles.begin() - 1;
+    for (size_t t = begin; t < end; t++) {
+        while (t >= first_triangles[draw + 1]) {
+            ++draw;
+        }
+        const SoftMesh &mesh = draws[draw].mesh;
+        const Vertex *verts[3];
+        for (int i = 0; i < 3; i++) {
+            const size_t index_pos = mesh.start_index + 3 * (t - first_triangles[draw]) + i;
+            const uint32_t index = mesh.index32 ? static_cast<const uint32_t *>(mesh.indices)[index_pos]
+                : static_cast<const uint16_t *>(mesh.indices)[index_pos];
+            assert(index < mesh.n_vertex);
+            verts[i] = &vertices[first_vertices[draw] + index];
+        }
+        SetupTriangle(verts, (uint32_t) draw, chunk.triangles);
+    }
+
+    // bin triangles to the tiles they touch
+    const uint32_t n_tile = n_tile_x * n_tile_y;
+    const int32_t tile = kSoftTileSize;
+    chunk.first_binned.assign(n_tile + 1, 0);
+    for (const Triangle &tri : chunk.triangles) {
+        for (int32_t ty = tri.y0 / tile; ty <= (tri.y1 - 1) / tile; ty++) {
+            for (int32_t tx = tri.x0 / tile; tx <= (tri.x1 - 1) / tile; tx++) {
+                ++chunk.first_binned[ty * n_tile_x + tx + 1];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < n_tile; i++) {
+        chunk.first_binned[i + 1] += chunk.first_binned[i];
+    }
+    chunk.binned.resize(chunk.first_binned[n_tile]);
+    for (uint32_t i = 0; i < chunk.triangles.size(); i++) {
+        const Triangle &tri = chunk.triangles[i];
+        for (int32_t ty = tri.y0 / tile; ty <= (tri.y1 - 1) / tile; ty++) {
+            for (int32_t tx = tri.x0 / tile; tx <= (tri.x1 - 1) / tile; tx++) {
+                chunk.binned[chunk.first_binned[ty * n_tile_x + tx]++] = i;
+            }
+        }
+    }
+    // first_binned[tile] ended at the first of the next tile
+    for (uint32_t i = n_tile; i > 0; i--) {
+        chunk.first_binned[i] = chunk.first_binned[i - 1];
+    }
+    chunk.first_binned[0] = 0;
+}
+
+void SoftRenderer::DrawTriangle(const Triangle &tri, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+    const Shading shading(*pass, counts, draws[tri.draw].material);
+    const Float4 zero = Set1(0.0f);
+    // groups of 4 pixels start at multiples of 4, tiles and the width are multiples of 4 too
+    const int32_t x_begin = x0 & ~3;
+    for (int32_t y = y0; y < y1; y++) {
+        const float fy = y + 0.5f - tri.origin[1];
+        const RowPlane e0(tri.edges[0], fy), e1(tri.edges[1], fy), e2(tri.edges[2], fy);
+        const RowPlane z_plane(tri.z, fy);
+        float *depth_row = depth.data() + (size_t) y * width;
+        uint32_t *pixel_row = pixels.data() + (size_t) y * width;
+        for (int32_t x = x_begin; x < x1; x += 4) {
+            const Float4 fx = Set1(x + 0.5f - tri.origin[0]) + Ramp();
+            Mask4 mask = GreaterEqual(e0.At(fx), zero) & GreaterEqual(e1.At(fx), zero) &
+                GreaterEqual(e2.At(fx), zero);
+            if (!Any(mask)) {
+                continue;
+            }
+            const Float4 z = z_plane.At(fx);
+            mask = mask & Less(z, Load(depth_row + x));
+            if (!Any(mask)) {
+                continue;
+            }
+
+            // perspective correct attributes
+            const Float4 w = Set1(1.0f) / RowPlane(tri.w_inv, fy).At(fx);
+            const Vec3 pos = {
+                RowPlane(tri.pos_w[0], fy).At(fx) * w,
+                RowPlane(tri.pos_w[1], fy).At(fx) * w,
+                RowPlane(tri.pos_w[2], fy).At(fx) * w
+            };
+            const Vec3 normal = Normalize({
+                RowPlane(tri.norm_w[0], fy).At(fx) * w,
+                RowPlane(tri.norm_w[1], fy).At(fx) * w,
+                RowPlane(tri.norm_w[2], fy).At(fx) * w
+            });
+            Float4 alpha;
+            const Vec3 color = shading.Shade(pos, normal, alpha);
+            StoreDepth(depth_row + x, mask, z);
+            StoreColor(pixel_row + x, mask, color.x, color.y, color.z, alpha);
+        }
+    }
+}
+
+void SoftRenderer::RenderTile(uint32_t tile) {
+    const int32_t tile_x0 = (tile % n_tile_x) * kSoftTileSize;
+    const int32_t tile_y0 = (tile / n_tile_x) * kSoftTileSize;
+    const int32_t tile_x1 = std::min<int32_t>(width, tile_x0 + kSoftTileSize);
+    const int32_t tile_y1 = std::min<int32_t>(height, tile_y0 + kSoftTileSize);
+    // chunks and their triangles in order, so the result doesn't depend on the thread count
+    for (const Chunk &chunk : chunks) {
+        for (uint32_t i = chunk.first_binned[tile]; i < chunk.first_binned[tile + 1]; i++) {
+            const Triangle &tri = chunk.triangles[chunk.binned[i]];
+            DrawTriangle(tri, std::max(tri.x0, tile_x0), std::max(tri.y0, tile_y0), std::min(tri.x1, tile_x1),
+                std::min(tri.y1, tile_y1));
+        }
+    }
+}
+
+void SoftRenderer::Render(JobSystem &jobs, const SoftPass &pass, const SoftLightCounts &counts,
+        const SoftDraw *draws, size_t n) {
+    this->pass = &pass;
+    this->counts = counts;
+    this->draws = draws;
+
+    first_vertices.resize(n + 1);
+    first_triangles.resize(n + 1);
+    first_vertices[0] = 0;
+    first_triangles[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        first_vertices[i + 1] = first_vertices[i] + draws[i].mesh.n_vertex;
+        first_triangles[i + 1] = first_triangles[i] + draws[i].mesh.n_index / 3;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    vertices.resize(first_vertices[n]);
+    jobs.ParallelForRange(0, vertices.size(), [this](size_t b, size_t e) {
+        size_t draw = std::upper_bound(first_vertices.begin(), first_vertices.end(), b) - first_vertices.begin() - 1;
+        while (b < e) {
+            while (b >= first_vertices[draw + 1]) {
+                ++draw;
+            }
+            const size_t end = std::min(e, first_vertices[draw + 1]);
+            TransformVertices(draw, b, end);
+            b = end;
+        }
+    }, kVertexGrain);
+    stats = {};
+    stats.vertex_ms = Milliseconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    chunks.resize((first_triangles[n] + kChunkSize - 1) / kChunkSize);
+    jobs.ParallelFor(0, chunks.size(), [this](size_t chunk) {
+        SetupChunk(chunk);
+    });
+    stats.setup_ms = Milliseconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    jobs.ParallelFor(0, n_tile_x * n_tile_y, [this](size_t tile) {
+        RenderTile((uint32_t) tile);
+    });
+    stats.raster_ms = Milliseconds(begin);
+
+    stats.n_draw = n;
+    stats.n_triangle = first_triangles[n];
+    for (const Chunk &chunk : chunks) {
+        stats.n_setup += chunk.triangles.size();
+    }
+    this->pass = nullptr;
+    this->draws = nullptr;
+}
+
+bool SoftRenderer::WritePpm(const std::string &filename) const {
+    FILE *fp = std::fopen(filename.c_str(), "wb");
+    if (fp == nullptr) {
+        return false;
+    }
+    std::fprintf(fp, "P6\n%u %u\n255\n", width, height);
+    std::vector<uint8_t> row(3 * (size_t) width);
+    bool ok = true;
+    for (uint32_t y = 0; y < height && ok; y++) {
+        const uint32_t *src = pixels.data() + (size_t) y * width;
+        for (uint32_t x = 0; x < width; x++) {
+            row[3 * x] = src[x] & 0xff;
+            row[3 * x + 1] = (src[x] >> 8) & 0xff;
+            row[3 * x + 2] = (src[x] >> 16) & 0xff;
+        }
+        ok = std::fwrite(row.data(), 1, row.size(), fp) == row.size();
+    }
+    return std::fclose(fp) == 0 && ok;
+}
\ No newline at end of file
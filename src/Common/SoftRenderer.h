@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+
+// cpu rendering of lit opaque meshes with the math of P3N3_default.hlsl & light.hlsl (blinn-phong, schlick fresnel),
+// so scenes of the chapters can be rendered to images where there is no d3d
+// matrices are row-major and used with row vectors (DirectXMath convention, clip z in [0, 1]) as constant buffers
+// hold them, back faces are culled and front faces are counter-clockwise as in the chapter PSOs
+// triangles are set up and binned to kSoftTileSize^2 tiles in chunks, one job per chunk, then every tile is
+// rasterized and shaded by one job, 4 pixels at a time with SSE2 (a scalar path does the same without it)
+
+const uint32_t kSoftTileSize = 64;
+const int kSoftMaxLights = 16;
+
+// same layout as Light of D3DUtil.h
+struct SoftLight {
+    float strength[3] = { 0.5f, 0.5f, 0.5f };
+    float falloff_start = 1.0f;
+    float direction[3] = { 0.0f, -1.0f, 0.0f };
+    float falloff_end = 10.0f;
+    float position[3] = { 0.0f, 0.0f, 0.0f };
+    float spot_power = 64.0f;
+};
+
+// same layout as MaterialConst of D3DUtil.h
+struct SoftMaterial {
+    float albedo[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float fresnel_r0[3] = { 0.01f, 0.01f, 0.01f };
+    float roughness = 0.25f;
+    float mat_transform[4][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+};
+
+// same layout as ObjectConst of ch08_lighting
+struct SoftObject {
+    float model[4][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+    float model_it[4][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+};
+
+// same layout as PassConst of ch08_lighting, only vp, eye, ambient and lights are used
+struct SoftPass {
+    float view[4][4] = {};
+    float view_inv[4][4] = {};
+    float proj[4][4] = {};
+    float proj_inv[4][4] = {};
+    float vp[4][4] = {};
+    float vp_inv[4][4] = {};
+    float eye[3] = { 0.0f, 0.0f, 0.0f };
+    float padding0 = 0.0f;
+    float rt_size[2] = { 0.0f, 0.0f };
+    float rt_size_inv[2] = { 0.0f, 0.0f };
+    float near_z = 0.0f;
+    float far_z = 0.0f;
+    float delta_time = 0.0f;
+    float total_time = 0.0f;
+    float ambient[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    SoftLight lights[kSoftMaxLights];
+};
+
+// first n_dir lights of the pass are directional, then n_point point and n_spot spot lights,
+// as N_DIR_LIGHTS, N_POINT_LIGHTS & N_SPOT_LIGHTS of the shaders
+struct SoftLightCounts {
+    int n_dir = 1;
+    int n_point = 0;
+    int n_spot = 0;
+};
+
+// an indexed triangle list, e.g. MeshGeometry::vb_cpu & ib_cpu with one of its submeshes
+struct SoftMesh {
+    const void *vertices = nullptr; // position is the first 3 floats of a vertex
+    uint32_t stride = 24; // in bytes
+    uint32_t normal_offset = 12; // in bytes
+    uint32_t n_vertex = 0; // vertices from base_vertex on that indices refer to
+    const void *indices = nullptr;
+    bool index32 = false;
+    uint32_t n_index = 0;
+    uint32_t start_index = 0;
+    int32_t base_vertex = 0;
+};
+
+struct SoftDraw {
+    SoftMesh mesh;
+    SoftObject object;
+    SoftMaterial material;
+};
+
+struct SoftStats {
+    size_t n_draw = 0;
+    size_t n_triangle = 0; // triangles given
+    size_t n_setup = 0; // triangles left after culling & clipping that touch the screen
+    double vertex_ms = 0.0;
+    double setup_ms = 0.0;
+    double raster_ms = 0.0;
+
+    double TotalMs() const {
+        return vertex_ms + setup_ms + raster_ms;
+    }
+};
+
+class SoftRenderer {
+  public:
+    // width is a multiple of 4
+    SoftRenderer(uint32_t width, uint32_t height);
+    SoftRenderer(const SoftRenderer &rhs) = delete;
+    SoftRenderer &operator=(const SoftRenderer &rhs) = delete;
+
+    void Clear(const float color[4]);
+    // draws are opaque and depth tested against everything drawn since Clear()
+    void Render(JobSystem &jobs, const SoftPass &pass, const SoftLightCounts &counts, const SoftDraw *draws, size_t n);
+
+    uint32_t Width() const {
+        return width;
+    }
+    uint32_t Height() const {
+        return height;
+    }
+    // rgba8 as DXGI_FORMAT_R8G8B8A8_UNORM, row by row from the top
+    const uint32_t *Pixels() const {
+        return pixels.data();
+    }
+    // binary ppm, alpha is dropped
+    bool WritePpm(const std::string &filename) const;
+    // of the last Render()
+    const SoftStats &Stats() const {
+        return stats;
+    }
+
+  private:
+    // after the vertex shader
+    struct Vertex {
+        float clip[4];
+        float pos_w[3];
+        float norm_w[3];
+    };
+    // planes a * x + b * y + c over the screen, relative to origin, edges are positive inside,
+    // attributes are divided by w so they can be interpolated on the screen and divided by 1 / w per pixel
+    struct Triangle {
+        float origin[2];
+        float edges[3][3];
+        float z[3];
+        float w_inv[3];
+        float pos_w[3][3];
+        float norm_w[3][3];
+        uint32_t draw;
+        int32_t x0, y0, x1, y1; // pixels [x0, x1) x [y0, y1)
+    };
+    // triangles set up and binned to tiles by one job
+    struct Chunk {
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> first_binned; // of each tile, and the total count at the end
+        std::vector<uint32_t> binned;
+    };
+
+    static constexpr size_t kChunkSize = 4096;
+
+    void TransformVertices(size_t draw, size_t begin, size_t end);
+    void SetupTriangle(const Vertex *verts[3], uint32_t draw, std::vector<Triangle> &out) const;
+    void SetupChunk(size_t chunk_index);
+    void DrawTriangle(const Triangle &tri, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+    void RenderTile(uint32_t tile);
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t n_tile_x;
+    uint32_t n_tile_y;
+    std::vector<uint32_t> pixels;
+    std::vector<float> depth;
+
+    // valid during Render()
+    const SoftPass *pass = nullptr;
+    SoftLightCounts counts;
+    const SoftDraw *draws = nullptr;
+
+    std::vector<size_t> first_vertices; // of each draw, and the total count at the end
+    std::vector<size_t> first_triangles; // of each draw, and the total count at the end
+    std::vector<Vertex> vertices;
+    std::vector<Chunk> chunks; // kChunkSize triangles each
+
+    SoftStats stats;
+};
\ No newline at end of file
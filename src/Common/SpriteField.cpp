@@ -0,0 +1,180 @@
+#include "SpriteField.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "Random.h"
+
+namespace {
+
+const size_t kCandidatesPerBlock = 4096;
+
+}
+
+void SpriteField::Scatter(JobSystem &jobs, const ScatterRule &rule, const HeightFieldFn &height) {
+    const size_t n_block = (rule.n_candidate + kCandidatesPerBlock - 1) / kCandidatesPerBlock;
+    std::vector<std::vector<SpriteInstance>> blocks(n_block);
+    jobs.ParallelFor(0, n_block, [&](size_t b) {
+        // one stream per block, so the result doesn't depend on which thread runs it
+        Random rnd(rule.seed, b);
+        const size_t n = std::min(kCandidatesPerBlock, rule.n_candidate - b * kCandidatesPerBlock);
+        std::vector<float> xs(n), zs(n);
+        rnd.FillF(xs.data(), n, rule.min_x, rule.max_x);
+        rnd.FillF(zs.data(), n, rule.min_z, rule.max_z);
+        // heights and normals of the whole block at once
+        const bool need_normal = rule.max_slope < FLT_MAX;
+        std::vector<float> ys(n), norms(need_normal ? 3 * n : 0);
+        height(xs.data(), zs.data(), n, ys.data(), need_normal ? norms.data() : nullptr);
+
+        auto &block = blocks[b];
+        for (size_t i = 0; i < n; i++) {
+            const float x = xs[i];
+            const float z = zs[i];
+            const float y = ys[i];
+            if (y < rule.min_height || y > rule.max_height) {
+                continue;
+            }
+            if (need_normal) {
+                // tan^2 of the slope is |dh/dx, dh/dz|^2 = (nx^2 + nz^2) / ny^2
+                const float *norm = &norms[3 * i];
+                const float max_slope_sq = rule.max_slope * rule.max_slope;
+                if (norm[0] * norm[0] + norm[2] * norm[2] > max_slope_sq * norm[1] * norm[1]) {
+                    continue;
+                }
+            }
+            if (rule.density < 1.0f && rnd.NextF() >= rule.density) {
+                continue;
+            }
+
+            SpriteInstance sprite;
+            const float size = rnd.RandF(rule.min_size, rule.max_size);
+            // trunk in the texture doesn't start at the bottom edge, sink the quad a little
+            sprite.pos[0] = x;
+            sprite.pos[1] = y + 0.4f * size;
+            sprite.pos[2] = z;
+            sprite.size[0] = size;
+            sprite.size[1] = size;
+            sprite.variant = rule.n_variant > 1 ? rnd.RandI(0, rule.n_variant - 1) : 0;
+            block.push_back(sprite);
+        }
+    });
+
+    std::vector<SpriteInstance> scattered;
+    size_t n_sprite = 0;
+    for (const auto &block : blocks) {
+        n_sprite += block.size();
+    }
+    scattered.reserve(n_sprite);
+    for (const auto &block : blocks) {
+        scattered.insert(scattered.end(), block.begin(), block.end());
+    }
+    BuildGrid(rule, scattered);
+}
+
+void SpriteField::BuildGrid(const ScatterRule &rule, std::vector<SpriteInstance> &scattered) {
+    assert(scattered.size() < UINT32_MAX);
+    sprites.clear();
+    cells.clear();
+    chunks.clear();
+    if (scattered.empty()) {
+        return;
+    }
+
+    const int n_cell_x = std::max(1, (int) std::ceil((rule.max_x - rule.min_x) / cell_size));
+    const int n_cell_z = std::max(1, (int) std::ceil((rule.max_z - rule.min_z) / cell_size));
+    auto cell_of = [&](const SpriteInstance &sprite) {
+        int cx = std::clamp((int) ((sprite.pos[0] - rule.min_x) / cell_size), 0, n_cell_x - 1);
+        int cz = std::clamp((int) ((sprite.pos[2] - rule.min_z) / cell_size), 0, n_cell_z - 1);
+        return (size_t) cz * n_cell_x + cx;
+    };
+
+    // counting sort by cell
+    std::vector<uint32_t> offsets((size_t) n_cell_x * n_cell_z + 1, 0);
+    for (const auto &sprite : scattered) {
+        ++offsets[cell_of(sprite) + 1];
+    }
+    for (size_t c = 1; c < offsets.size(); c++) {
+        offsets[c] += offsets[c - 1];
+    }
+    sprites.resize(scattered.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto &sprite : scattered) {
+        sprites[cursor[cell_of(sprite)]++] = sprite;
+    }
+
+    for (size_t c = 0; c + 1 < offsets.size(); c++) {
+        if (offsets[c] == offsets[c + 1]) {
+            continue;
+        }
+        Cell cell;
+        std::fill(cell.min, cell.min + 3, FLT_MAX);
+        std::fill(cell.max, cell.max + 3, -FLT_MAX);
+        cell.begin = offsets[c];
+        cell.end = offsets[c + 1];
+        for (uint32_t i = cell.begin; i < cell.end; i++) {
+            const auto &sprite = sprites[i];
+            // the quad rotates around y, so bound it by a box of its half width in x and z
+            const float half[3] = { 0.5f * sprite.size[0], 0.5f * sprite.size[1], 0.5f * sprite.size[0] };
+            for (int k = 0; k < 3; k++) {
+                cell.min[k] = std::min(cell.min[k], sprite.pos[k] - half[k]);
+                cell.max[k] = std::max(cell.max[k], sprite.pos[k] + half[k]);
+            }
+        }
+        cells.push_back(cell);
+    }
+    chunks.resize((cells.size() + kCellsPerChunk - 1) / kCellsPerChunk);
+}
+
+void SpriteField::AddRange(std::vector<CopyRange> &ranges, uint32_t src, uint32_t count) {
+    if (!ranges.empty() && ranges.back().src + ranges.back().count == src) {
+        ranges.back().count += count;
+    } else {
+        ranges.push_back({ src, count });
+    }
+}
+
+size_t SpriteField::Cull(JobSystem &jobs, const Frustum &frustum, SpriteInstance *out) {
+    jobs.ParallelFor(0, chunks.size(), [&](size_t c) {
+        Chunk &chunk = chunks[c];
+        chunk.ranges.clear();
+        chunk.n_visible = 0;
+        const size_t end = std::min(cells.size(), (c + 1) * kCellsPerChunk);
+        for (size_t i = c * kCellsPerChunk; i < end; i++) {
+            const Cell &cell = cells[i];
+            auto res = frustum.TestAabb(cell.min, cell.max);
+            if (res == Frustum::Result::Outside) {
+                continue;
+            }
+            if (res == Frustum::Result::Inside) {
+                AddRange(chunk.ranges, cell.begin, cell.end - cell.begin);
+                chunk.n_visible += cell.end - cell.begin;
+                continue;
+            }
+            for (uint32_t j = cell.begin; j < cell.end; j++) {
+                const auto &sprite = sprites[j];
+                float radius = 0.5f * std::sqrt(sprite.size[0] * sprite.size[0] + sprite.size[1] * sprite.size[1]);
+                if (frustum.TestSphere(sprite.pos, radius)) {
+                    AddRange(chunk.ranges, j, 1);
+                    ++chunk.n_visible;
+                }
+            }
+        }
+    });
+
+    size_t n_visible = 0;
+    for (auto &chunk : chunks) {
+        chunk.offset = n_visible;
+        n_visible += chunk.n_visible;
+    }
+
+    jobs.ParallelFor(0, chunks.size(), [&](size_t c) {
+        SpriteInstance *dst = out + chunks[c].offset;
+        for (const auto &range : chunks[c].ranges) {
+            std::memcpy(dst, &sprites[range.src], range.count * sizeof(SpriteInstance));
+            dst += range.count;
+        }
+    });
+    return n_visible;
+}
\ No newline at end of file
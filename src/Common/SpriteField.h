@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+
+// a sprite as the point fed to a billboard geometry shader, also the layout of the per-frame instance stream
+struct SpriteInstance {
+    float pos[3];    // center of the quad
+    float size[2];   // width, height
+    uint32_t variant; // texture array slice
+};
+
+// where and how sprites grow on a height field
+struct ScatterRule {
+    float min_x = -50.0f;
+    float max_x = 50.0f;
+    float min_z = -50.0f;
+    float max_z = 50.0f;
+    size_t n_candidate = 1024;  // candidates are uniform in the rectangle and then filtered
+    float min_height = -FLT_MAX;
+    float max_height = FLT_MAX;
+    float max_slope = FLT_MAX;  // tangent of the ground slope
+    float density = 1.0f;       // chance to keep a candidate passing the other rules
+    float min_size = 10.0f;
+    float max_size = 20.0f;
+    uint32_t n_variant = 1;
+    uint64_t seed = 0;          // same seed, same sprites, no matter how many threads
+};
+
+// sprites scattered on a height field and bucketed into a uniform grid on xz
+// Cull() writes the sprites of cells passing the frustum test, compacted, into an instance stream
+class SpriteField {
+  public:
+    explicit SpriteField(float cell_size = 8.0f) : cell_size(cell_size) {}
+
+    void Scatter(JobSystem &jobs, const ScatterRule &rule, const HeightFieldFn &height);
+
+    // out must have room for Count() sprites, returns number of sprites written
+    // cells fully inside are copied as a whole, sprites of cells crossing the frustum are tested one by one
+    size_t Cull(JobSystem &jobs, const Frustum &frustum, SpriteInstance *out);
+
+    size_t Count() const {
+        return sprites.size();
+    }
+    size_t CellCount() const {
+        return cells.size();
+    }
+    // in cell order
+    const std::vector<SpriteInstance> &Sprites() const {
+        return sprites;
+    }
+
+  private:
+    // non-empty cells only, bounds are of the quads it contains
+    struct Cell {
+        float min[3];
+        float max[3];
+        uint32_t begin;
+        uint32_t end;
+    };
+    struct CopyRange {
+        uint32_t src;
+        uint32_t count;
+    };
+    // cells are culled in chunks, each chunk collects ranges of visible sprites
+    struct Chunk {
+        std::vector<CopyRange> ranges;
+        size_t n_visible = 0;
+        size_t offset = 0;
+    };
+    static const size_t kCellsPerChunk = 32;
+
+    void BuildGrid(const ScatterRule &rule, std::vector<SpriteInstance> &scattered);
+    // append, merging with the last range if contiguous
+    static void AddRange(std::vector<CopyRange> &ranges, uint32_t src, uint32_t count);
+
+    float cell_size;
+    std::vector<SpriteInstance> sprites;
+    std::vector<Cell> cells;
+    std::vector<Chunk> chunks;
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cassert>
+
+void StagingRing::Reset(uint64_t capacity) {
+    this->capacity = capacity;
+    head = 0;
+    n_used = 0;
+    n_batch_used = 0;
+    batches.clear();
+}
+
+bool StagingRing::Allocate(uint64_t size, uint64_t align, uint64_t &offset) {
+    assert(align > 0 && (align & (align - 1)) == 0);
+    const uint64_t n_free = capacity - n_used;
+    uint64_t begin = (head + align - 1) & ~(align - 1);
+    uint64_t n_skip = begin - head;
+    if (begin > capacity || size > capacity - begin) {
+        // a range never wraps around, the rest of the ring is skipped and comes back with this batch
+        begin = 0;
+        n_skip = capacity - head;
+    }
+    if (size > capacity || n_skip > n_free || size > n_free - n_skip) {
+        return false;
+    }
+    offset = begin;
+    n_used += n_skip + size;
+    n_batch_used += n_skip + size;
+    head = begin + size == capacity ? 0 : begin + size;
+    peak_used = std::max(peak_used, n_used);
+    return true;
+}
+
+void StagingRing::EndBatch(uint64_t fence) {
+    if (n_batch_used == 0) {
+        return;
+    }
+    assert(batches.empty() || batches.back().fence <= fence);
+    batches.push_back({ fence, n_batch_used });
+    n_batch_used = 0;
+}
+
+void StagingRing::Retire(uint64_t completed_fence) {
+    while (!batches.empty() && batches.front().fence <= completed_fence) {
+        n_used -= batches.front().n_used;
+        batches.pop_front();
+    }
+    if (n_used == 0) {
+        head = 0;
+    }
+}
+
+size_t CoalesceCopies(std::vector<StagedCopy> &copies) {
+    std::stable_sort(copies.begin(), copies.end(), [](const StagedCopy &a, const StagedCopy &b) {
+        return a.dst < b.dst;
+    });
+    size_t n = 0;
+    for (const StagedCopy &copy : copies) {
+        if (n > 0) {
+            StagedCopy &last = copies[n - 1];
+            if (last.dst == copy.dst && last.src == copy.src && last.src_offset + last.size == copy.src_offset
+                    && last.dst_offset + last.size == copy.dst_offset) {
+                last.size += copy.size;
+                continue;
+            }
+        }
+        copies[n++] = copy;
+    }
+    copies.resize(n);
+    return n;
+}
\ No newline at end of file
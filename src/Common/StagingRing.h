@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// byte ranges of a staging buffer shared by all uploads, nothing here touches D3D (see UploadManager.h for that)
+// ranges are handed out in a ring and belong to the batch that is open, a batch ends with the fence signaled after
+// its copies, and its ranges come back once that fence completes
+class StagingRing {
+  public:
+    explicit StagingRing(uint64_t capacity = 0) {
+        Reset(capacity);
+    }
+
+    // forget all ranges, peak usage is kept
+    void Reset(uint64_t capacity);
+
+    // align is a power of two, false if there is no room until earlier batches retire
+    bool Allocate(uint64_t size, uint64_t align, uint64_t &offset);
+    void EndBatch(uint64_t fence);
+    void Retire(uint64_t completed_fence);
+
+    uint64_t Capacity() const {
+        return capacity;
+    }
+    // padding & skipped space at the end of the ring included
+    uint64_t Used() const {
+        return n_used;
+    }
+    uint64_t PeakUsed() const {
+        return peak_used;
+    }
+    bool Idle() const {
+        return n_used == 0;
+    }
+
+  private:
+    struct Batch {
+        uint64_t fence;
+        uint64_t n_used;
+    };
+
+    uint64_t capacity = 0;
+    // the n_used bytes before head are in use, batches are retired in order
+    uint64_t head = 0;
+    uint64_t n_used = 0;
+    uint64_t n_batch_used = 0;
+    uint64_t peak_used = 0;
+    std::deque<Batch> batches;
+};
+
+// copy of size bytes from staging buffer src to destination dst, both are indices into tables of the user
+struct StagedCopy {
+    uint32_t src;
+    uint32_t dst;
+    uint64_t dst_offset;
+    uint64_t src_offset;
+    uint64_t size;
+};
+
+// group copies by destination (keeping their order otherwise) and merge those continuing the previous one
+// in the same source and destination, returns the number of copies left
+size_t CoalesceCopies(std::vector<StagedCopy> &copies);
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+void TaskGraph::AddStage(const std::string &name, const std::vector<std::string> &inputs,
+        const std::vector<std::string> &outputs, std::function<void()> fn, bool serialized) {
+    Stage stage;
+    stage.name = name;
+    stage.inputs = inputs;
+    stage.outputs = outputs;
+    stage.fn = std::move(fn);
+    stage.serialized = serialized;
+    stages.push_back(std::move(stage));
+}
+
+void TaskGraph::ResolveDependency() {
+    std::unordered_map<std::string, std::vector<size_t>> producers;
+    for (size_t i = 0; i < stages.size(); i++) {
+        for (const auto &out : stages[i].outputs) {
+            producers[out].push_back(i);
+        }
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        auto &deps = stages[i].deps;
+        deps.clear();
+        for (const auto &in : stages[i].inputs) {
+            auto it = producers.find(in);
+            if (it == producers.end()) {
+                continue;
+            }
+            for (size_t p : it->second) {
+                if (p != i) {
+                    deps.push_back(p);
+                }
+            }
+        }
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+    }
+}
+
+void TaskGraph::Run(unsigned n_thread) {
+    ResolveDependency();
+
+    const size_t n = stages.size();
+    std::vector<std::vector<size_t>> dependents(n);
+    std::vector<size_t> n_waiting(n);
+    std::deque<size_t> ready;
+    for (size_t i = 0; i < n; i++) {
+        n_waiting[i] = stages[i].deps.size();
+        for (size_t d : stages[i].deps) {
+            dependents[d].push_back(i);
+        }
+        if (n_waiting[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    {
+        // Kahn's algorithm, every stage must be reachable or there is a cycle
+        // checked before any thread starts, workers would otherwise wait forever on the stages of the cycle
+        std::vector<size_t> cnt = n_waiting;
+        std::deque<size_t> q = ready;
+        size_t n_visited = 0;
+        while (!q.empty()) {
+            size_t u = q.front();
+            q.pop_front();
+            ++n_visited;
+            for (size_t v : dependents[u]) {
+                if (--cnt[v] == 0) {
+                    q.push_back(v);
+                }
+            }
+        }
+        if (n_visited != n) {
+            // stages left waiting are on a cycle or depend on one
+            std::string names;
+            for (size_t i = 0; i < n; i++) {
+                if (cnt[i] != 0) {
+                    names += (names.empty() ? "" : ", ") + stages[i].name;
+                }
+            }
+            throw std::logic_error("cyclic dependency among stages: " + names);
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t n_done = 0;
+    size_t n_running = 0;
+    bool serial_busy = false;
+    std::exception_ptr error = nullptr;
+
+    using Clock = std::chrono::steady_clock;
+    const auto t0 = Clock::now();
+    auto elapsed_ms = [&t0]() {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    };
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            auto runnable = ready.end();
+            cv.wait(lock, [&]() {
+                if (n_done == n || (error != nullptr)) {
+                    return true;
+                }
+                runnable = std::find_if(ready.begin(), ready.end(), [&](size_t i) {
+                    return !stages[i].serialized || !serial_busy;
+                });
+                return runnable != ready.end();
+            });
+            if (n_done == n || error != nullptr) {
+                break;
+            }
+
+            size_t i = *runnable;
+            ready.erase(runnable);
+            Stage &stage = stages[i];
+            if (stage.serialized) {
+                serial_busy = true;
+            }
+            ++n_running;
+            stage.start_ms = elapsed_ms();
+            lock.unlock();
+
+            std::exception_ptr stage_error = nullptr;
+            try {
+                stage.fn();
+            } catch (...) {
+                stage_error = std::current_exception();
+            }
+
+            lock.lock();
+            stage.end_ms = elapsed_ms();
+            --n_running;
+            if (stage.serialized) {
+                serial_busy = false;
+            }
+            if (stage_error != nullptr && error == nullptr) {
+                error = stage_error;
+            }
+            ++n_done;
+            for (size_t d : dependents[i]) {
+                if (--n_waiting[d] == 0) {
+                    ready.push_back(d);
+                }
+            }
+            cv.notify_all();
+        }
+    };
+
+    n_thread = std::max(1u, std::min<unsigned>(n_thread, static_cast<unsigned>(n)));
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < n_thread; i++) {
+        workers.emplace_back(worker);
+    }
+    // caller thread works as well
+    worker();
+    for (auto &t : workers) {
+        t.join();
+    }
+    wall_ms = elapsed_ms();
+
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<size_t> TaskGraph::CriticalPath(double &length_ms) const {
+    // stages are finished in topological order, so sort by end time gives a valid order
+    std::vector<size_t> order(stages.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return stages[a].end_ms < stages[b].end_ms;
+    });
+
+    std::vector<double> dist(stages.size(), 0.0);
+    std::vector<size_t> prev(stages.size(), stages.size());
+    for (size_t i : order) {
+        double best = 0.0;
+        for (size_t d : stages[i].deps) {
+            if (dist[d] > best) {
+                best = dist[d];
+                prev[i] = d;
+            }
+        }
+        dist[i] = best + (stages[i].end_ms - stages[i].start_ms);
+    }
+
+    length_ms = 0.0;
+    std::vector<size_t> path;
+    if (stages.empty()) {
+        return path;
+    }
+    size_t last = std::max_element(dist.begin(), dist.end()) - dist.begin();
+    length_ms = dist[last];
+    for (size_t i = last; i < stages.size(); i = prev[i]) {
+        path.push_back(i);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+std::string TaskGraph::Report() const {
+    std::ostringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(2);
+
+    double sum_ms = 0.0;
+    for (const auto &stage : stages) {
+        double t = stage.end_ms - stage.start_ms;
+        sum_ms += t;
+        ss << "  " << stage.name << ": " << t << " ms [" << stage.start_ms << ", " << stage.end_ms << "]"
+            << (stage.serialized ? " (serialized)" : "") << "\n";
+    }
+
+    double cp_ms = 0.0;
+    auto path = CriticalPath(cp_ms);
+    ss << "wall time: " << wall_ms << " ms, sum of stages: " << sum_ms << " ms\n";
+    ss << "critical path (" << cp_ms << " ms):";
+    for (size_t i = 0; i < path.size(); i++) {
+        ss << (i == 0 ? " " : " -> ") << stages[path[i]].name;
+    }
+    ss << "\n";
+    return ss.str();
+}
\ No newline at end of file
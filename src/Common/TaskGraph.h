@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+
+// run initialization stages on a worker pool, respecting data dependency among them
+// a stage depends on every stage that lists one of its inputs as output,
+// inputs that no stage produces (device, window, ...) are assumed to be ready
+// stages marked 'serialized' (e.g. recording into the shared command list) never overlap with each other
+class TaskGraph {
+  public:
+    struct Stage {
+        std::string name;
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        std::function<void()> fn;
+        bool serialized = false;
+
+        // filled by Run()
+        std::vector<size_t> deps;
+        double start_ms = 0.0;
+        double end_ms = 0.0;
+    };
+
+    void AddStage(const std::string &name, const std::vector<std::string> &inputs,
+        const std::vector<std::string> &outputs, std::function<void()> fn, bool serialized = false);
+
+    // block until all stages finish, exception thrown by a stage is re-thrown here
+    // throws std::logic_error without running any stage if the dependencies form a cycle
+    void Run(unsigned n_thread = std::thread::hardware_concurrency());
+
+    const std::vector<Stage> &Stages() const {
+        return stages;
+    }
+    // time from the start of Run() to the end of the last stage
+    double WallTime() const {
+        return wall_ms;
+    }
+    // longest chain of dependent stages, weighted by their execution time
+    std::vector<size_t> CriticalPath(double &length_ms) const;
+    // per-stage timing and critical path, in readable text
+    std::string Report() const;
+
+  private:
+    void ResolveDependency();
+
+    std::vector<Stage> stages;
+    double wall_ms = 0.0;
+};
\ No newline at end of file
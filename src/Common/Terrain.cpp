@@ -0,0 +1,267 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// height bounds of a leaf are taken from (kBoundSamples + 1)^2 samples
+const int kBoundSamples = 8;
+
+}
+
+Terrain::Terrain(JobSystem &jobs, const TerrainDesc &desc, HeightFieldFn height, int n_slot)
+    : desc(desc), height(std::move(height)), slots(n_slot) {
+    assert(desc.n_level >= 1 && desc.n_level <= 16);
+    assert(desc.chunk_quads >= 2 && desc.chunk_quads <= 128 && (desc.chunk_quads & (desc.chunk_quads - 1)) == 0);
+    assert(desc.lod_range_factor >= 1.5f);
+
+    bounds.resize(desc.n_level);
+    const int n_leaf = NodeCount(0);
+    const float leaf_size = NodeSize(0);
+    bounds[0].resize((size_t) n_leaf * n_leaf);
+    jobs.ParallelFor(0, bounds[0].size(), [&](size_t i) {
+        const float x0 = desc.min_x + (i % n_leaf) * leaf_size;
+        const float z0 = desc.min_z + (i / n_leaf) * leaf_size;
+        const int n_sample = (kBoundSamples + 1) * (kBoundSamples + 1);
+        float xs[n_sample], zs[n_sample], hs[n_sample];
+        for (int k = 0; k < n_sample; k++) {
+            xs[k] = x0 + leaf_size * (k % (kBoundSamples + 1)) / kBoundSamples;
+            zs[k] = z0 + leaf_size * (k / (kBoundSamples + 1)) / kBoundSamples;
+        }
+        this->height(xs, zs, n_sample, hs, nullptr);
+        Bound bound = { FLT_MAX, -FLT_MAX };
+        for (int k = 0; k < n_sample; k++) {
+            bound.min_h = std::min(bound.min_h, hs[k]);
+            bound.max_h = std::max(bound.max_h, hs[k]);
+        }
+        bound.min_h -= desc.bound_margin;
+        bound.max_h += desc.bound_margin;
+        bounds[0][i] = bound;
+    }, 16);
+    for (int level = 1; level < desc.n_level; level++) {
+        const int n = NodeCount(level);
+        bounds[level].resize((size_t) n * n);
+        for (int z = 0; z < n; z++) {
+            for (int x = 0; x < n; x++) {
+                Bound bound = { FLT_MAX, -FLT_MAX };
+                for (int k = 0; k < 4; k++) {
+                    const Bound &child = bounds[level - 1][(size_t) (2 * z + k / 2) * (2 * n) + 2 * x + k % 2];
+                    bound.min_h = std::min(bound.min_h, child.min_h);
+                    bound.max_h = std::max(bound.max_h, child.max_h);
+                }
+                bounds[level][(size_t) z * n + x] = bound;
+            }
+        }
+    }
+}
+
+bool Terrain::ShouldSplit(const TerrainNode &node, const float eye[3]) const {
+    const float size = NodeSize(node.level);
+    const float x0 = desc.min_x + node.x * size;
+    const float z0 = desc.min_z + node.z * size;
+    const float dx = std::max({ x0 - eye[0], 0.0f, eye[0] - x0 - size });
+    const float dz = std::max({ z0 - eye[2], 0.0f, eye[2] - z0 - size });
+    const float range = desc.lod_range_factor * size;
+    return dx * dx + dz * dz < range * range;
+}
+
+int Terrain::LevelAt(float x, float z, const float eye[3]) const {
+    TerrainNode node = { desc.n_level - 1, 0, 0 };
+    while (node.level > 0 && ShouldSplit(node, eye)) {
+        const float half = 0.5f * NodeSize(node.level);
+        const float x0 = desc.min_x + node.x * 2.0f * half;
+        const float z0 = desc.min_z + node.z * 2.0f * half;
+        node = { node.level - 1, 2 * node.x + (x >= x0 + half), 2 * node.z + (z >= z0 + half) };
+    }
+    return node.level;
+}
+
+uint32_t Terrain::StitchMask(const TerrainNode &node, const float eye[3]) const {
+    const float size = NodeSize(node.level);
+    const float x0 = desc.min_x + node.x * size;
+    const float z0 = desc.min_z + node.z * size;
+    // probe just outside the middle of each edge
+    const float eps = 0.5f * NodeSize(0);
+    const struct {
+        uint32_t side;
+        float x;
+        float z;
+    } probes[] = {
+        { kTerrainNorth, x0 + 0.5f * size, z0 + size + eps },
+        { kTerrainEast, x0 + size + eps, z0 + 0.5f * size },
+        { kTerrainSouth, x0 + 0.5f * size, z0 - eps },
+        { kTerrainWest, x0 - eps, z0 + 0.5f * size }
+    };
+    uint32_t mask = 0;
+    for (const auto &p : probes) {
+        if (p.x < desc.min_x || p.x >= desc.min_x + desc.size || p.z < desc.min_z || p.z >= desc.min_z + desc.size) {
+            continue;
+        }
+        if (LevelAt(p.x, p.z, eye) > node.level) {
+            mask |= p.side;
+        }
+    }
+    return mask;
+}
+
+void Terrain::Visit(const TerrainNode &node, const float eye[3], const Frustum *frustum,
+        std::vector<TerrainChunk> &chunks) const {
+    if (frustum != nullptr) {
+        const float size = NodeSize(node.level);
+        const Bound &bound = bounds[node.level][(size_t) node.z * NodeCount(node.level) + node.x];
+        const float min[3] = { desc.min_x + node.x * size, bound.min_h, desc.min_z + node.z * size };
+        const float max[3] = { min[0] + size, bound.max_h, min[2] + size };
+        if (frustum->TestAabb(min, max) == Frustum::Result::Outside) {
+            return;
+        }
+    }
+    if (node.level > 0 && ShouldSplit(node, eye)) {
+        for (int k = 0; k < 4; k++) {
+            Visit({ node.level - 1, 2 * node.x + k % 2, 2 * node.z + k / 2 }, eye, frustum, chunks);
+        }
+        return;
+    }
+    TerrainChunk chunk;
+    chunk.node = node;
+    chunk.stitch = StitchMask(node, eye);
+    chunks.push_back(chunk);
+}
+
+void Terrain::Select(const float eye[3], const Frustum *frustum, std::vector<TerrainChunk> &chunks) const {
+    chunks.clear();
+    Visit({ desc.n_level - 1, 0, 0 }, eye, frustum, chunks);
+}
+
+int Terrain::AcquireSlot(uint64_t frame, uint64_t n_frame_lag) {
+    int lru = -1;
+    for (int i = 0; i < (int) slots.size(); i++) {
+        if (slots[i].key == UINT64_MAX) {
+            return i;
+        }
+        if (slots[i].last_used + n_frame_lag <= frame && (lru < 0 || slots[i].last_used < slots[lru].last_used)) {
+            lru = i;
+        }
+    }
+    if (lru >= 0) {
+        resident.erase(slots[lru].key);
+        slots[lru].key = UINT64_MAX;
+    }
+    return lru;
+}
+
+size_t Terrain::Stream(JobSystem &jobs, std::vector<TerrainChunk> &chunks, uint64_t frame, uint64_t n_frame_lag,
+        TerrainVertex *slot_vertices) {
+    // mark resident chunks first so they are not evicted for missing ones
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        auto it = resident.find(Key(chunks[i].node));
+        if (it != resident.end()) {
+            chunks[i].slot = it->second;
+            slots[it->second].last_used = frame;
+        } else {
+            missing.push_back(i);
+        }
+    }
+
+    std::vector<size_t> generate;
+    for (size_t i : missing) {
+        int slot = AcquireSlot(frame, n_frame_lag);
+        chunks[i].slot = slot;
+        if (slot < 0) {
+            continue;
+        }
+        slots[slot].key = Key(chunks[i].node);
+        slots[slot].last_used = frame;
+        resident[slots[slot].key] = slot;
+        generate.push_back(i);
+    }
+
+    const size_t n_vertex = VertexCountPerChunk();
+    jobs.ParallelFor(0, generate.size(), [&](size_t i) {
+        const TerrainChunk &chunk = chunks[generate[i]];
+        GenerateChunk(chunk.node, slot_vertices + chunk.slot * n_vertex);
+    });
+    return generate.size();
+}
+
+void Terrain::GenerateChunk(const TerrainNode &node, TerrainVertex *out) const {
+    const int n = desc.chunk_quads;
+    const float size = NodeSize(node.level);
+    const float d = size / n;
+    const float x0 = desc.min_x + node.x * size;
+    const float z1 = desc.min_z + (node.z + 1) * size;
+
+    // heights and normals a row at a time
+    std::vector<float> xs(n + 1), zs(n + 1), hs(n + 1), norms(3 * (n + 1));
+    for (int c = 0; c <= n; c++) {
+        xs[c] = x0 + c * d;
+    }
+    for (int r = 0; r <= n; r++) {
+        const float z = z1 - r * d;
+        std::fill(zs.begin(), zs.end(), z);
+        height(xs.data(), zs.data(), n + 1, hs.data(), norms.data());
+        for (int c = 0; c <= n; c++) {
+            const float x = xs[c];
+            TerrainVertex v;
+            v.pos[0] = x;
+            v.pos[1] = hs[c];
+            v.pos[2] = z;
+            v.norm[0] = norms[3 * c];
+            v.norm[1] = norms[3 * c + 1];
+            v.norm[2] = norms[3 * c + 2];
+            v.texc[0] = x * desc.texc_scale;
+            v.texc[1] = -z * desc.texc_scale;
+            std::memcpy(out + (size_t) r * (n + 1) + c, &v, sizeof(v));
+        }
+    }
+}
+
+TerrainIndices Terrain::BuildIndices() const {
+    const int n = desc.chunk_quads;
+    TerrainIndices res;
+    for (uint32_t mask = 0; mask < kTerrainStitchCount; mask++) {
+        // odd vertices on an edge next to a coarser chunk are moved onto the previous even one,
+        // so the edge matches the coarser one, triangles becoming degenerate are dropped
+        auto vid = [&](int r, int c) {
+            if ((mask & kTerrainNorth) && r == 0 && (c & 1)) {
+                --c;
+            }
+            if ((mask & kTerrainSouth) && r == n && (c & 1)) {
+                --c;
+            }
+            if ((mask & kTerrainWest) && c == 0 && (r & 1)) {
+                --r;
+            }
+            if ((mask & kTerrainEast) && c == n && (r & 1)) {
+                --r;
+            }
+            return static_cast<uint16_t>(r * (n + 1) + c);
+        };
+        // twice the area on the grid is 0 if vertices were merged, or in a corner of two stitched sides where they
+        // end up on a line
+        auto emit = [&](uint16_t a, uint16_t b, uint16_t c) {
+            const int ar = a / (n + 1), ac = a % (n + 1);
+            const int area2 = (b % (n + 1) - ac) * (c / (n + 1) - ar) - (c % (n + 1) - ac) * (b / (n + 1) - ar);
+            if (area2 != 0) {
+                res.indices.push_back(a);
+                res.indices.push_back(b);
+                res.indices.push_back(c);
+            }
+        };
+
+        res.start[mask] = (uint32_t) res.indices.size();
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) {
+                // same triangulation as GeometryGenerator::Grid
+                emit(vid(r, c), vid(r, c + 1), vid(r + 1, c));
+                emit(vid(r, c + 1), vid(r + 1, c + 1), vid(r + 1, c));
+            }
+        }
+        res.count[mask] = (uint32_t) res.indices.size() - res.start[mask];
+    }
+    return res;
+}
\ No newline at end of file
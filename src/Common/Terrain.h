@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Frustum.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+
+// chunked height-field terrain, a quadtree of square chunks with the same vertex count on every level
+// (level 0 are the leaves, the root is level n_level - 1), a node is split while the eye is closer (on xz plane)
+// than lod_range_factor * its size, with factor >= 1.5 selected neighbors differ by at most one level,
+// so an edge next to a coarser chunk only needs every other vertex dropped to be crack-free
+
+// same layout as Vertex of the chapters
+struct TerrainVertex {
+    float pos[3];
+    float norm[3];
+    float texc[2];
+};
+
+struct TerrainDesc {
+    float min_x = -160.0f;
+    float min_z = -160.0f;
+    float size = 320.0f;
+    int n_level = 4;
+    int chunk_quads = 32;          // quads per chunk side, power of two
+    float lod_range_factor = 2.0f;
+    float texc_scale = 1.0f / 32.0f; // texc = xz * scale
+    float bound_margin = 1.0f;     // height bounds are sampled, pad them by this
+};
+
+struct TerrainNode {
+    int level = 0;
+    int x = 0; // index along x on its level
+    int z = 0; // index along z on its level
+};
+
+// stitch mask bits, a bit is set if the neighbor on that side is one level coarser
+enum TerrainSide : uint32_t {
+    kTerrainNorth = 1, // +z, first row of a chunk
+    kTerrainEast = 2,  // +x, last column
+    kTerrainSouth = 4, // -z, last row
+    kTerrainWest = 8,  // -x, first column
+    kTerrainStitchCount = 16
+};
+
+struct TerrainChunk {
+    TerrainNode node;
+    uint32_t stitch = 0;
+    int slot = -1; // where its vertices are, -1 if no slot is available
+};
+
+// index buffer of all 16 stitch variants, vertices are rows from +z to -z, each from -x to +x
+struct TerrainIndices {
+    std::vector<uint16_t> indices;
+    uint32_t start[kTerrainStitchCount];
+    uint32_t count[kTerrainStitchCount];
+};
+
+class Terrain {
+  public:
+    // n_slot chunks can be resident at the same time
+    Terrain(JobSystem &jobs, const TerrainDesc &desc, HeightFieldFn height, int n_slot);
+
+    // chunks to draw for the eye, frustum may be nullptr
+    void Select(const float eye[3], const Frustum *frustum, std::vector<TerrainChunk> &chunks) const;
+    // give every chunk a slot, chunks not resident are generated in parallel into slot_vertices
+    // a slot used in frame f is only reused from frame f + n_frame_lag on (gpu may still read it before)
+    // returns number of chunks generated
+    size_t Stream(JobSystem &jobs, std::vector<TerrainChunk> &chunks, uint64_t frame, uint64_t n_frame_lag,
+        TerrainVertex *slot_vertices);
+
+    TerrainIndices BuildIndices() const;
+    // vertices of one chunk, as Stream() generates them
+    void GenerateChunk(const TerrainNode &node, TerrainVertex *out) const;
+
+    int VertexCountPerChunk() const {
+        return (desc.chunk_quads + 1) * (desc.chunk_quads + 1);
+    }
+    int SlotCount() const {
+        return (int) slots.size();
+    }
+    float NodeSize(int level) const {
+        return desc.size / (1 << (desc.n_level - 1 - level));
+    }
+    // level of the chunk that would be selected at (x, z)
+    int LevelAt(float x, float z, const float eye[3]) const;
+    const TerrainDesc &Desc() const {
+        return desc;
+    }
+
+  private:
+    struct Bound {
+        float min_h;
+        float max_h;
+    };
+    struct Slot {
+        uint64_t key = UINT64_MAX;
+        uint64_t last_used = 0;
+    };
+
+    static uint64_t Key(const TerrainNode &node) {
+        return ((uint64_t) node.level << 48) | ((uint64_t) node.x << 24) | (uint64_t) node.z;
+    }
+    int NodeCount(int level) const {
+        return 1 << (desc.n_level - 1 - level);
+    }
+    bool ShouldSplit(const TerrainNode &node, const float eye[3]) const;
+    void Visit(const TerrainNode &node, const float eye[3], const Frustum *frustum,
+        std::vector<TerrainChunk> &chunks) const;
+    uint32_t StitchMask(const TerrainNode &node, const float eye[3]) const;
+    int AcquireSlot(uint64_t frame, uint64_t n_frame_lag);
+
+    TerrainDesc desc;
+    HeightFieldFn height;
+    // bounds[level][z * NodeCount(level) + x]
+    std::vector<std::vector<Bound>> bounds;
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint64_t, int> resident;
+};
\ No newline at end of file
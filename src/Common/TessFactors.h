@@ -0,0 +1,23 @@
+#pragma once
+
+#include <algorithm>
+
+// factors of the quad domain in the order of SV_TessFactor and SV_InsideTessFactor:
+// edges u = 0, v = 0, u = 1, v = 1, then inside along u and along v
+// also the element of the factor buffer read by the hull shaders of ch14
+struct PatchTessFactors {
+    float edge[4];
+    float inside[2];
+};
+
+// distance rule of ch14_tessellation_basic/shaders/tessellation.hlsl,
+// factor = (max_tess - 1) * saturate((d1 - dist) / (d1 - d0)) + 1
+struct TessDistanceRule {
+    float d0 = 20.0f;
+    float d1 = 100.0f;
+    float max_tess = 64.0f;
+
+    float Factor(float dist) const {
+        return (max_tess - 1.0f) * std::clamp((d1 - dist) / (d1 - d0), 0.0f, 1.0f) + 1.0f;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "Tlsf.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+int LowestBit(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int) index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+int HighestBit(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (int) index;
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
+
+uint64_t AlignUp(uint64_t x, uint64_t align) {
+    return (x + align - 1) & ~(align - 1);
+}
+
+}
+
+void TlsfAllocator::Reset(uint64_t capacity, uint64_t granularity) {
+    assert(granularity > 0 && (granularity & (granularity - 1)) == 0);
+    this->granularity = granularity;
+    n_unit = capacity / granularity;
+    n_used = 0;
+    n_allocation = 0;
+    blocks.clear();
+    unused_blocks.clear();
+    fl_bitmap = 0;
+    std::fill(std::begin(sl_bitmap), std::end(sl_bitmap), 0);
+    for (auto &heads : free_heads) {
+        std::fill(std::begin(heads), std::end(heads), kNull);
+    }
+    if (n_unit > 0) {
+        const uint32_t b = NewBlock();
+        blocks[b].size = n_unit;
+        InsertFree(b);
+    }
+}
+
+void TlsfAllocator::Mapping(uint64_t size, int &fl, int &sl) {
+    // sizes below kSlCount have a list each in the first level
+    const int msb = HighestBit(size);
+    if (msb < kSlLog2) {
+        fl = 0;
+        sl = (int) size;
+    } else {
+        fl = msb - kSlLog2 + 1;
+        sl = (int) ((size >> (msb - kSlLog2)) ^ kSlCount);
+    }
+}
+
+uint32_t TlsfAllocator::NewBlock() {
+    if (!unused_blocks.empty()) {
+        const uint32_t b = unused_blocks.back();
+        unused_blocks.pop_back();
+        blocks[b] = Block {};
+        return b;
+    }
+    assert(blocks.size() < kNull);
+    blocks.emplace_back();
+    return (uint32_t) blocks.size() - 1;
+}
+
+void TlsfAllocator::DeleteBlock(uint32_t b) {
+    // size 0 marks an unused block, so a stale handle is caught by the asserts
+    blocks[b].size = 0;
+    blocks[b].b_free = false;
+    unused_blocks.push_back(b);
+}
+
+void TlsfAllocator::InsertFree(uint32_t b) {
+    Block &block = blocks[b];
+    int fl, sl;
+    Mapping(block.size, fl, sl);
+    block.b_free = true;
+    block.prev_free = kNull;
+    block.next_free = free_heads[fl][sl];
+    if (block.next_free != kNull) {
+        blocks[block.next_free].prev_free = b;
+    }
+    free_heads[fl][sl] = b;
+    fl_bitmap |= uint64_t(1) << fl;
+    sl_bitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t b) {
+    Block &block = blocks[b];
+    int fl, sl;
+    Mapping(block.size, fl, sl);
+    if (block.prev_free != kNull) {
+        blocks[block.prev_free].next_free = block.next_free;
+    } else {
+        free_heads[fl][sl] = block.next_free;
+        if (block.next_free == kNull) {
+            sl_bitmap[fl] &= ~(1u << sl);
+            if (sl_bitmap[fl] == 0) {
+                fl_bitmap &= ~(uint64_t(1) << fl);
+            }
+        }
+    }
+    if (block.next_free != kNull) {
+        blocks[block.next_free].prev_free = block.prev_free;
+    }
+    block.b_free = false;
+    block.prev_free = kNull;
+    block.next_free = kNull;
+}
+
+uint32_t TlsfAllocator::FindFree(uint64_t size) const {
+    // round size up to the next class, every block there is large enough
+    const int msb = HighestBit(size);
+    if (msb >= kSlLog2) {
+        const uint64_t round = (uint64_t(1) << (msb - kSlLog2)) - 1;
+        if (size > UINT64_MAX - round) {
+            return kNull;
+        }
+        size += round;
+    }
+    int fl, sl;
+    Mapping(size, fl, sl);
+    if (fl >= kFlCount) {
+        return kNull;
+    }
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        const uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return kNull;
+        }
+        fl = LowestBit(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    sl = LowestBit(sl_map);
+    return free_heads[fl][sl];
+}
+
+void TlsfAllocator::Split(uint32_t b, uint64_t size) {
+    assert(blocks[b].size > size);
+    const uint32_t rest = NewBlock();
+    // NewBlock() may reallocate blocks
+    Block &block = blocks[b];
+    Block &rest_block = blocks[rest];
+    rest_block.offset = block.offset + size;
+    rest_block.size = block.size - size;
+    rest_block.prev_phys = b;
+    rest_block.next_phys = block.next_phys;
+    if (block.next_phys != kNull) {
+        blocks[block.next_phys].prev_phys = rest;
+    }
+    block.next_phys = rest;
+    block.size = size;
+    InsertFree(rest);
+}
+
+void TlsfAllocator::MergeNext(uint32_t b) {
+    const uint32_t next = blocks[b].next_phys;
+    assert(next != kNull);
+    Block &block = blocks[b];
+    block.size += blocks[next].size;
+    block.next_phys = blocks[next].next_phys;
+    if (block.next_phys != kNull) {
+        blocks[block.next_phys].prev_phys = b;
+    }
+    DeleteBlock(next);
+}
+
+bool TlsfAllocator::Allocate(uint64_t size, uint64_t align, Handle &handle) {
+    assert(align > 0 && (align & (align - 1)) == 0);
+    const uint64_t n = std::max<uint64_t>((size + granularity - 1) / granularity, 1);
+    const uint64_t align_unit = std::max<uint64_t>(align / granularity, 1);
+    // room for the worst padding, so the first block found always fits
+    if (n > n_unit || align_unit - 1 > n_unit - n) {
+        return false;
+    }
+    uint32_t b = FindFree(n + align_unit - 1);
+    if (b == kNull) {
+        return false;
+    }
+    RemoveFree(b);
+
+    const uint64_t pad = AlignUp(blocks[b].offset, align_unit) - blocks[b].offset;
+    if (pad > 0) {
+        // the padding in front stays free, the previous block is in use or it would have been merged with b
+        Split(b, pad);
+        const uint32_t rest = blocks[b].next_phys;
+        RemoveFree(rest);
+        InsertFree(b);
+        b = rest;
+    }
+    if (blocks[b].size > n) {
+        Split(b, n);
+    }
+
+    Block &block = blocks[b];
+    block.align = align_unit;
+    n_used += block.size;
+    ++n_allocation;
+    handle = b;
+    return true;
+}
+
+void TlsfAllocator::Free(Handle handle) {
+    assert(handle < blocks.size() && blocks[handle].size > 0 && !blocks[handle].b_free);
+    uint32_t b = handle;
+    n_used -= blocks[b].size;
+    --n_allocation;
+    const uint32_t next = blocks[b].next_phys;
+    if (next != kNull && blocks[next].b_free) {
+        RemoveFree(next);
+        MergeNext(b);
+    }
+    const uint32_t prev = blocks[b].prev_phys;
+    if (prev != kNull && blocks[prev].b_free) {
+        RemoveFree(prev);
+        MergeNext(prev);
+        b = prev;
+    }
+    InsertFree(b);
+}
+
+uint64_t TlsfAllocator::Offset(Handle handle) const {
+    assert(handle < blocks.size() && blocks[handle].size > 0 && !blocks[handle].b_free);
+    return blocks[handle].offset * granularity;
+}
+
+uint64_t TlsfAllocator::Size(Handle handle) const {
+    assert(handle < blocks.size() && blocks[handle].size > 0 && !blocks[handle].b_free);
+    return blocks[handle].size * granularity;
+}
+
+void TlsfAllocator::Defragment(std::vector<Move> &moves) {
+    std::vector<uint32_t> used;
+    used.reserve(n_allocation);
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].size > 0 && !blocks[b].b_free) {
+            used.push_back(b);
+        } else if (blocks[b].b_free) {
+            RemoveFree(b);
+            DeleteBlock(b);
+        }
+    }
+    std::sort(used.begin(), used.end(), [this](uint32_t a, uint32_t b) {
+        return blocks[a].offset < blocks[b].offset;
+    });
+
+    // used blocks in address order, padding for alignment in between is free
+    uint64_t offset = 0;
+    uint32_t prev = kNull;
+    auto link = [&](uint32_t b) {
+        blocks[b].prev_phys = prev;
+        blocks[b].next_phys = kNull;
+        if (prev != kNull) {
+            blocks[prev].next_phys = b;
+        }
+        prev = b;
+    };
+    auto add_free = [&](uint64_t size) {
+        const uint32_t b = NewBlock();
+        blocks[b].offset = offset;
+        blocks[b].size = size;
+        link(b);
+        InsertFree(b);
+        offset += size;
+    };
+    for (uint32_t b : used) {
+        const uint64_t aligned = AlignUp(offset, blocks[b].align);
+        if (aligned > offset) {
+            add_free(aligned - offset);
+        }
+        moves.push_back({ b, blocks[b].offset * granularity, offset * granularity, blocks[b].size * granularity });
+        blocks[b].offset = offset;
+        link(b);
+        offset += blocks[b].size;
+    }
+    if (offset < n_unit) {
+        add_free(n_unit - offset);
+    }
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats() const {
+    Stats stats;
+    stats.capacity = n_unit * granularity;
+    stats.used = n_used * granularity;
+    stats.n_allocation = n_allocation;
+    for (const Block &block : blocks) {
+        if (block.b_free) {
+            ++stats.n_free_block;
+            stats.largest_free = std::max(stats.largest_free, block.size * granularity);
+        }
+    }
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// two-level segregated fit allocator of ranges [offset, offset + size) in [0, capacity)
+// it only hands out offsets, the memory lives elsewhere (see BufferHeap.h), so it also works for GPU memory
+// free blocks are kept in lists by size class: the first level is the power of two, the second one splits it
+// into kSlCount classes, bitmaps of non-empty lists make both Allocate() and Free() O(1)
+// sizes and offsets are multiples of granularity
+
+class TlsfAllocator {
+  public:
+    // handle of an allocation, stays the same across Defragment()
+    using Handle = uint32_t;
+    static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+    struct Stats {
+        uint64_t capacity = 0;
+        uint64_t used = 0;
+        uint64_t largest_free = 0;
+        uint32_t n_allocation = 0;
+        uint32_t n_free_block = 0;
+
+        // 0 when all free space is one block, close to 1 when it is scattered in small ones
+        float Fragmentation() const {
+            const uint64_t n_free = capacity - used;
+            return n_free == 0 ? 0.0f : 1.0f - (float) largest_free / n_free;
+        }
+    };
+
+    // allocation `handle` goes from src to dst, both are byte offsets
+    struct Move {
+        Handle handle;
+        uint64_t src;
+        uint64_t dst;
+        uint64_t size;
+    };
+
+    explicit TlsfAllocator(uint64_t capacity = 0, uint64_t granularity = 256) {
+        Reset(capacity, granularity);
+    }
+
+    // forget all allocations
+    void Reset(uint64_t capacity, uint64_t granularity = 256);
+
+    // align is a power of two, false if no free block is large enough
+    bool Allocate(uint64_t size, uint64_t align, Handle &handle);
+    void Free(Handle handle);
+
+    uint64_t Offset(Handle handle) const;
+    uint64_t Size(Handle handle) const;
+
+    // pack all allocations to the beginning in address order, a move is appended for each of them,
+    // src == dst for those staying where they are
+    // moves are in address order and dst <= src, a move may overlap its own source (memmove, not memcpy)
+    void Defragment(std::vector<Move> &moves);
+
+    Stats GetStats() const;
+    uint64_t Capacity() const {
+        return n_unit * granularity;
+    }
+
+  private:
+    static constexpr int kSlLog2 = 5;
+    static constexpr uint32_t kSlCount = 1u << kSlLog2;
+    static constexpr int kFlCount = 64 - kSlLog2 + 1;
+    static constexpr uint32_t kNull = UINT32_MAX;
+
+    // sizes and offsets in units of granularity
+    struct Block {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t align = 1;
+        // neighbours in memory
+        uint32_t prev_phys = kNull;
+        uint32_t next_phys = kNull;
+        // neighbours in the free list
+        uint32_t prev_free = kNull;
+        uint32_t next_free = kNull;
+        bool b_free = false;
+    };
+
+    static void Mapping(uint64_t size, int &fl, int &sl);
+    uint32_t NewBlock();
+    void DeleteBlock(uint32_t b);
+    void InsertFree(uint32_t b);
+    void RemoveFree(uint32_t b);
+    // a free block of at least size units, kNull if there is none
+    uint32_t FindFree(uint64_t size) const;
+    // split the first size units off free block b, the rest becomes a new free block
+    void Split(uint32_t b, uint64_t size);
+    // merge b with the next block, which is not in a free list
+    void MergeNext(uint32_t b);
+
+    uint64_t n_unit = 0;
+    uint64_t granularity = 1;
+    uint64_t n_used = 0;
+    uint32_t n_allocation = 0;
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unused_blocks;
+
+    uint64_t fl_bitmap = 0;
+    uint32_t sl_bitmap[kFlCount] = {};
+    uint32_t free_heads[kFlCount][kSlCount];
+};
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cassert>
+
 #include "D3DUtil.h"
 
 template <typename T>
@@ -36,6 +38,11 @@ class UploadBuffer {
     void CopyData(int i_ele, const T &data) {
         memcpy(mapped_data + i_ele * ele_size, &data, sizeof(T));
     }
+    // elements are tightly packed only in non-constant buffers
+    T *Data() {
+        assert(!is_const);
+        return reinterpret_cast<T *>(mapped_data);
+    }
 
   private:
     Microsoft::WRL::ComPtr<ID3D12Resource> upload_buf;
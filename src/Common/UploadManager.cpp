@@ -0,0 +1,40 @@
+#include "UploadManager.h"
+
+#include <utility>
+
+D3DUploadDevice::Buffer D3DUploadDevice::CreateBuffer(uint64_t capacity, uint8_t *&mapped_data) {
+    Buffer buffer;
+    auto upload_heap_prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+    ThrowIfFailed(device->CreateCommittedResource(&upload_heap_prop, D3D12_HEAP_FLAG_NONE, &buffer_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+    ThrowIfFailed(buffer->Map(0, nullptr, reinterpret_cast<void **>(&mapped_data)));
+    return buffer;
+}
+
+void D3DUploadDevice::DestroyBuffer(Buffer &buffer) {
+    buffer->Unmap(0, nullptr);
+    buffer.Reset();
+}
+
+void D3DUploadDevice::BeginCopies(ID3D12GraphicsCommandList *cmd_list, const std::vector<Destination> &dsts) {
+    barriers.clear();
+    for (const Destination &dst : dsts) {
+        if (dst.state != D3D12_RESOURCE_STATE_COPY_DEST) {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(dst.resource,
+                dst.state, D3D12_RESOURCE_STATE_COPY_DEST));
+        }
+    }
+    if (!barriers.empty()) {
+        cmd_list->ResourceBarrier((UINT) barriers.size(), barriers.data());
+    }
+}
+
+void D3DUploadDevice::EndCopies(ID3D12GraphicsCommandList *cmd_list, const std::vector<Destination> &dsts) {
+    for (D3D12_RESOURCE_BARRIER &barrier : barriers) {
+        std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    }
+    if (!barriers.empty()) {
+        cmd_list->ResourceBarrier((UINT) barriers.size(), barriers.data());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "D3DUtil.h"
+#include "UploadQueue.h"
+
+// the d3d implementation of UploadQueue's Device: committed upload buffers, and barriers to COPY_DEST and back for
+// destinations in other states
+class D3DUploadDevice {
+  public:
+    using Buffer = Microsoft::WRL::ComPtr<ID3D12Resource>;
+    using Resource = ID3D12Resource *;
+    using State = D3D12_RESOURCE_STATES;
+    using CommandList = ID3D12GraphicsCommandList;
+    using Destination = UploadDestination<Resource, State>;
+    static constexpr D3D12_RESOURCE_STATES kDefaultState = D3D12_RESOURCE_STATE_GENERIC_READ;
+
+    explicit D3DUploadDevice(ID3D12Device *device) : device(device) {}
+
+    Buffer CreateBuffer(uint64_t capacity, uint8_t *&mapped_data);
+    void DestroyBuffer(Buffer &buffer);
+
+    void BeginCopies(ID3D12GraphicsCommandList *cmd_list, const std::vector<Destination> &dsts);
+    void Copy(ID3D12GraphicsCommandList *cmd_list, ID3D12Resource *dst, uint64_t dst_offset, const Buffer &src,
+            uint64_t src_offset, uint64_t size) {
+        cmd_list->CopyBufferRegion(dst, dst_offset, src.Get(), src_offset, size);
+    }
+    void EndCopies(ID3D12GraphicsCommandList *cmd_list, const std::vector<Destination> &dsts);
+
+  private:
+    ID3D12Device *device;
+    // of the last BeginCopies(), EndCopies() reverses them
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+};
+
+class UploadManager : public UploadQueue<D3DUploadDevice> {
+  public:
+    UploadManager(ID3D12Device *device, UINT64 capacity = 16 * 1024 * 1024)
+        : UploadQueue(D3DUploadDevice(device), capacity) {}
+};
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "StagingRing.h"
+
+// all uploads go through one persistently mapped staging buffer, instead of an upload resource per buffer
+// Upload() only copies data into the ring, Flush() records the copies of all pending uploads, grouped by destination
+// with one transition pair each, and staging space comes back when the fence given to Flush() completes
+// when the ring is full it's replaced by a larger one, the old one lives until its copies are done
+// Device is what touches the api, D3DUploadDevice in UploadManager.h for d3d, or a mock that logs calls, it has
+//   types Buffer, Resource, State & CommandList, and a State kDefaultState
+//   Buffer CreateBuffer(uint64_t capacity, uint8_t *&mapped_data), a staging buffer mapped for good
+//   void DestroyBuffer(Buffer &buffer)
+//   void BeginCopies(CommandList *cmd_list, const std::vector<UploadDestination<Resource, State>> &dsts)
+//   void Copy(CommandList *cmd_list, Resource dst, uint64_t dst_offset, const Buffer &src, uint64_t src_offset,
+//       uint64_t size)
+//   void EndCopies(CommandList *cmd_list, const std::vector<UploadDestination<Resource, State>> &dsts)
+// BeginCopies() makes the destinations copyable and EndCopies() puts them back in their states
+
+// a buffer copies go to, and the state it's in before and after them
+template <typename Resource, typename State>
+struct UploadDestination {
+    Resource resource;
+    State state;
+};
+
+template <typename Device>
+class UploadQueue {
+  public:
+    using Buffer = typename Device::Buffer;
+    using Resource = typename Device::Resource;
+    using State = typename Device::State;
+    using CommandList = typename Device::CommandList;
+    using Destination = UploadDestination<Resource, State>;
+
+    struct Stats {
+        uint64_t capacity = 0;
+        uint64_t peak_used = 0; // summed over rings alive at the same time
+        uint32_t n_upload_resource = 0; // created so far
+        uint32_t n_upload = 0;
+        uint32_t n_copy = 0; // copy commands recorded
+    };
+
+    UploadQueue(Device device, uint64_t capacity) : device(std::move(device)) {
+        CreateRing(capacity);
+    }
+    UploadQueue(const UploadQueue &rhs) = delete;
+    UploadQueue &operator=(const UploadQueue &rhs) = delete;
+    ~UploadQueue() {
+        for (Ring &ring : rings) {
+            device.DestroyBuffer(ring.buffer);
+        }
+    }
+
+    // dst is a buffer in state `state`, it's in that state again after the copy
+    void Upload(Resource dst, uint64_t dst_offset, const void *data, uint64_t size,
+            State state = Device::kDefaultState) {
+        if (size == 0) {
+            return;
+        }
+        uint64_t src_offset;
+        if (!rings.back().ring.Allocate(size, kStagingAlign, src_offset)) {
+            // pending copies still read from the old ring, it's dropped after they are done
+            CreateRing(std::max(2 * rings.back().ring.Capacity(), size));
+            [[maybe_unused]] bool b_allocated = rings.back().ring.Allocate(size, kStagingAlign, src_offset);
+            assert(b_allocated);
+        }
+        std::memcpy(rings.back().mapped_data + src_offset, data, size);
+        pending.push_back({ (uint32_t) rings.size() - 1, DestinationIndex(dst, state), dst_offset, src_offset, size });
+
+        uint64_t n_used = 0;
+        for (const Ring &ring : rings) {
+            n_used += ring.ring.Used();
+        }
+        stats.peak_used = std::max(stats.peak_used, n_used);
+        ++stats.n_upload;
+    }
+
+    // record pending copies to cmd_list, fence is the value signaled after cmd_list is executed
+    void Flush(CommandList *cmd_list, uint64_t fence) {
+        if (pending.empty()) {
+            return;
+        }
+        CoalesceCopies(pending);
+
+        device.BeginCopies(cmd_list, destinations);
+        for (const StagedCopy &copy : pending) {
+            device.Copy(cmd_list, destinations[copy.dst].resource, copy.dst_offset, rings[copy.src].buffer,
+                copy.src_offset, copy.size);
+        }
+        device.EndCopies(cmd_list, destinations);
+        stats.n_copy += (uint32_t) pending.size();
+
+        for (Ring &ring : rings) {
+            ring.ring.EndBatch(fence);
+        }
+        pending.clear();
+        destinations.clear();
+    }
+
+    void Retire(uint64_t completed_fence) {
+        for (Ring &ring : rings) {
+            ring.ring.Retire(completed_fence);
+        }
+        // ring indices of pending copies have to stay valid
+        if (!pending.empty()) {
+            return;
+        }
+        for (size_t i = rings.size() - 1; i-- > 0;) {
+            if (rings[i].ring.Idle()) {
+                device.DestroyBuffer(rings[i].buffer);
+                rings.erase(rings.begin() + i);
+            }
+        }
+    }
+
+    const Stats &GetStats() const {
+        return stats;
+    }
+
+  private:
+    struct Ring {
+        Buffer buffer;
+        uint8_t *mapped_data = nullptr;
+        StagingRing ring;
+    };
+
+    void CreateRing(uint64_t capacity) {
+        Ring ring;
+        ring.buffer = device.CreateBuffer(capacity, ring.mapped_data);
+        ring.ring.Reset(capacity);
+        rings.push_back(std::move(ring));
+
+        stats.capacity = capacity;
+        ++stats.n_upload_resource;
+    }
+    uint32_t DestinationIndex(Resource resource, State state) {
+        for (uint32_t i = 0; i < destinations.size(); i++) {
+            if (destinations[i].resource == resource) {
+                assert(destinations[i].state == state);
+                return i;
+            }
+        }
+        destinations.push_back({ resource, state });
+        return (uint32_t) destinations.size() - 1;
+    }
+
+    // copies of buffers need no alignment, it's just to keep memcpy on aligned words
+    inline static const uint64_t kStagingAlign = 16;
+
+    Device device;
+    // the last one is in use, older ones are dropped once their copies are done
+    std::vector<Ring> rings;
+
+    // copies not flushed yet, src indexes rings and dst destinations
+    std::vector<StagedCopy> pending;
+    std::vector<Destination> destinations;
+
+    Stats stats;
+};
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "WaveInteraction.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+template <WaveKernel kernel>
+inline float Weight(float t2) {
+    if constexpr (kernel == WaveKernel::Cone) {
+        return 1.0f - std::sqrt(t2);
+    } else if constexpr (kernel == WaveKernel::Smooth) {
+        const float a = 1.0f - t2;
+        return a * a;
+    } else {
+        return std::exp(-4.0f * t2);
+    }
+}
+
+// add a disturbance to cells [i0, i1) x [j0, j1)
+template <WaveKernel kernel>
+void Splat(const WaveGrid &grid, const WaveDisturbance &d, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1) {
+    const float inv_r2 = 1.0f / (d.radius * d.radius);
+    for (uint32_t i = i0; i < i1; i++) {
+        const float dz = grid.z0 - i * grid.spacing - d.z;
+        const float dz2 = dz * dz * inv_r2;
+        if (dz2 >= 1.0f) {
+            continue;
+        }
+        float *row = grid.heights + (size_t) i * grid.n_col * grid.stride;
+        for (uint32_t j = j0; j < j1; j++) {
+            const float dx = grid.x0 + j * grid.spacing - d.x;
+            const float t2 = dx * dx * inv_r2 + dz2;
+            if (t2 < 1.0f) {
+                row[(size_t) j * grid.stride] += d.magnitude * Weight<kernel>(t2);
+            }
+        }
+    }
+}
+
+void SplatClipped(const WaveGrid &grid, const WaveDisturbance &d, uint32_t i0, uint32_t i1, uint32_t j0,
+    uint32_t j1) {
+    switch (d.kernel) {
+        case WaveKernel::Cone:
+            Splat<WaveKernel::Cone>(grid, d, i0, i1, j0, j1);
+            break;
+        case WaveKernel::Smooth:
+            Splat<WaveKernel::Smooth>(grid, d, i0, i1, j0, j1);
+            break;
+        default:
+            Splat<WaveKernel::Gaussian>(grid, d, i0, i1, j0, j1);
+            break;
+    }
+}
+
+// [lo, hi) of the cells within radius of center along one axis, index = (center - origin) / step
+void CellRange(float center, float radius, float origin, float step, uint32_t lo, uint32_t hi, uint32_t &begin,
+    uint32_t &end) {
+    const float first = std::ceil((center - radius - origin) / step);
+    const float last = std::floor((center + radius - origin) / step) + 1.0f;
+    begin = (uint32_t) std::clamp(first, (float) lo, (float) hi);
+    end = (uint32_t) std::clamp(last, (float) lo, (float) hi);
+}
+
+}
+
+void WaveInteraction::Disturb(JobSystem &jobs, const WaveGrid &grid, const WaveDisturbance *disturbances, size_t n) {
+    if (grid.n_row <= 2 * grid.border || grid.n_col <= 2 * grid.border) {
+        return;
+    }
+    const uint32_t n_tile_x = (grid.n_col + kWaveTileSize - 1) / kWaveTileSize;
+    const uint32_t n_tile_y = (grid.n_row + kWaveTileSize - 1) / kWaveTileSize;
+    const uint32_t n_tile = n_tile_x * n_tile_y;
+
+    // rows go to -z, so they are indexed by -z from -z0
+    footprints.resize(n);
+    jobs.ParallelForRange(0, n, [this, &grid, disturbances](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            const WaveDisturbance &d = disturbances[k];
+            Footprint &fp = footprints[k];
+            CellRange(-d.z, d.radius, -grid.z0, grid.spacing, grid.border, grid.n_row - grid.border, fp.i0, fp.i1);
+            CellRange(d.x, d.radius, grid.x0, grid.spacing, grid.border, grid.n_col - grid.border, fp.j0, fp.j1);
+        }
+    }, 1024);
+
+    // counting sort of (tile, disturbance) pairs, disturbances stay in order within a tile
+    first_binned.assign(n_tile + 1, 0);
+    for (const Footprint &fp : footprints) {
+        if (fp.i0 >= fp.i1 || fp.j0 >= fp.j1) {
+            continue;
+        }
+        for (uint32_t ty = fp.i0 / kWaveTileSize; ty <= (fp.i1 - 1) / kWaveTileSize; ty++) {
+            for (uint32_t tx = fp.j0 / kWaveTileSize; tx <= (fp.j1 - 1) / kWaveTileSize; tx++) {
+                first_binned[ty * n_tile_x + tx]++;
+            }
+        }
+    }
+    uint32_t total = 0;
+    for (uint32_t t = 0; t < n_tile; t++) {
+        const uint32_t count = first_binned[t];
+        first_binned[t] = total;
+        total += count;
+    }
+    first_binned[n_tile] = total;
+    binned.resize(total);
+    for (size_t k = 0; k < n; k++) {
+        const Footprint &fp = footprints[k];
+        if (fp.i0 >= fp.i1 || fp.j0 >= fp.j1) {
+            continue;
+        }
+        for (uint32_t ty = fp.i0 / kWaveTileSize; ty <= (fp.i1 - 1) / kWaveTileSize; ty++) {
+            for (uint32_t tx = fp.j0 / kWaveTileSize; tx <= (fp.j1 - 1) / kWaveTileSize; tx++) {
+                binned[first_binned[ty * n_tile_x + tx]++] = (uint32_t) k;
+            }
+        }
+    }
+    // every entry has moved to the start of the next tile
+    for (uint32_t t = n_tile - 1; t > 0; t--) {
+        first_binned[t] = first_binned[t - 1];
+    }
+    first_binned[0] = 0;
+
+    jobs.ParallelFor(0, n_tile, [this, &grid, disturbances, n_tile_x](size_t tile) {
+        const uint32_t ti0 = (uint32_t) tile / n_tile_x * kWaveTileSize;
+        const uint32_t tj0 = (uint32_t) tile % n_tile_x * kWaveTileSize;
+        for (uint32_t b = first_binned[tile]; b < first_binned[tile + 1]; b++) {
+            const Footprint &fp = footprints[binned[b]];
+            SplatClipped(grid, disturbances[binned[b]], std::max(fp.i0, ti0), std::min(fp.i1, ti0 + kWaveTileSize),
+                std::max(fp.j0, tj0), std::min(fp.j1, tj0 + kWaveTileSize));
+        }
+    });
+}
+
+void WaveInteraction::Sample(JobSystem &jobs, const ConstWaveGrid &grid, const float *x, const float *z, size_t n,
+    float *heights, float *normals) const {
+    assert(grid.n_row >= 2 && grid.n_col >= 2);
+    jobs.ParallelForRange(0, n, [&grid, x, z, heights, normals](size_t begin, size_t end) {
+        const float inv_spacing = 1.0f / grid.spacing;
+        const size_t row_stride = (size_t) grid.n_col * grid.stride;
+        for (size_t p = begin; p < end; p++) {
+            const float u = std::clamp((x[p] - grid.x0) * inv_spacing, 0.0f, (float) (grid.n_col - 1));
+            const float v = std::clamp((grid.z0 - z[p]) * inv_spacing, 0.0f, (float) (grid.n_row - 1));
+            const uint32_t j = std::min((uint32_t) u, grid.n_col - 2);
+            const uint32_t i = std::min((uint32_t) v, grid.n_row - 2);
+            const float fu = u - j, fv = v - i;
+            const size_t c00 = i * row_stride + (size_t) j * grid.stride;
+            const size_t c01 = c00 + grid.stride, c10 = c00 + row_stride, c11 = c10 + grid.stride;
+
+            const float h00 = grid.heights[c00], h01 = grid.heights[c01];
+            const float h10 = grid.heights[c10], h11 = grid.heights[c11];
+            const float h0 = h00 + (h01 - h00) * fu;
+            const float h1 = h10 + (h11 - h10) * fu;
+            heights[p] = h0 + (h1 - h0) * fv;
+            if (normals == nullptr) {
+                continue;
+            }
+
+            float nx, ny, nz;
+            if (grid.normals != nullptr) {
+                const float w00 = (1.0f - fu) * (1.0f - fv), w01 = fu * (1.0f - fv);
+                const float w10 = (1.0f - fu) * fv, w11 = fu * fv;
+                const float *n00 = grid.normals + c00, *n01 = grid.normals + c01;
+                const float *n10 = grid.normals + c10, *n11 = grid.normals + c11;
+                nx = w00 * n00[0] + w01 * n01[0] + w10 * n10[0] + w11 * n11[0];
+                ny = w00 * n00[1] + w01 * n01[1] + w10 * n10[1] + w11 * n11[1];
+                nz = w00 * n00[2] + w01 * n01[2] + w10 * n10[2] + w11 * n11[2];
+            } else {
+                // gradient of the bilinear patch, rows go to -z
+                nx = -((h01 - h00) * (1.0f - fv) + (h11 - h10) * fv) * inv_spacing;
+                ny = 1.0f;
+                nz = (h1 - h0) * inv_spacing;
+            }
+            const float len_inv = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+            normals[3 * p] = nx * len_inv;
+            normals[3 * p + 1] = ny * len_inv;
+            normals[3 * p + 2] = nz * len_inv;
+        }
+    }, 1024);
+}
\ No newline at end of file
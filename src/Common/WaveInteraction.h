@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "JobSystem.h"
+
+// batched interaction with a height field laid out as Wave's grid: disturbances (boats, rain, characters) are splatted
+// with radial kernels and heights & normals are sampled at world positions (buoyancy)
+// disturbances are binned to kWaveTileSize^2 cell tiles and every tile is splatted by one job, so a tile stays in cache
+// while all disturbances touching it are added, in the order they were given
+
+const uint32_t kWaveTileSize = 32;
+
+// row i is at z = z0 - i * spacing and column j at x = x0 + j * spacing,
+// the height of cell (i, j) is heights[(i * n_col + j) * stride], e.g. &XMFLOAT3::y of Wave's solution with stride 3
+// Height is float for a grid Disturb() writes (WaveGrid) and const float for one that is only read (ConstWaveGrid)
+template <typename Height>
+struct BasicWaveGrid {
+    Height *heights = nullptr;
+    const float *normals = nullptr; // x, y & z from normals[(i * n_col + j) * stride] on, or null
+    uint32_t stride = 1; // in floats
+    uint32_t n_row = 0;
+    uint32_t n_col = 0;
+    float x0 = 0.0f;
+    float z0 = 0.0f;
+    float spacing = 1.0f;
+    uint32_t border = 0; // cells this close to the edges are never disturbed (Wave keeps its boundary at rest)
+
+    BasicWaveGrid() = default;
+    // a grid of writable heights is also one of readable heights
+    template <typename Rhs, typename = std::enable_if_t<std::is_convertible_v<Rhs *, Height *>>>
+    BasicWaveGrid(const BasicWaveGrid<Rhs> &rhs) : heights(rhs.heights), normals(rhs.normals), stride(rhs.stride),
+        n_row(rhs.n_row), n_col(rhs.n_col), x0(rhs.x0), z0(rhs.z0), spacing(rhs.spacing), border(rhs.border) {}
+};
+using WaveGrid = BasicWaveGrid<float>;
+using ConstWaveGrid = BasicWaveGrid<const float>;
+
+// weight of a cell at distance r from the center, t = r / radius, 0 from t = 1 on
+enum class WaveKernel : uint32_t {
+    Cone, // 1 - t
+    Smooth, // (1 - t^2)^2
+    Gaussian // e^(-4 t^2)
+};
+
+struct WaveDisturbance {
+    float x = 0.0f;
+    float z = 0.0f;
+    float radius = 1.0f;
+    float magnitude = 0.0f; // height added at the center
+    WaveKernel kernel = WaveKernel::Smooth;
+};
+
+class WaveInteraction {
+  public:
+    // add disturbances[0, n) to the heights, footprints are clamped to the grid inside its border,
+    // every cell sums the disturbances in the given order, so results don't depend on the thread count
+    void Disturb(JobSystem &jobs, const WaveGrid &grid, const WaveDisturbance *disturbances, size_t n);
+
+    // bilinear height at (x[i], z[i]) and unit normal (3 floats per point, may be null), positions off the grid
+    // are clamped to its edges; normals are interpolated from grid.normals, or from the height gradient without them
+    void Sample(JobSystem &jobs, const ConstWaveGrid &grid, const float *x, const float *z, size_t n, float *heights,
+        float *normals) const;
+
+  private:
+    // cells [i0, i1) x [j0, j1) that a disturbance touches
+    struct Footprint {
+        uint32_t i0, i1, j0, j1;
+    };
+
+    std::vector<Footprint> footprints;
+    std::vector<uint32_t> first_binned; // of each tile, and the total count at the end
+    std::vector<uint32_t> binned;
+};
\ No newline at end of file
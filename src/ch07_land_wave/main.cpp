@@ -7,6 +7,7 @@
 #include "D3DApp.h"
 #include "D3DUtil.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
 #include "FrameResource.h"
 #include "Wave.h"
 
@@ -297,12 +298,12 @@ class D3DAppLandWave : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
 
             if (vertices[i].pos.y < -10.0f) {
                 vertices[i].color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
@@ -479,21 +480,6 @@ class D3DAppLandWave : public D3DApp {
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
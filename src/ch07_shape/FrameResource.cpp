@@ -6,6 +6,7 @@ FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj) {
 
     p_pass_cb = std::make_unique<UploadBuffer<PassConst>>(device, n_pass, true);
     p_obj_cb = std::make_unique<UploadBuffer<ObjectConst>>(device, n_obj, true);
+    p_instance_buffer = std::make_unique<UploadBuffer<ObjectConst>>(device, n_obj, false);
 }
 
 FrameResource::~FrameResource() {}
\ No newline at end of file
@@ -42,5 +42,7 @@ struct FrameResource {
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> p_cmd_alloc;
     std::unique_ptr<UploadBuffer<ObjectConst>> p_obj_cb = nullptr;
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
+    // ObjectConst of instanced draws, tightly packed for a structured buffer
+    std::unique_ptr<UploadBuffer<ObjectConst>> p_instance_buffer = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
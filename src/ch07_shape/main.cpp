@@ -7,6 +7,7 @@
 #include "D3DApp.h"
 #include "D3DUtil.h"
 #include "GeometryGenerator.h"
+#include "InstanceBatcher.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -19,6 +20,8 @@ struct RenderItem {
     int n_frame_dirty = n_frame_resource;
     UINT obj_cb_ind = -1;
     MeshGeometry *geo = nullptr;
+    uint16_t geo_id = 0; // index of geo in geo_ids
+    uint16_t submesh_id = 0; // items of the same geo & submesh are drawn as instances of one draw
     D3D12_PRIMITIVE_TOPOLOGY prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
     UINT n_index = 0;
     UINT start_index = 0;
@@ -86,16 +89,19 @@ class D3DAppShape : public D3DApp {
 
         UpdateObjCont(timer);
         UpdatePassConst(timer);
+        if (instancing) {
+            UpdateInstances(timer);
+        }
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
         auto cmd_alloc = curr_fr->p_cmd_alloc;
         ThrowIfFailed(cmd_alloc->Reset());
+        std::string pso_name = instancing ? "opaque_inst" : "opaque";
         if (wire_frame) {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque_wf"].Get()));
-        } else {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque"].Get()));
+            pso_name += "_wf";
         }
+        ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos[pso_name].Get()));
 
         // viewport and scissor
         p_cmd_list->RSSetViewports(1, &viewport);
@@ -126,7 +132,11 @@ class D3DAppShape : public D3DApp {
         p_cmd_list->SetGraphicsRootDescriptorTable(1, h_pass_cbv);
 
         // draw items
-        DrawRenderItems(p_cmd_list.Get(), opaque_items);
+        if (instancing) {
+            DrawBatches(p_cmd_list.Get(), opaque_items);
+        } else {
+            DrawRenderItems(p_cmd_list.Get(), opaque_items);
+        }
 
         // back buffer: render target -> present
         transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
@@ -177,6 +187,9 @@ class D3DAppShape : public D3DApp {
         if (GetAsyncKeyState('1') & 0x8000) {
             wire_frame = !wire_frame;
         }
+        if (GetAsyncKeyState('2') & 0x8000) {
+            instancing = !instancing;
+        }
     }
     void UpdateCamera(const Timer &timer) {
         float x = radius * std::sin(phi) * std::cos(theta);
@@ -235,6 +248,20 @@ class D3DAppShape : public D3DApp {
         auto curr_pass_cb = curr_fr->p_pass_cb.get();
         curr_pass_cb->CopyData(0, main_pass_cb);
     }
+    void UpdateInstances(const Timer &timer) {
+        // the chapter has no materials and the pso is picked per pass in Draw(), so geo & submesh decide a batch
+        batch_keys.resize(opaque_items.size());
+        for (size_t i = 0; i < opaque_items.size(); i++) {
+            batch_keys[i] = InstanceBatcher::MakeKey(opaque_items[i]->geo_id, opaque_items[i]->submesh_id, 0, 0);
+        }
+        batcher.Build(jobs, batch_keys.data(), (uint32_t) batch_keys.size());
+
+        // instances are repacked every frame since batches change with the visible items
+        ObjectConst *instances = curr_fr->p_instance_buffer->Data();
+        batcher.Pack(jobs, [this, instances](uint32_t instance, uint32_t item) {
+            instances[instance].model = opaque_items[item]->model;
+        });
+    }
 
     void BuildDescriporHeaps() {
         UINT n_obj = opaque_items.size();
@@ -293,11 +320,14 @@ class D3DAppShape : public D3DApp {
         cbv_table1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
         // use update frequency to group data in cbuufer
 
-        CD3DX12_ROOT_PARAMETER rt_params[2];
+        CD3DX12_ROOT_PARAMETER rt_params[4];
         rt_params[0].InitAsDescriptorTable(1, &cbv_table0);
         rt_params[1].InitAsDescriptorTable(1, &cbv_table1);
+        // instanced draws - instance buffer at t0 and offset of the batch at b2
+        rt_params[2].InitAsShaderResourceView(0);
+        rt_params[3].InitAsConstants(1, 2);
 
-        CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(2, rt_params, 0, nullptr,
+        CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(4, rt_params, 0, nullptr,
             D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
         ComPtr<ID3DBlob> serialized_rt_sig = nullptr;
@@ -313,9 +343,17 @@ class D3DAppShape : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildShaderAndInputLayout() {
+        // defines
+        const D3D_SHADER_MACRO instanced_defines[] = {
+            "INSTANCED", "1",
+            nullptr, nullptr
+        };
+
         // build shader from hlsl file
         shaders["standard_vs"] = D3DUtil::CompileShader(src_path + L"ch07_shape/shaders/shape.hlsl",
             nullptr, "VS", "vs_5_1");
+        shaders["instanced_vs"] = D3DUtil::CompileShader(src_path + L"ch07_shape/shaders/shape.hlsl",
+            instanced_defines, "VS", "vs_5_1");
         shaders["opaque_ps"] = D3DUtil::CompileShader(src_path + L"ch07_shape/shaders/shape.hlsl",
             nullptr, "PS", "ps_5_1");
 
@@ -438,6 +476,8 @@ class D3DAppShape : public D3DApp {
         geo->draw_args["cylinder"] = cylinder_submesh;
         geo->draw_args["geosphere"] = geosphere_submesh;
 
+        uint16_t geo_id = (uint16_t) geo_ids.size();
+        geo_ids[geo->name] = geo_id;
         geometries[geo->name] = std::move(geo);
     }
     void BuildPSOs() {
@@ -468,6 +508,19 @@ class D3DAppShape : public D3DApp {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC opaque_wf_pso_desc = opaque_pso_desc;
         opaque_wf_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME; // wire frame mode
         ThrowIfFailed(p_device->CreateGraphicsPipelineState(&opaque_wf_pso_desc, IID_PPV_ARGS(&psos["opaque_wf"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC opaque_inst_pso_desc = opaque_pso_desc;
+        opaque_inst_pso_desc.VS = {
+            reinterpret_cast<BYTE *>(shaders["instanced_vs"]->GetBufferPointer()),
+            shaders["instanced_vs"]->GetBufferSize()
+        };
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&opaque_inst_pso_desc,
+            IID_PPV_ARGS(&psos["opaque_inst"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC opaque_inst_wf_pso_desc = opaque_inst_pso_desc;
+        opaque_inst_wf_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&opaque_inst_wf_pso_desc,
+            IID_PPV_ARGS(&psos["opaque_inst_wf"])));
     }
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
@@ -487,6 +540,8 @@ class D3DAppShape : public D3DApp {
         box_item->n_index = box_item->geo->draw_args["box"].n_index;
         box_item->start_index = box_item->geo->draw_args["box"].start_index;
         box_item->base_vertex = box_item->geo->draw_args["box"].base_vertex;
+        box_item->geo_id = geo_ids["shape_geo"];
+        box_item->submesh_id = 0;
         items.emplace_back(std::move(box_item));
 
         auto grid_item = std::make_unique<RenderItem>();
@@ -497,6 +552,8 @@ class D3DAppShape : public D3DApp {
         grid_item->n_index = grid_item->geo->draw_args["grid"].n_index;
         grid_item->start_index = grid_item->geo->draw_args["grid"].start_index;
         grid_item->base_vertex = grid_item->geo->draw_args["grid"].base_vertex;
+        grid_item->geo_id = geo_ids["shape_geo"];
+        grid_item->submesh_id = 1;
         items.emplace_back(std::move(grid_item));
 
         for (int i = 0; i < 5; i++) {
@@ -518,6 +575,8 @@ class D3DAppShape : public D3DApp {
             left_cylinder_item->n_index = left_cylinder_item->geo->draw_args["cylinder"].n_index;
             left_cylinder_item->start_index = left_cylinder_item->geo->draw_args["cylinder"].start_index;
             left_cylinder_item->base_vertex = left_cylinder_item->geo->draw_args["cylinder"].base_vertex;
+            left_cylinder_item->geo_id = geo_ids["shape_geo"];
+            left_cylinder_item->submesh_id = 3;
 
             XMStoreFloat4x4(&right_cylinder_item->model, left_cylinder_model);
             right_cylinder_item->obj_cb_ind = obj_cb_ind++;
@@ -526,6 +585,8 @@ class D3DAppShape : public D3DApp {
             right_cylinder_item->n_index = right_cylinder_item->geo->draw_args["cylinder"].n_index;
             right_cylinder_item->start_index = right_cylinder_item->geo->draw_args["cylinder"].start_index;
             right_cylinder_item->base_vertex = right_cylinder_item->geo->draw_args["cylinder"].base_vertex;
+            right_cylinder_item->geo_id = geo_ids["shape_geo"];
+            right_cylinder_item->submesh_id = 3;
 
             XMStoreFloat4x4(&left_sphere_item->model, left_sphere_model);
             left_sphere_item->obj_cb_ind = obj_cb_ind++;
@@ -534,6 +595,8 @@ class D3DAppShape : public D3DApp {
             left_sphere_item->n_index = left_sphere_item->geo->draw_args["sphere"].n_index;
             left_sphere_item->start_index = left_sphere_item->geo->draw_args["sphere"].start_index;
             left_sphere_item->base_vertex = left_sphere_item->geo->draw_args["sphere"].base_vertex;
+            left_sphere_item->geo_id = geo_ids["shape_geo"];
+            left_sphere_item->submesh_id = 2;
 
             XMStoreFloat4x4(&right_sphere_item->model, right_sphere_model);
             right_sphere_item->obj_cb_ind = obj_cb_ind++;
@@ -542,6 +605,8 @@ class D3DAppShape : public D3DApp {
             right_sphere_item->n_index = right_sphere_item->geo->draw_args["geosphere"].n_index;
             right_sphere_item->start_index = right_sphere_item->geo->draw_args["geosphere"].start_index;
             right_sphere_item->base_vertex = right_sphere_item->geo->draw_args["geosphere"].base_vertex;
+            right_sphere_item->geo_id = geo_ids["shape_geo"];
+            right_sphere_item->submesh_id = 4;
 
             items.emplace_back(std::move(left_cylinder_item));
             items.emplace_back(std::move(right_cylinder_item));
@@ -575,6 +640,21 @@ class D3DAppShape : public D3DApp {
             cmd_list->DrawIndexedInstanced(item->n_index, 1, item->start_index, item->base_vertex, 0);
         }
     }
+    void DrawBatches(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
+        cmd_list->SetGraphicsRootShaderResourceView(2,
+            curr_fr->p_instance_buffer->Resource()->GetGPUVirtualAddress());
+        for (const auto &batch : batcher.Batches()) { // per batch
+            auto item = items[batch.item];
+            auto vbv = item->geo->VertexBufferView();
+            auto ibv = item->geo->IndexBufferView();
+            cmd_list->IASetVertexBuffers(0, 1, &vbv);
+            cmd_list->IASetIndexBuffer(&ibv);
+            cmd_list->IASetPrimitiveTopology(item->prim_ty);
+
+            cmd_list->SetGraphicsRoot32BitConstant(3, batch.first_instance, 0);
+            cmd_list->DrawIndexedInstanced(item->n_index, batch.n_instance, item->start_index, item->base_vertex, 0);
+        }
+    }
     
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
@@ -584,6 +664,7 @@ class D3DAppShape : public D3DApp {
     ComPtr<ID3D12DescriptorHeap> p_cbv_heap = nullptr;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
+    std::unordered_map<std::string, uint16_t> geo_ids; // index of each geometry, the first field of batch keys
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
@@ -597,6 +678,11 @@ class D3DAppShape : public D3DApp {
 
     bool wire_frame = false;
 
+    bool instancing = true;
+    JobSystem jobs;
+    InstanceBatcher batcher;
+    std::vector<uint64_t> batch_keys;
+
     XMFLOAT3 eye = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 view = DXMath::Identity4x4();
     XMFLOAT4X4 proj = DXMath::Identity4x4();
@@ -1,6 +1,17 @@
+#ifdef INSTANCED
+struct InstanceData {
+    float4x4 model;
+};
+StructuredBuffer<InstanceData> instances : register(t0);
+
+cbuffer instance_cb : register(b2) {
+    uint first_instance;
+};
+#else
 cbuffer obj_cb : register(b0) {
     float4x4 model;
 };
+#endif
 
 cbuffer pass_cb : register(b1) {
     float4x4 view;
@@ -22,7 +33,11 @@ struct VertexOut {
     float4 color : COLOR;
 };
 
-VertexOut VS(VertexIn vin) {
+VertexOut VS(VertexIn vin, uint instance_id : SV_InstanceID) {
+#ifdef INSTANCED
+    // SV_InstanceID doesn't count StartInstanceLocation, so the offset of the batch is passed as a constant
+    float4x4 model = instances[first_instance + instance_id].model;
+#endif
     VertexOut vout;
     // vout.pos = mul(float4(vin.pos, 1.0f), model);
     // vout.pos = mul(vout.pos, vp);
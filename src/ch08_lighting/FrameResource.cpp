@@ -1,6 +1,7 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex) {
+FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex,
+        UINT n_light, UINT n_cluster, UINT n_cluster_index) {
     ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
         IID_PPV_ARGS(&p_cmd_alloc)));
 
@@ -9,6 +10,10 @@ FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT
     p_mat_cb = std::make_unique<UploadBuffer<MaterialConst>>(device, n_mat, true);
 
     p_wave_vb = std::make_unique<UploadBuffer<Vertex>>(device, n_wave_vertex, false);
+
+    p_cluster_lights = std::make_unique<UploadBuffer<ClusterLight>>(device, n_light, false);
+    p_cluster_ranges = std::make_unique<UploadBuffer<ClusterRange>>(device, n_cluster, false);
+    p_cluster_indices = std::make_unique<UploadBuffer<uint32_t>>(device, n_cluster_index, false);
 }
 
 FrameResource::~FrameResource() {}
\ No newline at end of file
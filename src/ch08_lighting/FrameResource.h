@@ -4,6 +4,7 @@
 
 #include "D3DUtil.h"
 #include "DXMath.h"
+#include "LightCluster.h"
 #include "UploadBuffer.h"
 
 // data in cbuffer per object
@@ -32,13 +33,24 @@ struct PassConst {
     Light lights[MAX_N_LIGHT];
 };
 
+// data in root constants of the clustered lights
+struct ClusterConst {
+    UINT n_x = 0;
+    UINT n_y = 0;
+    UINT n_z = 0;
+    UINT n_point = 0; // lights before are point lights, lights after spot lights
+    float slice_scale = 0.0f;
+    float slice_bias = 0.0f;
+};
+
 struct Vertex {
     DirectX::XMFLOAT3 pos;
     DirectX::XMFLOAT3 norm;
 };
 
 struct FrameResource {
-    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex);
+    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex, UINT n_light,
+        UINT n_cluster, UINT n_cluster_index);
     FrameResource(const FrameResource &rhs) = delete;
     FrameResource &operator=(const FrameResource &rhs) = delete;
     ~FrameResource();
@@ -48,5 +60,9 @@ struct FrameResource {
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_cb = nullptr;
     std::unique_ptr<UploadBuffer<Vertex>> p_wave_vb = nullptr;
+    // point & spot lights and their assignment to clusters in this frame
+    std::unique_ptr<UploadBuffer<ClusterLight>> p_cluster_lights = nullptr;
+    std::unique_ptr<UploadBuffer<ClusterRange>> p_cluster_ranges = nullptr;
+    std::unique_ptr<UploadBuffer<uint32_t>> p_cluster_indices = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
@@ -4,6 +4,26 @@
 
 using namespace DirectX;
 
+namespace {
+
+// a solution as a grid centered at the origin, Grid is WaveGrid or ConstWaveGrid as the solution is writable or not
+template <typename Grid, typename Solution>
+Grid SolutionGrid(Solution &solution, const std::vector<XMFLOAT3> &normals, int n_row, int n_col, float dx) {
+    Grid grid;
+    grid.heights = &solution[0].y;
+    grid.normals = &normals[0].x;
+    grid.stride = sizeof(XMFLOAT3) / sizeof(float);
+    grid.n_row = n_row;
+    grid.n_col = n_col;
+    grid.x0 = -(n_col - 1) * dx * 0.5f;
+    grid.z0 = (n_row - 1) * dx * 0.5f;
+    grid.spacing = dx;
+    grid.border = 1;
+    return grid;
+}
+
+}
+
 Wave::Wave(int m, int n, float dx, float dt, float speed, float damping) {
     n_row = m;
     n_col = n;
@@ -103,15 +123,34 @@ void Wave::Update(float dt) {
 
 void Wave::Disturb(int i, int j, float magnitude) {
     // Don't disturb boundaries.
-    assert(i > 1 && i < n_row - 2);
-    assert(j > 1 && j < n_col - 2);
+    auto add = [this](int i, int j, float h) {
+        if (i > 0 && i < n_row - 1 && j > 0 && j < n_col - 1) {
+            curr_solution[i * n_col + j].y += h;
+        }
+    };
 
     float hm = 0.5f*magnitude;
 
     // Disturb the ijth vertex height and its neighbors.
-    curr_solution[i * n_col + j].y += magnitude;
-    curr_solution[i * n_col + j + 1].y += hm;
-    curr_solution[i * n_col + j - 1].y += hm;
-    curr_solution[(i + 1) * n_col + j].y += hm;
-    curr_solution[(i - 1) * n_col + j].y += hm;
+    add(i, j, magnitude);
+    add(i, j + 1, hm);
+    add(i, j - 1, hm);
+    add(i + 1, j, hm);
+    add(i - 1, j, hm);
+}
+
+void Wave::Disturb(JobSystem &jobs, const WaveDisturbance *disturbances, size_t n) {
+    interaction.Disturb(jobs, Grid(), disturbances, n);
+}
+
+void Wave::Sample(JobSystem &jobs, const float *x, const float *z, size_t n, float *heights, float *normals) const {
+    interaction.Sample(jobs, Grid(), x, z, n, heights, normals);
+}
+
+WaveGrid Wave::Grid() {
+    return SolutionGrid<WaveGrid>(curr_solution, normals, n_row, n_col, spatial_step);
+}
+
+ConstWaveGrid Wave::Grid() const {
+    return SolutionGrid<ConstWaveGrid>(curr_solution, normals, n_row, n_col, spatial_step);
 }
\ No newline at end of file
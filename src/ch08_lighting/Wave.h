@@ -4,6 +4,9 @@
 
 #include <DirectXMath.h>
 
+#include "JobSystem.h"
+#include "WaveInteraction.h"
+
 class Wave {
   public:
     Wave(int m, int n, float dx, float dt, float speed, float damping);
@@ -40,7 +43,15 @@ class Wave {
     }
 
     void Update(float dt);
+    // parts of a disturbance on the boundary or beyond are dropped, the boundary stays at rest
     void Disturb(int i, int j, float magnitude);
+    // batched, see WaveInteraction
+    void Disturb(JobSystem &jobs, const WaveDisturbance *disturbances, size_t n);
+    void Sample(JobSystem &jobs, const float *x, const float *z, size_t n, float *heights, float *normals) const;
+
+    // the current solution, valid until the next Update()
+    WaveGrid Grid();
+    ConstWaveGrid Grid() const;
 
   private:
     int n_row = 0;
@@ -59,4 +70,6 @@ class Wave {
     std::vector<DirectX::XMFLOAT3> curr_solution;
     std::vector<DirectX::XMFLOAT3> normals;
     std::vector<DirectX::XMFLOAT3> tangents;
+
+    WaveInteraction interaction;
 };
\ No newline at end of file
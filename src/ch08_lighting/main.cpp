@@ -7,6 +7,11 @@
 #include "D3DApp.h"
 #include "D3DUtil.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+#include "LightCluster.h"
+#include "Ocean.h"
+#include "Random.h"
 #include "FrameResource.h"
 #include "Wave.h"
 
@@ -14,6 +19,11 @@ using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
 const int n_frame_resource = 3;
+// lights scattered on the land, far more than MAX_N_LIGHT, they are assigned to clusters every frame
+const int kNumPointLights = 1024;
+const int kNumSpotLights = 256;
+// drops hitting the wave when it rains
+const float kRainDropsPerSecond = 2000.0f;
 
 struct RenderItem {
     XMFLOAT4X4 model = DXMath::Identity4x4();
@@ -33,6 +43,7 @@ enum class RenderLayor : size_t {
 };
 
 // always remember that constant buffer is 128-bit aligned
+// the sun is in the pass cbuffer, point & spot lights are shaded per cluster (LightCluster)
 
 class D3DAppLighting : public D3DApp {
   public:
@@ -49,6 +60,11 @@ class D3DAppLighting : public D3DApp {
         }
 
         p_wave = std::make_unique<Wave>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+        // same grid size as the wave, so both share the index buffer
+        OceanSettings ocean_settings;
+        ocean_settings.n = 128;
+        ocean_settings.length = 128.0f;
+        p_ocean = std::make_unique<Ocean>(jobs, ocean_settings);
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
@@ -57,6 +73,7 @@ class D3DAppLighting : public D3DApp {
         BuildLandGeometry();
         BuildWaveGeometryBuffers();
         BuildMaterials();
+        BuildLights();
         BuildRenderItems();
         BuildFrameResources();
         BuildPSOs();
@@ -74,6 +91,12 @@ class D3DAppLighting : public D3DApp {
         D3DApp::OnResize();
         XMMATRIX _proj = XMMatrixPerspectiveFovRH(XM_PIDIV4, Aspect(), 0.1f, 1000.0f);
         XMStoreFloat4x4(&proj, _proj);
+
+        ClusterDesc cluster_desc = light_clusters.Desc();
+        cluster_desc.aspect = Aspect();
+        cluster_desc.near_z = 0.1f;
+        cluster_desc.far_z = 1000.0f;
+        light_clusters.Resize(cluster_desc);
     }
     void Update(const Timer &timer) override {
         OnKeyboardInput(timer);
@@ -93,6 +116,7 @@ class D3DAppLighting : public D3DApp {
         UpdateObjCont(timer);
         UpdatePassConst(timer);
         UpdateMaterialConst(timer);
+        UpdateLightClusters(timer);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
@@ -122,6 +146,14 @@ class D3DAppLighting : public D3DApp {
         // set per pass cbv
         auto pass_cb = curr_fr->p_pass_cb->Resource();
         p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+        // set clustered lights
+        p_cmd_list->SetGraphicsRootShaderResourceView(3,
+            curr_fr->p_cluster_lights->Resource()->GetGPUVirtualAddress());
+        p_cmd_list->SetGraphicsRootShaderResourceView(4,
+            curr_fr->p_cluster_ranges->Resource()->GetGPUVirtualAddress());
+        p_cmd_list->SetGraphicsRootShaderResourceView(5,
+            curr_fr->p_cluster_indices->Resource()->GetGPUVirtualAddress());
+        p_cmd_list->SetGraphicsRoot32BitConstants(6, sizeof(ClusterConst) / 4, &cluster_const, 0);
 
         // draw items
         DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
@@ -172,6 +204,12 @@ class D3DAppLighting : public D3DApp {
     }
     void OnKeyboardInput(const Timer &timer) {
         const float dt = timer.DeltaTime();
+        if (GetAsyncKeyState('1') & 0x8000) {
+            b_ocean = !b_ocean;
+        }
+        if (GetAsyncKeyState('2') & 0x8000) {
+            b_rain = !b_rain;
+        }
         if (GetAsyncKeyState(VK_LEFT) & 0x8000) {
             sun_theta -= 1.0f * dt;
         }
@@ -265,30 +303,84 @@ class D3DAppLighting : public D3DApp {
             }
         }
     }
+    void UpdateLightClusters(const Timer &timer) {
+        light_clusters.Assign(jobs, view.m, scene_lights.data(), kNumPointLights, kNumSpotLights);
+
+        // lights don't move, every frame resource gets them once after they change
+        if (lights_n_frame_dirty > 0) {
+            std::copy(scene_lights.begin(), scene_lights.end(), curr_fr->p_cluster_lights->Data());
+            --lights_n_frame_dirty;
+        }
+        const auto &ranges = light_clusters.Ranges();
+        std::copy(ranges.begin(), ranges.end(), curr_fr->p_cluster_ranges->Data());
+        const auto &indices = light_clusters.Indices();
+        std::copy(indices.begin(), indices.end(), curr_fr->p_cluster_indices->Data());
+
+        const ClusterDesc &desc = light_clusters.Desc();
+        cluster_const.n_x = desc.n_x;
+        cluster_const.n_y = desc.n_y;
+        cluster_const.n_z = desc.n_z;
+        cluster_const.n_point = kNumPointLights;
+        cluster_const.slice_scale = light_clusters.SliceScale();
+        cluster_const.slice_bias = light_clusters.SliceBias();
+    }
     void UpdateWaves(const Timer &timer) {
+        if (b_ocean) {
+            p_ocean->Update(timer.DeltaTime());
+            CopyWaveVertices(*p_ocean);
+            return;
+        }
+
+        // disturbances of this frame go to the wave in one batch
+        wave_disturbances.clear();
+        const float hw = 0.5f * p_wave->Width();
+        const float hd = 0.5f * p_wave->Depth();
+
         // Every quarter second, generate a random wave.
         static float t_base = 0.0f;
         if ((this->timer.TotalTime() - t_base) >= 0.25f) {
             t_base += 0.25f;
 
-            int i = DXMath::RandI(4, p_wave->RowCount() - 5);
-            int j = DXMath::RandI(4, p_wave->ColumnCount() - 5);
-
-            float r = DXMath::RandF(0.2f, 0.5f);
+            // about the cell and its 4 neighbours as Wave::Disturb(i, j, r)
+            WaveDisturbance d;
+            d.x = DXMath::RandF(-hw + 4.0f, hw - 4.0f);
+            d.z = DXMath::RandF(-hd + 4.0f, hd - 4.0f);
+            d.radius = 2.0f;
+            d.magnitude = DXMath::RandF(0.2f, 0.5f);
+            d.kernel = WaveKernel::Cone;
+            wave_disturbances.push_back(d);
+        }
 
-            p_wave->Disturb(i, j, r);
+        if (b_rain) {
+            rain_drops += kRainDropsPerSecond * timer.DeltaTime();
+            for (; rain_drops >= 1.0f; rain_drops -= 1.0f) {
+                WaveDisturbance d;
+                d.x = DXMath::RandF(-hw, hw);
+                d.z = DXMath::RandF(-hd, hd);
+                d.radius = 1.5f;
+                d.magnitude = -DXMath::RandF(0.01f, 0.03f);
+                d.kernel = WaveKernel::Smooth;
+                wave_disturbances.push_back(d);
+            }
         }
 
+        p_wave->Disturb(jobs, wave_disturbances.data(), wave_disturbances.size());
+
         // Update the wave simulation.
         p_wave->Update(timer.DeltaTime());
 
         // Update the wave vertex buffer with the new solution.
+        CopyWaveVertices(*p_wave);
+    }
+    // Wave & Ocean have the same accessors
+    template <typename Surface>
+    void CopyWaveVertices(const Surface &surface) {
         auto wave_vb = curr_fr->p_wave_vb.get();
-        for (int i = 0; i < p_wave->VertexCount(); i++) {
+        for (int i = 0; i < surface.VertexCount(); i++) {
             Vertex v;
 
-            v.pos = p_wave->Position(i);
-            v.norm = p_wave->Normal(i);
+            v.pos = surface.Position(i);
+            v.norm = surface.Normal(i);
 
             wave_vb->CopyData(i, v);
         }
@@ -298,10 +390,15 @@ class D3DAppLighting : public D3DApp {
     }
 
     void BuildRootSignature() {
-        CD3DX12_ROOT_PARAMETER rt_params[3];
+        CD3DX12_ROOT_PARAMETER rt_params[7];
         rt_params[0].InitAsConstantBufferView(0);
         rt_params[1].InitAsConstantBufferView(1);
         rt_params[2].InitAsConstantBufferView(2);
+        // clustered lights
+        rt_params[3].InitAsShaderResourceView(0);
+        rt_params[4].InitAsShaderResourceView(1);
+        rt_params[5].InitAsShaderResourceView(2);
+        rt_params[6].InitAsConstants(sizeof(ClusterConst) / 4, 3);
 
         CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(sizeof(rt_params) / sizeof(rt_params[0]), rt_params,
             0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
@@ -322,8 +419,12 @@ class D3DAppLighting : public D3DApp {
         // build shader from hlsl file
         shaders["standard_vs"] = D3DUtil::CompileShader(src_path + L"ch08_lighting/shaders/P3N3_default.hlsl",
             nullptr, "VS", "vs_5_1");
+        const D3D_SHADER_MACRO clustered_defines[] = {
+            "CLUSTERED_LIGHTS", "1",
+            nullptr, nullptr
+        };
         shaders["opaque_ps"] = D3DUtil::CompileShader(src_path + L"ch08_lighting/shaders/P3N3_default.hlsl",
-            nullptr, "PS", "ps_5_1");
+            clustered_defines, "PS", "ps_5_1");
 
         // input layout and input elements specify input of (vertex) shader
         input_layout = {
@@ -334,13 +435,13 @@ class D3DAppLighting : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
+            vertices[i].norm = grid.vertices[i].norm;
         }
         std::vector<uint16_t> indices = grid.GetIndices16();
 
@@ -443,6 +544,29 @@ class D3DAppLighting : public D3DApp {
         materials["grass"] = std::move(grass);
         materials["water"] = std::move(water);
     }
+    void BuildLights() {
+        // small lights of random colors a little above the hills, spot lights point down
+        Random rng(8, 0);
+        scene_lights.resize(kNumPointLights + kNumSpotLights);
+        for (int i = 0; i < scene_lights.size(); i++) {
+            ClusterLight &light = scene_lights[i];
+            const float x = rng.RandF(-75.0f, 75.0f);
+            const float z = rng.RandF(-75.0f, 75.0f);
+            light.position[0] = x;
+            light.position[1] = HillField::Height(x, z) + rng.RandF(1.0f, 4.0f);
+            light.position[2] = z;
+            for (int k = 0; k < 3; k++) {
+                light.strength[k] = rng.RandF(0.1f, 0.8f);
+            }
+            light.direction[0] = 0.0f;
+            light.direction[1] = -1.0f;
+            light.direction[2] = 0.0f;
+            light.falloff_start = 1.0f;
+            light.falloff_end = rng.RandF(4.0f, 10.0f);
+            light.spot_power = i < kNumPointLights ? 0.0f : 8.0f;
+        }
+        lights_n_frame_dirty = n_frame_resource;
+    }
     void BuildPSOs() {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC opaque_pso_desc = {};
         opaque_pso_desc.InputLayout = { input_layout.data(), (UINT) input_layout.size() };
@@ -471,7 +595,8 @@ class D3DAppLighting : public D3DApp {
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
             frame_resources.push_back(std::make_unique<FrameResource>(p_device.Get(), 1,
-                items.size(), materials.size(), p_wave->VertexCount()));
+                items.size(), materials.size(), p_wave->VertexCount(), scene_lights.size(),
+                light_clusters.ClusterCount(), light_clusters.MaxIndexCount()));
         }
     }
     void BuildRenderItems() {
@@ -527,21 +652,6 @@ class D3DAppLighting : public D3DApp {
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
@@ -559,9 +669,20 @@ class D3DAppLighting : public D3DApp {
     RenderItem *wave_ritem;
     std::vector<RenderItem *> ritem_layer[(size_t) RenderLayor::Count];
     std::unique_ptr<Wave> p_wave;
+    std::unique_ptr<Ocean> p_ocean;
+    bool b_ocean = false;
+    std::vector<WaveDisturbance> wave_disturbances;
+    bool b_rain = false;
+    float rain_drops = 0.0f; // fraction of a drop left from the last frame
 
     PassConst main_pass_cb;
 
+    JobSystem jobs;
+    std::vector<ClusterLight> scene_lights;
+    int lights_n_frame_dirty = n_frame_resource; // of scene_lights
+    LightClusters light_clusters;
+    ClusterConst cluster_const;
+
     XMFLOAT3 eye = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 view = DXMath::Identity4x4();
     XMFLOAT4X4 proj = DXMath::Identity4x4();
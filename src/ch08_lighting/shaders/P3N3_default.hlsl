@@ -43,6 +43,45 @@ cbuffer pass_cb : register(b2) {
     Light lights[MAX_N_LIGHTS];   
 }
 
+#ifdef CLUSTERED_LIGHTS
+// point & spot lights assigned to clusters of the view frustum on cpu (LightCluster)
+struct ClusterRange {
+    uint offset;
+    uint count;
+};
+
+StructuredBuffer<Light> cluster_lights : register(t0);
+StructuredBuffer<ClusterRange> cluster_ranges : register(t1);
+StructuredBuffer<uint> cluster_indices : register(t2);
+
+cbuffer cluster_cb : register(b3) {
+    uint3 cluster_dims;
+    uint n_cluster_point_lights; // lights before are point lights, lights after spot lights
+    float slice_scale;
+    float slice_bias;
+}
+
+float3 ComputeClusteredLights(float2 pos_screen, float3 pos_w, Material mat, float3 normal, float3 view_dir) {
+    // same cluster as LightClusters, tiles from the top left, slices exponential in view depth
+    float depth = -mul(view, float4(pos_w, 1.0f)).z;
+    uint3 cluster;
+    cluster.xy = min(uint2(pos_screen * rt_size_inv * cluster_dims.xy), cluster_dims.xy - 1);
+    cluster.z = (uint) clamp(floor(log(depth) * slice_scale + slice_bias), 0.0f, cluster_dims.z - 1.0f);
+    ClusterRange range = cluster_ranges[(cluster.z * cluster_dims.y + cluster.y) * cluster_dims.x + cluster.x];
+
+    float3 res = 0.0f;
+    for (uint i = 0; i < range.count; i++) {
+        uint id = cluster_indices[range.offset + i];
+        if (id < n_cluster_point_lights) {
+            res += ComputePointLight(cluster_lights[id], mat, pos_w, normal, view_dir);
+        } else {
+            res += ComputeSpotLight(cluster_lights[id], mat, pos_w, normal, view_dir);
+        }
+    }
+    return res;
+}
+#endif
+
 struct VertexIn {
     float3 pos : POSITION;
     float3 norm : NORMAL;
@@ -70,6 +109,9 @@ float4 PS(VertexOut pin) : SV_TARGET {
     float shiniess = 1.0f - roughness;
     Material mat = { albedo, fresnel_r0, shiniess };
     float4 light_res = ComputeLight(lights, mat, pin.pos_w, pin.norm_w, view);
+#ifdef CLUSTERED_LIGHTS
+    light_res.rgb += ComputeClusteredLights(pin.pos.xy, pin.pos_w, mat, pin.norm_w, view);
+#endif
     float4 res = light_res + ambient;
     res.a = albedo.a;
     return res;
@@ -10,7 +10,11 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 #include "Wave.h"
 
@@ -55,22 +59,40 @@ class D3DAppTexture : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildWaveGeometryBuffers();
-        BuildBoxGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // geometry stages share p_uploads & p_buffer_heap and never overlap,
+        // the rest run as soon as their inputs are built
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildLandGeometry", {}, { "land_geo" }, [this]() { BuildLandGeometry(); }, true);
+        init_graph.AddStage("BuildWaveGeometryBuffers", {}, { "water_geo" },
+            [this]() { BuildWaveGeometryBuffers(); }, true);
+        init_graph.AddStage("BuildBoxGeometry", {}, { "box_geo" }, [this]() { BuildBoxGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "water_geo", "box_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -130,7 +152,7 @@ class D3DAppTexture : public D3DApp {
         auto pass_cb = curr_fr->p_pass_cb->Resource();
         p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
 
         // draw items
@@ -390,13 +412,14 @@ class D3DAppTexture : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = 3;
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
+
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["grass"] = tex_range.offset;
+        texture_srv["water"] = tex_range.offset + 1;
+        texture_srv["crate"] = tex_range.offset + 2;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto grass_tex = textures["grass"]->resource;
         auto water_tex = textures["water"]->resource;
         auto crate_tex = textures["crate"]->resource;
@@ -434,13 +457,13 @@ class D3DAppTexture : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
+            vertices[i].norm = grid.vertices[i].norm;
             vertices[i].texc = grid.vertices[i].texc;
         }
         std::vector<uint16_t> indices = grid.GetIndices16();
@@ -456,10 +479,12 @@ class D3DAppTexture : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -507,8 +532,9 @@ class D3DAppTexture : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -546,10 +572,12 @@ class D3DAppTexture : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -569,7 +597,7 @@ class D3DAppTexture : public D3DApp {
         grass->name = "grass";
         grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = 0;
-        grass->diffuse_srv_heap_index = 0;
+        grass->diffuse_srv_heap_index = texture_srv["grass"];
         grass->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -579,7 +607,7 @@ class D3DAppTexture : public D3DApp {
         water->name = "water";
         water->n_frame_dirty = n_frame_resource;
         water->mat_cb_ind = 1;
-        water->diffuse_srv_heap_index = 1;
+        water->diffuse_srv_heap_index = texture_srv["water"];
         water->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         water->fresnel_r0 = { 0.2f, 0.2f, 0.2f };
         water->roughness = 0.0f;
@@ -589,7 +617,7 @@ class D3DAppTexture : public D3DApp {
         crate->name = "crate";
         crate->n_frame_dirty = n_frame_resource;
         crate->mat_cb_ind = 2;
-        crate->diffuse_srv_heap_index = 2;
+        crate->diffuse_srv_heap_index = texture_srv["crate"];
         crate->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         crate->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         crate->roughness = 0.25f;
@@ -687,8 +715,7 @@ class D3DAppTexture : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -696,31 +723,20 @@ class D3DAppTexture : public D3DApp {
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
@@ -6,7 +6,7 @@ FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT
 
     p_pass_cb = std::make_unique<UploadBuffer<PassConst>>(device, n_pass, true);
     p_obj_cb = std::make_unique<UploadBuffer<ObjectConst>>(device, n_obj, true);
-    p_mat_cb = std::make_unique<UploadBuffer<MaterialConst>>(device, n_mat, true);
+    p_mat_buffer = std::make_unique<UploadBuffer<MaterialConst>>(device, n_mat, false);
 
     p_wave_vb = std::make_unique<UploadBuffer<Vertex>>(device, n_wave_vertex, false);
 }
@@ -52,7 +52,8 @@ struct FrameResource {
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> p_cmd_alloc;
     std::unique_ptr<UploadBuffer<ObjectConst>> p_obj_cb = nullptr;
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_cb = nullptr;
+    // all materials packed, see MaterialTable
+    std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_buffer = nullptr;
     std::unique_ptr<UploadBuffer<Vertex>> p_wave_vb = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
@@ -10,7 +10,15 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
+#include "CapturedCommandList.h"
+#include "DepthSort.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 #include "Wave.h"
 
@@ -30,6 +38,7 @@ struct RenderItem {
     UINT n_index = 0;
     UINT start_index = 0;
     int base_vertex = 0;
+    XMFLOAT3 center = { 0.0f, 0.0f, 0.0f }; // in model space, where transparent items are sorted by
 };
 
 enum class RenderLayor : size_t {
@@ -57,22 +66,40 @@ class D3DAppBlending : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildWaveGeometryBuffers();
-        BuildBoxGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // geometry stages share p_uploads & p_buffer_heap and never overlap,
+        // the rest run as soon as their inputs are built
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildLandGeometry", {}, { "land_geo" }, [this]() { BuildLandGeometry(); }, true);
+        init_graph.AddStage("BuildWaveGeometryBuffers", {}, { "water_geo" },
+            [this]() { BuildWaveGeometryBuffers(); }, true);
+        init_graph.AddStage("BuildBoxGeometry", {}, { "box_geo" }, [this]() { BuildBoxGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "water_geo", "box_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -102,58 +129,80 @@ class D3DAppBlending : public D3DApp {
         UpdateObjCont(timer);
         UpdatePassConst(timer);
         UpdateMaterialConst(timer);
+        SortTransparentItems(timer);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
         auto cmd_alloc = curr_fr->p_cmd_alloc;
         ThrowIfFailed(cmd_alloc->Reset());
-        ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque"].Get()));
+
+        // calls through cmd_list are recorded into capture_stream when a capture is requested
+        if (capture_frame) {
+            capture_stream.Clear();
+        }
+        CapturedCommandList cmd_list(p_cmd_list.Get(), capture_frame ? &capture_stream : nullptr);
+        ThrowIfFailed(cmd_list.Reset(cmd_alloc.Get(), psos["opaque"].Get()));
 
         // viewport and scissor
-        p_cmd_list->RSSetViewports(1, &viewport);
-        p_cmd_list->RSSetScissorRects(1, &scissors);
+        cmd_list.RSSetViewports(1, &viewport);
+        cmd_list.RSSetScissorRects(1, &scissors);
 
         // back buffer: present -> render target
         auto transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
             D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        p_cmd_list->ResourceBarrier(1, &transit_barrier);
+        cmd_list.ResourceBarrier(1, &transit_barrier);
         // clear rtv and dsv
         auto back_buffer_view = CurrBackBufferView();
         auto depth_stencil_view = DepthStencilView();
-        p_cmd_list->ClearRenderTargetView(back_buffer_view, (float *) &main_pass_cb.fog_color, 0, nullptr);
-        p_cmd_list->ClearDepthStencilView(depth_stencil_view, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
+        cmd_list.ClearRenderTargetView(back_buffer_view, (float *) &main_pass_cb.fog_color, 0, nullptr);
+        cmd_list.ClearDepthStencilView(depth_stencil_view, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
             1.0f, 0, 0, nullptr);
         // set rtv and dsv
-        p_cmd_list->OMSetRenderTargets(1, &back_buffer_view, true, &depth_stencil_view);
+        cmd_list.OMSetRenderTargets(1, &back_buffer_view, true, &depth_stencil_view);
 
         // set root signature
-        p_cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
+        cmd_list.SetGraphicsRootSignature(p_rt_sig.Get());
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
-        p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
+        ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
+        cmd_list.SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
         // set per pass cbv
         auto pass_cb = curr_fr->p_pass_cb->Resource();
-        p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+        cmd_list.SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+        // set materials
+        auto mat_buffer = curr_fr->p_mat_buffer->Resource();
+        cmd_list.SetGraphicsRootShaderResourceView(4, mat_buffer->GetGPUVirtualAddress());
 
         // draw opaque items
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
+        cmd_list.BeginLayer("opaque");
+        DrawRenderItems(&cmd_list, ritem_layer[(size_t) RenderLayor::Opaque]);
         // draw alpha tested items
-        p_cmd_list->SetPipelineState(psos["alpha_tested"].Get());
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::AlphaTested]);
+        cmd_list.BeginLayer("alpha_tested");
+        cmd_list.SetPipelineState(psos["alpha_tested"].Get());
+        DrawRenderItems(&cmd_list, ritem_layer[(size_t) RenderLayor::AlphaTested]);
         // draw transparent items
-        p_cmd_list->SetPipelineState(psos["transparent"].Get());
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Transparent]);
+        cmd_list.BeginLayer("transparent");
+        cmd_list.SetPipelineState(psos["transparent"].Get());
+        DrawRenderItems(&cmd_list, ritem_layer[(size_t) RenderLayor::Transparent]);
 
         // back buffer: render target -> present
+        cmd_list.BeginLayer("present");
         transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
             D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-        p_cmd_list->ResourceBarrier(1, &transit_barrier);
+        cmd_list.ResourceBarrier(1, &transit_barrier);
         
         // close & begin execution
-        ThrowIfFailed(p_cmd_list->Close());
+        ThrowIfFailed(cmd_list.Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
 
+        if (capture_frame) {
+            // analyze it offline with cmd_replay
+            capture_stream.Save(build_path + L"frame_capture.cmds");
+            OutputDebugStringA(("captured " + std::to_string(capture_stream.CommandCount()) + " commands, "
+                + std::to_string(capture_stream.Data().size()) + " bytes\n").c_str());
+            capture_frame = false;
+        }
+
         // swap
         p_swap_chain->Present(0, 0);
         curr_back_buffer = (curr_back_buffer + 1) % kSwapChainBufferCnt;
@@ -189,7 +238,10 @@ class D3DAppBlending : public D3DApp {
         ReleaseCapture();
     }
     void OnKeyboardInput(const Timer &timer) {
-        ;
+        // capture commands of next frame
+        if (GetAsyncKeyState('C') & 0x8000) {
+            capture_frame = true;
+        }
     }
 
     void UpdateCamera(const Timer &timer) {
@@ -262,20 +314,39 @@ class D3DAppBlending : public D3DApp {
         curr_pass_cb->CopyData(0, main_pass_cb);
     }
     void UpdateMaterialConst(const Timer &timer) {
-        auto curr_mat_cb = curr_fr->p_mat_cb.get();
-        for (auto &[_, _mat] : materials) {
-            Material *mat = _mat.get();
-            if (mat->n_frame_dirty > 0) {
-                XMMATRIX mat_transform = XMLoadFloat4x4(&mat->mat_transform);
-                MaterialConst mat_const;
-                mat_const.albedo = mat->albedo;
-                mat_const.fresnel_r0 = mat->fresnel_r0;
-                mat_const.roughness = mat->roughness;
-                XMStoreFloat4x4(&mat_const.mat_transform, mat_transform);
-                curr_mat_cb->CopyData(mat->mat_cb_ind, mat_const);
-                --mat->n_frame_dirty;
-            }
+        // only materials changed since this frame resource was last used are copied
+        material_table.Upload(curr_fr_ind, curr_fr->p_mat_buffer->Data());
+    }
+    static MaterialConst MaterialRecord(const Material &mat) {
+        MaterialConst mat_const;
+        mat_const.albedo = mat.albedo;
+        mat_const.fresnel_r0 = mat.fresnel_r0;
+        mat_const.roughness = mat.roughness;
+        mat_const.mat_transform = mat.mat_transform;
+        return mat_const;
+    }
+    // transparent items are drawn far to near, the order of last frame breaks ties so it doesn't flicker
+    void SortTransparentItems(const Timer &timer) {
+        auto &layer = ritem_layer[(size_t) RenderLayor::Transparent];
+        const size_t n = layer.size();
+        sort_centers.resize(n);
+        sort_materials.resize(n);
+        sort_order.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            XMMATRIX model = XMLoadFloat4x4(&layer[i]->model);
+            XMStoreFloat3(&sort_centers[i], XMVector3TransformCoord(XMLoadFloat3(&layer[i]->center), model));
+            sort_materials[i] = layer[i]->mat->mat_cb_ind;
         }
+        // camera looks at the origin
+        const XMFLOAT3 look = { -eye.x, -eye.y, -eye.z };
+        depth_sorter.Sort(jobs, reinterpret_cast<const float (*)[3]>(sort_centers.data()), sort_materials.data(), n,
+            &eye.x, &look.x, sort_order.data());
+
+        sorted_items.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            sorted_items[i] = layer[sort_order[i]];
+        }
+        layer.swap(sorted_items);
     }
     void UpdateWaves(const Timer &timer) {
         // Every quarter second, generate a random wave.
@@ -322,7 +393,7 @@ class D3DAppBlending : public D3DApp {
         if (v >= 1.0f) {
             v -= 1.0f;
         }
-        water_mat->n_frame_dirty = n_frame_resource;
+        material_table.Set(water_mat->mat_cb_ind, MaterialRecord(*water_mat));
     }
 
     std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSampler() {
@@ -383,12 +454,15 @@ class D3DAppBlending : public D3DApp {
     }
 
     void BuildRootSignature() {
-        CD3DX12_ROOT_PARAMETER rt_params[4];
+        CD3DX12_ROOT_PARAMETER rt_params[5];
         rt_params[0].InitAsConstantBufferView(0);
-        rt_params[1].InitAsConstantBufferView(1);
+        // index of the material
+        rt_params[1].InitAsConstants(1, 1);
         rt_params[2].InitAsConstantBufferView(2);
         auto srv_range = CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
         rt_params[3].InitAsDescriptorTable(1, &srv_range, D3D12_SHADER_VISIBILITY_PIXEL);
+        // all materials
+        rt_params[4].InitAsShaderResourceView(1);
 
         auto static_samplers = GetStaticSampler();
         CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(sizeof(rt_params) / sizeof(rt_params[0]), rt_params,
@@ -408,13 +482,15 @@ class D3DAppBlending : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
+
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["grass"] = tex_range.offset;
+        texture_srv["water"] = tex_range.offset + 1;
+        texture_srv["crate"] = tex_range.offset + 2;
+        texture_srv["fence"] = tex_range.offset + 3;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto grass_tex = textures["grass"]->resource;
         auto water_tex = textures["water"]->resource;
         auto crate_tex = textures["crate"]->resource;
@@ -470,13 +546,13 @@ class D3DAppBlending : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
+            vertices[i].norm = grid.vertices[i].norm;
             vertices[i].texc = grid.vertices[i].texc;
         }
         std::vector<uint16_t> indices = grid.GetIndices16();
@@ -492,10 +568,12 @@ class D3DAppBlending : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -543,8 +621,9 @@ class D3DAppBlending : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -582,10 +661,12 @@ class D3DAppBlending : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -603,9 +684,8 @@ class D3DAppBlending : public D3DApp {
     void BuildMaterials() {
         auto grass = std::make_unique<Material>();
         grass->name = "grass";
-        grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = 0;
-        grass->diffuse_srv_heap_index = 0;
+        grass->diffuse_srv_heap_index = texture_srv["grass"];
         grass->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -613,9 +693,8 @@ class D3DAppBlending : public D3DApp {
 
         auto water = std::make_unique<Material>();
         water->name = "water";
-        water->n_frame_dirty = n_frame_resource;
         water->mat_cb_ind = 1;
-        water->diffuse_srv_heap_index = 1;
+        water->diffuse_srv_heap_index = texture_srv["water"];
         water->albedo = { 1.0f, 1.0f, 1.0f, 0.5f }; // transparent water
         water->fresnel_r0 = { 0.2f, 0.2f, 0.2f };
         water->roughness = 0.0f;
@@ -623,9 +702,8 @@ class D3DAppBlending : public D3DApp {
 
         auto crate = std::make_unique<Material>();
         crate->name = "crate";
-        crate->n_frame_dirty = n_frame_resource;
         crate->mat_cb_ind = 2;
-        crate->diffuse_srv_heap_index = 2;
+        crate->diffuse_srv_heap_index = texture_srv["crate"];
         crate->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         crate->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         crate->roughness = 0.25f;
@@ -633,13 +711,21 @@ class D3DAppBlending : public D3DApp {
 
         auto fence = std::make_unique<Material>();
         fence->name = "fence";
-        fence->n_frame_dirty = n_frame_resource;
         fence->mat_cb_ind = 3;
-        fence->diffuse_srv_heap_index = 3;
+        fence->diffuse_srv_heap_index = texture_srv["fence"];
         fence->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         fence->fresnel_r0 = { 0.1f, 0.1f, 0.1f };
         fence->roughness = 0.25f;
         materials[fence->name] = std::move(fence);
+
+        // mat_cb_ind is the index in the table
+        std::vector<const Material *> ordered(materials.size());
+        for (const auto &[_, mat] : materials) {
+            ordered[mat->mat_cb_ind] = mat.get();
+        }
+        for (const Material *mat : ordered) {
+            material_table.Add(MaterialRecord(*mat));
+        }
     }
     void BuildPSOs() {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC opaque_pso_desc = {};
@@ -738,11 +824,9 @@ class D3DAppBlending : public D3DApp {
         items.push_back(std::move(crate_ritem));
     }
 
-    void DrawRenderItems(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
+    void DrawRenderItems(CapturedCommandList *cmd_list, const std::vector<RenderItem *> &items) {
         UINT obj_cb_size = D3DUtil::CBSize(sizeof(ObjectConst));
-        UINT mat_cb_size = D3DUtil::CBSize(sizeof(MaterialConst));
         auto obj_cb = curr_fr->p_obj_cb->Resource();
-        auto mat_cb = curr_fr->p_mat_cb->Resource();
         for (auto item : items) { // per object
             // set vb, ib and primitive type
             auto vbv = item->geo->VertexBufferView();
@@ -754,12 +838,10 @@ class D3DAppBlending : public D3DApp {
             // set per object cbv
             auto obj_cb_addr = obj_cb->GetGPUVirtualAddress() + item->obj_cb_ind * obj_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(0, obj_cb_addr);
-            // set matertial cbv
-            auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
-            cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
+            // set material index
+            cmd_list->SetGraphicsRoot32BitConstant(1, item->mat->mat_cb_ind, 0);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -767,31 +849,20 @@ class D3DAppBlending : public D3DApp {
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
@@ -801,9 +872,20 @@ class D3DAppBlending : public D3DApp {
     RenderItem *wave_ritem;
     std::vector<RenderItem *> ritem_layer[(size_t) RenderLayor::Count];
     std::unique_ptr<Wave> p_wave;
+    MaterialTable<MaterialConst> material_table { n_frame_resource };
+
+    JobSystem jobs;
+    DepthSorter depth_sorter;
+    std::vector<XMFLOAT3> sort_centers;
+    std::vector<uint32_t> sort_materials;
+    std::vector<uint32_t> sort_order;
+    std::vector<RenderItem *> sorted_items;
 
     PassConst main_pass_cb;
 
+    bool capture_frame = false;
+    CommandStreamWriter capture_stream;
+
     XMFLOAT3 eye = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 view = DXMath::Identity4x4();
     XMFLOAT4X4 proj = DXMath::Identity4x4();
@@ -27,11 +27,18 @@ cbuffer obj_cb : register(b0) {
     float4x4 tex_transform;
 };
 
-cbuffer mat_cb : register(b1) {
-    float4 g_albedo;
+struct MaterialData {
+    float4 albedo;
     float3 fresnel_r0;
     float roughness;
     float4x4 mat_transform;
+};
+
+// all materials, packed (MaterialTable)
+StructuredBuffer<MaterialData> materials : register(t1);
+
+cbuffer mat_cb : register(b1) {
+    uint mat_index;
 }
 
 cbuffer pass_cb : register(b2) {
@@ -76,12 +83,14 @@ VertexOut VS(VertexIn vin) {
     vout.pos_w = pos_w.xyz;
     vout.pos = mul(vp, pos_w);
     vout.norm_w = mul((float3x3) model_it, vin.norm);
+    float4x4 mat_transform = materials[mat_index].mat_transform;
     vout.texc = mul(mat_transform, mul(tex_transform, float4(vin.texc, 0.0f, 1.0f)));
     return vout;
 }
 
 float4 PS(VertexOut pin) : SV_TARGET {
-    float4 albedo = diffuse_map.Sample(sam_aniso_wrap, pin.texc) * g_albedo;
+    MaterialData mat_data = materials[mat_index];
+    float4 albedo = diffuse_map.Sample(sam_aniso_wrap, pin.texc) * mat_data.albedo;
 #ifdef ALPHA_TEST
     clip(albedo.a - 0.1f);
 #endif
@@ -90,8 +99,8 @@ float4 PS(VertexOut pin) : SV_TARGET {
     float view_dist = length(view_w);
     float3 view = view_w / view_dist;
     float4 ambient = g_ambient * albedo;
-    float shiniess = 1.0f - roughness;
-    Material mat = { albedo, fresnel_r0, shiniess };
+    float shiniess = 1.0f - mat_data.roughness;
+    Material mat = { albedo, mat_data.fresnel_r0, shiniess };
     float4 light_res = ComputeLight(lights, mat, pin.pos_w, pin.norm_w, view);
     float4 res = light_res + ambient;
 #ifdef FOG
@@ -11,7 +11,13 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "JobSystem.h"
+#include "MultiViewCull.h"
+#include "OcclusionBuffer.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 
 #ifdef max
@@ -37,6 +43,16 @@ struct RenderItem {
     UINT n_index = 0;
     UINT start_index = 0;
     int base_vertex = 0;
+    BoundingBox bbox; // of the submesh, in object space
+    bool mirrored = false; // also drawn in the mirror, by a reflection made in 'BuildReflectedItems()'
+    RenderItem *p_reflection = nullptr;
+    bool visible = true; // false if out of its view or hidden behind the room, see 'CullViews()' & 'CullOccluded()'
+};
+
+// views culled together by 'CullViews()', the bits of 'MultiViewCull::Masks()'
+enum class CullView : uint32_t {
+    Main,
+    Mirror // the main view seen in the mirror, culls the originals of reflected items
 };
 
 enum class RenderLayor : size_t {
@@ -69,21 +85,42 @@ class D3DAppStenciling : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildRoomGeometry();
-        BuildSkullGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // room & skull go through p_uploads and p_buffer_heap, so they are serialized
+        // occluders read the geometry map, which is only complete once both are built
+        // reflected items copy render items and go on with their object constant indices
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildRoomGeometry", {}, { "room_geo" }, [this]() { BuildRoomGeometry(); }, true);
+        init_graph.AddStage("BuildSkullGeometry", {}, { "skull_geo" }, [this]() { BuildSkullGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "room_geo", "skull_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildReflectedItems", { "render_items" }, { "reflected_items" },
+            [this]() { BuildReflectedItems(); });
+        init_graph.AddStage("BuildOccluders", { "room_geo", "skull_geo" }, { "occluders" },
+            [this]() { BuildOccluders(); });
+        init_graph.AddStage("BuildFrameResources", { "reflected_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        p_uploads->Retire(curr_fence);
 
         return true;
     }
@@ -109,10 +146,13 @@ class D3DAppStenciling : public D3DApp {
         }
 
         AnimateMaterials(timer);
+        UpdateReflectedItems(timer);
         UpdateObjectCB(timer);
         UpdateMainPassCB(timer);
         UpdateReflectedPassCB(timer);
         UpdateMaterialCB(timer);
+        CullViews(timer);
+        CullOccluded(timer);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
@@ -140,7 +180,7 @@ class D3DAppStenciling : public D3DApp {
         // set root signature
         p_cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
 
         // draw opaque items
@@ -226,6 +266,12 @@ class D3DAppStenciling : public D3DApp {
         if (GetAsyncKeyState('1') & 0x8000) {
             b_outline = !b_outline;
         }
+        if (GetAsyncKeyState('2') & 0x8000) {
+            b_occlusion_cull = !b_occlusion_cull;
+        }
+        if (GetAsyncKeyState('3') & 0x8000) {
+            b_view_cull = !b_view_cull;
+        }
 
         if (GetAsyncKeyState('A') & 0x8000) {
             skull_translation.x += 1.0f * dt;
@@ -251,12 +297,7 @@ class D3DAppStenciling : public D3DApp {
         XMMATRIX outline_model = rotate * scale * outline_scale * translate;
         XMStoreFloat4x4(&p_outline_skull_ritem->model, outline_model);
 
-        XMVECTOR mirror_plane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-        XMMATRIX reflect = XMMatrixReflect(mirror_plane);
-        XMStoreFloat4x4(&p_reflected_skull_ritem->model, model * reflect);
-
         p_skull_ritem->n_frame_dirty = n_frame_resource;
-        p_reflected_skull_ritem->n_frame_dirty = n_frame_resource;
         p_outline_skull_ritem->n_frame_dirty = n_frame_resource;
     }
 
@@ -272,6 +313,17 @@ class D3DAppStenciling : public D3DApp {
         XMMATRIX _view = XMMatrixLookAtRH(pos, lookat, up);
         XMStoreFloat4x4(&view, _view);
     }
+    void UpdateReflectedItems(const Timer &timer) {
+        XMVECTOR mirror_plane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+        XMMATRIX reflect = XMMatrixReflect(mirror_plane);
+        for (auto &item : items) {
+            if (item->p_reflection != nullptr && item->n_frame_dirty > 0) {
+                XMMATRIX model = XMLoadFloat4x4(&item->model);
+                XMStoreFloat4x4(&item->p_reflection->model, model * reflect);
+                item->p_reflection->n_frame_dirty = n_frame_resource;
+            }
+        }
+    }
     void UpdateObjectCB(const Timer &timer) {
         auto curr_obj_cb = curr_fr->p_obj_cb.get();
         for (auto &item : items) {
@@ -329,6 +381,79 @@ class D3DAppStenciling : public D3DApp {
         auto curr_pass_cb = curr_fr->p_pass_cb.get();
         curr_pass_cb->CopyData(0, main_pass_cb);
     }
+    void CullViews(const Timer &timer) {
+        if (!b_view_cull) {
+            for (auto &item : items) {
+                item->visible = true;
+            }
+            return;
+        }
+
+        // reflections are drawn with model * reflect, so their originals are culled by the frustum of reflect * vp
+        XMVECTOR mirror_plane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+        XMMATRIX reflect = XMMatrixReflect(mirror_plane);
+        XMFLOAT4X4 mirror_vp;
+        XMStoreFloat4x4(&mirror_vp, reflect * XMLoadFloat4x4(&main_pass_cb.vp));
+        // in the order of CullView
+        view_cull.ClearViews();
+        view_cull.AddView(Frustum::FromViewProj(main_pass_cb.vp.m));
+        view_cull.AddView(Frustum::FromViewProj(mirror_vp.m));
+
+        cull_boxes.resize(cull_items.size());
+        for (size_t i = 0; i < cull_items.size(); i++) {
+            const auto item = cull_items[i];
+            cull_boxes[i] = CullBox::Transform(&item->bbox.Center.x, &item->bbox.Extents.x, item->model.m);
+        }
+        view_cull.Cull(jobs, cull_boxes.data(), cull_boxes.size());
+
+        for (auto &item : items) {
+            item->visible = false;
+        }
+        for (uint32_t i : view_cull.Visible((uint32_t) CullView::Main)) {
+            cull_items[i]->visible = true;
+        }
+        // reflections are only seen through the mirror
+        if (p_mirror_ritem->visible) {
+            for (uint32_t i : view_cull.Visible((uint32_t) CullView::Mirror)) {
+                if (cull_items[i]->p_reflection != nullptr) {
+                    cull_items[i]->p_reflection->visible = true;
+                }
+            }
+        }
+        p_outline_skull_ritem->visible = p_skull_ritem->visible;
+    }
+    void CullOccluded(const Timer &timer) {
+        const size_t n_occludee = 2;
+        RenderItem *occludee_items[n_occludee] = { p_skull_ritem, p_reflected_skull_ritem };
+        if (!b_occlusion_cull) {
+            return;
+        }
+
+        // floor & walls are drawn into a small cpu depth buffer, the skull and its reflection are tested against it
+        occlusion_buffer.Render(jobs, main_pass_cb.vp.m, occluders.data(), occluders.size());
+        Occludee occludees[n_occludee];
+        bool visible[n_occludee];
+        for (size_t i = 0; i < n_occludee; i++) {
+            const auto &bbox = occludee_items[i]->geo->draw_args["skull"].bbox;
+            std::copy_n(&bbox.Center.x, 3, occludees[i].center);
+            std::copy_n(&bbox.Extents.x, 3, occludees[i].extents);
+            std::copy_n(&occludee_items[i]->model.m[0][0], 16, &occludees[i].model[0][0]);
+        }
+        occlusion_buffer.Test(jobs, occludees, n_occludee, visible);
+        for (size_t i = 0; i < n_occludee; i++) {
+            occludee_items[i]->visible = occludee_items[i]->visible && visible[i];
+        }
+        p_outline_skull_ritem->visible = p_skull_ritem->visible;
+
+        if (timer.TotalTime() - last_occlusion_report >= 1.0f) {
+            const auto &stats = occlusion_buffer.Stats();
+            OutputDebugStringA(("occlusion: " + std::to_string(stats.n_rasterized) + "/" +
+                std::to_string(stats.n_triangle) + " triangles in " + std::to_string(stats.raster_ms) + " ms, " +
+                std::to_string(stats.n_occluded) + "/" + std::to_string(stats.n_tested) + " culled in " +
+                std::to_string(stats.test_ms) + " ms\n").c_str());
+            last_occlusion_report = timer.TotalTime();
+        }
+    }
     void UpdateReflectedPassCB(const Timer &timer) {
         reflected_pass_cb = main_pass_cb;
 
@@ -447,13 +572,15 @@ class D3DAppStenciling : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
+
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["bricks"] = tex_range.offset;
+        texture_srv["checkboard"] = tex_range.offset + 1;
+        texture_srv["ice"] = tex_range.offset + 2;
+        texture_srv["white"] = tex_range.offset + 3;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto bricks_tex = textures["bricks"]->resource;
         auto checkboard_tex = textures["checkboard"]->resource;
         auto ice_tex = textures["ice"]->resource;
@@ -564,10 +691,12 @@ class D3DAppStenciling : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -578,18 +707,21 @@ class D3DAppStenciling : public D3DApp {
         floor_submesh.n_index = 6;
         floor_submesh.start_index = 0;
         floor_submesh.base_vertex = 0;
+        BoundingBox::CreateFromPoints(floor_submesh.bbox, 4, &vertices[0].pos, sizeof(Vertex));
         geo->draw_args["floor"] = floor_submesh;
 
         SubmeshGeometry wall_submesh;
         wall_submesh.n_index = 18;
         wall_submesh.start_index = 6;
         wall_submesh.base_vertex = 0;
+        BoundingBox::CreateFromPoints(wall_submesh.bbox, 12, &vertices[4].pos, sizeof(Vertex));
         geo->draw_args["wall"] = wall_submesh;
 
         SubmeshGeometry mirror_submesh;
         mirror_submesh.n_index = 6;
         mirror_submesh.start_index = 24;
         mirror_submesh.base_vertex = 0;
+        BoundingBox::CreateFromPoints(mirror_submesh.bbox, 4, &vertices[16].pos, sizeof(Vertex));
         geo->draw_args["mirror"] = mirror_submesh;
 
         geometries[geo->name] = std::move(geo);
@@ -632,10 +764,12 @@ class D3DAppStenciling : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -646,6 +780,7 @@ class D3DAppStenciling : public D3DApp {
         submesh.n_index = indices.size();
         submesh.start_index = 0;
         submesh.base_vertex = 0;
+        BoundingBox::CreateFromPoints(submesh.bbox, vertices.size(), &vertices[0].pos, sizeof(Vertex));
         geo->draw_args["skull"] = submesh;
 
         geometries[geo->name] = std::move(geo);
@@ -655,7 +790,7 @@ class D3DAppStenciling : public D3DApp {
         bricks->name = "bricks";
         bricks->n_frame_dirty = n_frame_resource;
         bricks->mat_cb_ind = 0;
-        bricks->diffuse_srv_heap_index = 0;
+        bricks->diffuse_srv_heap_index = texture_srv["bricks"];
         bricks->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         bricks->fresnel_r0 = { 0.05f, 0.05f, 0.05f };
         bricks->roughness = 0.25f;
@@ -665,7 +800,7 @@ class D3DAppStenciling : public D3DApp {
         checkboard->name = "checkboard";
         checkboard->n_frame_dirty = n_frame_resource;
         checkboard->mat_cb_ind = 1;
-        checkboard->diffuse_srv_heap_index = 1;
+        checkboard->diffuse_srv_heap_index = texture_srv["checkboard"];
         checkboard->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         checkboard->fresnel_r0 = { 0.07f, 0.07f, 0.07f };
         checkboard->roughness = 0.3f;
@@ -675,7 +810,7 @@ class D3DAppStenciling : public D3DApp {
         mirror->name = "mirror";
         mirror->n_frame_dirty = n_frame_resource;
         mirror->mat_cb_ind = 2;
-        mirror->diffuse_srv_heap_index = 2;
+        mirror->diffuse_srv_heap_index = texture_srv["ice"];
         mirror->albedo = { 1.0f, 1.0f, 1.0f, 0.3f };
         mirror->fresnel_r0 = { 0.1f, 0.1f, 0.1f };
         mirror->roughness = 0.5f;
@@ -685,7 +820,7 @@ class D3DAppStenciling : public D3DApp {
         skull->name = "skull";
         skull->n_frame_dirty = n_frame_resource;
         skull->mat_cb_ind = 3;
-        skull->diffuse_srv_heap_index = 3;
+        skull->diffuse_srv_heap_index = texture_srv["white"];
         skull->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         skull->fresnel_r0 = { 0.05f, 0.05f, 0.05f };
         skull->roughness = 0.3f;
@@ -800,96 +935,121 @@ class D3DAppStenciling : public D3DApp {
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
             frame_resources.push_back(std::make_unique<FrameResource>(p_device.Get(), 2,
-                items.size(), materials.size()));
+                n_obj_cb, materials.size()));
         }
     }
     void BuildRenderItems() {
-        int obj_cb_ind = 0;
-
         auto floor_ritem = std::make_unique<RenderItem>();
         floor_ritem->model = DXMath::Identity4x4();
         floor_ritem->tex_transform = DXMath::Identity4x4();
-        floor_ritem->obj_cb_ind = obj_cb_ind++;
+        floor_ritem->obj_cb_ind = n_obj_cb++;
         floor_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
         floor_ritem->mat = materials["checkboard"].get();
         floor_ritem->geo = geometries["room_geo"].get();
         floor_ritem->n_index = floor_ritem->geo->draw_args["floor"].n_index;
         floor_ritem->start_index = floor_ritem->geo->draw_args["floor"].start_index;
         floor_ritem->base_vertex = floor_ritem->geo->draw_args["floor"].base_vertex;
+        floor_ritem->bbox = floor_ritem->geo->draw_args["floor"].bbox;
+        floor_ritem->mirrored = true;
         ritem_layer[(size_t) RenderLayor::Opaque].push_back(floor_ritem.get());
+        cull_items.push_back(floor_ritem.get());
         items.push_back(std::move(floor_ritem));
 
-        auto reflect_floor_ritem = std::make_unique<RenderItem>();
-        XMMATRIX reflect = XMMatrixReflect(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
-        XMStoreFloat4x4(&reflect_floor_ritem->model, reflect);
-        reflect_floor_ritem->tex_transform = DXMath::Identity4x4();
-        reflect_floor_ritem->obj_cb_ind = obj_cb_ind++;
-        reflect_floor_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-        reflect_floor_ritem->mat = materials["checkboard"].get();
-        reflect_floor_ritem->geo = geometries["room_geo"].get();
-        reflect_floor_ritem->n_index = reflect_floor_ritem->geo->draw_args["floor"].n_index;
-        reflect_floor_ritem->start_index = reflect_floor_ritem->geo->draw_args["floor"].start_index;
-        reflect_floor_ritem->base_vertex = reflect_floor_ritem->geo->draw_args["floor"].base_vertex;
-        ritem_layer[(size_t) RenderLayor::Reflected].push_back(reflect_floor_ritem.get());
-        items.push_back(std::move(reflect_floor_ritem));
-
         auto wall_ritem = std::make_unique<RenderItem>();
         wall_ritem->model = DXMath::Identity4x4();
         wall_ritem->tex_transform = DXMath::Identity4x4();
-        wall_ritem->obj_cb_ind = obj_cb_ind++;
+        wall_ritem->obj_cb_ind = n_obj_cb++;
         wall_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
         wall_ritem->mat = materials["bricks"].get();
         wall_ritem->geo = geometries["room_geo"].get();
         wall_ritem->n_index = wall_ritem->geo->draw_args["wall"].n_index;
         wall_ritem->start_index = wall_ritem->geo->draw_args["wall"].start_index;
         wall_ritem->base_vertex = wall_ritem->geo->draw_args["wall"].base_vertex;
+        wall_ritem->bbox = wall_ritem->geo->draw_args["wall"].bbox;
         ritem_layer[(size_t) RenderLayor::Opaque].push_back(wall_ritem.get());
+        cull_items.push_back(wall_ritem.get());
         items.push_back(std::move(wall_ritem));
 
         auto skull_ritem = std::make_unique<RenderItem>();
         skull_ritem->model = DXMath::Identity4x4(); // will be set in 'OnKeyboardInput()'
         skull_ritem->tex_transform = DXMath::Identity4x4();
-        skull_ritem->obj_cb_ind = obj_cb_ind++;
+        skull_ritem->obj_cb_ind = n_obj_cb++;
         skull_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
         skull_ritem->mat = materials["skull"].get();
         skull_ritem->geo = geometries["skull_geo"].get();
         skull_ritem->n_index = skull_ritem->geo->draw_args["skull"].n_index;
         skull_ritem->start_index = skull_ritem->geo->draw_args["skull"].start_index;
         skull_ritem->base_vertex = skull_ritem->geo->draw_args["skull"].base_vertex;
+        skull_ritem->bbox = skull_ritem->geo->draw_args["skull"].bbox;
         ritem_layer[(size_t) RenderLayor::Opaque].push_back(skull_ritem.get());
         ritem_layer[(size_t) RenderLayor::OutlineStencil].push_back(skull_ritem.get());
+        cull_items.push_back(skull_ritem.get());
         p_skull_ritem = skull_ritem.get();
 
-        auto reflect_skull_ritem = std::make_unique<RenderItem>();
-        *reflect_skull_ritem = *skull_ritem;
-        reflect_skull_ritem->obj_cb_ind = obj_cb_ind++;
-        ritem_layer[(size_t) RenderLayor::Reflected].push_back(reflect_skull_ritem.get());
-        p_reflected_skull_ritem = reflect_skull_ritem.get();
-
+        // follows the skull, see 'CullViews()'
         auto outline_skull_ritem = std::make_unique<RenderItem>();
         *outline_skull_ritem = *skull_ritem;
-        outline_skull_ritem->obj_cb_ind = obj_cb_ind++;
+        outline_skull_ritem->obj_cb_ind = n_obj_cb++;
         ritem_layer[(size_t) RenderLayor::Outline].push_back(outline_skull_ritem.get());
         p_outline_skull_ritem = outline_skull_ritem.get();
+        skull_ritem->mirrored = true;
 
         items.push_back(std::move(outline_skull_ritem));
-        items.push_back(std::move(reflect_skull_ritem));
         items.push_back(std::move(skull_ritem));
 
         auto mirror_ritem = std::make_unique<RenderItem>();
         mirror_ritem->model = DXMath::Identity4x4();
         mirror_ritem->tex_transform = DXMath::Identity4x4();
-        mirror_ritem->obj_cb_ind = obj_cb_ind++;
+        mirror_ritem->obj_cb_ind = n_obj_cb++;
         mirror_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
         mirror_ritem->mat = materials["mirror"].get();
         mirror_ritem->geo = geometries["room_geo"].get();
         mirror_ritem->n_index = mirror_ritem->geo->draw_args["mirror"].n_index;
         mirror_ritem->start_index = mirror_ritem->geo->draw_args["mirror"].start_index;
         mirror_ritem->base_vertex = mirror_ritem->geo->draw_args["mirrpr"].base_vertex;
+        mirror_ritem->bbox = mirror_ritem->geo->draw_args["mirror"].bbox;
         ritem_layer[(size_t) RenderLayor::Mirror].push_back(mirror_ritem.get());
         ritem_layer[(size_t) RenderLayor::Transparent].push_back(mirror_ritem.get());
+        cull_items.push_back(mirror_ritem.get());
+        p_mirror_ritem = mirror_ritem.get();
         items.push_back(std::move(mirror_ritem));
     }
+    void BuildReflectedItems() {
+        // a copy of each mirrored item drawn by the reflected pass, its model is kept in 'UpdateReflectedItems()'
+        const size_t n_item = items.size();
+        for (size_t i = 0; i < n_item; i++) {
+            RenderItem *item = items[i].get();
+            if (!item->mirrored) {
+                continue;
+            }
+            auto reflect_ritem = std::make_unique<RenderItem>();
+            *reflect_ritem = *item;
+            reflect_ritem->mirrored = false;
+            reflect_ritem->obj_cb_ind = n_obj_cb++;
+            reflect_ritem->n_frame_dirty = n_frame_resource;
+            ritem_layer[(size_t) RenderLayor::Reflected].push_back(reflect_ritem.get());
+            item->p_reflection = reflect_ritem.get();
+            items.push_back(std::move(reflect_ritem));
+        }
+        p_reflected_skull_ritem = p_skull_ritem->p_reflection;
+    }
+
+    void BuildOccluders() {
+        // floor & walls of the room, read from the cpu copy of its buffers
+        auto geo = geometries["room_geo"].get();
+        for (const char *name : { "floor", "wall" }) {
+            const auto &submesh = geo->draw_args[name];
+            Occluder occluder;
+            occluder.vertices = geo->vb_cpu->GetBufferPointer();
+            occluder.stride = geo->vb_stride;
+            occluder.indices = geo->ib_cpu->GetBufferPointer();
+            occluder.index32 = geo->index_fmt == DXGI_FORMAT_R32_UINT;
+            occluder.n_index = submesh.n_index;
+            occluder.start_index = submesh.start_index;
+            occluder.base_vertex = submesh.base_vertex;
+            occluders.push_back(occluder);
+        }
+    }
 
     void DrawRenderItems(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
         UINT obj_cb_size = D3DUtil::CBSize(sizeof(ObjectConst));
@@ -897,6 +1057,9 @@ class D3DAppStenciling : public D3DApp {
         auto obj_cb = curr_fr->p_obj_cb->Resource();
         auto mat_cb = curr_fr->p_mat_cb->Resource();
         for (auto item : items) { // per object
+            if (!item->visible) {
+                continue;
+            }
             // set vb, ib and primitive type
             auto vbv = item->geo->VertexBufferView();
             auto ibv = item->geo->IndexBufferView();
@@ -911,8 +1074,7 @@ class D3DAppStenciling : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -925,26 +1087,45 @@ class D3DAppStenciling : public D3DApp {
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> input_layout;
 
     std::vector<std::unique_ptr<RenderItem>> items;
+    UINT n_obj_cb = 0; // object constants handed out to items
     std::vector<RenderItem *> ritem_layer[(size_t) RenderLayor::Count];
     RenderItem *p_skull_ritem = nullptr;
     RenderItem *p_reflected_skull_ritem = nullptr;
     RenderItem *p_outline_skull_ritem = nullptr;
+    RenderItem *p_mirror_ritem = nullptr;
 
     XMFLOAT3 skull_translation = { 0.0f, 1.0f, -5.0f };
 
     bool b_outline = false;
 
+    // frustum culling of the main view and the mirror in one pass, items with bounds are in 'cull_items'
+    bool b_view_cull = true;
+    MultiViewCull view_cull;
+    std::vector<RenderItem *> cull_items;
+    std::vector<CullBox> cull_boxes;
+
+    // cpu occlusion culling of the skulls
+    bool b_occlusion_cull = true;
+    JobSystem jobs;
+    OcclusionBuffer occlusion_buffer;
+    std::vector<Occluder> occluders;
+    float last_occlusion_report = 0.0f;
+
     PassConst main_pass_cb;
     PassConst reflected_pass_cb;
 
@@ -1,14 +1,21 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex) {
+FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex,
+        UINT n_sprite) {
     ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
         IID_PPV_ARGS(&p_cmd_alloc)));
+    p_cmd_list_pool = std::make_unique<CommandListPool<D3DCommandList>>([device]() {
+        return std::make_unique<D3DCommandList>(device);
+    });
 
     p_pass_cb = std::make_unique<UploadBuffer<PassConst>>(device, n_pass, true);
     p_obj_cb = std::make_unique<UploadBuffer<ObjectConst>>(device, n_obj, true);
     p_mat_cb = std::make_unique<UploadBuffer<MaterialConst>>(device, n_mat, true);
 
     p_wave_vb = std::make_unique<UploadBuffer<Vertex>>(device, n_wave_vertex, false);
+    p_sprite_vb = std::make_unique<UploadBuffer<SpriteInstance>>(device, std::max(n_sprite, 1u), false);
+    p_billboard_vb = std::make_unique<UploadBuffer<BillboardVertex>>(device,
+        std::max<UINT>(n_sprite * kBillboardVertexCount, 1), false);
 }
 
 FrameResource::~FrameResource() {}
\ No newline at end of file
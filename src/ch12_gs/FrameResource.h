@@ -5,6 +5,10 @@
 #include "D3DUtil.h"
 #include "DXMath.h"
 #include "UploadBuffer.h"
+#include "D3DCommandList.h"
+#include "ParallelRecorder.h"
+#include "SpriteField.h"
+#include "Billboard.h"
 
 // data in cbuffer per object
 struct ObjectConst {
@@ -44,15 +48,22 @@ struct Vertex {
 };
 
 struct FrameResource {
-    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex);
+    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_wave_vertex,
+        UINT n_sprite);
     FrameResource(const FrameResource &rhs) = delete;
     FrameResource &operator=(const FrameResource &rhs) = delete;
     ~FrameResource();
 
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> p_cmd_alloc;
+    // lists for parallel recording, each with its own allocator
+    std::unique_ptr<CommandListPool<D3DCommandList>> p_cmd_list_pool = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConst>> p_obj_cb = nullptr;
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_cb = nullptr;
     std::unique_ptr<UploadBuffer<Vertex>> p_wave_vb = nullptr;
+    // visible tree sprites of this frame
+    std::unique_ptr<UploadBuffer<SpriteInstance>> p_sprite_vb = nullptr;
+    // quads of visible tree sprites when they are expanded on cpu
+    std::unique_ptr<UploadBuffer<BillboardVertex>> p_billboard_vb = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
@@ -10,7 +10,15 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "Billboard.h"
+#include "JobSystem.h"
+#include "SpriteField.h"
+#include "TaskGraph.h"
+#include "Terrain.h"
 #include "FrameResource.h"
 #include "Wave.h"
 
@@ -32,6 +40,16 @@ struct RenderItem {
     int base_vertex = 0;
 };
 
+// an item in the flattened draw list together with the pso it is drawn with
+struct DrawPacket {
+    RenderItem *item = nullptr;
+    ID3D12PipelineState *pso = nullptr;
+};
+
+// fewer draws than this are not worth another command list (reset, states that don't carry over, submission)
+// the terrain alone gives 20 to 60 visible chunks, so a frame is split into a few lists
+const size_t kMinDrawsPerCmdList = 16;
+
 enum class RenderLayor : size_t {
     Opaque,      // opaque models
     AlphaTested, // models with transparent part
@@ -58,23 +76,41 @@ class D3DAppBillboard : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildWaveGeometryBuffers();
-        BuildBoxGeometry();
-        BuildTreeSpriteGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // stages only touching device/cpu data run in parallel,
+        // stages sharing p_uploads & p_buffer_heap are serialized
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildTerrain", {}, { "land_geo" }, [this]() { BuildTerrain(); }, true);
+        init_graph.AddStage("BuildWaveGeometryBuffers", {}, { "water_geo" },
+            [this]() { BuildWaveGeometryBuffers(); }, true);
+        init_graph.AddStage("BuildBoxGeometry", {}, { "box_geo" }, [this]() { BuildBoxGeometry(); }, true);
+        init_graph.AddStage("BuildTreeSprites", {}, { "tree_geo" }, [this]() { BuildTreeSprites(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "water_geo", "box_geo", "tree_geo", "materials" },
+            { "render_items" }, [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -99,11 +135,20 @@ class D3DAppBillboard : public D3DApp {
             CloseHandle(event);
         }
 
-        AnimateMaterials(timer);
-        UpdateWaves(timer);
-        UpdateObjectCB(timer);
-        UpdatePassCB(timer);
-        UpdateMaterialCB(timer);
+        ++n_frame;
+
+        // each stage writes its own upload buffer of current frame resource
+        JobSystem::Counter update_counter;
+        jobs.Run([this, &timer]() { UpdateWaves(timer); }, &update_counter);
+        jobs.Run([this, &timer]() { UpdateObjectCB(timer); }, &update_counter);
+        jobs.Run([this, &timer]() { UpdatePassCB(timer); }, &update_counter);
+        jobs.Run([this, &timer]() { UpdateTreeSprites(timer); }, &update_counter);
+        jobs.Run([this, &timer]() { UpdateTerrain(timer); }, &update_counter);
+        jobs.Run([this, &timer]() {
+            AnimateMaterials(timer);
+            UpdateMaterialCB(timer);
+        }, &update_counter);
+        jobs.Wait(update_counter);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
@@ -111,10 +156,6 @@ class D3DAppBillboard : public D3DApp {
         ThrowIfFailed(cmd_alloc->Reset());
         ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque"].Get()));
 
-        // viewport and scissor
-        p_cmd_list->RSSetViewports(1, &viewport);
-        p_cmd_list->RSSetScissorRects(1, &scissors);
-
         // back buffer: present -> render target
         auto transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
             D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
@@ -125,39 +166,63 @@ class D3DAppBillboard : public D3DApp {
         p_cmd_list->ClearRenderTargetView(back_buffer_view, (float *) &main_pass_cb.fog_color, 0, nullptr);
         p_cmd_list->ClearDepthStencilView(depth_stencil_view, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
             1.0f, 0, 0, nullptr);
-        // set rtv and dsv
-        p_cmd_list->OMSetRenderTargets(1, &back_buffer_view, true, &depth_stencil_view);
-
-        // set root signature
-        p_cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
-        // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
-        p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
-        // set per pass cbv
-        auto pass_cb = curr_fr->p_pass_cb->Resource();
-        p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
-
-        // draw opaque items
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
-        // draw alpha tested items
-        p_cmd_list->SetPipelineState(psos["alpha_tested"].Get());
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::AlphaTested]);
-        // draw transparent items
-        p_cmd_list->SetPipelineState(psos["tree_sprite"].Get());
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Sprites]);
-        // draw transparent items
-        p_cmd_list->SetPipelineState(psos["transparent"].Get());
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Transparent]);
+        ThrowIfFailed(p_cmd_list->Close());
+
+        // draw list in drawing order: opaque, alpha tested, tree sprites, transparent
+        draw_list.clear();
+        const std::pair<RenderLayor, const char *> layer_psos[] = {
+            { RenderLayor::Opaque, "opaque" },
+            { RenderLayor::AlphaTested, "alpha_tested" },
+            { RenderLayor::Sprites, cpu_billboard ? "tree_billboard" : "tree_sprite" },
+            { RenderLayor::Transparent, "transparent" }
+        };
+        for (const auto &[layer, pso_name] : layer_psos) {
+            auto pso = psos[pso_name].Get();
+            for (auto item : ritem_layer[(size_t) layer]) {
+                draw_list.push_back({ item, pso });
+            }
+        }
+
+        // record draws into several lists in parallel, states are not inherited between lists
+        auto pool = curr_fr->p_cmd_list_pool.get();
+        pool->BeginFrame();
+        auto draw_cmd_lists = RecordParallel(jobs, *pool, draw_list.size(), kMinDrawsPerCmdList,
+            [&](D3DCommandList &list) {
+                auto cmd_list = list.Get();
+                cmd_list->RSSetViewports(1, &viewport);
+                cmd_list->RSSetScissorRects(1, &scissors);
+                cmd_list->OMSetRenderTargets(1, &back_buffer_view, true, &depth_stencil_view);
+                cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
+                ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
+                cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
+                auto pass_cb = curr_fr->p_pass_cb->Resource();
+                cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+            },
+            [&](D3DCommandList &list, size_t begin, size_t end) {
+                ID3D12PipelineState *curr_pso = nullptr;
+                for (size_t i = begin; i < end; i++) {
+                    if (draw_list[i].pso != curr_pso) {
+                        curr_pso = draw_list[i].pso;
+                        list.Get()->SetPipelineState(curr_pso);
+                    }
+                    DrawRenderItem(list.Get(), draw_list[i].item);
+                }
+            });
 
         // back buffer: render target -> present
+        auto post_list = pool->Acquire();
         transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
             D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-        p_cmd_list->ResourceBarrier(1, &transit_barrier);
-        
-        // close & begin execution
-        ThrowIfFailed(p_cmd_list->Close());
-        ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
-        p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
+        post_list->Get()->ResourceBarrier(1, &transit_barrier);
+        post_list->Close();
+
+        // begin execution, in recording order
+        std::vector<ID3D12CommandList *> cmds = { p_cmd_list.Get() };
+        for (auto list : draw_cmd_lists) {
+            cmds.push_back(list->Get());
+        }
+        cmds.push_back(post_list->Get());
+        p_cmd_queue->ExecuteCommandLists(cmds.size(), cmds.data());
 
         // swap
         p_swap_chain->Present(0, 0);
@@ -194,7 +259,10 @@ class D3DAppBillboard : public D3DApp {
         ReleaseCapture();
     }
     void OnKeyboardInput(const Timer &timer) {
-        ;
+        // expand tree sprites on cpu instead of in geometry shader
+        if (GetAsyncKeyState('B') & 0x8000) {
+            cpu_billboard = !cpu_billboard;
+        }
     }
 
     void UpdateCamera(const Timer &timer) {
@@ -211,7 +279,8 @@ class D3DAppBillboard : public D3DApp {
     }
     void UpdateObjectCB(const Timer &timer) {
         auto curr_obj_cb = curr_fr->p_obj_cb.get();
-        for (auto &item : items) {
+        jobs.ParallelFor(0, items.size(), [&](size_t i) {
+            auto &item = items[i];
             if (item->n_frame_dirty > 0) {
                 ObjectConst obj_const;
                 XMMATRIX model = XMLoadFloat4x4(&item->model);
@@ -225,7 +294,7 @@ class D3DAppBillboard : public D3DApp {
                 curr_obj_cb->CopyData(item->obj_cb_ind, obj_const);
                 --item->n_frame_dirty;
             }
-        }
+        }, 64);
     }
     void UpdatePassCB(const Timer &timer) {
         XMMATRIX _view = XMLoadFloat4x4(&view);
@@ -301,7 +370,7 @@ class D3DAppBillboard : public D3DApp {
 
         // Update the wave vertex buffer with the new solution.
         auto wave_vb = curr_fr->p_wave_vb.get();
-        for (int i = 0; i < p_wave->VertexCount(); i++) {
+        jobs.ParallelFor(0, p_wave->VertexCount(), [&](size_t i) {
             Vertex v;
 
             v.pos = p_wave->Position(i);
@@ -310,11 +379,72 @@ class D3DAppBillboard : public D3DApp {
             v.texc.y = 0.5f + v.pos.z / p_wave->Depth();
 
             wave_vb->CopyData(i, v);
-        }
+        }, 1024);
 
         // Set the dynamic VB of the wave renderitem to the current frame VB.
         wave_ritem->geo->vb_gpu = wave_vb->Resource();
     }
+    // frustum of the camera of this frame, pass cb may still be being written by another job
+    Frustum CameraFrustum() const {
+        XMMATRIX _vp = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj));
+        XMFLOAT4X4 vp;
+        XMStoreFloat4x4(&vp, _vp);
+        return Frustum::FromViewProj(vp.m);
+    }
+    void UpdateTerrain(const Timer &timer) {
+        auto frustum = CameraFrustum();
+        p_terrain->Select(&eye.x, &frustum, terrain_chunks);
+        // a slot is only overwritten after n_frame_resource frames without use, gpu has finished with it then
+        p_terrain->Stream(jobs, terrain_chunks, n_frame, n_frame_resource,
+            reinterpret_cast<TerrainVertex *>(p_terrain_vb->Data()));
+
+        // land is drawn as one render item per chunk, all sharing object cb and material of land_ritem
+        // only fields that never change are copied, UpdateObjectCB counts down n_frame_dirty of land_ritem meanwhile
+        auto &opaque_layer = ritem_layer[(size_t) RenderLayor::Opaque];
+        opaque_layer.clear();
+        for (const auto &chunk : terrain_chunks) {
+            if (chunk.slot < 0) {
+                continue;
+            }
+            if (opaque_layer.size() == terrain_ritems.size()) {
+                terrain_ritems.push_back(std::make_unique<RenderItem>());
+            }
+            RenderItem *item = terrain_ritems[opaque_layer.size()].get();
+            item->obj_cb_ind = land_ritem->obj_cb_ind;
+            item->geo = land_ritem->geo;
+            item->mat = land_ritem->mat;
+            item->prim_ty = land_ritem->prim_ty;
+            const SubmeshGeometry &submesh = terrain_stitches[chunk.stitch];
+            item->n_index = submesh.n_index;
+            item->start_index = submesh.start_index;
+            item->base_vertex = chunk.slot * p_terrain->VertexCountPerChunk();
+            opaque_layer.push_back(item);
+        }
+    }
+    void UpdateTreeSprites(const Timer &timer) {
+        auto frustum = CameraFrustum();
+
+        if (cpu_billboard) {
+            // cull into cpu memory since mapped memory is slow to read, then expand quads into mapped memory
+            // eye is the same as main_pass_cb.eye
+            visible_sprites.resize(tree_field.Count());
+            size_t n_visible = tree_field.Cull(jobs, frustum, visible_sprites.data());
+            auto billboard_vb = curr_fr->p_billboard_vb.get();
+            ExpandBillboards(jobs, visible_sprites.data(), n_visible, &eye.x, billboard_vb->Data());
+            tree_ritem->geo = geometries["tree_billboard_geo"].get();
+            tree_ritem->geo->vb_gpu = billboard_vb->Resource();
+            tree_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+            tree_ritem->n_index = n_visible * kBillboardIndexCount;
+        } else {
+            // visible sprites are compacted into the vertex buffer of current frame resource
+            auto sprite_vb = curr_fr->p_sprite_vb.get();
+            size_t n_visible = tree_field.Cull(jobs, frustum, sprite_vb->Data());
+            tree_ritem->geo = geometries["tree_geo"].get();
+            tree_ritem->geo->vb_gpu = sprite_vb->Resource();
+            tree_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
+            tree_ritem->n_index = n_visible;
+        }
+    }
     void AnimateMaterials(const Timer &timer) {
         auto water_mat = materials["water"].get();
         float &u = water_mat->mat_transform(3, 0);
@@ -413,13 +543,15 @@ class D3DAppBillboard : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
+
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["grass"] = tex_range.offset;
+        texture_srv["water"] = tex_range.offset + 1;
+        texture_srv["fence"] = tex_range.offset + 2;
+        texture_srv["tree"] = tex_range.offset + 3;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto grass_tex = textures["grass"]->resource;
         auto water_tex = textures["water"]->resource;
         auto fence_tex = textures["fence"]->resource;
@@ -477,6 +609,8 @@ class D3DAppBillboard : public D3DApp {
             nullptr, "GS", "gs_5_1");
         shaders["tree_sprite_ps"] = D3DUtil::CompileShader(src_path + L"ch12_gs/shaders/tree_sprite.hlsl",
             alpha_test_defines, "PS", "ps_5_1");
+        shaders["tree_billboard_vs"] = D3DUtil::CompileShader(src_path + L"ch12_gs/shaders/tree_sprite.hlsl",
+            nullptr, "BillboardVS", "vs_5_1");
 
         // input layout and input elements specify input of (vertex) shader
         std_input_layout = {
@@ -487,49 +621,60 @@ class D3DAppBillboard : public D3DApp {
 
         tree_sprite_input_layout = {
             { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-            { "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+            { "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "VARIANT", 0, DXGI_FORMAT_R32_UINT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
         };
-    }
-    void BuildLandGeometry() {
-        GeometryGenerator geo_gen;
-        GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
 
-        std::vector<Vertex> vertices(grid.vertices.size());
-        for (int i = 0; i < vertices.size(); i++) {
-            const auto &p = grid.vertices[i].pos;
-            vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
-            vertices[i].texc = grid.vertices[i].texc;
-        }
-        std::vector<uint16_t> indices = grid.GetIndices16();
-
-        const UINT vb_size = vertices.size() * sizeof(Vertex);
-        const UINT ib_size = indices.size() * sizeof(uint16_t);
+        tree_billboard_input_layout = {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "VARIANT", 0, DXGI_FORMAT_R32_UINT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+        };
+    }
+    void BuildTerrain() {
+        // 320 x 320 land in chunks of 32 x 32 quads, from 40 (finest) to 320 (coarsest) units wide
+        TerrainDesc desc;
+        desc.min_x = -160.0f;
+        desc.min_z = -160.0f;
+        desc.size = 320.0f;
+        desc.n_level = 4;
+        desc.chunk_quads = 32;
+        const int n_slot = 256;
+        p_terrain = std::make_unique<Terrain>(jobs, desc, HillField::Evaluate, n_slot);
+
+        // vertices of resident chunks, read by gpu from upload heap like the wave vertices
+        static_assert(sizeof(TerrainVertex) == sizeof(Vertex));
+        const UINT n_vertex = n_slot * p_terrain->VertexCountPerChunk();
+        p_terrain_vb = std::make_unique<UploadBuffer<Vertex>>(p_device.Get(), n_vertex, false);
+
+        // one static index buffer of all stitch variants
+        TerrainIndices indices = p_terrain->BuildIndices();
+        const UINT ib_size = indices.indices.size() * sizeof(uint16_t);
 
         auto geo = std::make_unique<MeshGeometry>();
         geo->name = "land_geo";
 
-        ThrowIfFailed(D3DCreateBlob(vb_size, &geo->vb_cpu));
-        CopyMemory(geo->vb_cpu->GetBufferPointer(), vertices.data(), vb_size);
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
-        CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
-
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.indices.data(), ib_size);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
+        geo->vb_gpu = p_terrain_vb->Resource();
 
         geo->vb_stride = sizeof(Vertex);
-        geo->vb_size = vb_size;
+        geo->vb_size = n_vertex * sizeof(Vertex);
         geo->index_fmt = DXGI_FORMAT_R16_UINT;
         geo->ib_size = ib_size;
 
-        SubmeshGeometry submesh;
-        submesh.n_index = indices.size();
-        submesh.start_index = 0;
-        submesh.base_vertex = 0;
-        geo->draw_args["grid"] = submesh;
+        for (uint32_t stitch = 0; stitch < kTerrainStitchCount; stitch++) {
+            SubmeshGeometry submesh;
+            submesh.n_index = indices.count[stitch];
+            submesh.start_index = indices.start[stitch];
+            submesh.base_vertex = 0;
+            geo->draw_args["stitch" + std::to_string(stitch)] = submesh;
+            terrain_stitches[stitch] = submesh;
+        }
 
         geometries[geo->name] = std::move(geo);
     }
@@ -566,8 +711,9 @@ class D3DAppBillboard : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -605,10 +751,12 @@ class D3DAppBillboard : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -623,60 +771,60 @@ class D3DAppBillboard : public D3DApp {
 
         geometries[geo->name] = std::move(geo);
     }
-    void BuildTreeSpriteGeometry() {
-        struct TreeSpriteVertex {
-            XMFLOAT3 pos;
-            XMFLOAT2 size;
-        };
-        const int n_tree = 16;
-        std::array<TreeSpriteVertex, n_tree> vertices;
-        for (int i = 0; i < n_tree; i++) {
-            float x = DXMath::RandF(-45.0f, 45.0f);
-            float z = DXMath::RandF(-45.0f, 45.0f);
-            float y = GetHillHeight(x, z) + 8.0f;
-            vertices[i].pos = { x, y, z };
-            vertices[i].size = { 20.0f, 20.0f };
-        }
-        std::array<uint16_t, n_tree> indices = {
-            0, 1, 2, 3, 4, 5, 6, 7,
-            8, 9, 10, 11, 12, 13, 14, 15
-        };
-
-        UINT vb_size = vertices.size() * sizeof(TreeSpriteVertex);
-        UINT ib_size = indices.size() * sizeof(uint16_t);
-
+    void BuildTreeSprites() {
+        // trees on the land above water and not too steep
+        ScatterRule rule;
+        rule.min_x = -75.0f;
+        rule.max_x = 75.0f;
+        rule.min_z = -75.0f;
+        rule.max_z = 75.0f;
+        rule.n_candidate = 1 << 16;
+        rule.min_height = 1.0f;
+        rule.max_slope = 1.0f;
+        rule.density = 0.25f;
+        rule.min_size = 8.0f;
+        rule.max_size = 14.0f;
+        rule.n_variant = 3; // slices of treeArray2
+        rule.seed = 12;
+        tree_field.Scatter(jobs, rule, HillField::Evaluate);
+
+        // no static buffers, vertex buffer is the visible sprites of current frame resource, see UpdateTreeSprites
         auto geo = std::make_unique<MeshGeometry>();
         geo->name = "tree_geo";
-
-        ThrowIfFailed(D3DCreateBlob(vb_size, &geo->vb_cpu));
-        CopyMemory(geo->vb_cpu->GetBufferPointer(), vertices.data(), vb_size);
-        ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
-        CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
-
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
-
-        geo->vb_stride = sizeof(TreeSpriteVertex);
-        geo->vb_size = vb_size;
-        geo->index_fmt = DXGI_FORMAT_R16_UINT;
-        geo->ib_size = ib_size;
+        geo->vb_stride = sizeof(SpriteInstance);
+        geo->vb_size = std::max<size_t>(tree_field.Count(), 1) * sizeof(SpriteInstance);
 
         SubmeshGeometry submesh;
-        submesh.n_index = indices.size();
+        submesh.n_index = 0;
         submesh.start_index = 0;
         submesh.base_vertex = 0;
         geo->draw_args["tree"] = submesh;
 
         geometries[geo->name] = std::move(geo);
+
+        // quads expanded on cpu, index buffer is static and vertex buffer is in current frame resource
+        std::vector<uint32_t> indices(tree_field.Count() * kBillboardIndexCount);
+        BuildBillboardIndices(tree_field.Count(), indices.data());
+        UINT ib_size = std::max<size_t>(indices.size(), 1) * sizeof(uint32_t);
+
+        auto billboard_geo = std::make_unique<MeshGeometry>();
+        billboard_geo->name = "tree_billboard_geo";
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        billboard_geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        billboard_geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
+        billboard_geo->vb_stride = sizeof(BillboardVertex);
+        billboard_geo->vb_size = std::max<size_t>(tree_field.Count(), 1) * kBillboardVertexCount
+            * sizeof(BillboardVertex);
+        billboard_geo->index_fmt = DXGI_FORMAT_R32_UINT;
+        billboard_geo->ib_size = ib_size;
+        geometries[billboard_geo->name] = std::move(billboard_geo);
     }
     void BuildMaterials() {
         auto grass = std::make_unique<Material>();
         grass->name = "grass";
         grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = 0;
-        grass->diffuse_srv_heap_index = 0;
+        grass->diffuse_srv_heap_index = texture_srv["grass"];
         grass->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -686,7 +834,7 @@ class D3DAppBillboard : public D3DApp {
         water->name = "water";
         water->n_frame_dirty = n_frame_resource;
         water->mat_cb_ind = 1;
-        water->diffuse_srv_heap_index = 1;
+        water->diffuse_srv_heap_index = texture_srv["water"];
         water->albedo = { 1.0f, 1.0f, 1.0f, 0.5f }; // transparent water
         water->fresnel_r0 = { 0.2f, 0.2f, 0.2f };
         water->roughness = 0.0f;
@@ -696,7 +844,7 @@ class D3DAppBillboard : public D3DApp {
         fence->name = "fence";
         fence->n_frame_dirty = n_frame_resource;
         fence->mat_cb_ind = 2;
-        fence->diffuse_srv_heap_index = 2;
+        fence->diffuse_srv_heap_index = texture_srv["fence"];
         fence->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         fence->fresnel_r0 = { 0.1f, 0.1f, 0.1f };
         fence->roughness = 0.25f;
@@ -706,7 +854,7 @@ class D3DAppBillboard : public D3DApp {
         tree->name = "tree";
         tree->n_frame_dirty = n_frame_resource;
         tree->mat_cb_ind = 3;
-        tree->diffuse_srv_heap_index = 3;
+        tree->diffuse_srv_heap_index = texture_srv["tree"];
         tree->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         tree->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         tree->roughness = 0.125f;
@@ -783,28 +931,40 @@ class D3DAppBillboard : public D3DApp {
         tree_sprite_pso_desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
         ThrowIfFailed(p_device->CreateGraphicsPipelineState(&tree_sprite_pso_desc,
             IID_PPV_ARGS(&psos["tree_sprite"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC tree_billboard_pso_desc = tree_sprite_pso_desc;
+        tree_billboard_pso_desc.InputLayout = {
+            tree_billboard_input_layout.data(),
+            (UINT) tree_billboard_input_layout.size()
+        };
+        tree_billboard_pso_desc.VS = {
+            reinterpret_cast<BYTE *>(shaders["tree_billboard_vs"]->GetBufferPointer()),
+            shaders["tree_billboard_vs"]->GetBufferSize()
+        };
+        tree_billboard_pso_desc.GS = {};
+        tree_billboard_pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&tree_billboard_pso_desc,
+            IID_PPV_ARGS(&psos["tree_billboard"])));
     }
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
             frame_resources.push_back(std::make_unique<FrameResource>(p_device.Get(), 1,
-                items.size(), materials.size(), p_wave->VertexCount()));
+                items.size(), materials.size(), p_wave->VertexCount(), tree_field.Count()));
         }
     }
     void BuildRenderItems() {
         int obj_cb_ind = 0;
 
-        auto grid_ritem = std::make_unique<RenderItem>();
-        grid_ritem->model = DXMath::Identity4x4();
-        XMStoreFloat4x4(&grid_ritem->tex_transform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
-        grid_ritem->obj_cb_ind = obj_cb_ind++;
-        grid_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-        grid_ritem->mat = materials["grass"].get();
-        grid_ritem->geo = geometries["land_geo"].get();
-        grid_ritem->n_index = grid_ritem->geo->draw_args["grid"].n_index;
-        grid_ritem->start_index = grid_ritem->geo->draw_args["grid"].start_index;
-        grid_ritem->base_vertex = grid_ritem->geo->draw_args["grid"].base_vertex;
-        ritem_layer[(size_t) RenderLayor::Opaque].push_back(grid_ritem.get());
-        items.push_back(std::move(grid_ritem));
+        // template of terrain chunks, which are added to opaque layer every frame in UpdateTerrain
+        // texture coordinates of terrain are already tiled
+        auto land_ritem = std::make_unique<RenderItem>();
+        land_ritem->model = DXMath::Identity4x4();
+        land_ritem->obj_cb_ind = obj_cb_ind++;
+        land_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+        land_ritem->mat = materials["grass"].get();
+        land_ritem->geo = geometries["land_geo"].get();
+        this->land_ritem = land_ritem.get();
+        items.push_back(std::move(land_ritem));
 
         auto wave_ritem = std::make_unique<RenderItem>();
         wave_ritem->model = DXMath::Identity4x4();
@@ -841,73 +1001,83 @@ class D3DAppBillboard : public D3DApp {
         tree_ritem->start_index = tree_ritem->geo->draw_args["tree"].start_index;
         tree_ritem->base_vertex = tree_ritem->geo->draw_args["tree"].base_vertex;
         ritem_layer[(size_t) RenderLayor::Sprites].push_back(tree_ritem.get());
+        this->tree_ritem = tree_ritem.get();
         items.push_back(std::move(tree_ritem));
     }
 
-    void DrawRenderItems(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
+    void DrawRenderItem(ID3D12GraphicsCommandList *cmd_list, const RenderItem *item) {
         UINT obj_cb_size = D3DUtil::CBSize(sizeof(ObjectConst));
         UINT mat_cb_size = D3DUtil::CBSize(sizeof(MaterialConst));
         auto obj_cb = curr_fr->p_obj_cb->Resource();
         auto mat_cb = curr_fr->p_mat_cb->Resource();
-        for (auto item : items) { // per object
-            // set vb, ib and primitive type
-            auto vbv = item->geo->VertexBufferView();
+
+        // set vb, ib and primitive type
+        auto vbv = item->geo->VertexBufferView();
+        cmd_list->IASetVertexBuffers(0, 1, &vbv);
+        if (item->geo->ib_gpu != nullptr) {
             auto ibv = item->geo->IndexBufferView();
-            cmd_list->IASetVertexBuffers(0, 1, &vbv);
             cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(item->prim_ty);
-
-            // set per object cbv
-            auto obj_cb_addr = obj_cb->GetGPUVirtualAddress() + item->obj_cb_ind * obj_cb_size;
-            cmd_list->SetGraphicsRootConstantBufferView(0, obj_cb_addr);
-            // set matertial cbv
-            auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
-            cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
-            // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
-            cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
-
-            // draw
+        }
+        cmd_list->IASetPrimitiveTopology(item->prim_ty);
+
+        // set per object cbv
+        auto obj_cb_addr = obj_cb->GetGPUVirtualAddress() + item->obj_cb_ind * obj_cb_size;
+        cmd_list->SetGraphicsRootConstantBufferView(0, obj_cb_addr);
+        // set matertial cbv
+        auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
+        cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
+        // set texture srv (descriptor table)
+        auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
+        cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
+
+        // draw, geometry without index buffer draws n_index vertices from base_vertex
+        if (item->geo->ib_gpu != nullptr) {
             cmd_list->DrawIndexedInstanced(item->n_index, 1, item->start_index, item->base_vertex, 0);
+        } else if (item->n_index > 0) {
+            cmd_list->DrawInstanced(item->n_index, 1, item->base_vertex, 0);
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> std_input_layout;
     std::vector<D3D12_INPUT_ELEMENT_DESC> tree_sprite_input_layout;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> tree_billboard_input_layout;
 
     std::vector<std::unique_ptr<RenderItem>> items;
     RenderItem *wave_ritem;
+    RenderItem *land_ritem;
+    RenderItem *tree_ritem;
     std::vector<RenderItem *> ritem_layer[(size_t) RenderLayor::Count];
+    std::vector<DrawPacket> draw_list;
     std::unique_ptr<Wave> p_wave;
+    std::unique_ptr<Terrain> p_terrain;
+    // resident terrain chunks, shared by frame resources
+    std::unique_ptr<UploadBuffer<Vertex>> p_terrain_vb;
+    std::vector<TerrainChunk> terrain_chunks;
+    SubmeshGeometry terrain_stitches[kTerrainStitchCount]; // by TerrainChunk::stitch
+    std::vector<std::unique_ptr<RenderItem>> terrain_ritems;
+    uint64_t n_frame = 0;
+    SpriteField tree_field;
+    std::vector<SpriteInstance> visible_sprites;
+    bool cpu_billboard = false;
+
+    JobSystem jobs;
 
     PassConst main_pass_cb;
 
@@ -60,11 +60,13 @@ cbuffer pass_cb : register(b2) {
 struct VertexIn {
     float3 pos : POSITION;
     float2 size : SIZE;
+    uint variant : VARIANT;
 };
 
 struct VertexOut {
     float3 pos : POSITION;
     float2 size : SIZE;
+    uint variant : VARIANT;
 };
 
 struct GeometryOut {
@@ -72,19 +74,20 @@ struct GeometryOut {
     float3 pos_w : POSITION;
     float3 norm_w : NORMAL;
     float2 texc : TEXCOORD;
-    uint prim_id : SV_PrimitiveID;
+    uint variant : VARIANT;
 };
 
 VertexOut VS(VertexIn vin) {
     VertexOut vout;
     vout.pos = vin.pos;
     vout.size = vin.size;
+    vout.variant = vin.variant;
     return vout;
 }
 
+// sprites are culled & compacted every frame, so texture is chosen by variant instead of primitive id
 [maxvertexcount(4)]
-void GS(point VertexOut gin[1], uint prim_id : SV_PrimitiveID,
-        inout TriangleStream<GeometryOut> gout_stream) {
+void GS(point VertexOut gin[1], inout TriangleStream<GeometryOut> gout_stream) {
     float3 up = float3(0.0f, 1.0f, 0.0f);
     float3 look = eye - gin[0].pos;
     look.y = 0.0f;
@@ -114,13 +117,31 @@ void GS(point VertexOut gin[1], uint prim_id : SV_PrimitiveID,
         gout.pos_w = pos[i].xyz;
         gout.norm_w = look;
         gout.texc = texc[i];
-        gout.prim_id = prim_id;
+        gout.variant = gin[0].variant;
         gout_stream.Append(gout);
     }
 }
 
+struct BillboardIn {
+    float3 pos : POSITION;
+    float3 norm : NORMAL;
+    float2 texc : TEXCOORD;
+    uint variant : VARIANT;
+};
+
+// quads expanded on cpu (see Common/Billboard.h), same output as GS
+GeometryOut BillboardVS(BillboardIn vin) {
+    GeometryOut vout;
+    vout.pos = mul(vp, float4(vin.pos, 1.0f));
+    vout.pos_w = vin.pos;
+    vout.norm_w = vin.norm;
+    vout.texc = vin.texc;
+    vout.variant = vin.variant;
+    return vout;
+}
+
 float4 PS(GeometryOut pin) : SV_TARGET {
-    float3 uvw = float3(pin.texc, pin.prim_id % 3);
+    float3 uvw = float3(pin.texc, pin.variant);
     float4 albedo = tree_maps.Sample(sam_aniso_wrap, uvw) * g_albedo;
 #ifdef ALPHA_TEST
     clip(albedo.a - 0.1f);
@@ -10,7 +10,11 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "GeometryArena.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 #include "Wave.h"
 #include "BlurFilter.h"
@@ -63,25 +67,45 @@ class D3DAppBlur : public D3DApp {
 
         p_wave = std::make_unique<Wave>(p_device.Get(), p_cmd_list.Get(), 128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
         p_blur_filter = std::make_unique<BlurFilter>(p_device.Get(), client_width, client_height, back_buffer_fmt);
-
-        LoadTextures();
-        BuildRootSignature();
-        BuildWaveRootSignature();
-        BuildPostRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildWaveGeometry();
-        BuildBoxGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+        // land (2.5K vertices, 14K indices), water (16K, 97K) and box (1.2K, 2.3K) fit one pool of about 1.3MB
+        p_geo_arena = std::make_unique<GeometryArena>(*p_buffer_heap, 1 << 15, 1 << 17);
+
+        // geometry goes through p_uploads & p_geo_arena, so those stages are serialized,
+        // materials take the srv indices of the textures from the descriptor heap
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildWaveRootSignature", {}, { "wave_root_signature" },
+            [this]() { BuildWaveRootSignature(); });
+        init_graph.AddStage("BuildPostRootSignature", {}, { "post_root_signature" },
+            [this]() { BuildPostRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildLandGeometry", {}, { "land_geo" }, [this]() { BuildLandGeometry(); }, true);
+        init_graph.AddStage("BuildWaveGeometry", {}, { "water_geo" }, [this]() { BuildWaveGeometry(); }, true);
+        init_graph.AddStage("BuildBoxGeometry", {}, { "box_geo" }, [this]() { BuildBoxGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "water_geo", "box_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs",
+            { "root_signature", "wave_root_signature", "post_root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        p_uploads->Retire(curr_fence);
 
         return true;
     }
@@ -138,7 +162,7 @@ class D3DAppBlur : public D3DApp {
         p_cmd_list->OMSetRenderTargets(1, &back_buffer_view, true, &depth_stencil_view);
         
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_cbv_srv_uav_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_cbv_srv_uav_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
         // update wave
         UpdateWaves(timer);
@@ -467,14 +491,15 @@ class D3DAppBlur : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_post_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size() + p_wave->DescriptorCount() +
-            p_blur_filter->DescriptorCount();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_cbv_srv_uav_heap)));
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart());
+        UINT n_descriptor = textures.size() + p_wave->DescriptorCount() + p_blur_filter->DescriptorCount();
+        p_cbv_srv_uav_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, n_descriptor, 0, true);
+
+        DescriptorRange tex_range = p_cbv_srv_uav_heap->Allocate(textures.size());
+        texture_srv["grass"] = tex_range.offset;
+        texture_srv["water"] = tex_range.offset + 1;
+        texture_srv["fence"] = tex_range.offset + 2;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_cbv_srv_uav_heap->CpuHandle(tex_range);
         auto grass_tex = textures["grass"]->resource;
         auto water_tex = textures["water"]->resource;
         auto fence_tex = textures["fence"]->resource;
@@ -495,19 +520,13 @@ class D3DAppBlur : public D3DApp {
         srv_desc.Format = fence_tex->GetDesc().Format;
         p_device->CreateShaderResourceView(fence_tex.Get(), &srv_desc, h_srv);
 
-        p_wave->BuildDescriptors(
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart(),
-                textures.size(), cbv_srv_uav_descriptor_size),
-            CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                textures.size(), cbv_srv_uav_descriptor_size),
-            cbv_srv_uav_descriptor_size);
-
-        p_blur_filter->BuildDescriptors(
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart(),
-                textures.size() + p_wave->DescriptorCount(), cbv_srv_uav_descriptor_size),
-            CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                textures.size() + p_wave->DescriptorCount(), cbv_srv_uav_descriptor_size),
-            cbv_srv_uav_descriptor_size);
+        DescriptorRange wave_range = p_cbv_srv_uav_heap->Allocate(p_wave->DescriptorCount());
+        p_wave->BuildDescriptors(p_cbv_srv_uav_heap->CpuHandle(wave_range),
+            p_cbv_srv_uav_heap->GpuHandle(wave_range), p_cbv_srv_uav_heap->IncrementSize());
+
+        DescriptorRange blur_range = p_cbv_srv_uav_heap->Allocate(p_blur_filter->DescriptorCount());
+        p_blur_filter->BuildDescriptors(p_cbv_srv_uav_heap->CpuHandle(blur_range),
+            p_cbv_srv_uav_heap->GpuHandle(blur_range), p_cbv_srv_uav_heap->IncrementSize());
     }
     void BuildShaderAndInputLayout() {
         // defines
@@ -553,13 +572,13 @@ class D3DAppBlur : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
+            vertices[i].norm = grid.vertices[i].norm;
             vertices[i].texc = grid.vertices[i].texc;
         }
         std::vector<uint16_t> indices = grid.GetIndices16();
@@ -575,20 +594,15 @@ class D3DAppBlur : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
-
-        geo->vb_stride = sizeof(Vertex);
-        geo->vb_size = vb_size;
-        geo->index_fmt = DXGI_FORMAT_R16_UINT;
-        geo->ib_size = ib_size;
+        auto mesh = p_geo_arena->Add(*p_uploads, vertices.data(), vertices.size(), sizeof(Vertex),
+            indices.data(), indices.size(), DXGI_FORMAT_R16_UINT);
+        p_geo_arena->Bind(mesh, *geo);
+        auto range = p_geo_arena->Range(mesh);
 
         SubmeshGeometry submesh;
         submesh.n_index = indices.size();
-        submesh.start_index = 0;
-        submesh.base_vertex = 0;
+        submesh.start_index = range.start_index;
+        submesh.base_vertex = range.base_vertex;
         geo->draw_args["grid"] = submesh;
 
         geometries[geo->name] = std::move(geo);
@@ -616,20 +630,15 @@ class D3DAppBlur : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
-
-        geo->vb_stride = sizeof(Vertex);
-        geo->vb_size = vb_size;
-        geo->index_fmt = DXGI_FORMAT_R16_UINT;
-        geo->ib_size = ib_size;
+        auto mesh = p_geo_arena->Add(*p_uploads, vertices.data(), vertices.size(), sizeof(Vertex),
+            indices.data(), indices.size(), DXGI_FORMAT_R16_UINT);
+        p_geo_arena->Bind(mesh, *geo);
+        auto range = p_geo_arena->Range(mesh);
 
         SubmeshGeometry submesh;
         submesh.n_index = indices.size();
-        submesh.start_index = 0;
-        submesh.base_vertex = 0;
+        submesh.start_index = range.start_index;
+        submesh.base_vertex = range.base_vertex;
         geo->draw_args["grid"] = submesh;
 
         geometries[geo->name] = std::move(geo);
@@ -657,20 +666,15 @@ class D3DAppBlur : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
-
-        geo->vb_stride = sizeof(Vertex);
-        geo->vb_size = vb_size;
-        geo->index_fmt = DXGI_FORMAT_R16_UINT;
-        geo->ib_size = ib_size;
+        auto mesh = p_geo_arena->Add(*p_uploads, vertices.data(), vertices.size(), sizeof(Vertex),
+            indices.data(), indices.size(), DXGI_FORMAT_R16_UINT);
+        p_geo_arena->Bind(mesh, *geo);
+        auto range = p_geo_arena->Range(mesh);
 
         SubmeshGeometry submesh;
         submesh.n_index = indices.size();
-        submesh.start_index = 0;
-        submesh.base_vertex = 0;
+        submesh.start_index = range.start_index;
+        submesh.base_vertex = range.base_vertex;
         geo->draw_args["box"] = submesh;
 
         geometries[geo->name] = std::move(geo);
@@ -680,7 +684,7 @@ class D3DAppBlur : public D3DApp {
         grass->name = "grass";
         grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = 0;
-        grass->diffuse_srv_heap_index = 0;
+        grass->diffuse_srv_heap_index = texture_srv["grass"];
         grass->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -690,7 +694,7 @@ class D3DAppBlur : public D3DApp {
         water->name = "water";
         water->n_frame_dirty = n_frame_resource;
         water->mat_cb_ind = 1;
-        water->diffuse_srv_heap_index = 1;
+        water->diffuse_srv_heap_index = texture_srv["water"];
         water->albedo = { 1.0f, 1.0f, 1.0f, 0.5f }; // transparent water
         water->fresnel_r0 = { 0.2f, 0.2f, 0.2f };
         water->roughness = 0.0f;
@@ -700,7 +704,7 @@ class D3DAppBlur : public D3DApp {
         fence->name = "fence";
         fence->n_frame_dirty = n_frame_resource;
         fence->mat_cb_ind = 2;
-        fence->diffuse_srv_heap_index = 2;
+        fence->diffuse_srv_heap_index = texture_srv["fence"];
         fence->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         fence->fresnel_r0 = { 0.1f, 0.1f, 0.1f };
         fence->roughness = 0.25f;
@@ -857,13 +861,23 @@ class D3DAppBlur : public D3DApp {
         UINT mat_cb_size = D3DUtil::CBSize(sizeof(MaterialConst));
         auto obj_cb = curr_fr->p_obj_cb->Resource();
         auto mat_cb = curr_fr->p_mat_cb->Resource();
+        // meshes of the geometry arena share buffers, the input assembler is only set when they change
+        MeshGeometry *last_geo = nullptr;
+        D3D12_PRIMITIVE_TOPOLOGY last_prim_ty = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
         for (auto item : items) { // per object
             // set vb, ib and primitive type
-            auto vbv = item->geo->VertexBufferView();
-            auto ibv = item->geo->IndexBufferView();
-            cmd_list->IASetVertexBuffers(0, 1, &vbv);
-            cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(item->prim_ty);
+            if (last_geo == nullptr || item->geo->vb_gpu != last_geo->vb_gpu || item->geo->ib_gpu != last_geo->ib_gpu
+                    || item->geo->vb_offset != last_geo->vb_offset || item->geo->ib_offset != last_geo->ib_offset) {
+                auto vbv = item->geo->VertexBufferView();
+                auto ibv = item->geo->IndexBufferView();
+                cmd_list->IASetVertexBuffers(0, 1, &vbv);
+                cmd_list->IASetIndexBuffer(&ibv);
+                last_geo = item->geo;
+            }
+            if (item->prim_ty != last_prim_ty) {
+                cmd_list->IASetPrimitiveTopology(item->prim_ty);
+                last_prim_ty = item->prim_ty;
+            }
 
             // set per object cbv
             auto obj_cb_addr = obj_cb->GetGPUVirtualAddress() + item->obj_cb_ind * obj_cb_size;
@@ -872,8 +886,7 @@ class D3DAppBlur : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_cbv_srv_uav_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -881,21 +894,6 @@ class D3DAppBlur : public D3DApp {
         }
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
@@ -903,11 +901,16 @@ class D3DAppBlur : public D3DApp {
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
     ComPtr<ID3D12RootSignature> p_wave_rt_sig = nullptr;
     ComPtr<ID3D12RootSignature> p_post_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_cbv_srv_uav_heap;
+    std::unique_ptr<DescriptorHeap> p_cbv_srv_uav_heap;
+    // vertex & index buffers of all meshes, pools of the arena are allocations of the heap
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<GeometryArena> p_geo_arena;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_cbv_srv_uav_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
@@ -14,7 +14,7 @@ void RenderTarget::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv_cpu,
 }
 
 void RenderTarget::OnResize(int new_width, int new_height) {
-    if (width != new_height || height != new_height) {
+    if (width != new_width || height != new_height) {
         width = new_width;
         height = new_height;
         BuildResource();
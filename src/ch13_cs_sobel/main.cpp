@@ -10,7 +10,11 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "HeightField.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 #include "Wave.h"
 #include "RenderTarget.h"
@@ -63,30 +67,50 @@ class D3DAppSobel : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
         p_wave = std::make_unique<Wave>(p_device.Get(), p_cmd_list.Get(), 128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
         p_render_target = std::make_unique<RenderTarget>(p_device.Get(), client_width, client_height,
             back_buffer_fmt);
         p_sobel_filter = std::make_unique<SobelFilter>(p_device.Get(), client_width, client_height,
             back_buffer_fmt);
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildWaveRootSignature();
-        BuildPostRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildWaveGeometry();
-        BuildBoxGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        // geometry stages share p_uploads & p_buffer_heap and never overlap,
+        // the rest run as soon as their inputs are built
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildWaveRootSignature", {}, { "wave_root_signature" },
+            [this]() { BuildWaveRootSignature(); });
+        init_graph.AddStage("BuildPostRootSignature", {}, { "post_root_signature" },
+            [this]() { BuildPostRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildLandGeometry", {}, { "land_geo" }, [this]() { BuildLandGeometry(); }, true);
+        init_graph.AddStage("BuildWaveGeometry", {}, { "water_geo" }, [this]() { BuildWaveGeometry(); }, true);
+        init_graph.AddStage("BuildBoxGeometry", {}, { "box_geo" }, [this]() { BuildBoxGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "water_geo", "box_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs",
+            { "root_signature", "wave_root_signature", "post_root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -94,19 +118,10 @@ class D3DAppSobel : public D3DApp {
   private:
     void CreateDescriptorHeaps() override {
         // rtv (1 more rtv for RenderTarget)
-        D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc;
-        rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-        rtv_heap_desc.NumDescriptors = kSwapChainBufferCnt + 1;
-        rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        rtv_heap_desc.NodeMask = 0;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&p_rtv_heap)));
+        p_rtv_heap = std::make_unique<DescriptorHeap>(p_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
+            kSwapChainBufferCnt + 1, 0, false);
         // dsv
-        D3D12_DESCRIPTOR_HEAP_DESC dsv_heap_desc;
-        dsv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-        dsv_heap_desc.NumDescriptors = 1;
-        dsv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        dsv_heap_desc.NodeMask = 0;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&dsv_heap_desc, IID_PPV_ARGS(&p_dsv_heap)));
+        p_dsv_heap = std::make_unique<DescriptorHeap>(p_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, 0, false);
     }
 
     void OnResize() override {
@@ -164,7 +179,7 @@ class D3DAppSobel : public D3DApp {
         p_cmd_list->OMSetRenderTargets(1, &render_target_view, true, &depth_stencil_view);
         
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_cbv_srv_uav_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_cbv_srv_uav_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
         // update wave
         UpdateWaves(timer);
@@ -493,17 +508,15 @@ class D3DAppSobel : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_post_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size() + p_wave->DescriptorCount() +
-            p_render_target->DescriptorCount() + p_sobel_filter->DescriptorCount();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_cbv_srv_uav_heap)));
-
-        int offset = 0;
+        UINT n_descriptor = textures.size() + p_wave->DescriptorCount() + p_render_target->DescriptorCount() +
+            p_sobel_filter->DescriptorCount();
+        p_cbv_srv_uav_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, n_descriptor, 0, true);
 
         // textures
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart());
+        DescriptorRange tex_range = p_cbv_srv_uav_heap->Allocate(textures.size());
+        texture_srv["white"] = tex_range.offset;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_cbv_srv_uav_heap->CpuHandle(tex_range);
         auto white_tex = textures["white"]->resource;
 
         D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
@@ -514,34 +527,21 @@ class D3DAppSobel : public D3DApp {
         srv_desc.Texture2D.MipLevels = -1;
         p_device->CreateShaderResourceView(white_tex.Get(), &srv_desc, h_srv);
 
-        offset += textures.size();
-
         // wave
-        p_wave->BuildDescriptors(
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            cbv_srv_uav_descriptor_size);
-        offset += p_wave->DescriptorCount();
-
-        // render target
-        p_render_target->BuildDescriptors(
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_rtv_heap->GetCPUDescriptorHandleForHeapStart(),
-                kSwapChainBufferCnt, rtv_descriptor_size));
-        offset += p_render_target->DescriptorCount();
+        DescriptorRange wave_range = p_cbv_srv_uav_heap->Allocate(p_wave->DescriptorCount());
+        p_wave->BuildDescriptors(p_cbv_srv_uav_heap->CpuHandle(wave_range),
+            p_cbv_srv_uav_heap->GpuHandle(wave_range), p_cbv_srv_uav_heap->IncrementSize());
+
+        // render target, its rtv is the one p_rtv_heap has besides the back buffers'
+        DescriptorRange rt_srv_range = p_cbv_srv_uav_heap->Allocate(p_render_target->DescriptorCount());
+        DescriptorRange rt_rtv_range = p_rtv_heap->Allocate(1);
+        p_render_target->BuildDescriptors(p_cbv_srv_uav_heap->CpuHandle(rt_srv_range),
+            p_cbv_srv_uav_heap->GpuHandle(rt_srv_range), p_rtv_heap->CpuHandle(rt_rtv_range));
 
         // sobel filter
-        p_sobel_filter->BuildDescriptors(
-            CD3DX12_CPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                offset, cbv_srv_uav_descriptor_size),
-            cbv_srv_uav_descriptor_size);
+        DescriptorRange sobel_range = p_cbv_srv_uav_heap->Allocate(p_sobel_filter->DescriptorCount());
+        p_sobel_filter->BuildDescriptors(p_cbv_srv_uav_heap->CpuHandle(sobel_range),
+            p_cbv_srv_uav_heap->GpuHandle(sobel_range), p_cbv_srv_uav_heap->IncrementSize());
     }
     void BuildShaderAndInputLayout() {
         // defines
@@ -589,13 +589,13 @@ class D3DAppSobel : public D3DApp {
     void BuildLandGeometry() {
         GeometryGenerator geo_gen;
         GeometryGenerator::MeshData grid = geo_gen.Grid(160.0f, 160.0f, 50, 50);
+        geo_gen.ApplyHeightField(grid, HillField::Evaluate);
 
         std::vector<Vertex> vertices(grid.vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
             const auto &p = grid.vertices[i].pos;
             vertices[i].pos = p;
-            vertices[i].pos.y = GetHillHeight(p.x, p.z);
-            vertices[i].norm = GetHillNormal(p.x, p.z);
+            vertices[i].norm = grid.vertices[i].norm;
             vertices[i].texc = grid.vertices[i].texc;
         }
         std::vector<uint16_t> indices = grid.GetIndices16();
@@ -611,10 +611,12 @@ class D3DAppSobel : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -652,10 +654,12 @@ class D3DAppSobel : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -693,10 +697,12 @@ class D3DAppSobel : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(Vertex);
         geo->vb_size = vb_size;
@@ -716,7 +722,7 @@ class D3DAppSobel : public D3DApp {
         grass->name = "grass";
         grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = 0;
-        grass->diffuse_srv_heap_index = 0;
+        grass->diffuse_srv_heap_index = texture_srv["white"];
         grass->albedo = { 0.25f, 1.0f, 0.25f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -726,7 +732,7 @@ class D3DAppSobel : public D3DApp {
         water->name = "water";
         water->n_frame_dirty = n_frame_resource;
         water->mat_cb_ind = 1;
-        water->diffuse_srv_heap_index = 0;
+        water->diffuse_srv_heap_index = texture_srv["white"];
         water->albedo = { 0.15f, 0.15f, 1.0f, 0.8f }; // transparent water
         water->fresnel_r0 = { 0.2f, 0.2f, 0.2f };
         water->roughness = 0.0f;
@@ -736,7 +742,7 @@ class D3DAppSobel : public D3DApp {
         fence->name = "fence";
         fence->n_frame_dirty = n_frame_resource;
         fence->mat_cb_ind = 2;
-        fence->diffuse_srv_heap_index = 0;
+        fence->diffuse_srv_heap_index = texture_srv["white"];
         fence->albedo = { 0.7f, 0.7f, 0.7f, 1.0f };
         fence->fresnel_r0 = { 0.1f, 0.1f, 0.1f };
         fence->roughness = 0.25f;
@@ -914,8 +920,7 @@ class D3DAppSobel : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_cbv_srv_uav_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_cbv_srv_uav_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -929,21 +934,6 @@ class D3DAppSobel : public D3DApp {
         cmd_list->DrawInstanced(4, 1, 0, 0);
     }
     
-    float GetHillHeight(float x, float z) const {
-        return 0.3f * (z * std::sin(0.1f * x) + x * std::cos(0.1f * z));
-    }
-    XMFLOAT3 GetHillNormal(float x, float z) const {
-        // n = (-df/dx, 1, -df/dz)
-        XMFLOAT3 norm(
-            -0.03f * z * std::cos(0.1f * x) - 0.3f * std::cosf(0.1f * z),
-            1.0f,
-            -0.3f * std::sin(0.1f * x) + 0.03f * x * std::sin(0.1f * z)
-        );
-
-        XMStoreFloat3(&norm, XMVector3Normalize(XMLoadFloat3(&norm)));
-        return norm;
-    }
-
     std::vector<std::unique_ptr<FrameResource>> frame_resources;
     FrameResource *curr_fr = nullptr;
     int curr_fr_ind = 0;
@@ -951,11 +941,15 @@ class D3DAppSobel : public D3DApp {
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
     ComPtr<ID3D12RootSignature> p_wave_rt_sig = nullptr;
     ComPtr<ID3D12RootSignature> p_post_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_cbv_srv_uav_heap;
+    std::unique_ptr<DescriptorHeap> p_cbv_srv_uav_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_cbv_srv_uav_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
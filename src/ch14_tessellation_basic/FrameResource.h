@@ -4,6 +4,7 @@
 
 #include "D3DUtil.h"
 #include "DXMath.h"
+#include "TessFactors.h"
 #include "UploadBuffer.h"
 
 // data in cbuffer per object
@@ -44,7 +45,8 @@ struct PassConst {
 // };
 
 struct FrameResource {
-    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat);
+    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_patch,
+        UINT n_patch_index);
     FrameResource(const FrameResource &rhs) = delete;
     FrameResource &operator=(const FrameResource &rhs) = delete;
     ~FrameResource();
@@ -53,5 +55,8 @@ struct FrameResource {
     std::unique_ptr<UploadBuffer<ObjectConst>> p_obj_cb = nullptr;
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_cb = nullptr;
+    // factors and control point indices of the patches visible in this frame (PatchCull)
+    std::unique_ptr<UploadBuffer<PatchTessFactors>> p_patch_factors = nullptr;
+    std::unique_ptr<UploadBuffer<uint16_t>> p_patch_ib = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
@@ -10,13 +10,20 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "JobSystem.h"
+#include "PatchCull.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
 const int n_frame_resource = 3;
+// patches per side of the land quad
+const int kPatchGrid = 4;
 
 struct RenderItem {
     XMFLOAT4X4 model = DXMath::Identity4x4();
@@ -33,12 +40,14 @@ struct RenderItem {
 
 enum class RenderLayor : size_t {
     Opaque,
+    CulledPatch,
     Count
 };
 
 // use HS & DS to tessellate a quad according to distance to eye
 // and displace the vertices to be a hill
 // use '1' to switch on/off wireframe
+// use '2' to switch between tess factors of HS and of PatchCull (per edge, patches out of frustum are not drawn)
 
 class D3DAppTSBaisc : public D3DApp {
   public:
@@ -56,20 +65,37 @@ class D3DAppTSBaisc : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildLandGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // the land geometry also builds the patch list that sizes the frame resources
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildLandGeometry", {}, { "land_geo", "patches" },
+            [this]() { BuildLandGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "land_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials", "patches" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -98,16 +124,15 @@ class D3DAppTSBaisc : public D3DApp {
         UpdateObjectCB(timer);
         UpdatePassCB(timer);
         UpdateMaterialCB(timer);
+        UpdatePatchCulling(timer);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
         auto cmd_alloc = curr_fr->p_cmd_alloc;
         ThrowIfFailed(cmd_alloc->Reset());
-        if (b_wireframe) {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["wireframe"].Get()));
-        } else {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque"].Get()));
-        }
+        const char *pso_name = b_cpu_factors ? (b_wireframe ? "wireframe_cpu_factors" : "opaque_cpu_factors")
+            : (b_wireframe ? "wireframe" : "opaque");
+        ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos[pso_name].Get()));
 
         // viewport and scissor
         p_cmd_list->RSSetViewports(1, &viewport);
@@ -130,14 +155,21 @@ class D3DAppTSBaisc : public D3DApp {
         // set root signature
         p_cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
         // set per pass cbv
         auto pass_cb = curr_fr->p_pass_cb->Resource();
         p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+        // tess factors of visible patches, only read by the HS of cpu factors
+        auto patch_factors = curr_fr->p_patch_factors->Resource();
+        p_cmd_list->SetGraphicsRootShaderResourceView(4, patch_factors->GetGPUVirtualAddress());
 
         // draw opaque items
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
+        if (b_cpu_factors) {
+            DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::CulledPatch]);
+        } else {
+            DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
+        }
 
         // back buffer: render target -> present
         transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
@@ -187,6 +219,9 @@ class D3DAppTSBaisc : public D3DApp {
         if (GetAsyncKeyState('1') & 0x8000) {
             b_wireframe = !b_wireframe;
         }
+        if (GetAsyncKeyState('2') & 0x8000) {
+            b_cpu_factors = !b_cpu_factors;
+        }
     }
 
     void UpdateCamera(const Timer &timer) {
@@ -274,6 +309,33 @@ class D3DAppTSBaisc : public D3DApp {
             }
         }
     }
+    // frustum of the camera of this frame
+    Frustum CameraFrustum() const {
+        XMMATRIX _vp = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj));
+        XMFLOAT4X4 vp;
+        XMStoreFloat4x4(&vp, _vp);
+        return Frustum::FromViewProj(vp.m);
+    }
+    void UpdatePatchCulling(const Timer &timer) {
+        if (!b_cpu_factors) {
+            return;
+        }
+        // model of the patches is identity, frustum and eye are in patch space already
+        const Frustum frustum = CameraFrustum();
+        const size_t n_visible = CullPatches(jobs, patch_list, frustum, &eye.x, tess_rule, visible_patches.data(),
+            curr_fr->p_patch_factors->Data());
+
+        // draw visible patches in the order of their factors, so SV_PrimitiveID indexes the factors
+        const size_t n_cp = patch_list.n_cp;
+        uint16_t *indices = curr_fr->p_patch_ib->Data();
+        for (size_t i = 0; i < n_visible; i++) {
+            std::copy_n(&patch_indices[visible_patches[i] * n_cp], n_cp, indices + i * n_cp);
+        }
+        MeshGeometry *geo = culled_patch_ritem->geo;
+        geo->ib_gpu = curr_fr->p_patch_ib->Resource();
+        geo->ib_size = n_visible * n_cp * sizeof(uint16_t);
+        culled_patch_ritem->n_index = n_visible * n_cp;
+    }
     void AnimateMaterials(const Timer &timer) {
         ;
     }
@@ -322,12 +384,14 @@ class D3DAppTSBaisc : public D3DApp {
     }
 
     void BuildRootSignature() {
-        CD3DX12_ROOT_PARAMETER rt_params[4];
+        CD3DX12_ROOT_PARAMETER rt_params[5];
         rt_params[0].InitAsConstantBufferView(0);
         rt_params[1].InitAsConstantBufferView(1);
         rt_params[2].InitAsConstantBufferView(2);
         auto srv_range = CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
         rt_params[3].InitAsDescriptorTable(1, &srv_range, D3D12_SHADER_VISIBILITY_PIXEL);
+        // tess factors of PatchCull
+        rt_params[4].InitAsShaderResourceView(1);
 
         auto static_samplers = GetStaticSampler();
         CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(sizeof(rt_params) / sizeof(rt_params[0]), rt_params,
@@ -347,13 +411,13 @@ class D3DAppTSBaisc : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
 
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["white"] = tex_range.offset;
+        texture_srv["grass"] = tex_range.offset + 1;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto white_tex = textures["white"]->resource;
         auto grass_tex = textures["grass"]->resource;
 
@@ -375,6 +439,12 @@ class D3DAppTSBaisc : public D3DApp {
             nullptr, "VS", "vs_5_1");
         shaders["tess_hs"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_basic/shaders/tessellation.hlsl",
             nullptr, "HS", "hs_5_1");
+        const D3D_SHADER_MACRO cpu_factor_defines[] = {
+            "CPU_TESS_FACTORS", "1",
+            nullptr, nullptr
+        };
+        shaders["tess_hs_cpu_factors"] = D3DUtil::CompileShader(
+            src_path + L"ch14_tessellation_basic/shaders/tessellation.hlsl", cpu_factor_defines, "HS", "hs_5_1");
         shaders["tess_ds"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_basic/shaders/tessellation.hlsl",
             nullptr, "DS", "ds_5_1");
         shaders["tess_ps"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_basic/shaders/tessellation.hlsl",
@@ -386,14 +456,34 @@ class D3DAppTSBaisc : public D3DApp {
         };
     }
     void BuildLandGeometry() {
-        std::array<XMFLOAT3, 4> vertices = {
-            XMFLOAT3(-10.0f, 0.0f, -10.0f),
-            XMFLOAT3(-10.0f, 0.0f,  10.0f),
-            XMFLOAT3( 10.0f, 0.0f, -10.0f),
-            XMFLOAT3( 10.0f, 0.0f,  10.0f)
-        };
+        // the quad is split into kPatchGrid x kPatchGrid patches, so they can be culled one by one
+        const int n = kPatchGrid;
+        std::vector<XMFLOAT3> vertices;
+        for (int i = 0; i <= n; i++) {
+            for (int j = 0; j <= n; j++) {
+                vertices.push_back(XMFLOAT3(-10.0f + 20.0f * i / n, 0.0f, -10.0f + 20.0f * j / n));
+            }
+        }
+        // corners in the order of the whole quad, (-x, -z), (-x, +z), (+x, -z), (+x, +z)
+        patch_indices.clear();
+        patch_cp.clear();
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                const uint16_t v0 = i * (n + 1) + j;
+                for (uint16_t id : { v0, (uint16_t) (v0 + 1), (uint16_t) (v0 + n + 1), (uint16_t) (v0 + n + 2) }) {
+                    patch_indices.push_back(id);
+                    patch_cp.push_back(vertices[id]);
+                }
+            }
+        }
+        patch_list.cp = reinterpret_cast<const float (*)[3]>(patch_cp.data());
+        patch_list.n_cp = 4;
+        patch_list.n_patch = (size_t) n * n;
+        // DS sets y to 0.3 * (z * sin(x) + x * cos(z)), |y| <= 0.3 * (10 + 10)
+        patch_list.bound_pad[1] = 6.0f;
+        visible_patches.resize(patch_list.n_patch);
 
-        std::array<uint16_t, 4> indices = { 0, 1, 2, 3 };
+        std::vector<uint16_t> indices = patch_indices;
 
         const UINT vb_size = vertices.size() * sizeof(XMFLOAT3);
         const UINT ib_size = indices.size() * sizeof(uint16_t);
@@ -406,10 +496,12 @@ class D3DAppTSBaisc : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(XMFLOAT3);
         geo->vb_size = vb_size;
@@ -422,7 +514,17 @@ class D3DAppTSBaisc : public D3DApp {
         submesh.base_vertex = 0;
         geo->draw_args["quad_patch"] = submesh;
 
+        // same vertices, indices of the visible patches are in frame resources, see UpdatePatchCulling
+        auto culled_geo = std::make_unique<MeshGeometry>();
+        culled_geo->name = "culled_patch_geo";
+        culled_geo->vb_gpu = geo->vb_gpu;
+        culled_geo->vb_offset = geo->vb_offset;
+        culled_geo->vb_stride = geo->vb_stride;
+        culled_geo->vb_size = geo->vb_size;
+        culled_geo->index_fmt = DXGI_FORMAT_R16_UINT;
+
         geometries[geo->name] = std::move(geo);
+        geometries[culled_geo->name] = std::move(culled_geo);
     }
     void BuildMaterials() {
         int mat_cb_ind = 0;
@@ -431,7 +533,7 @@ class D3DAppTSBaisc : public D3DApp {
         white->name = "white";
         white->n_frame_dirty = n_frame_resource;
         white->mat_cb_ind = mat_cb_ind++;
-        white->diffuse_srv_heap_index = 0;
+        white->diffuse_srv_heap_index = texture_srv["white"];
         white->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         white->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         white->roughness = 0.125f;
@@ -441,7 +543,7 @@ class D3DAppTSBaisc : public D3DApp {
         grass->name = "grass";
         grass->n_frame_dirty = n_frame_resource;
         grass->mat_cb_ind = mat_cb_ind++;
-        grass->diffuse_srv_heap_index = 1;
+        grass->diffuse_srv_heap_index = texture_srv["grass"];
         grass->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         grass->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         grass->roughness = 0.125f;
@@ -485,11 +587,24 @@ class D3DAppTSBaisc : public D3DApp {
         wireframe_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
         ThrowIfFailed(p_device->CreateGraphicsPipelineState(&wireframe_pso_desc,
             IID_PPV_ARGS(&psos["wireframe"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_factors_pso_desc = opaque_pso_desc;
+        cpu_factors_pso_desc.HS = {
+            reinterpret_cast<BYTE *>(shaders["tess_hs_cpu_factors"]->GetBufferPointer()),
+            shaders["tess_hs_cpu_factors"]->GetBufferSize()
+        };
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_factors_pso_desc,
+            IID_PPV_ARGS(&psos["opaque_cpu_factors"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_factors_wireframe_pso_desc = cpu_factors_pso_desc;
+        cpu_factors_wireframe_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_factors_wireframe_pso_desc,
+            IID_PPV_ARGS(&psos["wireframe_cpu_factors"])));
     }
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
             frame_resources.push_back(std::make_unique<FrameResource>(p_device.Get(), 1,
-                items.size(), materials.size()));
+                items.size(), materials.size(), patch_list.n_patch, patch_indices.size()));
         }
     }
     void BuildRenderItems() {
@@ -505,6 +620,15 @@ class D3DAppTSBaisc : public D3DApp {
         grid_ritem->base_vertex = grid_ritem->geo->draw_args["quad_patch"].base_vertex;
         ritem_layer[(size_t) RenderLayor::Opaque].push_back(grid_ritem.get());
         items.push_back(std::move(grid_ritem));
+
+        auto culled_ritem = std::make_unique<RenderItem>();
+        culled_ritem->obj_cb_ind = obj_cb_ind++;
+        culled_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST;
+        culled_ritem->mat = materials["grass"].get();
+        culled_ritem->geo = geometries["culled_patch_geo"].get();
+        culled_patch_ritem = culled_ritem.get();
+        ritem_layer[(size_t) RenderLayor::CulledPatch].push_back(culled_ritem.get());
+        items.push_back(std::move(culled_ritem));
     }
 
     void DrawRenderItems(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
@@ -527,8 +651,7 @@ class D3DAppTSBaisc : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -541,11 +664,15 @@ class D3DAppTSBaisc : public D3DApp {
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
@@ -558,6 +685,16 @@ class D3DAppTSBaisc : public D3DApp {
     PassConst main_pass_cb;
 
     bool b_wireframe = true;
+    bool b_cpu_factors = false;
+
+    JobSystem jobs;
+    PatchList patch_list;
+    std::vector<XMFLOAT3> patch_cp;
+    std::vector<uint16_t> patch_indices;
+    std::vector<uint32_t> visible_patches;
+    // same as ConstHS of tessellation.hlsl
+    TessDistanceRule tess_rule = { 20.0f, 100.0f, 16.0f };
+    RenderItem *culled_patch_ritem = nullptr;
 
     XMFLOAT3 eye = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 view = DXMath::Identity4x4();
@@ -71,6 +71,16 @@ VertexOut VS(VertexIn vin) {
     return vout;
 }
 
+#ifdef CPU_TESS_FACTORS
+// factors of the drawn patches computed on cpu (PatchCull), in draw order
+struct PatchFactors {
+    float edge[4];
+    float inside[2];
+};
+
+StructuredBuffer<PatchFactors> patch_factors : register(t1);
+#endif
+
 struct PatchTess {
     float edge_tess[4] : SV_TessFactor;
     float inside_tess[2] : SV_InsideTessFactor;
@@ -79,13 +89,24 @@ struct PatchTess {
 PatchTess ConstHS(InputPatch<VertexOut, 4> patch, uint pid : SV_PrimitiveID) {
     PatchTess pt;
 
-    float3 center = 0.25f * (patch[0].pos + patch[1].pos, patch[2].pos, patch[3].pos);
+#ifdef CPU_TESS_FACTORS
+    PatchFactors factors = patch_factors[pid];
+    pt.edge_tess[0] = factors.edge[0];
+    pt.edge_tess[1] = factors.edge[1];
+    pt.edge_tess[2] = factors.edge[2];
+    pt.edge_tess[3] = factors.edge[3];
+
+    pt.inside_tess[0] = factors.inside[0];
+    pt.inside_tess[1] = factors.inside[1];
+#else
+    float3 center = 0.25f * (patch[0].pos + patch[1].pos + patch[2].pos + patch[3].pos);
     center = mul(model, float4(center, 1.0f));
     float dist = distance(center, eye);
 
     const float d0 = 20.0f;
     const float d1 = 100.0f;
-    float tess = 63.0f * saturate((d1 - dist) / (d1 - d0)) + 1.0f;
+    // the land is 4 x 4 patches, 16 per patch keeps the density of 64 of a single quad
+    float tess = 15.0f * saturate((d1 - dist) / (d1 - d0)) + 1.0f;
 
     pt.edge_tess[0] = tess;
     pt.edge_tess[1] = tess;
@@ -94,6 +115,7 @@ PatchTess ConstHS(InputPatch<VertexOut, 4> patch, uint pid : SV_PrimitiveID) {
 
     pt.inside_tess[0] = tess;
     pt.inside_tess[1] = tess;
+#endif
 
     return pt;
 }
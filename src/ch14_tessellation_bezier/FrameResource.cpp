@@ -1,12 +1,17 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat) {
+FrameResource::FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_tess_vertex,
+        UINT n_tess_index, UINT n_patch, UINT n_patch_index) {
     ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
         IID_PPV_ARGS(&p_cmd_alloc)));
 
     p_pass_cb = std::make_unique<UploadBuffer<PassConst>>(device, n_pass, true);
     p_obj_cb = std::make_unique<UploadBuffer<ObjectConst>>(device, n_obj, true);
     p_mat_cb = std::make_unique<UploadBuffer<MaterialConst>>(device, n_mat, true);
+    p_patch_factors = std::make_unique<UploadBuffer<PatchTessFactors>>(device, n_patch, false);
+    p_patch_ib = std::make_unique<UploadBuffer<uint16_t>>(device, n_patch_index, false);
+    p_tess_vb = std::make_unique<UploadBuffer<Vertex>>(device, n_tess_vertex, false);
+    p_tess_ib = std::make_unique<UploadBuffer<uint32_t>>(device, n_tess_index, false);
 }
 
 FrameResource::~FrameResource() {}
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "D3DUtil.h"
 #include "DXMath.h"
+#include "TessFactors.h"
 #include "UploadBuffer.h"
 
 // data in cbuffer per object
@@ -37,14 +38,15 @@ struct PassConst {
     Light lights[MAX_N_LIGHT];
 };
 
-// struct Vertex {
-//     DirectX::XMFLOAT3 pos;
-//     DirectX::XMFLOAT3 norm;
-//     DirectX::XMFLOAT2 texc;
-// };
+struct Vertex {
+    DirectX::XMFLOAT3 pos;
+    DirectX::XMFLOAT3 norm;
+    DirectX::XMFLOAT2 texc;
+};
 
 struct FrameResource {
-    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat);
+    FrameResource(ID3D12Device *device, UINT n_pass, UINT n_obj, UINT n_mat, UINT n_tess_vertex,
+        UINT n_tess_index, UINT n_patch, UINT n_patch_index);
     FrameResource(const FrameResource &rhs) = delete;
     FrameResource &operator=(const FrameResource &rhs) = delete;
     ~FrameResource();
@@ -53,5 +55,11 @@ struct FrameResource {
     std::unique_ptr<UploadBuffer<ObjectConst>> p_obj_cb = nullptr;
     std::unique_ptr<UploadBuffer<PassConst>> p_pass_cb = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConst>> p_mat_cb = nullptr;
+    // patch tessellated on cpu in this frame
+    std::unique_ptr<UploadBuffer<Vertex>> p_tess_vb = nullptr;
+    std::unique_ptr<UploadBuffer<uint32_t>> p_tess_ib = nullptr;
+    // factors and control point indices of the patches visible in this frame (PatchCull)
+    std::unique_ptr<UploadBuffer<PatchTessFactors>> p_patch_factors = nullptr;
+    std::unique_ptr<UploadBuffer<uint16_t>> p_patch_ib = nullptr;
     UINT64 fence = 0;
 };
\ No newline at end of file
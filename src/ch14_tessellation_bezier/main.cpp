@@ -10,13 +10,22 @@
 #include "../defines.h"
 #include "D3DApp.h"
 #include "D3DUtil.h"
+#include "DescriptorHeap.h"
+#include "BufferHeap.h"
 #include "GeometryGenerator.h"
+#include "BezierPatch.h"
+#include "JobSystem.h"
+#include "PatchCull.h"
+#include "TaskGraph.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
 const int n_frame_resource = 3;
+// one patch at most 64 x 64 quads
+const UINT kMaxTessVertex = 65 * 65;
+const UINT kMaxTessIndex = 64 * 64 * 6;
 
 struct RenderItem {
     XMFLOAT4X4 model = DXMath::Identity4x4();
@@ -31,13 +40,26 @@ struct RenderItem {
     int base_vertex = 0;
 };
 
+// cpu tessellated vertex as drawn, tangent is not used by the shaders
+Vertex ToVertex(const BezierVertex &v) {
+    Vertex res;
+    res.pos = XMFLOAT3(v.pos[0], v.pos[1], v.pos[2]);
+    res.norm = XMFLOAT3(v.norm[0], v.norm[1], v.norm[2]);
+    res.texc = XMFLOAT2(v.texc[0], v.texc[1]);
+    return res;
+}
+
 enum class RenderLayor : size_t {
     Opaque,
+    CulledPatch,
+    CpuTessellated,
     Count
 };
 
 // use HS & DS to get a cubic Bezier surface
 // use '1' to switch on/off wireframe
+// use '2' to switch between HS & DS and the patch tessellated on cpu (BezierPatch) with the distance rule
+// use '3' to switch between tess factors of HS and of PatchCull (per edge, patches out of frustum are not drawn)
 
 class D3DAppTSBezier : public D3DApp {
   public:
@@ -55,20 +77,37 @@ class D3DAppTSBezier : public D3DApp {
 
         ThrowIfFailed(p_cmd_list->Reset(p_cmd_allocator.Get(), nullptr));
 
-        LoadTextures();
-        BuildRootSignature();
-        BuildDescriptorHeaps();
-        BuildShaderAndInputLayout();
-        BuildQuadPatchGeometry();
-        BuildMaterials();
-        BuildRenderItems();
-        BuildFrameResources();
-        BuildPSOs();
-
+        p_uploads = std::make_unique<UploadManager>(p_device.Get());
+        p_buffer_heap = std::make_unique<BufferHeap>(p_device.Get());
+
+        // the patch geometry also builds the patch list that sizes the frame resources
+        TaskGraph init_graph;
+        init_graph.AddStage("LoadTextures", {}, { "textures" }, [this]() { LoadTextures(); });
+        init_graph.AddStage("BuildRootSignature", {}, { "root_signature" }, [this]() { BuildRootSignature(); });
+        init_graph.AddStage("BuildDescriptorHeaps", { "textures" }, { "srv_heap" },
+            [this]() { BuildDescriptorHeaps(); });
+        init_graph.AddStage("BuildShaderAndInputLayout", {}, { "shaders", "input_layout" },
+            [this]() { BuildShaderAndInputLayout(); });
+        init_graph.AddStage("BuildQuadPatchGeometry", {}, { "patch_geo", "patches" },
+            [this]() { BuildQuadPatchGeometry(); }, true);
+        init_graph.AddStage("BuildMaterials", { "srv_heap" }, { "materials" }, [this]() { BuildMaterials(); });
+        init_graph.AddStage("BuildRenderItems", { "patch_geo", "materials" }, { "render_items" },
+            [this]() { BuildRenderItems(); });
+        init_graph.AddStage("BuildFrameResources", { "render_items", "materials", "patches" }, { "frame_resources" },
+            [this]() { BuildFrameResources(); });
+        init_graph.AddStage("BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" },
+            [this]() { BuildPSOs(); });
+        init_graph.Run();
+        OutputDebugStringA(("[init]\n" + init_graph.Report()).c_str());
+
+        // FlushCommandQueue() signals the next fence
+        p_uploads->Flush(p_cmd_list.Get(), curr_fence + 1);
         ThrowIfFailed(p_cmd_list->Close());
         ID3D12CommandList *cmds[] = { p_cmd_list.Get() };
         p_cmd_queue->ExecuteCommandLists(sizeof(cmds) / sizeof(cmds[0]), cmds);
         FlushCommandQueue();
+        // nothing is uploaded after init, the staging ring can go
+        p_uploads.reset();
 
         return true;
     }
@@ -97,16 +136,17 @@ class D3DAppTSBezier : public D3DApp {
         UpdateObjectCB(timer);
         UpdatePassCB(timer);
         UpdateMaterialCB(timer);
+        UpdateCpuTessellation(timer);
+        UpdatePatchCulling(timer);
     }
     void Draw(const Timer &timer) override {
         // reset cmd list and cmd alloc
         auto cmd_alloc = curr_fr->p_cmd_alloc;
         ThrowIfFailed(cmd_alloc->Reset());
-        if (b_wireframe) {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["wireframe"].Get()));
-        } else {
-            ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos["opaque"].Get()));
-        }
+        const char *pso_name = b_cpu_tess ? (b_wireframe ? "cpu_tess_wireframe" : "cpu_tess")
+            : b_cpu_factors ? (b_wireframe ? "wireframe_cpu_factors" : "opaque_cpu_factors")
+            : (b_wireframe ? "wireframe" : "opaque");
+        ThrowIfFailed(p_cmd_list->Reset(cmd_alloc.Get(), psos[pso_name].Get()));
 
         // viewport and scissor
         p_cmd_list->RSSetViewports(1, &viewport);
@@ -129,14 +169,23 @@ class D3DAppTSBezier : public D3DApp {
         // set root signature
         p_cmd_list->SetGraphicsRootSignature(p_rt_sig.Get());
         // set cbv/srv/uav heaps
-        ID3D12DescriptorHeap *heaps[] = { p_srv_heap.Get() };
+        ID3D12DescriptorHeap *heaps[] = { p_srv_heap->Heap() };
         p_cmd_list->SetDescriptorHeaps(sizeof(heaps) / sizeof(heaps[0]), heaps);
         // set per pass cbv
         auto pass_cb = curr_fr->p_pass_cb->Resource();
         p_cmd_list->SetGraphicsRootConstantBufferView(2, pass_cb->GetGPUVirtualAddress());
+        // tess factors of visible patches, only read by the HS of cpu factors
+        auto patch_factors = curr_fr->p_patch_factors->Resource();
+        p_cmd_list->SetGraphicsRootShaderResourceView(4, patch_factors->GetGPUVirtualAddress());
 
         // draw opaque items
-        DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
+        if (b_cpu_tess) {
+            DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::CpuTessellated]);
+        } else if (b_cpu_factors) {
+            DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::CulledPatch]);
+        } else {
+            DrawRenderItems(p_cmd_list.Get(), ritem_layer[(size_t) RenderLayor::Opaque]);
+        }
 
         // back buffer: render target -> present
         transit_barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrBackBuffer(),
@@ -186,6 +235,12 @@ class D3DAppTSBezier : public D3DApp {
         if (GetAsyncKeyState('1') & 0x8000) {
             b_wireframe = !b_wireframe;
         }
+        if (GetAsyncKeyState('3') & 0x8000) {
+            b_cpu_factors = !b_cpu_factors;
+        }
+        if (GetAsyncKeyState('2') & 0x8000) {
+            b_cpu_tess = !b_cpu_tess;
+        }
     }
 
     void UpdateCamera(const Timer &timer) {
@@ -273,6 +328,56 @@ class D3DAppTSBezier : public D3DApp {
             }
         }
     }
+    void UpdateCpuTessellation(const Timer &timer) {
+        if (!b_cpu_tess) {
+            return;
+        }
+        // model of the patch is identity, eye is in patch space already
+        const float eye_patch[3] = { eye.x, eye.y, eye.z };
+        tess_mesh.vertices.clear();
+        tess_mesh.indices.clear();
+        TessellateBezierPatches(jobs, &quad_patch, 1, eye_patch, tess_rule, tess_mesh);
+
+        Vertex *vertices = curr_fr->p_tess_vb->Data();
+        for (size_t i = 0; i < tess_mesh.vertices.size(); i++) {
+            vertices[i] = ToVertex(tess_mesh.vertices[i]);
+        }
+        std::copy(tess_mesh.indices.begin(), tess_mesh.indices.end(), curr_fr->p_tess_ib->Data());
+
+        MeshGeometry *geo = cpu_tess_ritem->geo;
+        geo->vb_gpu = curr_fr->p_tess_vb->Resource();
+        geo->vb_size = tess_mesh.vertices.size() * sizeof(Vertex);
+        geo->ib_gpu = curr_fr->p_tess_ib->Resource();
+        geo->ib_size = tess_mesh.indices.size() * sizeof(uint32_t);
+        cpu_tess_ritem->n_index = tess_mesh.indices.size();
+    }
+    // frustum of the camera of this frame
+    Frustum CameraFrustum() const {
+        XMMATRIX _vp = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj));
+        XMFLOAT4X4 vp;
+        XMStoreFloat4x4(&vp, _vp);
+        return Frustum::FromViewProj(vp.m);
+    }
+    void UpdatePatchCulling(const Timer &timer) {
+        if (!b_cpu_factors) {
+            return;
+        }
+        // model of the patches is identity, frustum and eye are in patch space already
+        const Frustum frustum = CameraFrustum();
+        const size_t n_visible = CullPatches(jobs, patch_list, frustum, &eye.x, tess_rule, visible_patches.data(),
+            curr_fr->p_patch_factors->Data());
+
+        // draw visible patches in the order of their factors, so SV_PrimitiveID indexes the factors
+        const size_t n_cp = patch_list.n_cp;
+        uint16_t *indices = curr_fr->p_patch_ib->Data();
+        for (size_t i = 0; i < n_visible; i++) {
+            std::copy_n(&patch_indices[visible_patches[i] * n_cp], n_cp, indices + i * n_cp);
+        }
+        MeshGeometry *geo = culled_patch_ritem->geo;
+        geo->ib_gpu = curr_fr->p_patch_ib->Resource();
+        geo->ib_size = n_visible * n_cp * sizeof(uint16_t);
+        culled_patch_ritem->n_index = n_visible * n_cp;
+    }
     void AnimateMaterials(const Timer &timer) {
         ;
     }
@@ -314,12 +419,14 @@ class D3DAppTSBezier : public D3DApp {
     }
 
     void BuildRootSignature() {
-        CD3DX12_ROOT_PARAMETER rt_params[4];
+        CD3DX12_ROOT_PARAMETER rt_params[5];
         rt_params[0].InitAsConstantBufferView(0);
         rt_params[1].InitAsConstantBufferView(1);
         rt_params[2].InitAsConstantBufferView(2);
         auto srv_range = CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
         rt_params[3].InitAsDescriptorTable(1, &srv_range, D3D12_SHADER_VISIBILITY_PIXEL);
+        // tess factors of PatchCull
+        rt_params[4].InitAsShaderResourceView(1);
 
         auto static_samplers = GetStaticSampler();
         CD3DX12_ROOT_SIGNATURE_DESC rt_sig_desc(sizeof(rt_params) / sizeof(rt_params[0]), rt_params,
@@ -339,13 +446,12 @@ class D3DAppTSBezier : public D3DApp {
             serialized_rt_sig->GetBufferSize(), IID_PPV_ARGS(&p_rt_sig)));
     }
     void BuildDescriptorHeaps() {
-        D3D12_DESCRIPTOR_HEAP_DESC srv_heap_desc = {};
-        srv_heap_desc.NumDescriptors = textures.size();
-        srv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        ThrowIfFailed(p_device->CreateDescriptorHeap(&srv_heap_desc, IID_PPV_ARGS(&p_srv_heap)));
+        p_srv_heap = std::make_unique<DescriptorHeap>(p_device.Get(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, textures.size(), 0, true);
 
-        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv(p_srv_heap->GetCPUDescriptorHandleForHeapStart());
+        DescriptorRange tex_range = p_srv_heap->Allocate(textures.size());
+        texture_srv["white"] = tex_range.offset;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE h_srv = p_srv_heap->CpuHandle(tex_range);
         auto white_tex = textures["white"]->resource;
 
         D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
@@ -362,15 +468,30 @@ class D3DAppTSBezier : public D3DApp {
             nullptr, "VS", "vs_5_1");
         shaders["tess_hs"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_bezier/shaders/tessellation.hlsl",
             nullptr, "HS", "hs_5_1");
+        const D3D_SHADER_MACRO cpu_factor_defines[] = {
+            "CPU_TESS_FACTORS", "1",
+            nullptr, nullptr
+        };
+        shaders["tess_hs_cpu_factors"] = D3DUtil::CompileShader(
+            src_path + L"ch14_tessellation_bezier/shaders/tessellation.hlsl", cpu_factor_defines, "HS", "hs_5_1");
         shaders["tess_ds"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_bezier/shaders/tessellation.hlsl",
             nullptr, "DS", "ds_5_1");
         shaders["tess_ps"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_bezier/shaders/tessellation.hlsl",
             nullptr, "PS", "ps_5_1");
+        shaders["standard_vs"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_bezier/shaders/P3N3U2_default.hlsl",
+            nullptr, "VS", "vs_5_1");
+        shaders["opaque_ps"] = D3DUtil::CompileShader(src_path + L"ch14_tessellation_bezier/shaders/P3N3U2_default.hlsl",
+            nullptr, "PS", "ps_5_1");
 
         // input layout and input elements specify input of (vertex) shader
         std_input_layout = {
             { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         };
+        cpu_tess_input_layout = {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+        };
     }
     void BuildQuadPatchGeometry() {
         std::array<XMFLOAT3, 16> vertices = {
@@ -397,6 +518,18 @@ class D3DAppTSBezier : public D3DApp {
         };
 
         std::array<uint16_t, 16> indices = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+        for (size_t i = 0; i < vertices.size(); i++) {
+            quad_patch.cp[i][0] = vertices[i].x;
+            quad_patch.cp[i][1] = vertices[i].y;
+            quad_patch.cp[i][2] = vertices[i].z;
+        }
+        // a bezier patch is inside the hull of its control points, no padding
+        patch_cp.assign(vertices.begin(), vertices.end());
+        patch_indices.assign(indices.begin(), indices.end());
+        patch_list.cp = reinterpret_cast<const float (*)[3]>(patch_cp.data());
+        patch_list.n_cp = 16;
+        patch_list.n_patch = 1;
+        visible_patches.resize(patch_list.n_patch);
 
         const UINT vb_size = vertices.size() * sizeof(XMFLOAT3);
         const UINT ib_size = indices.size() * sizeof(uint16_t);
@@ -409,10 +542,12 @@ class D3DAppTSBezier : public D3DApp {
         ThrowIfFailed(D3DCreateBlob(ib_size, &geo->ib_cpu));
         CopyMemory(geo->ib_cpu->GetBufferPointer(), indices.data(), ib_size);
 
-        geo->vb_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            vertices.data(), vb_size, geo->vb_uploader);
-        geo->ib_gpu = D3DUtil::CreateDefaultBuffer(p_device.Get(), p_cmd_list.Get(),
-            indices.data(), ib_size, geo->ib_uploader);
+        auto vb_alloc = p_buffer_heap->Create(*p_uploads, vertices.data(), vb_size);
+        geo->vb_gpu = p_buffer_heap->Resource(vb_alloc);
+        geo->vb_offset = p_buffer_heap->Offset(vb_alloc);
+        auto ib_alloc = p_buffer_heap->Create(*p_uploads, indices.data(), ib_size);
+        geo->ib_gpu = p_buffer_heap->Resource(ib_alloc);
+        geo->ib_offset = p_buffer_heap->Offset(ib_alloc);
 
         geo->vb_stride = sizeof(XMFLOAT3);
         geo->vb_size = vb_size;
@@ -425,7 +560,24 @@ class D3DAppTSBezier : public D3DApp {
         submesh.base_vertex = 0;
         geo->draw_args["quad_patch"] = submesh;
 
+        // same vertices, indices of the visible patches are in frame resources, see UpdatePatchCulling
+        auto culled_geo = std::make_unique<MeshGeometry>();
+        culled_geo->name = "culled_patch_geo";
+        culled_geo->vb_gpu = geo->vb_gpu;
+        culled_geo->vb_offset = geo->vb_offset;
+        culled_geo->vb_stride = geo->vb_stride;
+        culled_geo->vb_size = geo->vb_size;
+        culled_geo->index_fmt = DXGI_FORMAT_R16_UINT;
+
         geometries[geo->name] = std::move(geo);
+        geometries[culled_geo->name] = std::move(culled_geo);
+
+        // buffers of the cpu tessellated patch are in frame resources, see UpdateCpuTessellation
+        auto tess_geo = std::make_unique<MeshGeometry>();
+        tess_geo->name = "cpu_tess_geo";
+        tess_geo->vb_stride = sizeof(Vertex);
+        tess_geo->index_fmt = DXGI_FORMAT_R32_UINT;
+        geometries[tess_geo->name] = std::move(tess_geo);
     }
     void BuildMaterials() {
         int mat_cb_ind = 0;
@@ -434,7 +586,7 @@ class D3DAppTSBezier : public D3DApp {
         white->name = "white";
         white->n_frame_dirty = n_frame_resource;
         white->mat_cb_ind = mat_cb_ind++;
-        white->diffuse_srv_heap_index = 0;
+        white->diffuse_srv_heap_index = texture_srv["white"];
         white->albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
         white->fresnel_r0 = { 0.01f, 0.01f, 0.01f };
         white->roughness = 0.125f;
@@ -478,11 +630,46 @@ class D3DAppTSBezier : public D3DApp {
         wireframe_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
         ThrowIfFailed(p_device->CreateGraphicsPipelineState(&wireframe_pso_desc,
             IID_PPV_ARGS(&psos["wireframe"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_factors_pso_desc = opaque_pso_desc;
+        cpu_factors_pso_desc.HS = {
+            reinterpret_cast<BYTE *>(shaders["tess_hs_cpu_factors"]->GetBufferPointer()),
+            shaders["tess_hs_cpu_factors"]->GetBufferSize()
+        };
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_factors_pso_desc,
+            IID_PPV_ARGS(&psos["opaque_cpu_factors"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_factors_wireframe_pso_desc = cpu_factors_pso_desc;
+        cpu_factors_wireframe_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_factors_wireframe_pso_desc,
+            IID_PPV_ARGS(&psos["wireframe_cpu_factors"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_tess_pso_desc = opaque_pso_desc;
+        cpu_tess_pso_desc.InputLayout = { cpu_tess_input_layout.data(), (UINT) cpu_tess_input_layout.size() };
+        cpu_tess_pso_desc.VS = {
+            reinterpret_cast<BYTE *>(shaders["standard_vs"]->GetBufferPointer()),
+            shaders["standard_vs"]->GetBufferSize()
+        };
+        cpu_tess_pso_desc.HS = {};
+        cpu_tess_pso_desc.DS = {};
+        cpu_tess_pso_desc.PS = {
+            reinterpret_cast<BYTE *>(shaders["opaque_ps"]->GetBufferPointer()),
+            shaders["opaque_ps"]->GetBufferSize()
+        };
+        cpu_tess_pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_tess_pso_desc,
+            IID_PPV_ARGS(&psos["cpu_tess"])));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC cpu_tess_wireframe_pso_desc = cpu_tess_pso_desc;
+        cpu_tess_wireframe_pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        ThrowIfFailed(p_device->CreateGraphicsPipelineState(&cpu_tess_wireframe_pso_desc,
+            IID_PPV_ARGS(&psos["cpu_tess_wireframe"])));
     }
     void BuildFrameResources() {
         for (int i = 0; i < n_frame_resource; i++) {
             frame_resources.push_back(std::make_unique<FrameResource>(p_device.Get(), 1,
-                items.size(), materials.size()));
+                items.size(), materials.size(), kMaxTessVertex, kMaxTessIndex, patch_list.n_patch,
+                patch_indices.size()));
         }
     }
     void BuildRenderItems() {
@@ -498,6 +685,23 @@ class D3DAppTSBezier : public D3DApp {
         grid_ritem->base_vertex = grid_ritem->geo->draw_args["quad_patch"].base_vertex;
         ritem_layer[(size_t) RenderLayor::Opaque].push_back(grid_ritem.get());
         items.push_back(std::move(grid_ritem));
+
+        auto culled_ritem = std::make_unique<RenderItem>();
+        culled_ritem->obj_cb_ind = obj_cb_ind++;
+        culled_ritem->prim_ty = D3D_PRIMITIVE_TOPOLOGY_16_CONTROL_POINT_PATCHLIST;
+        culled_ritem->mat = materials["white"].get();
+        culled_ritem->geo = geometries["culled_patch_geo"].get();
+        culled_patch_ritem = culled_ritem.get();
+        ritem_layer[(size_t) RenderLayor::CulledPatch].push_back(culled_ritem.get());
+        items.push_back(std::move(culled_ritem));
+
+        auto tess_ritem = std::make_unique<RenderItem>();
+        tess_ritem->obj_cb_ind = obj_cb_ind++;
+        tess_ritem->mat = materials["white"].get();
+        tess_ritem->geo = geometries["cpu_tess_geo"].get();
+        cpu_tess_ritem = tess_ritem.get();
+        ritem_layer[(size_t) RenderLayor::CpuTessellated].push_back(tess_ritem.get());
+        items.push_back(std::move(tess_ritem));
     }
 
     void DrawRenderItems(ID3D12GraphicsCommandList *cmd_list, const std::vector<RenderItem *> &items) {
@@ -520,8 +724,7 @@ class D3DAppTSBezier : public D3DApp {
             auto mat_cb_addr = mat_cb->GetGPUVirtualAddress() + item->mat->mat_cb_ind * mat_cb_size;
             cmd_list->SetGraphicsRootConstantBufferView(1, mat_cb_addr);
             // set texture srv (descriptor table)
-            auto diffuse_tex = CD3DX12_GPU_DESCRIPTOR_HANDLE(p_srv_heap->GetGPUDescriptorHandleForHeapStart(),
-                item->mat->diffuse_srv_heap_index, cbv_srv_uav_descriptor_size);
+            auto diffuse_tex = p_srv_heap->GpuHandle(item->mat->diffuse_srv_heap_index);
             cmd_list->SetGraphicsRootDescriptorTable(3, diffuse_tex);
 
             // draw
@@ -534,16 +737,21 @@ class D3DAppTSBezier : public D3DApp {
     int curr_fr_ind = 0;
 
     ComPtr<ID3D12RootSignature> p_rt_sig = nullptr;
-    ComPtr<ID3D12DescriptorHeap> p_srv_heap;
+    std::unique_ptr<DescriptorHeap> p_srv_heap;
+    // vertex & index buffers of all static meshes
+    std::unique_ptr<BufferHeap> p_buffer_heap;
+    std::unique_ptr<UploadManager> p_uploads;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> materials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
+    std::unordered_map<std::string, UINT> texture_srv; // index of srv in p_srv_heap
     std::unordered_map<std::string, ComPtr<ID3DBlob>> shaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psos;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> std_input_layout;
     std::vector<D3D12_INPUT_ELEMENT_DESC> tree_sprite_input_layout;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> cpu_tess_input_layout;
 
     std::vector<std::unique_ptr<RenderItem>> items;
     std::vector<RenderItem *> ritem_layer[(size_t) RenderLayor::Count];
@@ -551,6 +759,20 @@ class D3DAppTSBezier : public D3DApp {
     PassConst main_pass_cb;
 
     bool b_wireframe = true;
+    bool b_cpu_factors = false;
+    bool b_cpu_tess = false;
+
+    JobSystem jobs;
+    BezierPatch quad_patch;
+    BezierMesh tess_mesh;
+    RenderItem *cpu_tess_ritem = nullptr;
+
+    PatchList patch_list;
+    std::vector<XMFLOAT3> patch_cp;
+    std::vector<uint16_t> patch_indices;
+    std::vector<uint32_t> visible_patches;
+    TessDistanceRule tess_rule;
+    RenderItem *culled_patch_ritem = nullptr;
 
     XMFLOAT3 eye = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 view = DXMath::Identity4x4();
@@ -71,6 +71,16 @@ VertexOut VS(VertexIn vin) {
     return vout;
 }
 
+#ifdef CPU_TESS_FACTORS
+// factors of the drawn patches computed on cpu (PatchCull), in draw order
+struct PatchFactors {
+    float edge[4];
+    float inside[2];
+};
+
+StructuredBuffer<PatchFactors> patch_factors : register(t1);
+#endif
+
 struct PatchTess {
     float edge_tess[4] : SV_TessFactor;
     float inside_tess[2] : SV_InsideTessFactor;
@@ -79,6 +89,16 @@ struct PatchTess {
 PatchTess ConstHS(InputPatch<VertexOut, 16> patch, uint pid : SV_PrimitiveID) {
     PatchTess pt;
 
+#ifdef CPU_TESS_FACTORS
+    PatchFactors factors = patch_factors[pid];
+    pt.edge_tess[0] = factors.edge[0];
+    pt.edge_tess[1] = factors.edge[1];
+    pt.edge_tess[2] = factors.edge[2];
+    pt.edge_tess[3] = factors.edge[3];
+
+    pt.inside_tess[0] = factors.inside[0];
+    pt.inside_tess[1] = factors.inside[1];
+#else
     float tess = 25.0f;
 
     pt.edge_tess[0] = tess;
@@ -88,6 +108,7 @@ PatchTess ConstHS(InputPatch<VertexOut, 16> patch, uint pid : SV_PrimitiveID) {
 
     pt.inside_tess[0] = tess;
     pt.inside_tess[1] = tess;
+#endif
 
     return pt;
 }
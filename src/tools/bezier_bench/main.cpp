@@ -0,0 +1,261 @@
+// check BezierPatch evaluation against the Bernstein sum in double, that tessellated vertices lie on the patch and
+// that neighbors sharing an edge tessellate it with bitwise equal vertices, then time TessellateBezierPatches,
+// exits with 1 if a check fails
+// usage: bezier_bench [n_thread]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "BezierPatch.h"
+#include "JobSystem.h"
+#include "Random.h"
+
+const int kRuns = 10;
+// of positions & derivatives relative to the size of the patch, and of normals
+const double kTolerance = 1e-5;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// n x n patches on a lattice of 3n + 1 points per side with spacing 1, neighbors share their edge control points
+std::vector<BezierPatch> PatchGrid(int n, float amplitude) {
+    auto point = [amplitude](int i, int j, float out[3]) {
+        out[0] = (float) i;
+        out[1] = amplitude * std::sin(0.3f * i) * std::cos(0.2f * j);
+        out[2] = (float) j;
+    };
+    std::vector<BezierPatch> patches((size_t) n * n);
+    for (int pj = 0; pj < n; pj++) {
+        for (int pi = 0; pi < n; pi++) {
+            BezierPatch &patch = patches[(size_t) pj * n + pi];
+            for (int k = 0; k < 16; k++) {
+                point(3 * pi + k % 4, 3 * pj + k / 4, patch.cp[k]);
+            }
+        }
+    }
+    return patches;
+}
+
+// pos, dp/du & dp/dv of the Bernstein sum in double
+void Reference(const BezierPatch &patch, double u, double v, double pos[3], double du[3], double dv[3]) {
+    auto basis = [](double t, double b[4], double db[4]) {
+        const double s = 1.0 - t;
+        b[0] = s * s * s;
+        b[1] = 3.0 * s * s * t;
+        b[2] = 3.0 * s * t * t;
+        b[3] = t * t * t;
+        db[0] = -3.0 * s * s;
+        db[1] = 3.0 * s * s - 6.0 * s * t;
+        db[2] = 6.0 * s * t - 3.0 * t * t;
+        db[3] = 3.0 * t * t;
+    };
+    double bu[4], dbu[4], bv[4], dbv[4];
+    basis(u, bu, dbu);
+    basis(v, bv, dbv);
+    for (int k = 0; k < 3; k++) {
+        pos[k] = du[k] = dv[k] = 0.0;
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                const double p = patch.cp[4 * j + i][k];
+                pos[k] += p * bu[i] * bv[j];
+                du[k] += p * dbu[i] * bv[j];
+                dv[k] += p * bu[i] * dbv[j];
+            }
+        }
+    }
+}
+
+// vertices of the mesh on a patch edge, u = 0, v = 0, u = 1 or v = 1 as PatchTessFactors, sorted by position bits
+std::vector<std::array<float, 3>> EdgeVertices(const BezierMesh &mesh, int edge) {
+    std::vector<std::array<float, 3>> points;
+    for (const BezierVertex &vertex : mesh.vertices) {
+        const float t = vertex.texc[edge % 2 == 0 ? 0 : 1];
+        if (t == (edge < 2 ? 0.0f : 1.0f)) {
+            points.push_back({ vertex.pos[0], vertex.pos[1], vertex.pos[2] });
+        }
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    return points;
+}
+
+// reverse the rows of a patch, which reverses its edges along v
+BezierPatch FlipV(const BezierPatch &patch) {
+    BezierPatch flipped;
+    for (int k = 0; k < 16; k++) {
+        std::copy(patch.cp[k], patch.cp[k] + 3, flipped.cp[4 * (3 - k / 4) + k % 4]);
+    }
+    return flipped;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("evaluation against the Bernstein sum\n");
+    {
+        Random rng(1, 0);
+        double max_err = 0.0;
+        for (int p = 0; p < 100; p++) {
+            BezierPatch patch;
+            rng.FillF(&patch.cp[0][0], 48, -10.0f, 10.0f);
+            for (int s = 0; s < 100; s++) {
+                const float u = rng.NextF(), v = rng.NextF();
+                float pos[3], du[3], dv[3];
+                double ref_pos[3], ref_du[3], ref_dv[3];
+                EvaluateBezierPatch(patch, u, v, pos, du, dv);
+                Reference(patch, u, v, ref_pos, ref_du, ref_dv);
+                for (int k = 0; k < 3; k++) {
+                    // control points up to 10, derivatives up to 3 * 20
+                    max_err = std::max({ max_err, std::abs(pos[k] - ref_pos[k]) / 10.0,
+                        std::abs(du[k] - ref_du[k]) / 60.0, std::abs(dv[k] - ref_dv[k]) / 60.0 });
+                }
+            }
+        }
+        const bool pass = max_err < kTolerance;
+        ok = ok && pass;
+        std::printf("  100 random patches, 100 points each: max error %.1e %s\n", max_err, pass ? "ok" : "FAILED");
+    }
+
+    std::printf("tessellated vertices & triangles\n");
+    {
+        const std::vector<BezierPatch> patches = PatchGrid(2, 1.5f);
+        double max_pos = 0.0, max_norm = 0.0;
+        bool indices_valid = true, ccw = true;
+        size_t n_triangle = 0;
+        for (float f0 : { 1.0f, 3.0f, 7.5f, 64.0f }) {
+            for (float f1 : { 1.0f, 4.0f, 16.0f }) {
+                // every edge different from the inside on some of them, so edge vertices snap
+                const PatchTessFactors factors = { { f0, f1, 2.0f, f0 }, { std::max(f0, f1), std::max(f0, f1) } };
+                for (const BezierPatch &patch : patches) {
+                    BezierMesh mesh;
+                    TessellateBezierPatch(patch, factors, mesh);
+                    for (const BezierVertex &vertex : mesh.vertices) {
+                        double pos[3], du[3], dv[3];
+                        Reference(patch, vertex.texc[0], vertex.texc[1], pos, du, dv);
+                        double n[3] = { du[1] * dv[2] - du[2] * dv[1], du[2] * dv[0] - du[0] * dv[2],
+                            du[0] * dv[1] - du[1] * dv[0] };
+                        const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                        for (int k = 0; k < 3; k++) {
+                            max_pos = std::max(max_pos, std::abs(vertex.pos[k] - pos[k]) / 4.0);
+                            max_norm = std::max(max_norm, std::abs(vertex.norm[k] - n[k] / len));
+                        }
+                    }
+                    for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+                        const uint32_t *tri = mesh.indices.data() + t;
+                        if (tri[0] >= mesh.vertices.size() || tri[1] >= mesh.vertices.size() ||
+                            tri[2] >= mesh.vertices.size() || tri[0] == tri[1] || tri[1] == tri[2] ||
+                            tri[0] == tri[2]) {
+                            indices_valid = false;
+                            continue;
+                        }
+                        // ccw seen from the side of the normal
+                        const float *a = mesh.vertices[tri[0]].pos, *b = mesh.vertices[tri[1]].pos;
+                        const float *c = mesh.vertices[tri[2]].pos;
+                        const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                        const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                        const float cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                            e1[0] * e2[1] - e1[1] * e2[0] };
+                        const float *normal = mesh.vertices[tri[0]].norm;
+                        ccw = ccw && cross[0] * normal[0] + cross[1] * normal[1] + cross[2] * normal[2] > 0.0f;
+                        n_triangle++;
+                    }
+                }
+            }
+        }
+        const bool on_patch = max_pos < kTolerance && max_norm < kTolerance;
+        ok = ok && on_patch;
+        std::printf("  vertices at their (u, v) on the patch: position error %.1e, normal error %.1e %s\n", max_pos,
+            max_norm, on_patch ? "ok" : "FAILED");
+        check(indices_valid, "indices in range, no degenerate triangles");
+        check(ccw && n_triangle > 0, "triangles ccw seen from the side of the normal");
+    }
+
+    std::printf("shared edges\n");
+    {
+        // a row of patches with the eye at one end, so factors change from patch to patch
+        const std::vector<BezierPatch> grid = PatchGrid(4, 2.0f);
+        TessDistanceRule rule;
+        rule.d0 = 2.0f;
+        rule.d1 = 14.0f;
+        bool same_factor = true, watertight = true, reversed_ok = true;
+        size_t n_edge = 0;
+        for (const auto &eye : { std::array<float, 3> { -1.0f, 3.0f, -1.0f },
+                std::array<float, 3> { 6.0f, 2.0f, 6.0f }, std::array<float, 3> { 13.0f, 8.0f, 2.0f } }) {
+            for (int pj = 0; pj < 4; pj++) {
+                for (int pi = 0; pi < 4; pi++) {
+                    const BezierPatch &patch = grid[pj * 4 + pi];
+                    const PatchTessFactors factors = ComputeBezierTessFactors(patch, eye.data(), rule);
+                    BezierMesh mesh;
+                    TessellateBezierPatch(patch, factors, mesh);
+                    // the neighbor along +u shares this u = 1 edge as its u = 0 edge, the one along +v v = 1 as v = 0
+                    for (int side = 0; side < 2; side++) {
+                        const int ni = pi + (side == 0), nj = pj + (side == 1);
+                        if (ni >= 4 || nj >= 4) {
+                            continue;
+                        }
+                        const BezierPatch &neighbor = grid[nj * 4 + ni];
+                        const PatchTessFactors n_factors = ComputeBezierTessFactors(neighbor, eye.data(), rule);
+                        const int edge = side == 0 ? 2 : 3, n_edge_id = side == 0 ? 0 : 1;
+                        same_factor = same_factor && factors.edge[edge] == n_factors.edge[n_edge_id];
+                        BezierMesh n_mesh;
+                        TessellateBezierPatch(neighbor, n_factors, n_mesh);
+                        watertight = watertight && EdgeVertices(mesh, edge) == EdgeVertices(n_mesh, n_edge_id);
+                        n_edge++;
+
+                        // the neighbor flipped along v walks the shared u = 0 edge the other way
+                        if (side == 0) {
+                            const BezierPatch flipped = FlipV(neighbor);
+                            const PatchTessFactors f_factors = ComputeBezierTessFactors(flipped, eye.data(), rule);
+                            BezierMesh f_mesh;
+                            TessellateBezierPatch(flipped, f_factors, f_mesh);
+                            reversed_ok = reversed_ok && f_factors.edge[0] == factors.edge[2] &&
+                                EdgeVertices(f_mesh, 0) == EdgeVertices(mesh, 2);
+                        }
+                    }
+                }
+            }
+        }
+        std::printf("  %zu shared edges\n", n_edge);
+        check(same_factor, "neighbors get the same factor for a shared edge");
+        check(watertight, "neighbors have bitwise equal vertices on a shared edge");
+        check(reversed_ok, "same when the neighbor walks the edge the other way");
+    }
+
+    std::printf("tessellation, %u threads\n", jobs.ThreadCount());
+    for (int n : { 8, 32 }) {
+        const std::vector<BezierPatch> patches = PatchGrid(n, 2.0f);
+        TessDistanceRule rule;
+        for (const auto &eye : { std::array<float, 3> { -20.0f, 10.0f, -20.0f },
+                std::array<float, 3> { 1.5f * n, 5.0f, 1.5f * n } }) {
+            BezierMesh mesh;
+            double best_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                mesh.vertices.clear();
+                mesh.indices.clear();
+                auto begin = std::chrono::steady_clock::now();
+                TessellateBezierPatches(jobs, patches.data(), patches.size(), eye.data(), rule, mesh);
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            std::printf("  %4zu patches, eye %s: %8zu vertices, %8zu triangles, %8.3f ms, %6.2f M vertices/s\n",
+                patches.size(), eye[0] < 0.0f ? "outside" : "center ", mesh.vertices.size(), mesh.indices.size() / 3,
+                best_ms, mesh.vertices.size() / (best_ms * 1e3));
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
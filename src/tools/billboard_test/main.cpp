@@ -0,0 +1,202 @@
+// check ExpandBillboards & BuildBillboardIndices against the geometry shader of ch12_gs (tree_sprite.hlsl GS)
+// transcribed in double, and time the expansion, exits with 1 if a check fails
+// usage: billboard_test [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Billboard.h"
+#include "JobSystem.h"
+#include "Random.h"
+
+const int kRuns = 10;
+// of positions relative to the size of the scene, and of normals
+const double kTolerance = 1e-5;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+struct GsVertex {
+    double pos[3];
+    double norm[3];
+    double texc[2];
+    uint32_t variant;
+};
+
+// the GS: look = normalize(eye - pos) with y = 0, right = cross(look, up), 4 corners emitted as a triangle strip
+void ReferenceGs(const SpriteInstance &sprite, const float eye[3], GsVertex out[4]) {
+    double look[3] = { (double) eye[0] - sprite.pos[0], 0.0, (double) eye[2] - sprite.pos[2] };
+    const double len = std::sqrt(look[0] * look[0] + look[2] * look[2]);
+    look[0] /= len;
+    look[2] /= len;
+    const double up[3] = { 0.0, 1.0, 0.0 };
+    const double right[3] = {
+        look[1] * up[2] - look[2] * up[1],
+        look[2] * up[0] - look[0] * up[2],
+        look[0] * up[1] - look[1] * up[0]
+    };
+    const double hw = sprite.size[0] * 0.5, hh = sprite.size[1] * 0.5;
+    const double sign_right[4] = { 1.0, 1.0, -1.0, -1.0 };
+    const double sign_up[4] = { 1.0, -1.0, 1.0, -1.0 };
+    const double texc[4][2] = { { 0.0, 0.0 }, { 0.0, 1.0 }, { 1.0, 0.0 }, { 1.0, 1.0 } };
+    for (int i = 0; i < 4; i++) {
+        for (int k = 0; k < 3; k++) {
+            out[i].pos[k] = sprite.pos[k] + sign_right[i] * hw * right[k] + sign_up[i] * hh * up[k];
+            out[i].norm[k] = look[k];
+        }
+        out[i].texc[0] = texc[i][0];
+        out[i].texc[1] = texc[i][1];
+        out[i].variant = sprite.variant;
+    }
+}
+
+std::vector<SpriteInstance> RandomSprites(size_t n, uint64_t seed) {
+    Random rng(seed, n);
+    std::vector<SpriteInstance> sprites(n);
+    for (SpriteInstance &sprite : sprites) {
+        sprite.pos[0] = rng.RandF(-100.0f, 100.0f);
+        sprite.pos[1] = rng.RandF(0.0f, 20.0f);
+        sprite.pos[2] = rng.RandF(-100.0f, 100.0f);
+        sprite.size[0] = rng.RandF(4.0f, 16.0f);
+        sprite.size[1] = rng.RandF(4.0f, 16.0f);
+        sprite.variant = (uint32_t) rng.RandI(0, 2);
+    }
+    return sprites;
+}
+
+// largest difference from the GS over all vertices, with the scene size 100 scaling position errors
+double MaxError(const std::vector<SpriteInstance> &sprites, const float eye[3], const BillboardVertex *vertices,
+    bool &same_attributes) {
+    double max_err = 0.0;
+    same_attributes = true;
+    for (size_t s = 0; s < sprites.size(); s++) {
+        GsVertex expected[4];
+        ReferenceGs(sprites[s], eye, expected);
+        for (int i = 0; i < 4; i++) {
+            const BillboardVertex &v = vertices[s * kBillboardVertexCount + i];
+            for (int k = 0; k < 3; k++) {
+                max_err = std::max({ max_err, std::abs(v.pos[k] - expected[i].pos[k]) / 100.0,
+                    std::abs(v.norm[k] - expected[i].norm[k]) });
+            }
+            same_attributes = same_attributes && v.texc[0] == expected[i].texc[0] &&
+                v.texc[1] == expected[i].texc[1] && v.variant == expected[i].variant;
+        }
+    }
+    return max_err;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("expansion against the GS\n");
+    const float eyes[][3] = { { 0.0f, 30.0f, -150.0f }, { 3.0f, 5.0f, 2.0f }, { 250.0f, 80.0f, 10.0f } };
+    // counts that aren't multiples of 4 or of a job leave a tail for the scalar path
+    for (size_t n : { (size_t) 1, (size_t) 7, (size_t) 1023, (size_t) 4099, (size_t) 100003 }) {
+        const std::vector<SpriteInstance> sprites = RandomSprites(n, 1);
+        double max_err = 0.0;
+        bool same_attributes = true, deterministic = true;
+        for (const auto &eye : eyes) {
+            std::vector<BillboardVertex> vertices(n * kBillboardVertexCount), one_thread(n * kBillboardVertexCount);
+            ExpandBillboards(jobs, sprites.data(), n, eye, vertices.data());
+            ExpandBillboards(single, sprites.data(), n, eye, one_thread.data());
+            bool same = true;
+            max_err = std::max(max_err, MaxError(sprites, eye, vertices.data(), same));
+            same_attributes = same_attributes && same;
+            deterministic = deterministic && std::memcmp(vertices.data(), one_thread.data(),
+                vertices.size() * sizeof(BillboardVertex)) == 0;
+        }
+        const bool pass = max_err < kTolerance && same_attributes && deterministic;
+        ok = ok && pass;
+        std::printf("  %6zu sprites: max error %.1e, %s, %s %s\n", n, max_err,
+            same_attributes ? "same texc & variant" : "texc or variant differ",
+            deterministic ? "deterministic" : "differs across threads", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("corner cases\n");
+    {
+        // the GS would normalize a zero vector, the cpu version looks along +z
+        SpriteInstance sprite = { { 5.0f, 2.0f, -3.0f }, { 4.0f, 6.0f }, 1 };
+        const float eye[3] = { 5.0f, 40.0f, -3.0f };
+        std::vector<SpriteInstance> sprites(5, sprite);
+        BillboardVertex vertices[5 * kBillboardVertexCount];
+        ExpandBillboards(single, sprites.data(), sprites.size(), eye, vertices);
+        bool along_z = true;
+        for (const BillboardVertex &v : vertices) {
+            along_z = along_z && v.norm[0] == 0.0f && v.norm[1] == 0.0f && v.norm[2] == 1.0f &&
+                std::abs(v.pos[2] - sprite.pos[2]) == 0.0f && std::abs(std::abs(v.pos[0] - 5.0f) - 2.0f) < 1e-6f;
+        }
+        check(along_z, "eye right above a sprite (sse & scalar path) gives a quad facing +z");
+
+        // the quad faces the eye: corners are half the width from the center, both triangles wind the same way
+        const std::vector<SpriteInstance> random = RandomSprites(64, 2);
+        const float far_eye[3] = { 30.0f, 10.0f, 70.0f };
+        std::vector<BillboardVertex> quads(64 * kBillboardVertexCount);
+        ExpandBillboards(single, random.data(), random.size(), far_eye, quads.data());
+        uint32_t indices[kBillboardIndexCount];
+        BuildBillboardIndices(1, indices);
+        bool facing = true;
+        for (size_t s = 0; s < random.size(); s++) {
+            const BillboardVertex *q = quads.data() + s * kBillboardVertexCount;
+            for (size_t t = 0; t < kBillboardIndexCount; t += 3) {
+                const float *a = q[indices[t]].pos, *b = q[indices[t + 1]].pos, *c = q[indices[t + 2]].pos;
+                const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                const float normal[3] = {
+                    e1[1] * e2[2] - e1[2] * e2[1],
+                    e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]
+                };
+                const float to_eye[2] = { far_eye[0] - random[s].pos[0], far_eye[2] - random[s].pos[2] };
+                facing = facing && normal[0] * to_eye[0] + normal[2] * to_eye[1] > 0.0f;
+            }
+            const float dx = q[0].pos[0] - random[s].pos[0], dz = q[0].pos[2] - random[s].pos[2];
+            facing = facing && std::abs(std::sqrt(dx * dx + dz * dz) - 0.5f * random[s].size[0]) < 1e-4f;
+        }
+        check(facing, "both triangles of every quad face the eye, corners half the width from the center");
+
+        // strip 0 1 2 3 as triangles, the second one flipped to keep the winding
+        std::vector<uint32_t> many(3 * kBillboardIndexCount);
+        BuildBillboardIndices(3, many.data());
+        bool strip = true;
+        for (uint32_t s = 0; s < 3; s++) {
+            const uint32_t b = s * kBillboardVertexCount;
+            const uint32_t expected[kBillboardIndexCount] = { b, b + 1, b + 2, b + 2, b + 1, b + 3 };
+            strip = strip && std::equal(expected, expected + kBillboardIndexCount, many.data() + s * 6);
+        }
+        check(strip, "indices are the GS triangle strip of every quad");
+    }
+
+    std::printf("expansion, %u threads\n", jobs.ThreadCount());
+    const float eye[3] = { 0.0f, 30.0f, -150.0f };
+    for (size_t n : { (size_t) 10000, (size_t) 100000, (size_t) 1000000 }) {
+        const std::vector<SpriteInstance> sprites = RandomSprites(n, 3);
+        std::vector<BillboardVertex> vertices(n * kBillboardVertexCount);
+        double best_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            ExpandBillboards(jobs, sprites.data(), n, eye, vertices.data());
+            const double ms = Milliseconds(begin);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+        }
+        const double mb = n * kBillboardVertexCount * sizeof(BillboardVertex) / (1024.0 * 1024.0);
+        std::printf("  %7zu sprites: %7.3f ms, %6.2f M sprites/s, %7.1f MB/s written\n", n, best_ms,
+            n / (best_ms * 1e3), mb / (best_ms * 1e-3));
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
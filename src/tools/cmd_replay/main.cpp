@@ -0,0 +1,147 @@
+// replay a command stream captured by CapturedCommandList and report what the frame submitted
+// usage: cmd_replay <capture file>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "CommandStream.h"
+
+struct LayerStats {
+    std::string name;
+    size_t n_command = 0;
+    size_t n_draw = 0;
+    size_t n_instance = 0;
+    uint64_t n_index = 0;
+    size_t n_state_set = 0;
+    size_t n_redundant = 0;
+    size_t n_barrier = 0;
+    size_t n_byte = 0;
+};
+
+// state bound by a set command, keyed by (op, slot, offset), offset is the destination of root constants
+struct BoundState {
+    uint64_t value = 0;
+    int64_t args[CommandEvent::kMaxArgs] = {};
+
+    bool operator==(const BoundState &rhs) const {
+        if (value != rhs.value) {
+            return false;
+        }
+        for (int i = 0; i < CommandEvent::kMaxArgs; i++) {
+            if (args[i] != rhs.args[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::printf("usage: %s <capture file>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (!CommandStreamReader::Load(argv[1], data)) {
+        std::printf("failed to load '%s'\n", argv[1]);
+        return 1;
+    }
+    const size_t n_byte = data.size();
+    CommandStreamReader reader(std::move(data));
+
+    std::vector<LayerStats> layers(1);
+    layers[0].name = "(none)";
+    std::map<std::tuple<int, int, int64_t>, BoundState> bound;
+    size_t op_count[(size_t) CommandOp::Count] = {};
+    size_t op_redundant[(size_t) CommandOp::Count] = {};
+    size_t n_list = 0;
+
+    CommandEvent event;
+    size_t last_offset = 0;
+    while (reader.Next(event)) {
+        LayerStats *layer = &layers.back();
+        ++op_count[(size_t) event.op];
+
+        switch (event.op) {
+            case CommandOp::BeginList:
+                bound.clear();
+                ++n_list;
+                break;
+            case CommandOp::BeginLayer:
+                layers.emplace_back();
+                layers.back().name = event.name;
+                layer = &layers.back();
+                break;
+            case CommandOp::Barrier:
+                ++layer->n_barrier;
+                break;
+            case CommandOp::DrawIndexed:
+                ++layer->n_draw;
+                layer->n_instance += event.args[1];
+                layer->n_index += (uint64_t) event.args[0] * event.args[1];
+                break;
+            case CommandOp::Draw:
+                ++layer->n_draw;
+                layer->n_instance += event.args[1];
+                layer->n_index += (uint64_t) event.args[0] * event.args[1];
+                break;
+            default:
+                break;
+        }
+
+        if (IsStateOp(event.op)) {
+            ++layer->n_state_set;
+            BoundState state;
+            state.value = event.value;
+            for (int i = 0; i < CommandEvent::kMaxArgs; i++) {
+                state.args[i] = event.args[i];
+            }
+            const int64_t offset = event.op == CommandOp::SetRootConstant ? event.args[0] : 0;
+            auto key = std::make_tuple((int) event.op, (int) event.slot, offset);
+            auto it = bound.find(key);
+            if (it != bound.end() && it->second == state) {
+                ++layer->n_redundant;
+                ++op_redundant[(size_t) event.op];
+            } else {
+                bound[key] = state;
+            }
+        }
+
+        ++layer->n_command;
+        layer->n_byte += reader.Offset() - last_offset;
+        last_offset = reader.Offset();
+    }
+    if (reader.Corrupted()) {
+        std::printf("warning: stream is corrupted at byte %zu, report is partial\n", reader.Offset());
+    }
+
+    size_t n_command = 0;
+    for (size_t i = 0; i < (size_t) CommandOp::Count; i++) {
+        n_command += op_count[i];
+    }
+    std::printf("%zu commands in %zu bytes (%.2f bytes/command), %zu command lists\n\n", n_command, n_byte,
+        n_command > 0 ? (double) n_byte / n_command : 0.0, n_list);
+
+    std::printf("%-20s %10s %10s\n", "command", "count", "redundant");
+    for (size_t i = 0; i < (size_t) CommandOp::Count; i++) {
+        if (op_count[i] > 0) {
+            std::printf("%-20s %10zu %10zu\n", CommandOpName((CommandOp) i), op_count[i], op_redundant[i]);
+        }
+    }
+
+    std::printf("\n%-16s %8s %8s %10s %8s %10s %8s %8s\n", "layer", "draws", "inst", "indices", "states",
+        "redundant", "barrier", "bytes");
+    for (const auto &layer : layers) {
+        if (layer.n_command == 0) {
+            continue;
+        }
+        std::printf("%-16s %8zu %8zu %10llu %8zu %10zu %8zu %8zu\n", layer.name.c_str(), layer.n_draw,
+            layer.n_instance, (unsigned long long) layer.n_index, layer.n_state_set, layer.n_redundant,
+            layer.n_barrier, layer.n_byte);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+// check CommandStreamWriter / CommandStreamReader: every kind of command decodes to the fields it was recorded with,
+// through memory and through a saved file, and a truncated or corrupted stream is reported instead of decoded,
+// exits with 1 if a check fails
+// usage: command_stream_test
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "CommandStream.h"
+#include "Random.h"
+
+namespace fs = std::filesystem;
+
+// which fields each op encodes, written out again here so that the test doesn't share the encoder's table
+struct OpFields {
+    bool has_slot;
+    bool has_value;
+    int n_arg;
+};
+
+const OpFields kOpFields[] = {
+    { false, false, 0 }, // BeginList
+    { false, false, 0 }, // BeginLayer
+    { false, true, 0 },  // SetPipelineState
+    { false, true, 0 },  // SetRootSignature
+    { false, true, 1 },  // SetDescriptorHeaps
+    { false, false, 4 }, // SetViewport
+    { false, false, 4 }, // SetScissor
+    { false, true, 2 },  // SetRenderTargets
+    { false, true, 0 },  // ClearRenderTarget
+    { false, true, 0 },  // ClearDepthStencil
+    { false, true, 2 },  // Barrier
+    { true, true, 2 },   // SetVertexBuffer
+    { false, true, 2 },  // SetIndexBuffer
+    { false, false, 1 }, // SetTopology
+    { true, true, 0 },   // SetRootCbv
+    { true, true, 0 },   // SetRootTable
+    { false, false, 5 }, // DrawIndexed
+    { false, false, 4 }, // Draw
+    { true, true, 0 },   // SetRootSrv
+    { true, true, 1 },   // SetRootConstant
+};
+static_assert(sizeof(kOpFields) / sizeof(kOpFields[0]) == (size_t) CommandOp::Count);
+
+int64_t RandomField(Random &rng, int64_t prev) {
+    switch (rng.RandI(0, 5)) {
+        case 0:
+            return prev;
+        case 1:
+            return (int64_t) ((uint64_t) prev + (uint64_t) rng.RandI(-64, 64));
+        case 2:
+            return rng.RandI(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+        case 3:
+            return std::numeric_limits<int64_t>::min() + rng.RandI(0, 1);
+        case 4:
+            return std::numeric_limits<int64_t>::max() - rng.RandI(0, 1);
+        default:
+            // gpu virtual address like
+            return (int64_t) ((uint64_t) rng.NextU32() << 16 | (uint64_t) rng.RandI(0, 255) << 8);
+    }
+}
+
+// a command with only the fields its op encodes set, so it should decode back to itself
+CommandEvent RandomEvent(Random &rng, CommandOp op, const CommandEvent &prev) {
+    const OpFields &fields = kOpFields[(size_t) op];
+    CommandEvent event;
+    event.op = op;
+    if (fields.has_slot) {
+        event.slot = (uint8_t) rng.RandI(0, CommandEvent::kMaxSlot - 1);
+    }
+    if (fields.has_value) {
+        event.value = (uint64_t) RandomField(rng, (int64_t) prev.value);
+    }
+    for (int i = 0; i < fields.n_arg; i++) {
+        event.args[i] = RandomField(rng, prev.args[i]);
+    }
+    if (op == CommandOp::BeginLayer) {
+        const int length = rng.RandI(0, 3) == 0 ? rng.RandI(128, 300) : rng.RandI(0, 12);
+        for (int i = 0; i < length; i++) {
+            event.name.push_back((char) rng.RandI(0, 255));
+        }
+    }
+    return event;
+}
+
+std::vector<char> ReadBytes(const fs::path &filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+void WriteBytes(const fs::path &filename, const std::vector<char> &bytes) {
+    std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+    fout.write(bytes.data(), bytes.size());
+}
+
+bool SameEvent(const CommandEvent &a, const CommandEvent &b) {
+    if (a.op != b.op || a.slot != b.slot || a.value != b.value || a.name != b.name) {
+        return false;
+    }
+    for (int i = 0; i < CommandEvent::kMaxArgs; i++) {
+        if (a.args[i] != b.args[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// decode all of data, false if a command differs from events or the stream doesn't end cleanly after them
+bool DecodesTo(std::vector<uint8_t> data, const std::vector<CommandEvent> &events) {
+    const size_t n_byte = data.size();
+    CommandStreamReader reader(std::move(data));
+    CommandEvent event;
+    for (const CommandEvent &expected : events) {
+        if (!reader.Next(event) || !SameEvent(event, expected)) {
+            return false;
+        }
+    }
+    return !reader.Next(event) && !reader.Corrupted() && reader.Offset() == n_byte;
+}
+
+// decode until the reader stops, number of commands decoded
+size_t DecodeAll(std::vector<uint8_t> data, bool &corrupted) {
+    CommandStreamReader reader(std::move(data));
+    CommandEvent event;
+    size_t n_command = 0;
+    while (reader.Next(event)) {
+        n_command++;
+    }
+    corrupted = reader.Corrupted();
+    return n_command;
+}
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    // every op a few hundred times in random order, interleaved so that deltas run across other ops and slots
+    const int kPerOp = 300;
+    Random rng(1, 0);
+    std::vector<CommandEvent> events;
+    std::vector<CommandEvent> prev((size_t) CommandOp::Count);
+    CommandStreamWriter writer;
+    std::vector<size_t> ends; // end offset of each command in the stream
+    for (int i = 0; i < kPerOp * (int) CommandOp::Count; i++) {
+        const CommandOp op = (CommandOp) rng.RandI(0, (int) CommandOp::Count - 1);
+        events.push_back(RandomEvent(rng, op, prev[(size_t) op]));
+        prev[(size_t) op] = events.back();
+        writer.Record(events.back());
+        ends.push_back(writer.Data().size());
+    }
+    std::printf("%zu commands, %zu bytes\n", events.size(), writer.Data().size());
+
+    {
+        std::vector<bool> seen((size_t) CommandOp::Count, false);
+        for (const CommandEvent &event : events) {
+            seen[(size_t) event.op] = true;
+        }
+        bool all_ops = true;
+        for (bool b : seen) {
+            all_ops = all_ops && b;
+        }
+        check(all_ops && writer.CommandCount() == events.size(), "every kind of command is recorded");
+        check(DecodesTo(writer.Data(), events), "every command decodes field by field to what was recorded");
+    }
+
+    {
+        // fields an op doesn't encode come back as zero instead of whatever the caller left in them
+        CommandEvent event;
+        event.op = CommandOp::SetTopology;
+        event.slot = 5;
+        event.value = 123;
+        event.args[0] = 4;
+        event.args[1] = 7;
+        event.name = "ignored";
+        CommandEvent expected;
+        expected.op = CommandOp::SetTopology;
+        expected.args[0] = 4;
+        CommandStreamWriter w;
+        w.Record(event);
+        check(DecodesTo(w.Data(), { expected }), "fields an op doesn't use aren't encoded");
+    }
+
+    {
+        const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        const fs::path file = fs::temp_directory_path() / ("command_stream_test_" + std::to_string(stamp) + ".cmds");
+        std::vector<uint8_t> data;
+        const bool b_loaded = writer.Save(file) && CommandStreamReader::Load(file, data);
+        check(b_loaded && data == writer.Data() && DecodesTo(data, events), "saved file loads back the same commands");
+
+        // bad magic, bad version, header cut short, no file
+        const std::vector<char> saved = ReadBytes(file);
+        bool rejected = saved.size() > 5;
+        for (size_t at : { 0, 4 }) {
+            std::vector<char> bytes = saved;
+            bytes[at] ^= 0x5a;
+            WriteBytes(file, bytes);
+            rejected = rejected && !CommandStreamReader::Load(file, data);
+        }
+        WriteBytes(file, std::vector<char>(saved.begin(), saved.begin() + 3));
+        rejected = rejected && !CommandStreamReader::Load(file, data);
+        rejected = rejected && !CommandStreamReader::Load(file.string() + ".missing", data);
+        check(rejected, "a file with a wrong header or no file isn't loaded");
+        std::error_code ec;
+        fs::remove(file, ec);
+    }
+
+    {
+        // a cut between two commands is a shorter valid stream, a cut inside one has to be reported
+        // every cut inside the first few commands of each op and at their ends
+        std::vector<int> n_cut((size_t) CommandOp::Count, 0);
+        bool truncated = true;
+        for (size_t i = 0; i < events.size(); i++) {
+            if (n_cut[(size_t) events[i].op]++ >= 3) {
+                continue;
+            }
+            const size_t begin = i == 0 ? 0 : ends[i - 1];
+            for (size_t n = begin + 1; n <= ends[i]; n++) {
+                std::vector<uint8_t> data(writer.Data().begin(), writer.Data().begin() + n);
+                bool corrupted;
+                const size_t n_command = DecodeAll(std::move(data), corrupted);
+                const bool b_whole = n == ends[i];
+                truncated = truncated && n_command == (b_whole ? i + 1 : i) && corrupted == !b_whole;
+            }
+        }
+        check(truncated, "a stream cut inside a command is reported as corrupted after the whole commands");
+    }
+
+    {
+        bool corrupt = true;
+        bool corrupted;
+        // unknown op
+        std::vector<uint8_t> data = writer.Data();
+        data.insert(data.begin() + ends[10], (uint8_t) CommandOp::Count);
+        corrupt = corrupt && DecodeAll(data, corrupted) == 11 && corrupted;
+        data = writer.Data();
+        data.insert(data.begin() + ends[10], 0xff);
+        corrupt = corrupt && DecodeAll(data, corrupted) == 11 && corrupted;
+
+        // varint longer than 64 bits
+        std::vector<uint8_t> overlong = { (uint8_t) CommandOp::SetPipelineState };
+        overlong.insert(overlong.end(), 10, 0x80);
+        overlong.push_back(0x01);
+        corrupt = corrupt && DecodeAll(overlong, corrupted) == 0 && corrupted;
+
+        // layer name longer than what is left of the stream
+        std::vector<uint8_t> layer = { (uint8_t) CommandOp::BeginLayer, 0xe8, 0x07, 'a', 'b' };
+        corrupt = corrupt && DecodeAll(layer, corrupted) == 0 && corrupted;
+        layer = { (uint8_t) CommandOp::BeginLayer, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 };
+        corrupt = corrupt && DecodeAll(layer, corrupted) == 0 && corrupted;
+
+        // the reader stays stopped once it has seen a corrupted command
+        data = writer.Data();
+        data.insert(data.begin() + ends[10], 0xff);
+        CommandStreamReader reader(data);
+        CommandEvent event;
+        for (int i = 0; i < 11; i++) {
+            reader.Next(event);
+        }
+        corrupt = corrupt && !reader.Next(event) && !reader.Next(event) && reader.Corrupted();
+        check(corrupt, "unknown ops, overlong varints and overlong layer names are reported as corrupted");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
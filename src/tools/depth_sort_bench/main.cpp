@@ -0,0 +1,159 @@
+// check DepthSorter (a permutation, far to near within a quantization step, ties by material then index, same order
+// with any thread count) and time it against std::stable_sort from 1k to 1M items, exits with 1 if a check fails
+// usage: depth_sort_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "DepthSort.h"
+#include "JobSystem.h"
+#include "Random.h"
+
+const int kRuns = 10;
+const uint32_t kMaterials = 64;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// centers in a 200 m cube, snapped to a 1 m lattice so that many items share a depth and ties are exercised
+struct Items {
+    std::vector<float> centers;
+    std::vector<uint32_t> materials;
+
+    Items(size_t n, uint64_t seed) : centers(3 * n), materials(n) {
+        Random rng(seed, n);
+        rng.FillF(centers.data(), centers.size(), -100.0f, 100.0f);
+        for (float &c : centers) {
+            c = std::floor(c);
+        }
+        for (uint32_t &m : materials) {
+            m = (uint32_t) rng.RandI(0, kMaterials - 1);
+        }
+    }
+    const float (*Centers() const)[3] {
+        return reinterpret_cast<const float (*)[3]>(centers.data());
+    }
+};
+
+double Depth(const Items &items, size_t i, const float eye[3], const float look[3]) {
+    const float *c = items.centers.data() + 3 * i;
+    return (c[0] - (double) eye[0]) * look[0] + (c[1] - (double) eye[1]) * look[1] + (c[2] - (double) eye[2]) * look[2];
+}
+
+// the comparison sort transparent items would get otherwise, far to near, ties by material
+void SortByComparison(const Items &items, const float eye[3], const float look[3], std::vector<float> &depths,
+    std::vector<uint32_t> &order) {
+    const size_t n = items.materials.size();
+    depths.resize(n);
+    order.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const float *c = items.centers.data() + 3 * i;
+        depths[i] = (c[0] - eye[0]) * look[0] + (c[1] - eye[1]) * look[1] + (c[2] - eye[2]) * look[2];
+        order[i] = (uint32_t) i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return depths[a] != depths[b] ? depths[a] > depths[b] : items.materials[a] < items.materials[b];
+    });
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    DepthSorter sorter;
+    bool ok = true;
+
+    const float eye[3] = { 150.0f, 80.0f, -220.0f };
+    const float look[3] = { -150.0f, -80.0f, 220.0f };
+
+    std::printf("order\n");
+    for (size_t n : { (size_t) 1, (size_t) 3, (size_t) 1000, (size_t) 4097, (size_t) 100000, (size_t) 1000000 }) {
+        const Items items(n, 1);
+        std::vector<uint32_t> order(n), order_single(n);
+        sorter.Sort(jobs, items.Centers(), items.materials.data(), n, eye, look, order.data());
+        DepthSorter other;
+        other.Sort(single, items.Centers(), items.materials.data(), n, eye, look, order_single.data());
+
+        std::vector<uint32_t> sorted = order;
+        std::sort(sorted.begin(), sorted.end());
+        bool permutation = true;
+        for (size_t i = 0; i < n; i++) {
+            permutation = permutation && sorted[i] == i;
+        }
+
+        // depths are quantized over their range, so an item is at most a step nearer than the next one
+        double min_depth = 1e30, max_depth = -1e30;
+        for (size_t i = 0; i < n; i++) {
+            min_depth = std::min(min_depth, Depth(items, i, eye, look));
+            max_depth = std::max(max_depth, Depth(items, i, eye, look));
+        }
+        const double step = (max_depth - min_depth) / ((1 << kDepthSortBits) - 1);
+        const double tolerance = 2.0 * step + 1e-5 * std::max(std::abs(min_depth), std::abs(max_depth));
+        bool far_to_near = true, ties = true;
+        for (size_t k = 0; permutation && k + 1 < n; k++) {
+            const uint32_t a = order[k], b = order[k + 1];
+            const double da = Depth(items, a, eye, look), db = Depth(items, b, eye, look);
+            far_to_near = far_to_near && da >= db - tolerance;
+            // the same center is the same key, ordered by material then index
+            if (std::equal(&items.centers[3 * a], &items.centers[3 * a] + 3, &items.centers[3 * b])) {
+                ties = ties && (items.materials[a] < items.materials[b] ||
+                    (items.materials[a] == items.materials[b] && a < b));
+            }
+        }
+        const bool same = order == order_single;
+        const bool pass = permutation && far_to_near && ties && same;
+        ok = ok && pass;
+        std::printf("  %7zu: %s, %s, %s, %s %s\n", n, permutation ? "permutation" : "not a permutation",
+            far_to_near ? "far to near" : "out of order", ties ? "ties by material & index" : "ties out of order",
+            same ? "deterministic" : "differs across threads", pass ? "ok" : "FAILED");
+    }
+
+    // every item at the same depth, and no materials: the index order is kept
+    {
+        const size_t n = 10000;
+        std::vector<float> centers(3 * n, 1.0f);
+        std::vector<uint32_t> order(n);
+        sorter.Sort(jobs, reinterpret_cast<const float (*)[3]>(centers.data()), nullptr, n, eye, look, order.data());
+        bool pass = true;
+        for (size_t i = 0; i < n; i++) {
+            pass = pass && order[i] == i;
+        }
+        ok = ok && pass;
+        std::printf("  one depth, no materials: %s\n", pass ? "index order ok" : "reordered FAILED");
+    }
+
+    std::printf("sort, %u threads\n", jobs.ThreadCount());
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        const Items items(n, 2);
+        std::vector<uint32_t> order(n);
+        std::vector<float> depths;
+        double radix_ms = 0.0, single_ms = 0.0, comparison_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            sorter.Sort(jobs, items.Centers(), items.materials.data(), n, eye, look, order.data());
+            double ms = Milliseconds(begin);
+            radix_ms = run == 0 ? ms : std::min(radix_ms, ms);
+
+            begin = std::chrono::steady_clock::now();
+            sorter.Sort(single, items.Centers(), items.materials.data(), n, eye, look, order.data());
+            ms = Milliseconds(begin);
+            single_ms = run == 0 ? ms : std::min(single_ms, ms);
+
+            begin = std::chrono::steady_clock::now();
+            SortByComparison(items, eye, look, depths, order);
+            ms = Milliseconds(begin);
+            comparison_ms = run == 0 ? ms : std::min(comparison_ms, ms);
+        }
+        std::printf("  %7zu: radix %8.3f ms (1 thread %8.3f ms), stable_sort %8.3f ms, %5.1fx, %6.1f M items/s\n", n,
+            radix_ms, single_ms, comparison_ms, comparison_ms / radix_ms, n / (radix_ms * 1e3));
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
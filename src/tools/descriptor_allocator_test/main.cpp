@@ -0,0 +1,218 @@
+// check DescriptorAllocator against cell owners kept here: persistent ranges are first fit, never overlap and coalesce
+// back into one range, transient ranges come from a ring that never wraps a range and is reclaimed in fence order,
+// the throwing overloads DescriptorHeap uses throw on running out, exits with 1 if a check fails
+// usage: descriptor_allocator_test
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "DescriptorAllocator.h"
+#include "Random.h"
+
+const uint32_t kPersistent = 1000;
+const uint32_t kTransient = 256;
+
+bool AllEqual(const std::vector<int> &owners, uint32_t begin, uint32_t end, int owner) {
+    return std::all_of(owners.begin() + begin, owners.begin() + end, [owner](int o) {
+        return o == owner;
+    });
+}
+
+// offset of the first run of count free cells, or -1
+int FirstFit(const std::vector<int> &owners, uint32_t count) {
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < owners.size(); i++) {
+        run = owners[i] < 0 ? run + 1 : 0;
+        if (run == count) {
+            return (int) (i + 1 - count);
+        }
+    }
+    return -1;
+}
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("persistent, %u descriptors\n", kPersistent);
+    {
+        Random rng(1, 0);
+        DescriptorAllocator allocator(kPersistent, kTransient);
+        std::vector<int> owners(kPersistent, -1);
+        std::vector<DescriptorRange> live;
+        uint32_t n_free = kPersistent;
+        bool first_fit = true, disjoint = true, counted = true;
+        int n_failed = 0;
+        for (int step = 0; step < 50000; step++) {
+            // mostly allocations while the heap is emptier, mostly frees while it is fuller
+            const bool b_allocate = live.empty() || rng.RandI(0, (int) kPersistent) < (int) n_free;
+            if (b_allocate) {
+                const uint32_t count = (uint32_t) rng.RandI(1, rng.RandI(0, 9) == 0 ? 200 : 16);
+                const int expected = FirstFit(owners, count);
+                DescriptorRange range;
+                const bool b_allocated = allocator.Allocate(count, range);
+                first_fit = first_fit && b_allocated == (expected >= 0);
+                if (!b_allocated) {
+                    n_failed++;
+                    continue;
+                }
+                first_fit = first_fit && range.offset == (uint32_t) expected && range.count == count;
+                if (range.offset + range.count > kPersistent) {
+                    disjoint = false;
+                    continue;
+                }
+                disjoint = disjoint && AllEqual(owners, range.offset, range.offset + count, -1);
+                std::fill(owners.begin() + range.offset, owners.begin() + range.offset + count, step);
+                live.push_back(range);
+                n_free -= count;
+            } else {
+                const size_t k = (size_t) rng.RandI(0, (int) live.size() - 1);
+                const DescriptorRange range = live[k];
+                live[k] = live.back();
+                live.pop_back();
+                allocator.Free(range);
+                std::fill(owners.begin() + range.offset, owners.begin() + range.offset + range.count, -1);
+                n_free += range.count;
+            }
+            counted = counted && allocator.PersistentFreeCount() == n_free;
+        }
+        check(first_fit, "Allocate gives the first free run, and fails only when no free run is long enough");
+        check(disjoint, "ranges stay in the persistent region and never overlap");
+        check(counted, "PersistentFreeCount matches the free cells");
+        check(n_failed > 0, "the heap ran full now and then");
+
+        for (const DescriptorRange &range : live) {
+            allocator.Free(range);
+        }
+        DescriptorRange all;
+        check(allocator.PersistentFreeCount() == kPersistent && allocator.Allocate(kPersistent, all) && all.offset == 0,
+            "freeing everything coalesces into one range");
+        check(allocator.TransientUsedCount() == 0, "the transient region is untouched");
+    }
+
+    std::printf("transient, %u descriptors after %u persistent\n", kTransient, kPersistent);
+    {
+        Random rng(2, 0);
+        DescriptorAllocator allocator(kPersistent, kTransient);
+        // frame owning each cell of the ring, skipped cells included
+        std::vector<int> owners(kTransient, -1);
+        uint32_t head = 0;
+        int completed = 0;
+        bool in_ring = true, at_head = true, disjoint = true, counted = true, reclaimed = true;
+        int n_failed = 0, n_skipped = 0;
+        for (int frame = 1; frame <= 20000; frame++) {
+            for (int k = rng.RandI(0, 6); k > 0; k--) {
+                const uint32_t count = (uint32_t) rng.RandI(1, rng.RandI(0, 19) == 0 ? kTransient : 40);
+                // a range goes at head, or at 0 if it doesn't fit before the end and the rest of the ring is free
+                int expected = -1;
+                if (head + count <= kTransient) {
+                    expected = AllEqual(owners, head, head + count, -1) ? (int) head : -1;
+                } else if (AllEqual(owners, head, kTransient, -1) && AllEqual(owners, 0, count, -1)) {
+                    expected = 0;
+                }
+                DescriptorRange range;
+                const bool b_allocated = allocator.AllocateTransient(count, range);
+                at_head = at_head && b_allocated == (expected >= 0);
+                if (!b_allocated) {
+                    n_failed++;
+                    continue;
+                }
+                at_head = at_head && range.offset == kPersistent + (uint32_t) expected && range.count == count;
+                if (range.offset < kPersistent || range.offset + range.count > kPersistent + kTransient) {
+                    in_ring = false;
+                    continue;
+                }
+                const uint32_t offset = range.offset - kPersistent;
+                disjoint = disjoint && AllEqual(owners, offset, offset + count, -1);
+                if (offset < head) {
+                    std::fill(owners.begin() + head, owners.end(), frame);
+                    n_skipped++;
+                }
+                std::fill(owners.begin() + offset, owners.begin() + offset + count, frame);
+                head = offset + count == kTransient ? 0 : offset + count;
+            }
+            allocator.EndFrame((uint64_t) frame);
+
+            // the gpu is 0 to 3 frames behind
+            completed = std::max(completed, frame - rng.RandI(0, 3));
+            allocator.Retire((uint64_t) completed);
+            for (int &owner : owners) {
+                owner = owner <= completed ? -1 : owner;
+            }
+            const uint32_t n_used = (uint32_t) std::count_if(owners.begin(), owners.end(), [](int o) {
+                return o >= 0;
+            });
+            head = n_used == 0 ? 0 : head;
+            counted = counted && allocator.TransientUsedCount() == n_used;
+            reclaimed = reclaimed && (completed < frame || n_used == 0);
+        }
+        check(in_ring, "ranges stay in the transient region");
+        check(at_head, "ranges go at the ring head and never wrap, failing only when the ring is full up to there");
+        check(disjoint, "ranges never overlap ranges of frames in flight");
+        check(counted, "TransientUsedCount matches the cells of frames in flight");
+        check(reclaimed, "frames are reclaimed once their fence completes");
+        check(n_failed > 0 && n_skipped > 0, "the ring ran full and skipped its end now and then");
+        check(allocator.PersistentFreeCount() == kPersistent, "the persistent region is untouched");
+    }
+
+    std::printf("full ring & reset\n");
+    {
+        DescriptorAllocator allocator(0, 64);
+        DescriptorRange range;
+        check(allocator.AllocateTransient(40, range) && range.offset == 0, "first range at the ring start");
+        check(!allocator.AllocateTransient(25, range), "a range larger than the rest of the ring fails");
+        check(allocator.AllocateTransient(24, range) && range.offset == 40, "the rest of the ring still fits");
+        check(!allocator.AllocateTransient(1, range), "a full ring fails");
+        allocator.EndFrame(1);
+        allocator.Retire(0);
+        check(!allocator.AllocateTransient(1, range), "a ring stays full until the fence of its frame completes");
+        allocator.Retire(1);
+        check(allocator.TransientUsedCount() == 0 && allocator.AllocateTransient(64, range) && range.offset == 0,
+            "an empty ring starts over");
+        check(!allocator.Allocate(1, range), "no persistent region, no persistent ranges");
+
+        allocator.Reset(10, 6);
+        check(allocator.Capacity() == 16 && allocator.PersistentFreeCount() == 10 &&
+            allocator.TransientUsedCount() == 0, "Reset forgets all allocations");
+        check(allocator.Allocate(10, range) && range.offset == 0 && allocator.AllocateTransient(6, range) &&
+            range.offset == 10, "Reset gives both regions back whole");
+    }
+
+    std::printf("running out throws\n");
+    {
+        // what DescriptorHeap::Allocate & AllocateTransient call, its heaps are sized up front
+        DescriptorAllocator allocator(8, 8);
+        auto throws = [](auto allocate) {
+            try {
+                allocate();
+            } catch (const std::runtime_error &) {
+                return true;
+            }
+            return false;
+        };
+        const DescriptorRange first = allocator.Allocate(5);
+        check(first.offset == 0 && first.count == 5 && allocator.Allocate(3).offset == 5,
+            "Allocate returns the range while there is room");
+        check(throws([&allocator]() { allocator.Allocate(1); }), "Allocate throws on a full persistent region");
+        allocator.Free(first);
+        check(throws([&allocator]() { allocator.Allocate(6); }) && allocator.PersistentFreeCount() == 5 &&
+            allocator.Allocate(5).offset == 0, "a failed Allocate leaves the free ranges as they were");
+
+        check(allocator.AllocateTransient(6).offset == 8, "AllocateTransient returns the range while there is room");
+        check(throws([&allocator]() { allocator.AllocateTransient(3); }) && allocator.TransientUsedCount() == 6,
+            "AllocateTransient throws on a full ring and leaves it as it was");
+        check(throws([&allocator]() { allocator.AllocateTransient(9); }),
+            "AllocateTransient throws on a range larger than the ring");
+        allocator.EndFrame(1);
+        allocator.Retire(1);
+        check(allocator.AllocateTransient(8).offset == 8, "the ring is usable after its frame completes");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
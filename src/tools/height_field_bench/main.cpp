@@ -0,0 +1,205 @@
+// accuracy of FastSinCos & HillField against double precision, agreement of their scalar, sse & row paths, and
+// their throughput against std::sin & std::cos, exits with 1 if a check fails
+// the scalar & sse paths round the same operations in the same order, so they agree bit for bit unless the compiler
+// contracts the scalar multiply-adds into fma, which it may only do when the target has fma (__FP_FAST_FMAF),
+// then they are only checked to agree within a few ulp
+// usage: height_field_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "HeightField.h"
+#include "Random.h"
+#include "SinCos.h"
+
+const int kRuns = 10;
+const size_t kPoints = 1 << 20;
+#ifdef __FP_FAST_FMAF
+const bool kMayContract = true;
+#else
+const bool kMayContract = false;
+#endif
+// paths agree within this many ulp of the magnitude of the terms if the compiler may contract
+const double kContractTolerance = 4.0 * 1.1920929e-7;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template <typename Fn>
+double NsPerValue(size_t n, const Fn &fn) {
+    double best_ms = 0.0;
+    for (int run = 0; run < kRuns; run++) {
+        auto begin = std::chrono::steady_clock::now();
+        fn();
+        const double ms = Milliseconds(begin);
+        best_ms = run == 0 ? ms : std::min(best_ms, ms);
+    }
+    return best_ms * 1e6 / n;
+}
+
+// bit for bit, or within kContractTolerance of scale, the magnitude of the terms summed, if the compiler may contract
+bool Agree(const float *a, const float *b, size_t n, double scale, double &max_diff) {
+    max_diff = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        max_diff = std::max(max_diff, (double) std::abs(a[i] - b[i]) / std::max(scale, (double) std::abs(b[i])));
+    }
+    return kMayContract ? max_diff <= kContractTolerance : std::memcmp(a, b, n * sizeof(float)) == 0;
+}
+
+int main() {
+    bool ok = true;
+    std::printf("fma contraction %s\n", kMayContract ? "possible, paths checked within a few ulp" :
+        "not possible, paths checked bit for bit");
+
+    std::printf("FastSinCos, %zu points per range\n", kPoints);
+    std::vector<float> x(kPoints), s(kPoints), c(kPoints), s4(kPoints), c4(kPoints);
+    // absolute error bounds of SinCos.h
+    const struct {
+        float range;
+        double bound;
+    } ranges[] = { { 3.2f, 1e-7 }, { 100.0f, 1e-7 }, { 8192.0f, 1e-7 }, { 65536.0f, 1e-6 } };
+    for (const auto &range : ranges) {
+        Random rng(1, (uint64_t) range.range);
+        rng.FillF(x.data(), kPoints, -range.range, range.range);
+        double max_err = 0.0;
+        for (size_t i = 0; i < kPoints; i++) {
+            FastSinCos(x[i], s[i], c[i]);
+            max_err = std::max({ max_err, std::abs(s[i] - std::sin((double) x[i])),
+                std::abs(c[i] - std::cos((double) x[i])) });
+        }
+        bool same = true;
+        double max_diff = 0.0;
+#ifdef SINCOS_SSE2
+        for (size_t i = 0; i < kPoints; i += 4) {
+            __m128 vs, vc;
+            FastSinCos4(_mm_loadu_ps(&x[i]), vs, vc);
+            _mm_storeu_ps(&s4[i], vs);
+            _mm_storeu_ps(&c4[i], vc);
+        }
+        double diff_c = 0.0;
+        same = Agree(s4.data(), s.data(), kPoints, 1.0, max_diff) && Agree(c4.data(), c.data(), kPoints, 1.0, diff_c);
+        max_diff = std::max(max_diff, diff_c);
+#endif
+        const bool pass = max_err < range.bound && same;
+        ok = ok && pass;
+        std::printf("  |x| < %7.1f: max error %.2e (bound %.0e), scalar & sse differ by %.1e %s\n", range.range,
+            max_err, range.bound, max_diff, pass ? "ok" : "FAILED");
+    }
+
+    std::printf("HillField, %zu points\n", kPoints);
+    {
+        std::vector<float> z(kPoints), h(kPoints), n(3 * kPoints), h1(kPoints), n1(3 * kPoints);
+        Random rng(2, 0);
+        rng.FillF(x.data(), kPoints, -200.0f, 200.0f);
+        rng.FillF(z.data(), kPoints, -200.0f, 200.0f);
+        HillField::Evaluate(x.data(), z.data(), kPoints, h.data(), n.data());
+
+        // against the formula in double with the same constants, height errors relative to amp * (|x| + |z|) the
+        // terms are scaled by; both are dominated by rounding freq * x to float, an ulp is 2e-6 at 20
+        const double freq = 0.1f, amp = 0.3f;
+        double h_err = 0.0, n_err = 0.0;
+        for (size_t i = 0; i < kPoints; i++) {
+            const double px = x[i], pz = z[i];
+            const double height = amp * (pz * std::sin(freq * px) + px * std::cos(freq * pz));
+            const double nx = -amp * (freq * pz * std::cos(freq * px) + std::cos(freq * pz));
+            const double nz = -amp * (std::sin(freq * px) - freq * px * std::sin(freq * pz));
+            const double len = std::sqrt(nx * nx + 1.0 + nz * nz);
+            h_err = std::max(h_err, std::abs(h[i] - height) / (amp * (std::abs(px) + std::abs(pz))));
+            n_err = std::max({ n_err, std::abs(n[3 * i] - nx / len), std::abs(n[3 * i + 1] - 1.0 / len),
+                std::abs(n[3 * i + 2] - nz / len) });
+        }
+        const bool accurate = h_err < 2e-6 && n_err < 2e-5;
+        ok = ok && accurate;
+        std::printf("  against double: relative height error %.1e, normal error %.1e %s\n", h_err, n_err,
+            accurate ? "ok" : "FAILED");
+
+        // one point at a time takes the scalar path
+        for (size_t i = 0; i < kPoints; i++) {
+            HillField::Evaluate(&x[i], &z[i], 1, &h1[i], &n1[3 * i]);
+        }
+        double diff_h = 0.0, diff_n = 0.0;
+        // heights sum terms up to 0.3 * (200 + 200), normal components up to 0.3 * (0.1 * 200 + 1) before normalizing
+        const bool same = Agree(h.data(), h1.data(), kPoints, 120.0, diff_h) &
+            Agree(n.data(), n1.data(), 3 * kPoints, 6.3, diff_n);
+        ok = ok && same;
+        std::printf("  batch & one point at a time differ by %.1e %s\n", std::max(diff_h, diff_n),
+            same ? "ok" : "FAILED");
+
+        // a row against the same points given one by one, x = x0 + i * dx as EvaluateRow computes it
+        const size_t n_row = 1027;
+        const float x0 = -160.0f, dx = 320.0f / 1024.0f, row_z = 37.3f;
+        std::vector<float> row_x(n_row), row_z_all(n_row, row_z), row_h(n_row), row_n(3 * n_row);
+        std::vector<float> each_h(n_row), each_n(3 * n_row);
+        for (size_t i = 0; i < n_row; i++) {
+            row_x[i] = x0 + (float) i * dx;
+            HillField::Evaluate(&row_x[i], &row_z_all[i], 1, &each_h[i], &each_n[3 * i]);
+        }
+        HillField::EvaluateRow(x0, dx, row_z, n_row, row_h.data(), row_n.data());
+        const bool same_row = Agree(row_h.data(), each_h.data(), n_row, 120.0, diff_h) &
+            Agree(row_n.data(), each_n.data(), 3 * n_row, 6.3, diff_n);
+        ok = ok && same_row;
+        std::printf("  row & one point at a time differ by %.1e %s\n", std::max(diff_h, diff_n),
+            same_row ? "ok" : "FAILED");
+    }
+
+    std::printf("throughput, ns per point\n");
+    {
+        Random rng(3, 0);
+        rng.FillF(x.data(), kPoints, -200.0f, 200.0f);
+        std::vector<float> z(kPoints), h(kPoints), n(3 * kPoints);
+        rng.FillF(z.data(), kPoints, -200.0f, 200.0f);
+        const double std_ns = NsPerValue(kPoints, [&]() {
+            for (size_t i = 0; i < kPoints; i++) {
+                s[i] = std::sin(x[i]);
+                c[i] = std::cos(x[i]);
+            }
+        });
+        const double fast_ns = NsPerValue(kPoints, [&]() {
+            for (size_t i = 0; i < kPoints; i++) {
+                FastSinCos(x[i], s[i], c[i]);
+            }
+        });
+        std::printf("  sin & cos: std %.2f, FastSinCos %.2f", std_ns, fast_ns);
+#ifdef SINCOS_SSE2
+        const double fast4_ns = NsPerValue(kPoints, [&]() {
+            for (size_t i = 0; i < kPoints; i += 4) {
+                __m128 vs, vc;
+                FastSinCos4(_mm_loadu_ps(&x[i]), vs, vc);
+                _mm_storeu_ps(&s[i], vs);
+                _mm_storeu_ps(&c[i], vc);
+            }
+        });
+        std::printf(", FastSinCos4 %.2f", fast4_ns);
+#endif
+        std::printf("\n");
+
+        const double height_ns = NsPerValue(kPoints, [&]() {
+            HillField::Evaluate(x.data(), z.data(), kPoints, h.data(), nullptr);
+        });
+        const double both_ns = NsPerValue(kPoints, [&]() {
+            HillField::Evaluate(x.data(), z.data(), kPoints, h.data(), n.data());
+        });
+        const double single_ns = NsPerValue(kPoints, [&]() {
+            for (size_t i = 0; i < kPoints; i++) {
+                HillField::Evaluate(&x[i], &z[i], 1, &h[i], &n[3 * i]);
+            }
+        });
+        const size_t n_row = 1024;
+        const double row_ns = NsPerValue(kPoints, [&]() {
+            for (size_t r = 0; r < kPoints / n_row; r++) {
+                HillField::EvaluateRow(-160.0f, 320.0f / n_row, -160.0f + r * 0.3f, n_row, h.data() + r * n_row,
+                    n.data() + 3 * r * n_row);
+            }
+        });
+        std::printf("  HillField: heights %.2f, heights & normals %.2f, one point at a time %.2f, rows %.2f\n",
+            height_ns, both_ns, single_ns, row_ns);
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+// check InstanceBatcher (every item drawn once, batches in order of their first item, items in order inside a batch,
+// same result with any thread count) and time a frame of it against the per-item path of ch07 on a mock command list,
+// headless, exits with 1 if a check fails
+// usage: instance_batch_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include "Random.h"
+
+const int kRuns = 5;
+// spin per recorded call, about what a driver spends on a call with a few root arguments
+const int kCallWork = 200;
+// object constants are 256 byte aligned, instances are packed
+const size_t kObjCbStride = 256;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// counts calls in place of a command list
+struct MockList {
+    size_t n_call = 0;
+    size_t n_draw = 0;
+    size_t n_instance = 0;
+    uint64_t work = 0;
+
+    void Record(uint64_t call) {
+        uint64_t h = call;
+        for (int k = 0; k < kCallWork; k++) {
+            h = h * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        work += h;
+        n_call++;
+    }
+    void Draw(uint64_t call, uint32_t n) {
+        Record(call);
+        n_draw++;
+        n_instance += n;
+    }
+};
+
+// visible items of a frame: a model matrix each and a key out of n_key (geometry, submesh, material & pso)
+struct Scene {
+    std::vector<float> models;
+    std::vector<uint64_t> keys;
+
+    Scene(uint32_t n, uint32_t n_key, uint64_t seed) : models(16 * (size_t) n), keys(n) {
+        Random rng(seed, n);
+        rng.FillF(models.data(), models.size(), -100.0f, 100.0f);
+        for (uint64_t &key : keys) {
+            const uint32_t k = (uint32_t) rng.RandI(0, (int) n_key - 1);
+            key = InstanceBatcher::MakeKey((uint16_t) (k % 7), (uint16_t) (k / 7 % 5), (uint16_t) (k / 35), 0);
+        }
+    }
+};
+
+// as DrawRenderItems() of ch07: object constants written per item, vb, ib, topology, cbv & draw per item
+void RecordPerItem(const Scene &scene, std::vector<uint8_t> &obj_cb, MockList &list) {
+    const size_t n = scene.keys.size();
+    obj_cb.resize(n * kObjCbStride);
+    for (size_t i = 0; i < n; i++) {
+        std::memcpy(obj_cb.data() + i * kObjCbStride, scene.models.data() + 16 * i, 16 * sizeof(float));
+        const uint64_t key = scene.keys[i];
+        list.Record(key >> 48);
+        list.Record(key >> 48);
+        list.Record(1);
+        list.Record(i);
+        list.Draw(key, 1);
+    }
+}
+
+// as UpdateInstances() & DrawBatches() of ch07: build, pack instances, then the instance buffer once and per batch
+// vb, ib, topology, first instance & draw
+void RecordBatched(JobSystem &jobs, InstanceBatcher &batcher, const Scene &scene, std::vector<float> &instances,
+    MockList &list) {
+    batcher.Build(jobs, scene.keys.data(), (uint32_t) scene.keys.size());
+    instances.resize(scene.models.size());
+    batcher.Pack(jobs, [&](uint32_t instance, uint32_t item) {
+        std::memcpy(instances.data() + 16 * (size_t) instance, scene.models.data() + 16 * (size_t) item,
+            16 * sizeof(float));
+    });
+    list.Record(2);
+    for (const InstanceBatcher::Batch &batch : batcher.Batches()) {
+        list.Record(batch.key >> 48);
+        list.Record(batch.key >> 48);
+        list.Record(1);
+        list.Record(batch.first_instance);
+        list.Draw(batch.key, batch.n_instance);
+    }
+}
+
+// batches by first appearance of their key, items in order inside
+bool BatchesValid(const InstanceBatcher &batcher, const std::vector<uint64_t> &keys) {
+    std::unordered_map<uint64_t, size_t> index;
+    std::vector<std::vector<uint32_t>> expected;
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        auto [it, inserted] = index.try_emplace(keys[i], expected.size());
+        if (inserted) {
+            expected.emplace_back();
+        }
+        expected[it->second].push_back(i);
+    }
+    const auto &batches = batcher.Batches();
+    if (batches.size() != expected.size() || batcher.Items().size() != keys.size()) {
+        return false;
+    }
+    uint32_t first = 0;
+    for (size_t b = 0; b < batches.size(); b++) {
+        const InstanceBatcher::Batch &batch = batches[b];
+        if (batch.first_instance != first || batch.n_instance != expected[b].size() ||
+                batch.key != keys[expected[b][0]] || batch.item != expected[b][0]) {
+            return false;
+        }
+        if (!std::equal(expected[b].begin(), expected[b].end(), batcher.Items().begin() + first)) {
+            return false;
+        }
+        first += batch.n_instance;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("checks, %u threads\n", jobs.ThreadCount());
+    {
+        bool valid = true, same = true, packed = true;
+        for (uint32_t n : { 0u, 1u, 5u, 4095u, 4096u, 4097u, 50000u, 300000u }) {
+            for (uint32_t n_key : { 1u, 3u, 100u, 5000u }) {
+                const Scene scene(n, n_key, 1);
+                InstanceBatcher batcher, other;
+                batcher.Build(jobs, scene.keys.data(), n);
+                other.Build(single, scene.keys.data(), n);
+                valid = valid && BatchesValid(batcher, scene.keys);
+                same = same && batcher.Items() == other.Items() && batcher.Batches().size() == other.Batches().size();
+
+                std::vector<uint32_t> packed_items(n, UINT32_MAX);
+                batcher.Pack(jobs, [&](uint32_t instance, uint32_t item) {
+                    packed_items[instance] = item;
+                });
+                packed = packed && packed_items == batcher.Items();
+            }
+        }
+        // a batcher is reused every frame
+        InstanceBatcher batcher;
+        for (uint32_t frame = 0; frame < 20; frame++) {
+            const Scene scene(1000 * (frame % 7), 1 + frame * 13, frame);
+            batcher.Build(jobs, scene.keys.data(), (uint32_t) scene.keys.size());
+            valid = valid && BatchesValid(batcher, scene.keys);
+        }
+        check(valid, "every item once, batches in order of their first item, items in order inside them");
+        check(same, "same batches with any thread count");
+        check(packed, "Pack visits every instance with its item");
+    }
+
+    std::printf("frame, %u threads, %d spins of driver work per call\n", jobs.ThreadCount(), kCallWork);
+    for (uint32_t n : { 1000u, 10000u, 100000u }) {
+        for (uint32_t n_key : { 16u, 1024u }) {
+            const Scene scene(n, n_key, 2);
+            InstanceBatcher batcher;
+            std::vector<uint8_t> obj_cb;
+            std::vector<float> instances;
+            double item_ms = 0.0, batch_ms = 0.0;
+            MockList item_list, batch_list;
+            for (int run = 0; run < kRuns; run++) {
+                item_list = MockList();
+                auto begin = std::chrono::steady_clock::now();
+                RecordPerItem(scene, obj_cb, item_list);
+                double ms = Milliseconds(begin);
+                item_ms = run == 0 ? ms : std::min(item_ms, ms);
+
+                batch_list = MockList();
+                begin = std::chrono::steady_clock::now();
+                RecordBatched(jobs, batcher, scene, instances, batch_list);
+                ms = Milliseconds(begin);
+                batch_ms = run == 0 ? ms : std::min(batch_ms, ms);
+            }
+            const bool pass = item_list.n_instance == n && batch_list.n_instance == n &&
+                batch_list.n_draw == batcher.Batches().size() && batch_list.n_draw <= n_key;
+            ok = ok && pass;
+            std::printf("  %6u items, %4u keys: per item %8.3f ms %7zu calls, batched %8.3f ms %5zu calls "
+                "%4zu draws (%.1fx) %s\n", n, n_key, item_ms, item_list.n_call, batch_ms, batch_list.n_call,
+                batch_list.n_draw, item_ms / batch_ms, pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+// stress JobSystem (coverage of ParallelFor, nested waits, exceptions, submitters outside the pool) and time how
+// ParallelFor & small jobs scale from 1 to n threads, exits with 1 if a check fails
+// usage: job_system_bench [max n_thread]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+
+const int kRuns = 5;
+const size_t kWorkSize = 1 << 22;
+const size_t kSmallJobs = 200000;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// every index of [begin, end) is visited once
+bool CoversOnce(JobSystem &jobs, size_t n, size_t min_grain) {
+    std::vector<std::atomic<uint8_t>> visits(n);
+    jobs.ParallelForRange(0, n, [&visits](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            visits[i]++;
+        }
+    }, min_grain);
+    return std::all_of(visits.begin(), visits.end(), [](const std::atomic<uint8_t> &v) { return v == 1; });
+}
+
+// binary tree of jobs that wait on their children inside the job, returns the number of leaves
+size_t SpawnTree(JobSystem &jobs, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    std::atomic<size_t> n_leaf = 0;
+    JobSystem::Counter counter;
+    for (int k = 0; k < 2; k++) {
+        jobs.Run([&jobs, &n_leaf, depth]() {
+            n_leaf += SpawnTree(jobs, depth - 1);
+        }, &counter);
+    }
+    jobs.Wait(counter);
+    return n_leaf;
+}
+
+// a bit of arithmetic per element, so that ParallelFor is bound by compute rather than memory
+void Work(const std::vector<float> &in, std::vector<float> &out, size_t i) {
+    float x = in[i];
+    for (int k = 0; k < 16; k++) {
+        x = std::sqrt(x * x + 1.0f) - 0.5f * x;
+    }
+    out[i] = x;
+}
+
+int main(int argc, char **argv) {
+    const unsigned max_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) :
+        std::max(4u, std::thread::hardware_concurrency());
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("stress, %u threads\n", max_thread);
+    {
+        JobSystem jobs(max_thread);
+        bool covered = true;
+        for (size_t n : { (size_t) 0, (size_t) 1, (size_t) 7, (size_t) 1000, (size_t) 1 << 20 }) {
+            for (size_t grain : { (size_t) 1, (size_t) 64, (size_t) 100000 }) {
+                covered = covered && CoversOnce(jobs, n, grain);
+            }
+        }
+        check(covered, "ParallelFor covers every index once");
+
+        check(SpawnTree(jobs, 14) == (size_t) 1 << 14, "jobs waiting on their children inside jobs");
+
+        std::atomic<size_t> n_done = 0;
+        JobSystem::Counter counter;
+        for (size_t i = 0; i < kSmallJobs; i++) {
+            jobs.Run([&n_done]() { n_done++; }, &counter);
+        }
+        jobs.Wait(counter);
+        check(n_done == kSmallJobs && counter.n_pending == 0, "every small job runs once");
+
+        // the first exception is re-thrown, the other jobs of the counter still finish
+        std::atomic<size_t> n_ok = 0;
+        JobSystem::Counter failing;
+        for (int i = 0; i < 1000; i++) {
+            jobs.Run([&n_ok, i]() {
+                if (i % 100 == 0) {
+                    throw std::runtime_error("job failed");
+                }
+                n_ok++;
+            }, &failing);
+        }
+        bool caught = false;
+        try {
+            jobs.Wait(failing);
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+        check(caught && n_ok == 990, "exceptions are re-thrown by Wait() after all jobs finish");
+        check(CoversOnce(jobs, 10000, 1), "still usable after an exception");
+
+        // the calling thread runs the first slice itself, an exception there still waits for the queued slices,
+        // which point at its stack
+        std::atomic<size_t> n_late = 0;
+        std::atomic<bool> b_returned = false;
+        bool caught_inline = false;
+        try {
+            jobs.ParallelFor(0, 2000, [&n_late, &b_returned](size_t i) {
+                if (i == 0) {
+                    throw std::runtime_error("first index failed");
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+                n_late += b_returned.load();
+            });
+        } catch (const std::runtime_error &) {
+            caught_inline = true;
+        }
+        b_returned = true;
+        check(caught_inline && n_late == 0, "an exception of the caller's slice is re-thrown after all slices finish");
+        check(CoversOnce(jobs, 10000, 1), "still usable after an exception of the caller's slice");
+
+        // threads outside the pool share queue 0
+        std::vector<std::thread> submitters;
+        std::atomic<size_t> n_external = 0;
+        for (int t = 0; t < 4; t++) {
+            submitters.emplace_back([&jobs, &n_external]() {
+                for (int round = 0; round < 100; round++) {
+                    JobSystem::Counter c;
+                    for (int i = 0; i < 100; i++) {
+                        jobs.Run([&n_external]() { n_external++; }, &c);
+                    }
+                    jobs.Wait(c);
+                }
+            });
+        }
+        for (auto &t : submitters) {
+            t.join();
+        }
+        check(n_external == 4 * 100 * 100, "submitters outside the pool");
+    }
+    {
+        // workers that are asleep, spinning or busy are all joined
+        bool all_done = true;
+        for (int i = 0; i < 100; i++) {
+            JobSystem jobs(1 + i % max_thread);
+            all_done = all_done && CoversOnce(jobs, 1000 * (i % 3), 1);
+        }
+        check(all_done, "creating & destroying job systems");
+    }
+
+    std::printf("scaling, ParallelFor over %zu elements and %zu small jobs\n", kWorkSize, kSmallJobs);
+    std::vector<float> in(kWorkSize), out(kWorkSize), reference(kWorkSize);
+    for (size_t i = 0; i < kWorkSize; i++) {
+        in[i] = (float) (i % 1000) * 0.01f;
+    }
+    double base_ms = 0.0, base_job_ns = 0.0;
+    for (unsigned n_thread = 1; n_thread <= max_thread; n_thread++) {
+        JobSystem jobs(n_thread);
+        double best_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            jobs.ParallelFor(0, kWorkSize, [&in, &out](size_t i) { Work(in, out, i); }, 1024);
+            const double ms = Milliseconds(begin);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+        }
+        if (n_thread == 1) {
+            reference = out;
+        }
+        const bool same = out == reference;
+        ok = ok && same;
+
+        double best_job_ns = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            std::atomic<size_t> n_done = 0;
+            JobSystem::Counter counter;
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < kSmallJobs; i++) {
+                jobs.Run([&n_done]() { n_done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            }
+            jobs.Wait(counter);
+            const double ns = Milliseconds(begin) * 1e6 / kSmallJobs;
+            best_job_ns = run == 0 ? ns : std::min(best_job_ns, ns);
+        }
+        if (n_thread == 1) {
+            base_ms = best_ms;
+            base_job_ns = best_job_ns;
+        }
+        std::printf("  %2u threads: parallel for %8.3f ms (%5.2fx), small job %6.1f ns (%5.2fx) %s\n", n_thread,
+            best_ms, base_ms / best_ms, best_job_ns, base_job_ns / best_job_ns, same ? "ok" : "FAILED");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
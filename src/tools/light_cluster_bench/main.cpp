@@ -0,0 +1,240 @@
+// check LightClusters against testing every light on every cluster (same lights, ascending, contiguous ranges, the
+// per-cluster cap keeping the smallest indices, same with any thread count) and the slice of a depth, then time Assign
+// from 1k to 100k lights, exits with 1 if a check fails
+// usage: light_cluster_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "LightCluster.h"
+#include "Random.h"
+
+const int kRuns = 10;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// XMMatrixLookAtRH as the chapters' camera, row vectors
+void LookAt(const float eye[3], const float target[3], float view[4][4]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+        view[c][3] = 0.0f;
+    }
+    view[3][3] = 1.0f;
+}
+
+// point lights, then spot lights, around the origin as ch08's, some behind the camera and beyond far
+std::vector<ClusterLight> RandomLights(size_t n, float extent, uint64_t seed) {
+    Random rng(seed, n);
+    std::vector<ClusterLight> lights(n);
+    for (ClusterLight &light : lights) {
+        for (int k = 0; k < 3; k++) {
+            light.position[k] = rng.RandF(-extent, extent);
+            light.strength[k] = rng.RandF(0.1f, 0.8f);
+        }
+        light.direction[0] = 0.0f;
+        light.direction[1] = -1.0f;
+        light.direction[2] = 0.0f;
+        light.falloff_start = 1.0f;
+        light.falloff_end = rng.RandF(1.0f, 0.1f * extent);
+        light.spot_power = 8.0f;
+    }
+    return lights;
+}
+
+// lights of every cluster by testing every light on every cluster box, as (x, y, depth) in view space
+std::vector<std::vector<uint32_t>> AssignEveryLight(const LightClusters &clusters, const float view[4][4],
+    const std::vector<ClusterLight> &lights) {
+    std::vector<std::vector<uint32_t>> cluster_lights(clusters.ClusterCount());
+    for (size_t i = 0; i < lights.size(); i++) {
+        const float *p = lights[i].position;
+        const float pos[3] = {
+            p[0] * view[0][0] + p[1] * view[1][0] + p[2] * view[2][0] + view[3][0],
+            p[0] * view[0][1] + p[1] * view[1][1] + p[2] * view[2][1] + view[3][1],
+            -(p[0] * view[0][2] + p[1] * view[1][2] + p[2] * view[2][2] + view[3][2]) };
+        const float r = lights[i].falloff_end;
+        for (size_t c = 0; c < clusters.ClusterCount(); c++) {
+            float min[3], max[3];
+            clusters.ClusterBounds(c, min, max);
+            float dist_sq = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                const float e = std::max(std::max(min[k] - pos[k], pos[k] - max[k]), 0.0f);
+                dist_sq += e * e;
+            }
+            if (dist_sq <= r * r && cluster_lights[c].size() < clusters.Desc().max_lights_per_cluster) {
+                cluster_lights[c].push_back((uint32_t) i);
+            }
+        }
+    }
+    return cluster_lights;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("slices\n");
+    {
+        ClusterDesc desc;
+        desc.near_z = 0.5f;
+        desc.far_z = 500.0f;
+        LightClusters clusters(desc);
+        bool tiled = true, sliced = true;
+        const size_t n_tile = (size_t) desc.n_x * desc.n_y;
+        for (uint32_t z = 0; z < desc.n_z; z++) {
+            float min[3], max[3];
+            clusters.ClusterBounds(z * n_tile, min, max);
+            // the middle of a slice is in it, and slices are exponential from near to far
+            const float middle = std::sqrt(min[2] * max[2]);
+            sliced = sliced && std::floor(std::log(middle) * clusters.SliceScale() + clusters.SliceBias()) == z &&
+                std::abs(max[2] / min[2] - std::pow(desc.far_z / desc.near_z, 1.0f / desc.n_z)) < 1e-3f;
+            // tiles of a slice cover the frustum at its far depth, from the top left
+            const float tan_y = std::tan(0.5f * desc.fov_y), tan_x = tan_y * desc.aspect;
+            float first_min[3], first_max[3], last_min[3], last_max[3];
+            clusters.ClusterBounds(z * n_tile, first_min, first_max);
+            clusters.ClusterBounds((z + 1) * n_tile - 1, last_min, last_max);
+            const float d = max[2];
+            tiled = tiled && std::abs(first_min[0] + tan_x * d) < 1e-3f * d &&
+                std::abs(first_max[1] - tan_y * d) < 1e-3f * d && std::abs(last_max[0] - tan_x * d) < 1e-3f * d &&
+                std::abs(last_min[1] + tan_y * d) < 1e-3f * d;
+        }
+        float first_min[3], first_max[3], last_min[3], last_max[3];
+        clusters.ClusterBounds(0, first_min, first_max);
+        clusters.ClusterBounds(clusters.ClusterCount() - 1, last_min, last_max);
+        check(sliced && first_min[2] == desc.near_z && last_max[2] == desc.far_z,
+            "slices split near to far exponentially, the middle of a slice is in it");
+        check(tiled, "tiles cover the frustum from the top left");
+    }
+
+    std::printf("assignment against testing every light\n");
+    for (uint32_t cap : { 64u, 4u }) {
+        for (size_t n_light : { (size_t) 1, (size_t) 300, (size_t) 3000 }) {
+            ClusterDesc desc;
+            desc.near_z = 0.5f;
+            desc.far_z = 200.0f;
+            desc.max_lights_per_cluster = cap;
+            LightClusters clusters(desc), clusters_single(desc);
+            const std::vector<ClusterLight> lights = RandomLights(n_light, 150.0f, n_light + cap);
+            const size_t n_point = n_light / 2;
+            bool same = true, contiguous = true, ascending = true, deterministic = true;
+            size_t n_assigned = 0;
+            for (float theta = 0.3f; theta < 6.2f; theta += 1.5f) {
+                const float eye[3] = { 60.0f * std::cos(theta), 20.0f, 60.0f * std::sin(theta) };
+                const float target[3] = { 0.0f, 0.0f, 0.0f };
+                float view[4][4];
+                LookAt(eye, target, view);
+                clusters.Assign(jobs, view, lights.data(), n_point, n_light - n_point);
+                clusters_single.Assign(single, view, lights.data(), n_point, n_light - n_point);
+                const auto expected = AssignEveryLight(clusters, view, lights);
+
+                const auto &ranges = clusters.Ranges();
+                const auto &indices = clusters.Indices();
+                uint32_t offset = 0;
+                for (size_t c = 0; c < clusters.ClusterCount(); c++) {
+                    contiguous = contiguous && ranges[c].offset == offset && ranges[c].count <= cap;
+                    offset += ranges[c].count;
+                    if (!contiguous || offset > indices.size()) {
+                        break;
+                    }
+                    const uint32_t *first = indices.data() + ranges[c].offset;
+                    ascending = ascending && std::is_sorted(first, first + ranges[c].count);
+                    same = same && std::equal(first, first + ranges[c].count, expected[c].begin(), expected[c].end());
+                }
+                contiguous = contiguous && offset == indices.size() && indices.size() <= clusters.MaxIndexCount();
+                deterministic = deterministic && indices == clusters_single.Indices();
+                for (size_t c = 0; c < clusters.ClusterCount() && deterministic; c++) {
+                    deterministic = ranges[c].offset == clusters_single.Ranges()[c].offset &&
+                        ranges[c].count == clusters_single.Ranges()[c].count;
+                }
+                n_assigned += indices.size();
+            }
+            const bool pass = same && contiguous && ascending && deterministic;
+            ok = ok && pass;
+            std::printf("  %4zu lights, cap %2u, %6zu assigned over 4 views: %s, %s, %s, %s %s\n", n_light, cap,
+                n_assigned, same ? "same as every light" : "differs from every light",
+                contiguous ? "contiguous" : "ranges overlap", ascending ? "ascending" : "out of order",
+                deterministic ? "deterministic" : "differs across threads", pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf("lights out of the frustum\n");
+    {
+        LightClusters clusters;
+        const ClusterDesc &desc = clusters.Desc();
+        float view[4][4];
+        const float eye[3] = { 0.0f, 0.0f, 0.0f }, target[3] = { 0.0f, 0.0f, -1.0f };
+        LookAt(eye, target, view);
+        // behind the eye, beyond far, and just past near
+        std::vector<ClusterLight> lights = RandomLights(3, 1.0f, 5);
+        const float z[3] = { 5.0f, -desc.far_z - 5.0f, -0.5f * desc.near_z };
+        for (int i = 0; i < 3; i++) {
+            lights[i].position[0] = 0.0f;
+            lights[i].position[1] = 0.0f;
+            lights[i].position[2] = z[i];
+            lights[i].falloff_end = i < 2 ? 2.0f : desc.near_z;
+        }
+        clusters.Assign(jobs, view, lights.data(), 3, 0);
+        const auto &indices = clusters.Indices();
+        check(indices.size() > 0 && std::all_of(indices.begin(), indices.end(), [](uint32_t i) { return i == 2; }),
+            "lights behind the eye or beyond far go nowhere, a light reaching past near does");
+    }
+
+    std::printf("assign, %u threads\n", jobs.ThreadCount());
+    for (size_t n_light : { (size_t) 1280, (size_t) 10000, (size_t) 100000 }) {
+        LightClusters clusters;
+        const std::vector<ClusterLight> lights = RandomLights(n_light, 75.0f * std::sqrt(n_light / 1280.0f), 9);
+        const float eye[3] = { 25.0f, 15.0f, 25.0f }, target[3] = { 0.0f, 0.0f, 0.0f };
+        float view[4][4];
+        LookAt(eye, target, view);
+        double best_ms = 0.0, single_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            clusters.Assign(jobs, view, lights.data(), n_light - n_light / 5, n_light / 5);
+            double ms = Milliseconds(begin);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+
+            begin = std::chrono::steady_clock::now();
+            clusters.Assign(single, view, lights.data(), n_light - n_light / 5, n_light / 5);
+            ms = Milliseconds(begin);
+            single_ms = run == 0 ? ms : std::min(single_ms, ms);
+        }
+        size_t n_full = 0;
+        for (const ClusterRange &range : clusters.Ranges()) {
+            n_full += range.count == clusters.Desc().max_lights_per_cluster ? 1 : 0;
+        }
+        std::printf("  %6zu lights: %8.3f ms (1 thread %8.3f ms), %7zu indices, %4zu of %zu clusters full\n", n_light,
+            best_ms, single_ms, clusters.Indices().size(), n_full, clusters.ClusterCount());
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
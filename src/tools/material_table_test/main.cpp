@@ -0,0 +1,169 @@
+// check DirtyBits against a vector<bool> (set, resize, runs & merged runs of Collect) and MaterialTable against
+// frame resources that must end up equal to the records, over random edits, exits with 1 if a check fails
+// usage: material_table_test
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "MaterialTable.h"
+#include "Random.h"
+
+const size_t kFrames = 3;
+
+// runs of set bits, merged when at most max_gap clear bits are between them
+std::vector<DirtyRange> Runs(const std::vector<bool> &bits, size_t max_gap) {
+    std::vector<DirtyRange> ranges;
+    for (size_t i = 0; i < bits.size(); i++) {
+        if (!bits[i]) {
+            continue;
+        }
+        size_t end = i;
+        while (end < bits.size() && bits[end]) {
+            end++;
+        }
+        if (!ranges.empty() && i - ranges.back().end <= max_gap) {
+            ranges.back().end = end;
+        } else {
+            ranges.push_back({ i, end });
+        }
+        i = end;
+    }
+    return ranges;
+}
+
+bool SameRanges(const std::vector<DirtyRange> &a, const std::vector<DirtyRange> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const DirtyRange &x, const DirtyRange &y) {
+        return x.begin == y.begin && x.end == y.end;
+    });
+}
+
+bool SameBits(const DirtyBits &bits, const std::vector<bool> &model) {
+    bool same = bits.Size() == model.size() && bits.Any() == (std::find(model.begin(), model.end(), true) != model.end());
+    for (size_t i = 0; same && i < model.size(); i++) {
+        same = bits.Test(i) == model[i];
+    }
+    return same;
+}
+
+struct Record {
+    float albedo[4];
+    uint32_t id;
+    uint32_t version;
+};
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("dirty bits\n");
+    {
+        Random rng(1, 0);
+        DirtyBits bits;
+        std::vector<bool> model;
+        bool same = true, runs = true, merged = true;
+        for (int step = 0; step < 20000; step++) {
+            const int op = rng.RandI(0, 9);
+            if (op == 0) {
+                // grows or shrinks, around word borders too
+                const size_t n = (size_t) rng.RandI(0, 300);
+                bits.Resize(n);
+                model.resize(n, true);
+            } else if (op == 1) {
+                bits.ClearAll();
+                std::fill(model.begin(), model.end(), false);
+            } else if (op == 2 && !model.empty()) {
+                size_t begin = (size_t) rng.RandI(0, (int) model.size()), end = (size_t) rng.RandI(0, (int) model.size());
+                if (begin > end) {
+                    std::swap(begin, end);
+                }
+                bits.SetRange(begin, end);
+                std::fill(model.begin() + begin, model.begin() + end, true);
+            } else if (op == 3 && rng.RandI(0, 20) == 0) {
+                bits.SetAll();
+                std::fill(model.begin(), model.end(), true);
+            } else if (!model.empty()) {
+                const size_t i = (size_t) rng.RandI(0, (int) model.size() - 1);
+                bits.Set(i);
+                model[i] = true;
+            }
+            same = same && SameBits(bits, model);
+            std::vector<DirtyRange> ranges;
+            bits.Collect(ranges);
+            runs = runs && SameRanges(ranges, Runs(model, 0));
+            const size_t max_gap = (size_t) rng.RandI(1, 70);
+            bits.Collect(ranges, max_gap);
+            merged = merged && SameRanges(ranges, Runs(model, max_gap));
+        }
+        check(same, "Set, SetRange, SetAll, ClearAll & Resize as a vector<bool>, new bits dirty");
+        check(runs, "Collect gives the runs of dirty bits");
+        check(merged, "Collect merges runs at most max_gap apart");
+    }
+
+    std::printf("material table, %zu frame resources\n", kFrames);
+    for (size_t max_gap : { (size_t) 0, (size_t) 2, (size_t) 16 }) {
+        Random rng(2, max_gap);
+        MaterialTable<Record> table(kFrames, max_gap);
+        std::vector<Record> frames[kFrames];
+        uint32_t version = 0;
+        bool same = true, only_dirty = true, quiet = true;
+        size_t n_copy = 0, n_copied = 0, n_frame = 0;
+        for (int frame = 0; frame < 3000; frame++) {
+            // materials are added now and then and a few are edited every frame
+            if (table.Size() < 500 && rng.RandI(0, 3) == 0) {
+                for (int k = rng.RandI(1, 40); k > 0; k--) {
+                    Record record = {};
+                    record.id = (uint32_t) table.Size();
+                    record.version = ++version;
+                    table.Add(record);
+                }
+            }
+            for (int k = rng.RandI(0, 8); k > 0 && table.Size() > 0; k--) {
+                const size_t i = (size_t) rng.RandI(0, (int) table.Size() - 1);
+                Record record = table.Get(i);
+                record.version = ++version;
+                record.albedo[0] = (float) version;
+                table.Set(i, record);
+            }
+
+            const size_t f = frame % kFrames;
+            // the buffer of a frame resource holds Size() records, what was never uploaded is garbage
+            std::vector<Record> &dst = frames[f];
+            const std::vector<Record> before = dst;
+            dst.resize(table.Size(), Record{ { -1.0f, -1.0f, -1.0f, -1.0f }, ~0u, 0 });
+            n_copy += table.Upload(f, dst.data());
+            n_frame++;
+            for (const DirtyRange &range : table.LastRanges()) {
+                n_copied += range.end - range.begin;
+            }
+            for (size_t i = 0; i < table.Size(); i++) {
+                same = same && std::memcmp(&dst[i], &table.Get(i), sizeof(Record)) == 0;
+            }
+            // records outside the copied ranges were already there
+            size_t r = 0;
+            const auto &ranges = table.LastRanges();
+            for (size_t i = 0; i < before.size(); i++) {
+                while (r < ranges.size() && ranges[r].end <= i) {
+                    r++;
+                }
+                const bool copied = r < ranges.size() && ranges[r].begin <= i;
+                only_dirty = only_dirty && (copied || std::memcmp(&before[i], &dst[i], sizeof(Record)) == 0);
+            }
+            // a second upload without edits copies nothing
+            quiet = quiet && table.Upload(f, dst.data()) == 0 && table.LastRanges().empty();
+        }
+        const bool pass = same && only_dirty && quiet;
+        ok = ok && pass;
+        std::printf("  max_gap %2zu, %zu records: %.1f copies & %.1f records per frame, %s, %s, %s %s\n", max_gap,
+            table.Size(), (double) n_copy / n_frame, (double) n_copied / n_frame,
+            same ? "frame resources match" : "frame resources stale", only_dirty ? "only dirty spans copied" :
+            "clean records copied", quiet ? "nothing twice" : "copies again", pass ? "ok" : "FAILED");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
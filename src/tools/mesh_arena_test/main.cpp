@@ -0,0 +1,190 @@
+// check MeshArena as GeometryArena drives it: meshes only go to pools of their layout, ranges stay inside their pool
+// and never overlap, a failed allocation takes nothing, and Compact packs the pools so that copying every move into
+// new buffers (as GeometryArena does on the gpu) keeps each mesh's vertices & indices, exits with 1 if a check fails
+// usage: mesh_arena_test
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "MeshArena.h"
+#include "Random.h"
+
+const uint32_t kPoolVertex = 1 << 14;
+const uint32_t kPoolIndex = 1 << 16;
+const uint64_t kLayouts[] = { (32ull << 32) | 57, (24ull << 32) | 42, (32ull << 32) | 42 };
+
+// what the gpu buffers of a pool hold, every vertex & index set to the id of the mesh owning it, 0 when free
+struct PoolContents {
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct LiveMesh {
+    MeshArena::Mesh mesh;
+    uint64_t layout;
+    uint32_t id;
+};
+
+bool Owned(const std::vector<uint32_t> &contents, uint32_t begin, uint32_t n, uint32_t id) {
+    return std::all_of(contents.begin() + begin, contents.begin() + begin + n, [id](uint32_t v) {
+        return v == id;
+    });
+}
+
+// what GeometryArena::Compact() records: the moves copied into new buffers, the old ones are dropped
+std::vector<uint32_t> CopyMoves(const std::vector<uint32_t> &old, const std::vector<TlsfAllocator::Move> &moves) {
+    std::vector<uint32_t> packed(old.size(), 0);
+    for (const TlsfAllocator::Move &move : moves) {
+        std::copy(old.begin() + move.src, old.begin() + move.src + move.size, packed.begin() + move.dst);
+    }
+    return packed;
+}
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("random meshes, %zu layouts, pools of %u vertices & %u indices\n", std::size(kLayouts), kPoolVertex,
+        kPoolIndex);
+    {
+        Random rng(1, 0);
+        MeshArena arena;
+        std::vector<PoolContents> contents;
+        std::vector<LiveMesh> live;
+        uint32_t next_id = 1;
+        bool by_layout = true, inside = true, disjoint = true, nothing_taken = true, counted = true;
+        bool kept = true, packed = true, handles = true;
+        int n_pool_added = 0, n_compact = 0;
+        for (int step = 1; step <= 60000; step++) {
+            if (live.empty() || rng.RandI(0, 99) < 50) {
+                // most meshes are small, a few take a good part of a pool
+                const uint64_t layout = kLayouts[rng.RandI(0, (int) std::size(kLayouts) - 1)];
+                const bool b_large = rng.RandI(0, 49) == 0;
+                const uint32_t n_vertex = (uint32_t) rng.RandI(3, b_large ? kPoolVertex / 2 : 600);
+                const uint32_t n_index = (uint32_t) rng.RandI(3, b_large ? kPoolIndex / 2 : 3000);
+
+                std::vector<MeshArena::PoolStats> before;
+                for (uint32_t p = 0; p < arena.PoolCount(); p++) {
+                    before.push_back(arena.GetStats(p));
+                }
+                MeshArena::Mesh mesh;
+                if (!arena.Allocate(layout, n_vertex, n_index, mesh)) {
+                    for (uint32_t p = 0; p < arena.PoolCount(); p++) {
+                        const MeshArena::PoolStats stats = arena.GetStats(p);
+                        nothing_taken = nothing_taken && stats.vertices.used == before[p].vertices.used &&
+                            stats.indices.used == before[p].indices.used;
+                    }
+                    // as GeometryArena does, a new pool of the layout
+                    arena.AddPool(layout, kPoolVertex, kPoolIndex);
+                    contents.push_back({ std::vector<uint32_t>(kPoolVertex, 0), std::vector<uint32_t>(kPoolIndex, 0) });
+                    n_pool_added++;
+                    if (!arena.Allocate(layout, n_vertex, n_index, mesh) || mesh.pool != arena.PoolCount() - 1) {
+                        nothing_taken = false;
+                        continue;
+                    }
+                }
+                by_layout = by_layout && arena.PoolLayout(mesh.pool) == layout;
+                const MeshArena::Range range = arena.GetRange(mesh);
+                if (range.n_vertex != n_vertex || range.n_index != n_index ||
+                        range.base_vertex + n_vertex > kPoolVertex || range.start_index + n_index > kPoolIndex) {
+                    inside = false;
+                    continue;
+                }
+                PoolContents &pool = contents[mesh.pool];
+                disjoint = disjoint && Owned(pool.vertices, range.base_vertex, n_vertex, 0) &&
+                    Owned(pool.indices, range.start_index, n_index, 0);
+                std::fill_n(pool.vertices.begin() + range.base_vertex, n_vertex, next_id);
+                std::fill_n(pool.indices.begin() + range.start_index, n_index, next_id);
+                live.push_back({ mesh, layout, next_id++ });
+            } else {
+                const size_t k = (size_t) rng.RandI(0, (int) live.size() - 1);
+                const MeshArena::Range range = arena.GetRange(live[k].mesh);
+                PoolContents &pool = contents[live[k].mesh.pool];
+                std::fill_n(pool.vertices.begin() + range.base_vertex, range.n_vertex, 0);
+                std::fill_n(pool.indices.begin() + range.start_index, range.n_index, 0);
+                arena.Free(live[k].mesh);
+                live[k] = live.back();
+                live.pop_back();
+            }
+
+            if (step % 5000 != 0) {
+                continue;
+            }
+            // pack every pool and move the contents the way the gpu copies would
+            for (uint32_t p = 0; p < arena.PoolCount(); p++) {
+                std::vector<TlsfAllocator::Move> vertex_moves, index_moves;
+                arena.Compact(p, vertex_moves, index_moves);
+                contents[p].vertices = CopyMoves(contents[p].vertices, vertex_moves);
+                contents[p].indices = CopyMoves(contents[p].indices, index_moves);
+                const MeshArena::PoolStats stats = arena.GetStats(p);
+                packed = packed && stats.vertices.largest_free == kPoolVertex - stats.vertices.used &&
+                    stats.indices.largest_free == kPoolIndex - stats.indices.used;
+                handles = handles && vertex_moves.size() == stats.vertices.n_allocation &&
+                    index_moves.size() == stats.indices.n_allocation;
+            }
+            n_compact++;
+            for (const LiveMesh &m : live) {
+                const MeshArena::Range range = arena.GetRange(m.mesh);
+                kept = kept && Owned(contents[m.mesh.pool].vertices, range.base_vertex, range.n_vertex, m.id) &&
+                    Owned(contents[m.mesh.pool].indices, range.start_index, range.n_index, m.id);
+            }
+        }
+        // used vertices & indices of every pool are those of its live meshes
+        std::vector<uint64_t> n_vertex(arena.PoolCount(), 0), n_index(arena.PoolCount(), 0);
+        for (const LiveMesh &m : live) {
+            const MeshArena::Range range = arena.GetRange(m.mesh);
+            n_vertex[m.mesh.pool] += range.n_vertex;
+            n_index[m.mesh.pool] += range.n_index;
+        }
+        for (uint32_t p = 0; p < arena.PoolCount(); p++) {
+            const MeshArena::PoolStats stats = arena.GetStats(p);
+            counted = counted && stats.vertices.used == n_vertex[p] && stats.indices.used == n_index[p];
+        }
+
+        check(by_layout, "meshes only go to pools of their layout");
+        check(inside, "ranges have the requested counts and stay inside their pool");
+        check(disjoint, "ranges of a pool never overlap");
+        check(nothing_taken, "a mesh that fits no pool takes nothing, and fits a new one");
+        check(counted, "pool stats count the vertices & indices of live meshes");
+        check(packed, "Compact leaves one free range at the end of each buffer");
+        check(handles, "Compact moves every mesh once and its handles stay valid");
+        check(kept, "copying the moves into new buffers keeps every mesh's vertices & indices");
+        std::printf("  %d pools added for %zu meshes alive, %d compactions\n", n_pool_added, live.size(),
+            n_compact);
+
+        for (const LiveMesh &m : live) {
+            arena.Free(m.mesh);
+        }
+        bool empty = true;
+        for (uint32_t p = 0; p < arena.PoolCount(); p++) {
+            const MeshArena::PoolStats stats = arena.GetStats(p);
+            empty = empty && stats.vertices.used == 0 && stats.indices.used == 0 && stats.vertices.n_free_block == 1 &&
+                stats.indices.n_free_block == 1;
+        }
+        check(empty, "freeing every mesh leaves each pool one free range");
+    }
+
+    std::printf("first pool with room\n");
+    {
+        MeshArena arena;
+        const uint32_t a = arena.AddPool(kLayouts[0], 100, 300);
+        const uint32_t b = arena.AddPool(kLayouts[1], 100, 300);
+        const uint32_t c = arena.AddPool(kLayouts[0], 100, 300);
+        MeshArena::Mesh m0, m1, m2, m3;
+        check(arena.Allocate(kLayouts[0], 60, 100, m0) && m0.pool == a, "the first pool of the layout");
+        check(arena.Allocate(kLayouts[0], 60, 100, m1) && m1.pool == c, "the next one when it's full of vertices");
+        check(arena.Allocate(kLayouts[1], 100, 200, m2) && m2.pool == b, "pools of other layouts are their own");
+        check(arena.Allocate(kLayouts[0], 10, 250, m3) == false && arena.GetStats(a).vertices.used == 60 &&
+            arena.GetStats(c).vertices.used == 60, "no room for the indices, the vertices are given back");
+        arena.Free(m0);
+        check(arena.Allocate(kLayouts[0], 40, 200, m3) && m3.pool == a && arena.GetRange(m3).base_vertex == 0,
+            "freed space is used again");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
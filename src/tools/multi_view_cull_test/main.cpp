@@ -0,0 +1,329 @@
+// check MultiViewCull against Frustum::TestAabb of every box and view (masks, draw lists, any count of boxes and views,
+// thread count), that the reflected view culls as the reflected boxes would be in the main view, the boxes of
+// CullBox::Transform, then time it against a TestAabb loop per view,
+// exits with 1 if a check fails
+// usage: multi_view_cull_test [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "MultiViewCull.h"
+#include "Random.h"
+
+const float kPi = 3.14159265358979f;
+const int kRuns = 10;
+const size_t kBoxes = 100000;
+// a box this close to a plane may go either way in float
+const double kMargin = 1e-3;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// XMMatrixLookAtRH * XMMatrixPerspectiveFovRH as the chapters' camera, fov 0.25 pi, near 0.1, far 1000
+void ViewProj(const float eye[3], const float target[3], float vp[4][4]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    float view[4][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f, aspect = 16.0f / 9.0f;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    float proj[4][4] = {};
+    proj[0][0] = h / aspect;
+    proj[1][1] = h;
+    proj[2][2] = range;
+    proj[2][3] = -1.0f;
+    proj[3][2] = range * near_z;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            vp[r][c] = view[r][0] * proj[0][c] + view[r][1] * proj[1][c] + view[r][2] * proj[2][c] +
+                view[r][3] * proj[3][c];
+        }
+    }
+}
+
+Frustum RandomFrustum(Random &rng) {
+    const float eye[3] = { rng.RandF(-50.0f, 50.0f), rng.RandF(-10.0f, 20.0f), rng.RandF(-50.0f, 50.0f) };
+    const float target[3] = { rng.RandF(-50.0f, 50.0f), rng.RandF(-10.0f, 10.0f), rng.RandF(-50.0f, 50.0f) };
+    float vp[4][4];
+    ViewProj(eye, target, vp);
+    return Frustum::FromViewProj(vp);
+}
+
+// boxes over the scene, from pebbles to houses, some of them far beyond it
+std::vector<CullBox> RandomBoxes(size_t n, uint64_t seed) {
+    Random rng(seed, n);
+    std::vector<CullBox> boxes(n);
+    for (CullBox &box : boxes) {
+        const float reach = rng.RandI(0, 9) == 0 ? 1500.0f : 100.0f;
+        for (int c = 0; c < 3; c++) {
+            box.center[c] = rng.RandF(-reach, reach);
+            box.extents[c] = rng.RandF(0.01f, rng.RandI(0, 9) == 0 ? 20.0f : 2.0f);
+        }
+    }
+    return boxes;
+}
+
+bool TestAabb(const Frustum &frustum, const CullBox &box) {
+    float min[3], max[3];
+    for (int c = 0; c < 3; c++) {
+        min[c] = box.center[c] - box.extents[c];
+        max[c] = box.center[c] + box.extents[c];
+    }
+    return frustum.TestAabb(min, max) != Frustum::Result::Outside;
+}
+
+// the distance the box reaches in front of the plane it is most behind, in double
+double Reach(const Frustum &frustum, const CullBox &box) {
+    double reach = 1e30;
+    for (const float *p : frustum.planes) {
+        double d = p[3];
+        for (int c = 0; c < 3; c++) {
+            d += (double) p[c] * box.center[c] + std::abs((double) p[c]) * box.extents[c];
+        }
+        reach = std::min(reach, d);
+    }
+    return reach;
+}
+
+// masks & draw lists of MultiViewCull give TestAabb of every box and view, boxes on a plane either way
+bool MatchesTestAabb(const MultiViewCull &cull, const std::vector<Frustum> &frustums, const CullBox *boxes, size_t n,
+    size_t &n_on_plane) {
+    bool match = cull.Masks().size() == n;
+    for (uint32_t v = 0; v < frustums.size(); v++) {
+        const std::vector<uint32_t> &list = cull.Visible(v);
+        size_t next = 0;
+        for (size_t i = 0; i < n && match; i++) {
+            const bool b_in_mask = (cull.Masks()[i] >> v) & 1;
+            const bool b_in_list = next < list.size() && list[next] == i;
+            next += b_in_list;
+            const bool b_expected = TestAabb(frustums[v], boxes[i]);
+            const bool b_on_plane = std::abs(Reach(frustums[v], boxes[i])) < kMargin;
+            n_on_plane += b_on_plane && b_in_mask != b_expected;
+            match = b_in_mask == b_in_list && (b_in_mask == b_expected || b_on_plane);
+        }
+        match = match && next == list.size();
+    }
+    // no bits beyond the views
+    const uint32_t all = frustums.size() == 32 ? ~0u : (1u << frustums.size()) - 1;
+    for (size_t i = 0; i < n && match; i++) {
+        match = (cull.Masks()[i] & ~all) == 0;
+    }
+    return match;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("checks, %u threads\n", jobs.ThreadCount());
+    {
+        Random rng(1, 0);
+        const std::vector<CullBox> boxes = RandomBoxes(kBoxes, 1);
+        bool match = true, same = true;
+        size_t n_on_plane = 0;
+        // counts of boxes around the block size and views up to kMaxCullViews
+        for (size_t n : { (size_t) 0, (size_t) 1, (size_t) 3, (size_t) 255, (size_t) 256, (size_t) 257,
+                 (size_t) 1003, kBoxes }) {
+            for (uint32_t n_view : { 0u, 1u, 3u, 5u, kMaxCullViews }) {
+                std::vector<Frustum> frustums;
+                MultiViewCull cull, one_thread;
+                for (uint32_t v = 0; v < n_view; v++) {
+                    frustums.push_back(RandomFrustum(rng));
+                    const uint32_t index = cull.AddView(frustums.back());
+                    one_thread.AddView(frustums.back());
+                    match = match && index == v;
+                }
+                match = match && cull.ViewCount() == n_view;
+                cull.Cull(jobs, boxes.data(), n);
+                one_thread.Cull(single, boxes.data(), n);
+                match = match && MatchesTestAabb(cull, frustums, boxes.data(), n, n_on_plane);
+                same = same && cull.Masks() == one_thread.Masks();
+                for (uint32_t v = 0; v < n_view; v++) {
+                    same = same && cull.Visible(v) == one_thread.Visible(v);
+                }
+            }
+        }
+        check(match, "masks & draw lists give TestAabb of every box and view");
+        check(same, "the same masks & draw lists with any thread count");
+        std::printf("  %zu boxes on a plane went the other way\n", n_on_plane);
+
+        // views are replaced, not added to, and a culler is reused for fewer boxes
+        MultiViewCull cull;
+        cull.AddView(RandomFrustum(rng));
+        cull.Cull(jobs, boxes.data(), kBoxes);
+        cull.ClearViews();
+        const std::vector<Frustum> frustums = { RandomFrustum(rng), RandomFrustum(rng) };
+        for (const Frustum &frustum : frustums) {
+            cull.AddView(frustum);
+        }
+        cull.Cull(jobs, boxes.data(), 1000);
+        size_t n_on_plane_reused = 0;
+        check(cull.ViewCount() == 2 && MatchesTestAabb(cull, frustums, boxes.data(), 1000, n_on_plane_reused),
+            "ClearViews & a second Cull forget the first");
+    }
+
+    std::printf("reflected view\n");
+    {
+        // as ch11: the mirror is the plane z = 0, reflected items are drawn with model * reflect, and their originals
+        // are culled by the frustum of reflect * vp
+        Random rng(2, 0);
+        const std::vector<CullBox> boxes = RandomBoxes(kBoxes, 2);
+        std::vector<CullBox> reflected(boxes);
+        for (CullBox &box : reflected) {
+            box.center[2] = -box.center[2];
+        }
+        bool match = true;
+        for (int k = 0; k < 20; k++) {
+            const float eye[3] = { rng.RandF(-20.0f, 20.0f), rng.RandF(0.0f, 10.0f), rng.RandF(1.0f, 40.0f) };
+            const float target[3] = { rng.RandF(-10.0f, 10.0f), rng.RandF(0.0f, 5.0f), rng.RandF(-10.0f, 0.0f) };
+            float vp[4][4], mirror_vp[4][4];
+            ViewProj(eye, target, vp);
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    mirror_vp[r][c] = r == 2 ? -vp[r][c] : vp[r][c];
+                }
+            }
+            MultiViewCull cull, reflected_cull;
+            cull.AddView(Frustum::FromViewProj(vp));
+            cull.AddView(Frustum::FromViewProj(mirror_vp));
+            reflected_cull.AddView(Frustum::FromViewProj(vp));
+            cull.Cull(jobs, boxes.data(), kBoxes);
+            reflected_cull.Cull(jobs, reflected.data(), kBoxes);
+            match = match && cull.Visible(1) == reflected_cull.Visible(0);
+        }
+        check(match, "the frustum of reflect * vp culls the boxes as the main view culls their reflections");
+    }
+
+    std::printf("CullBox::Transform\n");
+    {
+        Random rng(3, 0);
+        bool contains = true, tight = true;
+        for (int k = 0; k < 10000; k++) {
+            // a rotation about a random axis, scaled per axis, then moved
+            float axis[3] = { rng.RandF(-1.0f, 1.0f), rng.RandF(-1.0f, 1.0f), rng.RandF(-1.0f, 1.0f) };
+            const float len = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) + 1e-6f;
+            for (float &f : axis) {
+                f /= len;
+            }
+            const float angle = rng.RandF(-kPi, kPi), s = std::sin(angle), c = std::cos(angle);
+            const float rot[3][3] = {
+                { c + axis[0] * axis[0] * (1 - c), axis[0] * axis[1] * (1 - c) + axis[2] * s,
+                    axis[0] * axis[2] * (1 - c) - axis[1] * s },
+                { axis[1] * axis[0] * (1 - c) - axis[2] * s, c + axis[1] * axis[1] * (1 - c),
+                    axis[1] * axis[2] * (1 - c) + axis[0] * s },
+                { axis[2] * axis[0] * (1 - c) + axis[1] * s, axis[2] * axis[1] * (1 - c) - axis[0] * s,
+                    c + axis[2] * axis[2] * (1 - c) }
+            };
+            float model[4][4] = {};
+            for (int r = 0; r < 3; r++) {
+                const float scale = rng.RandF(0.1f, 5.0f);
+                for (int col = 0; col < 3; col++) {
+                    model[r][col] = scale * rot[r][col];
+                }
+                model[3][r] = rng.RandF(-100.0f, 100.0f);
+            }
+            model[3][3] = 1.0f;
+            float center[3], extents[3];
+            for (int i = 0; i < 3; i++) {
+                center[i] = rng.RandF(-3.0f, 3.0f);
+                extents[i] = rng.RandF(0.0f, 3.0f);
+            }
+            const CullBox box = CullBox::Transform(center, extents, model);
+
+            // every corner is inside, and the box touches the corners on each side
+            float reach[3] = { 0.0f, 0.0f, 0.0f };
+            for (int corner = 0; corner < 8; corner++) {
+                float p[3];
+                for (int i = 0; i < 3; i++) {
+                    p[i] = center[i] + ((corner >> i) & 1 ? extents[i] : -extents[i]);
+                }
+                for (int col = 0; col < 3; col++) {
+                    const float w = p[0] * model[0][col] + p[1] * model[1][col] + p[2] * model[2][col] + model[3][col];
+                    const float dist = std::abs(w - box.center[col]);
+                    contains = contains && dist <= box.extents[col] + 1e-3f;
+                    reach[col] = std::max(reach[col], dist);
+                }
+            }
+            for (int col = 0; col < 3; col++) {
+                tight = tight && reach[col] >= box.extents[col] - 1e-3f;
+            }
+        }
+        check(contains, "the box of a rotated & scaled box contains all its corners");
+        check(tight, "and touches them on every side");
+    }
+
+    std::printf("timing, %zu boxes, 3 views\n", kBoxes);
+    {
+        Random rng(4, 0);
+        const std::vector<CullBox> boxes = RandomBoxes(kBoxes, 4);
+        const Frustum frustums[3] = { RandomFrustum(rng), RandomFrustum(rng), RandomFrustum(rng) };
+        std::vector<uint32_t> lists[3];
+        double loop_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            for (int v = 0; v < 3; v++) {
+                lists[v].clear();
+                for (size_t i = 0; i < kBoxes; i++) {
+                    if (TestAabb(frustums[v], boxes[i])) {
+                        lists[v].push_back((uint32_t) i);
+                    }
+                }
+            }
+            const double ms = Milliseconds(begin);
+            loop_ms = run == 0 ? ms : std::min(loop_ms, ms);
+        }
+        std::printf("  TestAabb per view: %7.3f ms, %zu + %zu + %zu visible\n", loop_ms, lists[0].size(),
+            lists[1].size(), lists[2].size());
+        for (JobSystem *js : { &single, &jobs }) {
+            MultiViewCull cull;
+            for (const Frustum &frustum : frustums) {
+                cull.AddView(frustum);
+            }
+            double best_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                auto begin = std::chrono::steady_clock::now();
+                cull.Cull(*js, boxes.data(), kBoxes);
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            std::printf("  MultiViewCull, %u threads: %7.3f ms, %.2fx\n", js->ThreadCount(), best_ms,
+                loop_ms / best_ms);
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,338 @@
+// check OcclusionBuffer against a reference rasterizer in double: depths of walls and a ground crossing the near plane,
+// the same buffer with any thread count, no box hidden that shows in a pixel of the reference, the easy cases
+// (behind a wall, in front of it, behind the eye, across the near plane, off screen), then time it,
+// exits with 1 if a check fails
+// usage: occlusion_test [n_thread]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "Random.h"
+
+const float kPi = 3.14159265358979f;
+const uint32_t kWidth = 320;
+const uint32_t kHeight = 192;
+// pixel centers this close to an edge may go either way in float
+const double kEdge = 1e-3;
+// and depths may be off by this much
+const double kDepthError = 1e-5;
+
+// XMMatrixLookAtRH * XMMatrixPerspectiveFovRH as the chapters' camera, fov 0.25 pi, near 0.1, far 1000
+void ViewProj(const float eye[3], const float target[3], float vp[4][4]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    float view[4][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f, aspect = (float) kWidth / kHeight;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    float proj[4][4] = {};
+    proj[0][0] = h / aspect;
+    proj[1][1] = h;
+    proj[2][2] = range;
+    proj[2][3] = -1.0f;
+    proj[3][2] = range * near_z;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            vp[r][c] = view[r][0] * proj[0][c] + view[r][1] * proj[1][c] + view[r][2] * proj[2][c] +
+                view[r][3] * proj[3][c];
+        }
+    }
+}
+
+// a box [-1, 1]^3, scaled and moved by a model matrix
+const float kBoxVertices[8][3] = {
+    { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 }, { -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 }
+};
+const uint16_t kBoxIndices[36] = {
+    0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5
+};
+
+void BoxModel(const float center[3], const float half[3], float model[4][4]) {
+    std::memset(model, 0, 16 * sizeof(float));
+    for (int i = 0; i < 3; i++) {
+        model[i][i] = half[i];
+        model[3][i] = center[i];
+    }
+    model[3][3] = 1.0f;
+}
+
+Occluder BoxOccluder(const float center[3], const float half[3]) {
+    Occluder occluder;
+    occluder.vertices = kBoxVertices;
+    occluder.indices = kBoxIndices;
+    occluder.n_index = 36;
+    BoxModel(center, half, occluder.model);
+    return occluder;
+}
+
+Occludee BoxOccludee(const float center[3], const float half[3]) {
+    Occludee occludee;
+    occludee.extents[0] = occludee.extents[1] = occludee.extents[2] = 1.0f;
+    BoxModel(center, half, occludee.model);
+    return occludee;
+}
+
+// calls fn(x, y, z, d) for every pixel whose center is inside a triangle of the mesh or within kEdge of it, d being
+// its distance in pixels to the nearest edge, negative outside, triangles clipped by the near plane, in double
+template <typename Fn>
+void RasterizeReference(const float vp[4][4], const float model[4][4], const float (*vertices)[3],
+    const uint16_t *indices, uint32_t n_index, const Fn &fn) {
+    double mvp[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            mvp[r][c] = (double) model[r][0] * vp[0][c] + (double) model[r][1] * vp[1][c] +
+                (double) model[r][2] * vp[2][c] + (double) model[r][3] * vp[3][c];
+        }
+    }
+    for (uint32_t t = 0; t + 2 < n_index; t += 3) {
+        double clip[3][4];
+        for (int i = 0; i < 3; i++) {
+            const float *p = vertices[indices[t + i]];
+            for (int c = 0; c < 4; c++) {
+                clip[i][c] = p[0] * mvp[0][c] + p[1] * mvp[1][c] + p[2] * mvp[2][c] + mvp[3][c];
+            }
+        }
+        double poly[4][4];
+        int n_poly = 0;
+        for (int i = 0; i < 3; i++) {
+            const double *a = clip[i], *b = clip[(i + 1) % 3];
+            if (a[2] >= 0.0) {
+                std::copy(a, a + 4, poly[n_poly++]);
+            }
+            if ((a[2] >= 0.0) != (b[2] >= 0.0)) {
+                const double s = a[2] / (a[2] - b[2]);
+                for (int c = 0; c < 4; c++) {
+                    poly[n_poly][c] = a[c] + s * (b[c] - a[c]);
+                }
+                poly[n_poly++][2] = 0.0;
+            }
+        }
+        double screen[4][3];
+        for (int i = 0; i < n_poly; i++) {
+            screen[i][0] = (poly[i][0] / poly[i][3] * 0.5 + 0.5) * kWidth;
+            screen[i][1] = (0.5 - poly[i][1] / poly[i][3] * 0.5) * kHeight;
+            screen[i][2] = poly[i][2] / poly[i][3];
+        }
+        for (int k = 0; k + 2 < n_poly; k++) {
+            const double *p0 = screen[0], *p1 = screen[k + 1], *p2 = screen[k + 2];
+            const double area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+            if (area == 0.0) {
+                continue;
+            }
+            const double d0 = std::abs(area) / std::hypot(p2[0] - p1[0], p2[1] - p1[1]);
+            const double d1 = std::abs(area) / std::hypot(p0[0] - p2[0], p0[1] - p2[1]);
+            const double d2 = std::abs(area) / std::hypot(p1[0] - p0[0], p1[1] - p0[1]);
+            const int x0 = std::max(0, (int) std::floor(std::min({ p0[0], p1[0], p2[0] }) - 1.0));
+            const int x1 = std::min((int) kWidth, (int) std::ceil(std::max({ p0[0], p1[0], p2[0] }) + 1.0));
+            const int y0 = std::max(0, (int) std::floor(std::min({ p0[1], p1[1], p2[1] }) - 1.0));
+            const int y1 = std::min((int) kHeight, (int) std::ceil(std::max({ p0[1], p1[1], p2[1] }) + 1.0));
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    const double px = x + 0.5, py = y + 0.5;
+                    const double w0 = ((p1[0] - px) * (p2[1] - py) - (p2[0] - px) * (p1[1] - py)) / area;
+                    const double w1 = ((p2[0] - px) * (p0[1] - py) - (p0[0] - px) * (p2[1] - py)) / area;
+                    const double w2 = 1.0 - w0 - w1;
+                    const double d = std::min({ w0 * d0, w1 * d1, w2 * d2 });
+                    if (d >= -kEdge) {
+                        fn(x, y, w0 * p0[2] + w1 * p1[2] + w2 * p2[2], d);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// the depth a pixel may get lies between near, from every triangle that may cover it, and far, from the triangles that
+// surely cover it
+struct ReferenceDepth {
+    std::vector<double> near, far;
+
+    ReferenceDepth(const float vp[4][4], const std::vector<Occluder> &occluders) :
+        near((size_t) kWidth * kHeight, 1.0), far((size_t) kWidth * kHeight, 1.0) {
+        for (const Occluder &occluder : occluders) {
+            RasterizeReference(vp, occluder.model, static_cast<const float (*)[3]>(occluder.vertices),
+                static_cast<const uint16_t *>(occluder.indices), occluder.n_index,
+                [this](int x, int y, double z, double d) {
+                    const size_t p = (size_t) y * kWidth + x;
+                    near[p] = std::min(near[p], z);
+                    far[p] = d >= kEdge ? std::min(far[p], z) : far[p];
+                });
+        }
+    }
+    bool Matches(size_t p, float depth) const {
+        return depth >= near[p] - kDepthError && depth <= far[p] + kDepthError;
+    }
+    // a box surely shows if it surely covers a pixel nearer than any triangle that may cover it
+    bool Visible(const float vp[4][4], const Occludee &occludee) const {
+        bool visible = false;
+        RasterizeReference(vp, occludee.model, kBoxVertices, kBoxIndices, 36,
+            [this, &visible](int x, int y, double z, double d) {
+                visible = visible || (d >= kEdge && z < near[(size_t) y * kWidth + x] - kDepthError);
+            });
+        return visible;
+    }
+};
+
+// walls standing on a ground that runs under the eye and so crosses the near plane
+std::vector<Occluder> Scene(uint64_t seed, size_t n_wall) {
+    Random rng(seed, n_wall);
+    std::vector<Occluder> occluders;
+    const float ground_center[3] = { 0.0f, -1.0f, 0.0f }, ground_half[3] = { 200.0f, 0.5f, 200.0f };
+    occluders.push_back(BoxOccluder(ground_center, ground_half));
+    for (size_t i = 0; i < n_wall; i++) {
+        const bool b_along_x = rng.RandI(0, 1) == 0;
+        const float half[3] = { b_along_x ? rng.RandF(2.0f, 12.0f) : 0.3f, rng.RandF(1.0f, 6.0f),
+            b_along_x ? 0.3f : rng.RandF(2.0f, 12.0f) };
+        const float center[3] = { rng.RandF(-80.0f, 80.0f), half[1] - 0.5f, rng.RandF(-80.0f, 80.0f) };
+        occluders.push_back(BoxOccluder(center, half));
+    }
+    return occluders;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("random scenes, %ux%u, %u threads\n", kWidth, kHeight, jobs.ThreadCount());
+    {
+        Random rng(1, 0);
+        OcclusionBuffer buffer(kWidth, kHeight), other(kWidth, kHeight);
+        size_t n_pixel = 0, n_edge = 0, n_mismatch = 0, n_tested = 0, n_hidden = 0, n_ref_hidden = 0;
+        size_t n_false_hidden = 0;
+        bool in_range = true, same = true, tested = true;
+        for (int scene = 0; scene < 30; scene++) {
+            const std::vector<Occluder> occluders = Scene(scene, 40);
+            const float eye[3] = { rng.RandF(-60.0f, 60.0f), rng.RandF(0.5f, 6.0f), rng.RandF(-60.0f, 60.0f) };
+            const float target[3] = { rng.RandF(-60.0f, 60.0f), rng.RandF(0.0f, 2.0f), rng.RandF(-60.0f, 60.0f) };
+            float vp[4][4];
+            ViewProj(eye, target, vp);
+            buffer.Render(jobs, vp, occluders.data(), occluders.size());
+            other.Render(single, vp, occluders.data(), occluders.size());
+            same = same && std::equal(buffer.Depth(), buffer.Depth() + kWidth * kHeight, other.Depth());
+
+            const ReferenceDepth ref(vp, occluders);
+            for (size_t p = 0; p < ref.near.size(); p++) {
+                const float d = buffer.Depth()[p];
+                in_range = in_range && d >= 0.0f && d <= 1.0f;
+                n_mismatch += !ref.Matches(p, d);
+                n_edge += ref.far[p] - ref.near[p] > kDepthError;
+            }
+            n_pixel += ref.near.size();
+
+            std::vector<Occludee> occludees;
+            for (int k = 0; k < 400; k++) {
+                const float half[3] = { rng.RandF(0.2f, 3.0f), rng.RandF(0.2f, 3.0f), rng.RandF(0.2f, 3.0f) };
+                const float center[3] = { rng.RandF(-90.0f, 90.0f), rng.RandF(-0.5f, 4.0f), rng.RandF(-90.0f, 90.0f) };
+                occludees.push_back(BoxOccludee(center, half));
+            }
+            std::vector<uint8_t> visible(occludees.size());
+            const size_t n_visible = buffer.Test(jobs, occludees.data(), occludees.size(),
+                reinterpret_cast<bool *>(visible.data()));
+            tested = tested && buffer.Stats().n_tested == occludees.size() &&
+                buffer.Stats().n_occluded == occludees.size() - n_visible;
+            for (size_t k = 0; k < occludees.size(); k++) {
+                const bool b_ref_visible = ref.Visible(vp, occludees[k]);
+                tested = tested && (visible[k] != 0) == buffer.IsVisible(occludees[k]);
+                n_false_hidden += b_ref_visible && !visible[k];
+                n_hidden += !visible[k];
+                n_ref_hidden += !b_ref_visible;
+            }
+            n_tested += occludees.size();
+        }
+        check(in_range, "depths stay in [0, 1]");
+        check(same, "the same depths with any thread count");
+        check(n_mismatch == 0, "depths match the reference, pixels on edges either way");
+        check(n_false_hidden == 0, "no box is hidden that shows in the reference");
+        check(tested, "Test() gives IsVisible() of every box and counts them");
+        check(n_hidden * 2 > n_ref_hidden, "most boxes not surely visible in the reference are culled");
+        std::printf("  %zu of %zu pixels on edges, %zu of %zu boxes culled, %zu not surely visible\n", n_edge,
+            n_pixel, n_hidden, n_tested, n_ref_hidden);
+    }
+
+    std::printf("easy cases\n");
+    {
+        OcclusionBuffer buffer(kWidth, kHeight);
+        const float eye[3] = { 0.0f, 2.0f, 20.0f }, target[3] = { 0.0f, 2.0f, 0.0f };
+        float vp[4][4];
+        ViewProj(eye, target, vp);
+        const float wall_center[3] = { 0.0f, 2.0f, 0.0f }, wall_half[3] = { 30.0f, 20.0f, 0.5f };
+        const Occluder wall = BoxOccluder(wall_center, wall_half);
+        buffer.Render(jobs, vp, &wall, 1);
+
+        const float half[3] = { 1.0f, 1.0f, 1.0f };
+        const float behind[3] = { 0.0f, 2.0f, -5.0f }, in_front[3] = { 3.0f, 2.0f, 5.0f };
+        const float behind_eye[3] = { 0.0f, 2.0f, 30.0f }, at_eye[3] = { 0.0f, 2.0f, 20.5f };
+        const float off_screen[3] = { 60.0f, 2.0f, 5.0f };
+        check(!buffer.IsVisible(BoxOccludee(behind, half)), "a box behind the wall is hidden");
+        check(buffer.IsVisible(BoxOccludee(in_front, half)), "a box in front of the wall is visible");
+        check(!buffer.IsVisible(BoxOccludee(behind_eye, half)), "a box behind the eye is hidden");
+        check(buffer.IsVisible(BoxOccludee(at_eye, half)), "a box across the near plane is visible");
+        check(!buffer.IsVisible(BoxOccludee(off_screen, half)), "a box off screen is hidden");
+
+        buffer.Render(jobs, vp, nullptr, 0);
+        check(buffer.IsVisible(BoxOccludee(behind, half)) && buffer.Stats().n_triangle == 0,
+            "without occluders every box on screen is visible");
+    }
+
+    std::printf("timing, %u threads\n", jobs.ThreadCount());
+    for (size_t n_wall : { (size_t) 100, (size_t) 1000, (size_t) 10000 }) {
+        OcclusionBuffer buffer(kWidth, kHeight);
+        const std::vector<Occluder> occluders = Scene(7, n_wall);
+        const float eye[3] = { -70.0f, 3.0f, -70.0f }, target[3] = { 0.0f, 1.0f, 0.0f };
+        float vp[4][4];
+        ViewProj(eye, target, vp);
+        Random rng(8, n_wall);
+        std::vector<Occludee> occludees;
+        for (int k = 0; k < 10000; k++) {
+            const float half[3] = { 0.5f, 0.5f, 0.5f };
+            const float center[3] = { rng.RandF(-90.0f, 90.0f), rng.RandF(0.0f, 3.0f), rng.RandF(-90.0f, 90.0f) };
+            occludees.push_back(BoxOccludee(center, half));
+        }
+        std::vector<uint8_t> visible(occludees.size());
+        double raster_ms = 0.0, test_ms = 0.0;
+        for (int run = 0; run < 5; run++) {
+            buffer.Render(jobs, vp, occluders.data(), occluders.size());
+            buffer.Test(jobs, occludees.data(), occludees.size(), reinterpret_cast<bool *>(visible.data()));
+            raster_ms = run == 0 ? buffer.Stats().raster_ms : std::min(raster_ms, buffer.Stats().raster_ms);
+            test_ms = run == 0 ? buffer.Stats().test_ms : std::min(test_ms, buffer.Stats().test_ms);
+        }
+        const OcclusionStats &stats = buffer.Stats();
+        std::printf("  %6zu triangles (%6zu rasterized): render %7.3f ms, test %zu boxes %7.3f ms, %.0f%% culled\n",
+            stats.n_triangle, stats.n_rasterized, raster_ms, stats.n_tested, test_ms, 100.0f * stats.CullRate());
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+// check Fft2D against a direct dft and time it and Ocean::Update() for every size, exits with 1 if a check fails
+// usage: ocean_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Fft.h"
+#include "JobSystem.h"
+#include "Ocean.h"
+#include "Random.h"
+
+const double kPi = 3.14159265358979323846;
+const int kRuns = 10;
+// relative rms error against the dft in double, and max error of a forward & inverse round trip of values in [-1, 1)
+const double kDftTolerance = 1e-6;
+const double kRoundTripTolerance = 1e-5;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void RandomPlanes(uint32_t n, uint64_t seed, std::vector<float> &re, std::vector<float> &im) {
+    Random rng(seed, n);
+    re.resize((size_t) n * n);
+    im.resize((size_t) n * n);
+    rng.FillF(re.data(), re.size(), -1.0f, 1.0f);
+    rng.FillF(im.data(), im.size(), -1.0f, 1.0f);
+}
+
+// relative rms error of the transform of (re, im) against the direct sum, rows & columns separable
+double DftError(JobSystem &jobs, uint32_t n, bool inverse) {
+    std::vector<float> re, im;
+    RandomPlanes(n, 1, re, im);
+    std::vector<float> out_re = re, out_im = im;
+    Fft2D fft(n);
+    fft.Transform(jobs, out_re.data(), out_im.data(), inverse);
+
+    const double sign = inverse ? 1.0 : -1.0;
+    std::vector<double> cos_table(n), sin_table(n);
+    for (uint32_t i = 0; i < n; i++) {
+        cos_table[i] = std::cos(sign * 2.0 * kPi * i / n);
+        sin_table[i] = std::sin(sign * 2.0 * kPi * i / n);
+    }
+    // dft of rows, then of columns
+    std::vector<double> row_re((size_t) n * n), row_im((size_t) n * n);
+    for (uint32_t r = 0; r < n; r++) {
+        for (uint32_t v = 0; v < n; v++) {
+            double sum_re = 0.0, sum_im = 0.0;
+            for (uint32_t c = 0; c < n; c++) {
+                const uint32_t t = (uint32_t) (((uint64_t) v * c) % n);
+                const double x_re = re[r * n + c], x_im = im[r * n + c];
+                sum_re += x_re * cos_table[t] - x_im * sin_table[t];
+                sum_im += x_re * sin_table[t] + x_im * cos_table[t];
+            }
+            row_re[r * n + v] = sum_re;
+            row_im[r * n + v] = sum_im;
+        }
+    }
+    double err = 0.0, norm = 0.0;
+    for (uint32_t u = 0; u < n; u++) {
+        for (uint32_t v = 0; v < n; v++) {
+            double sum_re = 0.0, sum_im = 0.0;
+            for (uint32_t r = 0; r < n; r++) {
+                const uint32_t t = (uint32_t) (((uint64_t) u * r) % n);
+                sum_re += row_re[r * n + v] * cos_table[t] - row_im[r * n + v] * sin_table[t];
+                sum_im += row_re[r * n + v] * sin_table[t] + row_im[r * n + v] * cos_table[t];
+            }
+            const double d_re = sum_re - out_re[u * n + v], d_im = sum_im - out_im[u * n + v];
+            err += d_re * d_re + d_im * d_im;
+            norm += sum_re * sum_re + sum_im * sum_im;
+        }
+    }
+    return std::sqrt(err / norm);
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+
+    std::printf("fft against dft\n");
+    for (uint32_t n = 4; n <= 128; n *= 2) {
+        const double forward = DftError(jobs, n, false);
+        const double inverse = DftError(jobs, n, true);
+        const bool pass = forward < kDftTolerance && inverse < kDftTolerance;
+        ok = ok && pass;
+        std::printf("  %4u: forward %.2e, inverse %.2e %s\n", n, forward, inverse, pass ? "ok" : "FAILED");
+    }
+
+    std::printf("fft round trip & timing, %u threads\n", jobs.ThreadCount());
+    for (uint32_t n = 64; n <= 1024; n *= 2) {
+        std::vector<float> re, im;
+        RandomPlanes(n, 2, re, im);
+        std::vector<float> out_re = re, out_im = im;
+        Fft2D fft(n);
+
+        double best_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            const auto begin = std::chrono::steady_clock::now();
+            fft.Transform(jobs, out_re.data(), out_im.data(), false);
+            const double ms = Milliseconds(begin);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            fft.Transform(jobs, out_re.data(), out_im.data(), true);
+            const float scale = 1.0f / ((float) n * n);
+            for (size_t i = 0; i < out_re.size(); i++) {
+                out_re[i] *= scale;
+                out_im[i] *= scale;
+            }
+        }
+        double max_err = 0.0;
+        for (size_t i = 0; i < re.size(); i++) {
+            max_err = std::max({ max_err, (double) std::abs(out_re[i] - re[i]), (double) std::abs(out_im[i] - im[i]) });
+        }
+
+        // same bits with one thread
+        std::vector<float> single_re = re, single_im = im, multi_re = re, multi_im = im;
+        fft.Transform(single, single_re.data(), single_im.data(), false);
+        fft.Transform(jobs, multi_re.data(), multi_im.data(), false);
+        const bool same = single_re == multi_re && single_im == multi_im;
+
+        const bool pass = max_err < kRoundTripTolerance && same;
+        ok = ok && pass;
+        // 5 n^2 log2(n^2) flops of a radix-2 fft
+        const double gflops = 5.0 * n * n * std::log2((double) n * n) / (best_ms * 1e6);
+        std::printf("  %4u: %8.3f ms, %5.2f gflops, round trip error %.2e, %s %s\n", n, best_ms, gflops, max_err,
+            same ? "deterministic" : "differs across threads", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("ocean update, %u threads\n", jobs.ThreadCount());
+    for (uint32_t n = 64; n <= 1024; n *= 2) {
+        OceanSettings settings;
+        settings.n = n;
+        settings.length = (float) n;
+        Ocean ocean(jobs, settings);
+        OceanStats best;
+        for (int run = 0; run < kRuns; run++) {
+            ocean.Update(1.0f / 60.0f);
+            if (run == 0 || ocean.Stats().TotalMs() < best.TotalMs()) {
+                best = ocean.Stats();
+            }
+        }
+        double sum_sq = 0.0;
+        for (int i = 0; i < ocean.VertexCount(); i++) {
+            sum_sq += ocean.Position(i).y * ocean.Position(i).y;
+        }
+        std::printf("  %4u: %8.3f ms (spectrum %.3f, fft %.3f, vertex %.3f), rms height %.3f m\n", n, best.TotalMs(),
+            best.spectrum_ms, best.fft_ms, best.vertex_ms, std::sqrt(sum_sq / ocean.VertexCount()));
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+// check PartitionDraws, CommandListPool & RecordParallel against a mock command list and time parallel recording
+// against one list, exits with 1 if a check fails
+// usage: parallel_record_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "ParallelRecorder.h"
+
+const int kRuns = 20;
+// spin per recorded call, about what a driver spends on a draw with a few root arguments
+const int kCallWork = 200;
+const uint64_t kSetupCall = ~0ull;
+const uint64_t kPsoCall = 1ull << 40;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// logs calls in place of a command list
+struct MockList {
+    std::vector<uint64_t> calls;
+    int n_reset = 0;
+    bool closed = true;
+    uint64_t work = 0;
+
+    void Reset() {
+        calls.clear();
+        n_reset++;
+        closed = false;
+    }
+    void Close() {
+        closed = true;
+    }
+    void Record(uint64_t call) {
+        uint64_t h = call;
+        for (int k = 0; k < kCallWork; k++) {
+            h = h * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        work += h;
+        calls.push_back(call);
+    }
+};
+
+// draw i uses pso i / 8, like a draw list sorted by pso
+uint64_t PsoOf(size_t i) {
+    return i / 8;
+}
+
+void RecordDraws(MockList &list, size_t begin, size_t end) {
+    uint64_t curr_pso = ~0ull;
+    for (size_t i = begin; i < end; i++) {
+        if (PsoOf(i) != curr_pso) {
+            curr_pso = PsoOf(i);
+            list.Record(kPsoCall | curr_pso);
+        }
+        list.Record(i);
+    }
+}
+
+std::vector<MockList *> Record(JobSystem &jobs, CommandListPool<MockList> &pool, size_t n_draw, size_t min_chunk) {
+    return RecordParallel(jobs, pool, n_draw, min_chunk,
+        [](MockList &list) { list.Record(kSetupCall); },
+        [](MockList &list, size_t begin, size_t end) { RecordDraws(list, begin, end); });
+}
+
+bool PartitionValid(size_t n_item, size_t max_chunk, size_t min_chunk) {
+    const auto chunks = PartitionDraws(n_item, max_chunk, min_chunk);
+    if (n_item == 0) {
+        return chunks.empty();
+    }
+    if (chunks.empty() || chunks.size() > std::max<size_t>(max_chunk, 1) || chunks.front().begin != 0 ||
+            chunks.back().end != n_item) {
+        return false;
+    }
+    for (size_t c = 0; c < chunks.size(); c++) {
+        if (chunks[c].begin >= chunks[c].end || (c > 0 && chunks[c].begin != chunks[c - 1].end)) {
+            return false;
+        }
+        if (chunks.size() > 1 && chunks[c].end - chunks[c].begin < min_chunk) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// every list starts with the setup and re-sets the pso, draws of all lists in order are 0..n_draw-1
+bool ListsValid(const std::vector<MockList *> &lists, size_t n_draw) {
+    std::vector<uint64_t> draws;
+    for (const MockList *list : lists) {
+        if (!list->closed || list->calls.size() < 2 || list->calls[0] != kSetupCall ||
+                (list->calls[1] & kPsoCall) == 0) {
+            return false;
+        }
+        for (uint64_t call : list->calls) {
+            if (call != kSetupCall && (call & kPsoCall) == 0) {
+                draws.push_back(call);
+            }
+        }
+    }
+    if (draws.size() != n_draw) {
+        return false;
+    }
+    for (size_t i = 0; i < n_draw; i++) {
+        if (draws[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) :
+        std::max(4u, std::thread::hardware_concurrency());
+    JobSystem jobs(std::max(n_thread, 1u));
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("checks, %u threads\n", jobs.ThreadCount());
+    {
+        bool valid = true;
+        for (size_t n_item = 0; n_item <= 300; n_item++) {
+            for (size_t max_chunk = 0; max_chunk <= 9; max_chunk++) {
+                for (size_t min_chunk : { (size_t) 0, (size_t) 1, (size_t) 5, (size_t) 16, (size_t) 64 }) {
+                    valid = valid && PartitionValid(n_item, max_chunk, min_chunk);
+                }
+            }
+        }
+        check(valid, "partitions are contiguous, cover all draws and respect the chunk limits");
+
+        auto factory = []() { return std::make_unique<MockList>(); };
+        CommandListPool<MockList> pool(factory);
+        bool lists_valid = true;
+        size_t max_used = 0;
+        for (size_t n_draw : { (size_t) 1, (size_t) 6, (size_t) 40, (size_t) 1000, (size_t) 5, (size_t) 333 }) {
+            pool.BeginFrame();
+            const auto lists = Record(jobs, pool, n_draw, 16);
+            lists_valid = lists_valid && lists.size() == PartitionDraws(n_draw, jobs.ThreadCount(), 16).size() &&
+                ListsValid(lists, n_draw) && pool.UsedCount() == lists.size();
+            max_used = std::max(max_used, lists.size());
+        }
+        check(lists_valid, "lists start with the setup and hold the draws in order");
+        check(pool.Size() == max_used, "pool reuses its lists across frames");
+        check(Record(jobs, pool, 0, 16).empty(), "no lists for no draws");
+    }
+
+    std::printf("record with %d steps of work per call, %u threads\n", kCallWork, jobs.ThreadCount());
+    for (size_t n_draw : { (size_t) 6, (size_t) 40, (size_t) 100, (size_t) 1000, (size_t) 10000 }) {
+        MockList single;
+        double single_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            single.Reset();
+            single.Record(kSetupCall);
+            RecordDraws(single, 0, n_draw);
+            single.Close();
+            const double ms = Milliseconds(begin);
+            single_ms = run == 0 ? ms : std::min(single_ms, ms);
+        }
+        std::printf("  %5zu draws: one list %7.3f ms", n_draw, single_ms);
+        for (size_t min_chunk : { (size_t) 16, (size_t) 64 }) {
+            CommandListPool<MockList> pool([]() { return std::make_unique<MockList>(); });
+            double best_ms = 0.0;
+            size_t n_list = 0;
+            for (int run = 0; run < kRuns; run++) {
+                pool.BeginFrame();
+                auto begin = std::chrono::steady_clock::now();
+                n_list = Record(jobs, pool, n_draw, min_chunk).size();
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            std::printf(", min %2zu: %7.3f ms in %zu lists", min_chunk, best_ms, n_list);
+        }
+        std::printf("\n");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,291 @@
+// check PatchCull against testing every patch (visibility, order, factors, thread count), that no patch with a point
+// in the frustum is dropped, and the tess factors of the distance rule, then time CullPatches,
+// exits with 1 if a check fails
+// usage: patch_cull_test [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "BezierPatch.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "PatchCull.h"
+#include "Random.h"
+
+const float kPi = 3.14159265358979f;
+const int kRuns = 10;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// XMMatrixLookAtRH * XMMatrixPerspectiveFovRH as the chapters' camera, fov 0.25 pi, near 0.1, far 1000
+Frustum CameraFrustum(const float eye[3], const float target[3]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    float view[4][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f, aspect = 16.0f / 9.0f;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    float proj[4][4] = {};
+    proj[0][0] = h / aspect;
+    proj[1][1] = h;
+    proj[2][2] = range;
+    proj[2][3] = -1.0f;
+    proj[3][2] = range * near_z;
+
+    float vp[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            vp[r][c] = view[r][0] * proj[0][c] + view[r][1] * proj[1][c] + view[r][2] * proj[2][c] +
+                view[r][3] * proj[3][c];
+        }
+    }
+    return Frustum::FromViewProj(vp);
+}
+
+// n x n patches of k x k control points over [-size / 2, size / 2]^2 in xz, bumpy in y, neighbors share edges
+std::vector<float> PatchGrid(int n, int k, float size) {
+    const int n_point = (k - 1) * n + 1;
+    const float spacing = size / (n_point - 1);
+    std::vector<float> cp((size_t) n * n * k * k * 3);
+    for (int pj = 0; pj < n; pj++) {
+        for (int pi = 0; pi < n; pi++) {
+            float *patch = cp.data() + ((size_t) pj * n + pi) * k * k * 3;
+            for (int c = 0; c < k * k; c++) {
+                const int i = (k - 1) * pi + c % k, j = (k - 1) * pj + c / k;
+                patch[3 * c] = -0.5f * size + i * spacing;
+                patch[3 * c + 1] = 3.0f * std::sin(0.7f * i * spacing) * std::cos(0.4f * j * spacing);
+                patch[3 * c + 2] = -0.5f * size + j * spacing;
+            }
+        }
+    }
+    return cp;
+}
+
+PatchList MakeList(const std::vector<float> &cp, size_t n_cp) {
+    PatchList list;
+    list.cp = reinterpret_cast<const float (*)[3]>(cp.data());
+    list.n_cp = n_cp;
+    list.n_patch = cp.size() / (3 * n_cp);
+    return list;
+}
+
+bool SameFactors(const PatchTessFactors &a, const PatchTessFactors &b) {
+    return std::memcmp(&a, &b, sizeof(PatchTessFactors)) == 0;
+}
+
+// any point of the patch in the frustum, from a grid of points on it
+bool AnyPointInside(const PatchList &patches, size_t patch, const Frustum &frustum) {
+    const float (*cp)[3] = patches.cp + patch * patches.n_cp;
+    BezierPatch bezier;
+    if (patches.n_cp == 16) {
+        std::copy(&cp[0][0], &cp[0][0] + 48, &bezier.cp[0][0]);
+    }
+    for (int j = 0; j <= 8; j++) {
+        for (int i = 0; i <= 8; i++) {
+            const float u = i / 8.0f, v = j / 8.0f;
+            float p[3];
+            if (patches.n_cp == 16) {
+                EvaluateBezierPatch(bezier, u, v, p, nullptr, nullptr);
+            } else {
+                for (int k = 0; k < 3; k++) {
+                    p[k] = (1.0f - v) * ((1.0f - u) * cp[0][k] + u * cp[1][k]) +
+                        v * ((1.0f - u) * cp[2][k] + u * cp[3][k]);
+                }
+            }
+            if (frustum.TestSphere(p, 0.0f)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("distance rule\n");
+    {
+        TessDistanceRule rule;
+        bool pass = rule.Factor(0.0f) == rule.max_tess && rule.Factor(rule.d0) == rule.max_tess &&
+            rule.Factor(rule.d1) == 1.0f && rule.Factor(1e6f) == 1.0f;
+        // linear in between, as tessellation.hlsl
+        for (float d = rule.d0; d <= rule.d1; d += 0.37f) {
+            const float expected = (rule.max_tess - 1.0f) * (rule.d1 - d) / (rule.d1 - rule.d0) + 1.0f;
+            pass = pass && std::abs(rule.Factor(d) - expected) < 1e-4f;
+        }
+        check(pass, "max_tess up to d0, 1 from d1 on, linear in between");
+    }
+
+    std::printf("tess factors\n");
+    for (size_t k : { (size_t) 2, (size_t) 4 }) {
+        const std::vector<float> cp = PatchGrid(8, (int) k, 80.0f);
+        const PatchList list = MakeList(cp, k * k);
+        TessDistanceRule rule;
+        Random rng(1, k);
+        bool shared = true, inside_max = true, bezier_same = true, orientation = true;
+        for (int e = 0; e < 20; e++) {
+            const float eye[3] = { rng.RandF(-60.0f, 60.0f), rng.RandF(1.0f, 40.0f), rng.RandF(-60.0f, 60.0f) };
+            std::vector<PatchTessFactors> factors(list.n_patch);
+            for (size_t p = 0; p < list.n_patch; p++) {
+                factors[p] = ComputePatchTessFactors(list, p, eye, rule);
+                inside_max = inside_max && factors[p].inside[0] == std::max(factors[p].edge[1], factors[p].edge[3]) &&
+                    factors[p].inside[1] == std::max(factors[p].edge[0], factors[p].edge[2]);
+                if (k == 4) {
+                    BezierPatch bezier;
+                    std::copy(&list.cp[16 * p][0], &list.cp[16 * p][0] + 48, &bezier.cp[0][0]);
+                    bezier_same = bezier_same && SameFactors(factors[p], ComputeBezierTessFactors(bezier, eye, rule));
+                }
+            }
+            // u = 1 of a patch is u = 0 of the next along x, v = 1 is v = 0 of the next along z
+            for (size_t p = 0; p < list.n_patch; p++) {
+                const size_t pi = p % 8, pj = p / 8;
+                if (pi + 1 < 8) {
+                    shared = shared && factors[p].edge[2] == factors[p + 1].edge[0];
+                }
+                if (pj + 1 < 8) {
+                    shared = shared && factors[p].edge[3] == factors[p + 8].edge[1];
+                }
+            }
+            // the same patch with u & v swapped has its edges swapped the same way
+            for (size_t p = 0; p < list.n_patch; p += 7) {
+                std::vector<float> swapped(3 * k * k);
+                for (size_t c = 0; c < k * k; c++) {
+                    std::copy(list.cp[p * k * k + (c % k) * k + c / k], list.cp[p * k * k + (c % k) * k + c / k] + 3,
+                        swapped.data() + 3 * c);
+                }
+                const PatchTessFactors f = ComputePatchTessFactors(MakeList(swapped, k * k), 0, eye, rule);
+                orientation = orientation && f.edge[0] == factors[p].edge[1] && f.edge[1] == factors[p].edge[0] &&
+                    f.edge[2] == factors[p].edge[3] && f.edge[3] == factors[p].edge[2];
+            }
+        }
+        std::printf("  %zu x %zu control points\n", k, k);
+        check(shared, "neighbors get the same factor for a shared edge");
+        check(orientation, "an edge gets the same factor walked either way");
+        check(inside_max, "inside factors are the max of the edges along the same direction");
+        if (k == 4) {
+            check(bezier_same, "bicubic patches get the factors of ComputeBezierTessFactors");
+        }
+    }
+
+    std::printf("culling against testing every patch\n");
+    for (size_t k : { (size_t) 2, (size_t) 4 }) {
+        // 61 x 61 patches is not a multiple of a chunk
+        const std::vector<float> cp = PatchGrid(61, (int) k, 400.0f);
+        PatchList list = MakeList(cp, k * k);
+        TessDistanceRule rule;
+        bool same = true, conservative = true, deterministic = true, padded = true;
+        size_t n_visible_total = 0;
+        for (float theta = 0.0f; theta < 2.0f * kPi; theta += 0.9f) {
+            const float eye[3] = { 60.0f * std::cos(theta), 25.0f, 60.0f * std::sin(theta) };
+            const float target[3] = { 0.0f, 0.0f, 0.0f };
+            const Frustum frustum = CameraFrustum(eye, target);
+            std::vector<uint32_t> visible(list.n_patch), visible_single(list.n_patch);
+            std::vector<PatchTessFactors> factors(list.n_patch), factors_single(list.n_patch);
+            const size_t n_visible = CullPatches(jobs, list, frustum, eye, rule, visible.data(), factors.data());
+            const size_t n_single = CullPatches(single, list, frustum, eye, rule, visible_single.data(),
+                factors_single.data());
+            deterministic = deterministic && n_single == n_visible && std::equal(visible.begin(), visible.begin() +
+                n_visible, visible_single.begin()) && std::memcmp(factors.data(), factors_single.data(), n_visible *
+                sizeof(PatchTessFactors)) == 0;
+            n_visible_total += n_visible;
+
+            // visible patches are those whose control point bounds pass, in order, with their factors
+            size_t v = 0;
+            for (size_t p = 0; p < list.n_patch; p++) {
+                float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                for (size_t c = 0; c < list.n_cp; c++) {
+                    for (int a = 0; a < 3; a++) {
+                        min[a] = std::min(min[a], list.cp[p * list.n_cp + c][a]);
+                        max[a] = std::max(max[a], list.cp[p * list.n_cp + c][a]);
+                    }
+                }
+                const bool expected = frustum.TestAabb(min, max) != Frustum::Result::Outside;
+                const bool taken = v < n_visible && visible[v] == p;
+                same = same && expected == taken &&
+                    (!taken || SameFactors(factors[v], ComputePatchTessFactors(list, p, eye, rule)));
+                conservative = conservative && (taken || !AnyPointInside(list, p, frustum));
+                v += taken ? 1 : 0;
+            }
+
+            // padding the bounds keeps every patch kept without it
+            list.bound_pad[1] = 5.0f;
+            std::vector<uint32_t> visible_pad(list.n_patch);
+            std::vector<PatchTessFactors> factors_pad(list.n_patch);
+            const size_t n_pad = CullPatches(jobs, list, frustum, eye, rule, visible_pad.data(), factors_pad.data());
+            padded = padded && n_pad >= n_visible && std::includes(visible_pad.begin(), visible_pad.begin() + n_pad,
+                visible.begin(), visible.begin() + n_visible);
+            list.bound_pad[1] = 0.0f;
+        }
+        const bool pass = same && conservative && deterministic && padded;
+        ok = ok && pass;
+        std::printf("  %zu x %zu control points, %zu patches, %zu visible over 7 views: %s, %s, %s, %s %s\n", k, k,
+            list.n_patch, n_visible_total, same ? "same as every patch" : "differs from every patch",
+            conservative ? "conservative" : "drops visible patches",
+            deterministic ? "deterministic" : "differs across threads",
+            padded ? "padding only adds" : "padding drops patches", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("culling, %u threads\n", jobs.ThreadCount());
+    for (int n : { 64, 256, 1024 }) {
+        for (size_t k : { (size_t) 2, (size_t) 4 }) {
+            if (k == 4 && n > 256) {
+                continue;
+            }
+            const std::vector<float> cp = PatchGrid(n, (int) k, 4.0f * n);
+            const PatchList list = MakeList(cp, k * k);
+            TessDistanceRule rule;
+            const float eye[3] = { 0.0f, 30.0f, -2.0f * n }, target[3] = { 0.0f, 0.0f, 0.0f };
+            const Frustum frustum = CameraFrustum(eye, target);
+            std::vector<uint32_t> visible(list.n_patch);
+            std::vector<PatchTessFactors> factors(list.n_patch);
+            size_t n_visible = 0;
+            double best_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                auto begin = std::chrono::steady_clock::now();
+                n_visible = CullPatches(jobs, list, frustum, eye, rule, visible.data(), factors.data());
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            std::printf("  %7zu patches of %2zu points: %7zu visible, %8.3f ms, %6.2f M patches/s\n", list.n_patch,
+                list.n_cp, n_visible, best_ms, list.n_patch / (best_ms * 1e3));
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
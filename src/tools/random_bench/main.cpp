@@ -0,0 +1,282 @@
+// statistical checks of Random (uniformity, bit balance, serial & cross-stream correlation, unbiased ranges) and
+// throughput of its generators against std::mt19937, exits with 1 if a check fails
+// all checks use fixed seeds, bounds are 6 standard deviations, so a correct generator doesn't fail by chance
+// usage: random_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Random.h"
+
+const size_t kSamples = 1 << 24;
+const int kRuns = 5;
+const double kSigmas = 6.0;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+bool ok = true;
+
+void Check(bool pass, const char *what, double value, double bound) {
+    ok = ok && pass;
+    std::printf("  %-48s %10.4f (bound %.4f) %s\n", what, value, bound, pass ? "ok" : "FAILED");
+}
+
+// chi-square of the bin counts against a uniform distribution, with its bound for bins - 1 degrees of freedom
+double ChiSquare(const std::vector<size_t> &counts, size_t n, double &bound) {
+    const double expected = (double) n / counts.size();
+    double chi2 = 0.0;
+    for (size_t c : counts) {
+        chi2 += (c - expected) * (c - expected) / expected;
+    }
+    const double dof = counts.size() - 1.0;
+    bound = dof + kSigmas * std::sqrt(2.0 * dof);
+    return chi2;
+}
+
+// pearson correlation of a[i] & b[i]
+double Correlation(const float *a, const float *b, size_t n, size_t stride) {
+    double sa = 0.0, sb = 0.0, saa = 0.0, sbb = 0.0, sab = 0.0;
+    size_t m = 0;
+    for (size_t i = 0; i < n; i += stride, m++) {
+        sa += a[i];
+        sb += b[i];
+        saa += (double) a[i] * a[i];
+        sbb += (double) b[i] * b[i];
+        sab += (double) a[i] * b[i];
+    }
+    const double cov = sab / m - (sa / m) * (sb / m);
+    return cov / std::sqrt((saa / m - (sa / m) * (sa / m)) * (sbb / m - (sb / m) * (sb / m)));
+}
+
+template <typename Fn>
+double NsPerValue(size_t n, const Fn &fn) {
+    double best_ms = 0.0;
+    for (int run = 0; run < kRuns; run++) {
+        auto begin = std::chrono::steady_clock::now();
+        fn();
+        const double ms = Milliseconds(begin);
+        best_ms = run == 0 ? ms : std::min(best_ms, ms);
+    }
+    return best_ms * 1e6 / n;
+}
+
+int main() {
+    std::vector<float> f(kSamples);
+    {
+        Random rng(1, 0);
+        for (float &x : f) {
+            x = rng.NextF();
+        }
+    }
+
+    std::printf("NextF / NextU32, %zu samples\n", kSamples);
+    {
+        double sum = 0.0, sum_sq = 0.0;
+        for (float x : f) {
+            sum += x;
+            sum_sq += (double) x * x;
+        }
+        const double mean = sum / kSamples;
+        const double var = sum_sq / kSamples - mean * mean;
+        const double mean_bound = kSigmas * std::sqrt(1.0 / 12.0 / kSamples);
+        Check(std::abs(mean - 0.5) < mean_bound, "mean - 1/2", mean - 0.5, mean_bound);
+        // variance of (x - 1/2)^2 is 1/180
+        const double var_bound = kSigmas * std::sqrt(1.0 / 180.0 / kSamples);
+        Check(std::abs(var - 1.0 / 12.0) < var_bound, "variance - 1/12", var - 1.0 / 12.0, var_bound);
+        Check(*std::min_element(f.begin(), f.end()) >= 0.0f && *std::max_element(f.begin(), f.end()) < 1.0f,
+            "in [0, 1)", 0.0, 0.0);
+
+        std::vector<size_t> bins(256, 0);
+        for (float x : f) {
+            bins[(size_t) (x * 256.0f)]++;
+        }
+        double bound;
+        const double chi2 = ChiSquare(bins, kSamples, bound);
+        Check(chi2 < bound, "chi-square of 256 bins", chi2, bound);
+
+        const double corr_bound = kSigmas / std::sqrt((double) kSamples);
+        const double lag1 = Correlation(f.data(), f.data() + 1, kSamples - 1, 1);
+        Check(std::abs(lag1) < corr_bound, "correlation of successive values", lag1, corr_bound);
+
+        // every bit of NextU32 is set half of the time
+        Random rng(2, 0);
+        std::vector<size_t> bit_count(32, 0);
+        for (size_t i = 0; i < kSamples; i++) {
+            const uint32_t v = rng.NextU32();
+            for (int b = 0; b < 32; b++) {
+                bit_count[b] += (v >> b) & 1;
+            }
+        }
+        double worst_bit = 0.0;
+        for (size_t c : bit_count) {
+            worst_bit = std::max(worst_bit, std::abs((double) c / kSamples - 0.5));
+        }
+        const double bit_bound = kSigmas * 0.5 / std::sqrt((double) kSamples);
+        Check(worst_bit < bit_bound, "worst bit frequency - 1/2", worst_bit, bit_bound);
+    }
+
+    std::printf("streams\n");
+    {
+        Random a(1, 0), a2(1, 0);
+        bool same = true;
+        for (int i = 0; i < 1000; i++) {
+            same = same && a.NextU32() == a2.NextU32();
+        }
+        Check(same, "same seed & stream repeat", 0.0, 0.0);
+
+        const double corr_bound = kSigmas / std::sqrt((double) kSamples);
+        for (auto [seed, stream] : { std::pair<uint64_t, uint64_t> { 1, 1 }, { 2, 0 } }) {
+            std::vector<float> g(kSamples);
+            Random rng(seed, stream);
+            for (float &x : g) {
+                x = rng.NextF();
+            }
+            const double corr = Correlation(f.data(), g.data(), kSamples, 1);
+            Check(std::abs(corr) < corr_bound, stream == 1 ? "correlation with the next stream" :
+                "correlation with the next seed", corr, corr_bound);
+        }
+    }
+
+    std::printf("FillF / FillI\n");
+    {
+        std::vector<float> g(kSamples);
+        Random rng(3, 0);
+        rng.FillF(g.data(), kSamples, 0.0f, 1.0f);
+        std::vector<size_t> bins(256, 0);
+        for (float x : g) {
+            bins[std::min<size_t>((size_t) (x * 256.0f), 255)]++;
+        }
+        double bound;
+        const double chi2 = ChiSquare(bins, kSamples, bound);
+        Check(chi2 < bound, "FillF chi-square of 256 bins", chi2, bound);
+
+        // neighbors come from different lanes, every 4th from the same one
+        const double corr_bound = kSigmas / std::sqrt(kSamples / 4.0);
+        double worst = 0.0;
+        for (int lag = 1; lag <= 4; lag++) {
+            worst = std::max(worst, std::abs(Correlation(g.data(), g.data() + lag, kSamples - 4, 4)));
+        }
+        Check(worst < corr_bound, "FillF worst correlation at lag 1..4", worst, corr_bound);
+
+        // filling in pieces of multiples of 4 continues the same sequence
+        Random whole(4, 0), pieces(4, 0);
+        std::vector<float> w(1000), p(1000);
+        whole.FillF(w.data(), 1000, -1.0f, 1.0f);
+        pieces.FillF(p.data(), 4, -1.0f, 1.0f);
+        pieces.FillF(p.data() + 4, 396, -1.0f, 1.0f);
+        pieces.FillF(p.data() + 400, 600, -1.0f, 1.0f);
+        Check(w == p, "FillF in pieces", 0.0, 0.0);
+
+        std::vector<int> v(kSamples);
+        rng.FillI(v.data(), kSamples, -50, 49);
+        std::vector<size_t> counts(100, 0);
+        bool in_range = true;
+        for (int x : v) {
+            in_range = in_range && x >= -50 && x <= 49;
+            counts[std::clamp(x + 50, 0, 99)]++;
+        }
+        const double chi2_i = ChiSquare(counts, kSamples, bound);
+        Check(in_range && chi2_i < bound, "FillI [-50, 49] chi-square", chi2_i, bound);
+    }
+
+    std::printf("RandF / FillF, [2^20, 2^20 + 1/4)\n");
+    {
+        // floats near 2^20 are 1/8 apart, the range holds 2 of them and l + (r - l) * u rounds to r for 1/4 of u
+        const float l = 1048576.0f, r = 1048576.25f;
+        Random rng(7, 0);
+        std::vector<float> g(kSamples / 4);
+        for (float &x : g) {
+            x = rng.RandF(l, r);
+        }
+        std::vector<float> h(kSamples / 4 + 3);
+        rng.FillF(h.data(), h.size(), l, r);
+        for (const std::vector<float> *values : { &g, &h }) {
+            const size_t n_r = std::count_if(values->begin(), values->end(), [r](float x) { return x >= r; });
+            const bool b_low = std::count(values->begin(), values->end(), l) > 0;
+            Check(n_r == 0 && b_low, values == &g ? "RandF share of values >= r" : "FillF share of values >= r",
+                (double) n_r / values->size(), 0.0);
+        }
+    }
+
+    std::printf("RandI\n");
+    {
+        Random rng(5, 0);
+        std::vector<size_t> counts(7, 0);
+        for (size_t i = 0; i < kSamples / 4; i++) {
+            counts[rng.RandI(3, 9) - 3]++;
+        }
+        double bound;
+        const double chi2 = ChiSquare(counts, kSamples / 4, bound);
+        Check(chi2 < bound, "[3, 9] chi-square", chi2, bound);
+
+        // a range of 3 * 2^30, plain multiply-shift would make the thirds 1/4, 1/4 & 1/2 likely
+        const int lo = INT32_MIN, hi = (1 << 30) - 1;
+        std::vector<size_t> thirds(3, 0);
+        const int64_t range = (int64_t) hi - lo + 1;
+        for (size_t i = 0; i < kSamples / 4; i++) {
+            const int64_t x = (int64_t) rng.RandI(lo, hi) - lo;
+            thirds[std::min<int64_t>(x * 3 / range, 2)]++;
+        }
+        const double chi2_big = ChiSquare(thirds, kSamples / 4, bound);
+        Check(chi2_big < bound, "[-2^31, 2^30) thirds chi-square", chi2_big, bound);
+
+        bool full = true;
+        for (int i = 0; i < 1000; i++) {
+            const int x = rng.RandI(5, 5);
+            full = full && x == 5;
+        }
+        Check(full, "[5, 5] is 5", 0.0, 0.0);
+    }
+
+    std::printf("throughput, ns per value\n");
+    {
+        std::vector<float> out(kSamples);
+        std::vector<int> out_i(kSamples);
+        Random rng(6, 0);
+        uint32_t sink = 0;
+        const double u32 = NsPerValue(kSamples, [&]() {
+            for (size_t i = 0; i < kSamples; i++) {
+                sink += rng.NextU32();
+            }
+        });
+        const double next_f = NsPerValue(kSamples, [&]() {
+            for (size_t i = 0; i < kSamples; i++) {
+                out[i] = rng.NextF();
+            }
+        });
+        const double rand_i = NsPerValue(kSamples, [&]() {
+            for (size_t i = 0; i < kSamples; i++) {
+                out_i[i] = rng.RandI(0, 99);
+            }
+        });
+        const double fill_f = NsPerValue(kSamples, [&]() { rng.FillF(out.data(), kSamples, 0.0f, 1.0f); });
+        const double fill_i = NsPerValue(kSamples, [&]() { rng.FillI(out_i.data(), kSamples, 0, 99); });
+
+        std::mt19937 mt(6);
+        std::uniform_real_distribution<float> dist_f(0.0f, 1.0f);
+        std::uniform_int_distribution<int> dist_i(0, 99);
+        const double mt_f = NsPerValue(kSamples, [&]() {
+            for (size_t i = 0; i < kSamples; i++) {
+                out[i] = dist_f(mt);
+            }
+        });
+        const double mt_i = NsPerValue(kSamples, [&]() {
+            for (size_t i = 0; i < kSamples; i++) {
+                out_i[i] = dist_i(mt);
+            }
+        });
+        std::printf("  NextU32 %.2f, NextF %.2f, RandI %.2f, FillF %.2f, FillI %.2f\n", u32, next_f, rand_i, fill_f,
+            fill_i);
+        std::printf("  mt19937 uniform real %.2f, uniform int %.2f (%u)\n", mt_f, mt_i, sink & 1);
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
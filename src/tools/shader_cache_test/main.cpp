@@ -0,0 +1,222 @@
+// check ShaderCache with a stub compiler: hits, misses, invalidation by includes & options, corrupt cache files
+// and stores from several caches of one file at once (as separate processes would do)
+// exits with 1 if a check fails
+// usage: shader_cache_test [work dir]
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShaderCache.h"
+
+namespace fs = std::filesystem;
+
+bool ok = true;
+
+void Check(bool pass, const char *what) {
+    ok = ok && pass;
+    std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+}
+
+void WriteText(const fs::path &filename, const std::string &text) {
+    std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+    fout << text;
+}
+
+std::string ReadText(const fs::path &filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+// "bytecode" is the source with its options, so every change of them is visible in the result
+struct StubCompiler {
+    int n_compile = 0;
+
+    ShaderCache::Compiler Get() {
+        return [this](const fs::path &filename, const ShaderCache::Defines &defines, const std::string &entry,
+                const std::string &target) {
+            n_compile++;
+            std::string code = ReadText(filename) + "|" + entry + "|" + target;
+            for (const auto &[name, value] : defines) {
+                code += "|" + name + "=" + value;
+            }
+            return std::vector<char>(code.begin(), code.end());
+        };
+    }
+};
+
+std::string AsString(const std::vector<char> &code) {
+    return std::string(code.begin(), code.end());
+}
+
+int main(int argc, char **argv) {
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const fs::path dir = argc >= 2 ? fs::path(argv[1]) :
+        fs::temp_directory_path() / ("shader_cache_test_" + std::to_string(stamp));
+    fs::create_directories(dir);
+    const fs::path cache_file = dir / "shader.cache";
+    const fs::path shader = dir / "color.hlsl";
+    const fs::path common = dir / "common.hlsl";
+    fs::remove(cache_file);
+    WriteText(common, "float4 Tint() { return 1; }\n");
+    WriteText(shader, "#include \"common.hlsl\"\nfloat4 PS() : SV_Target { return Tint(); }\n");
+    const ShaderCache::Defines no_defines;
+    const ShaderCache::Defines fog = { { "FOG", "1" } };
+
+    std::printf("hit & miss\n");
+    {
+        StubCompiler compiler;
+        ShaderCache cache(cache_file);
+        const auto first = cache.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1 && fs::exists(cache_file), "first use compiles and creates the file");
+        const auto second = cache.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1 && second == first, "second use hits");
+
+        ShaderCache reopened(cache_file);
+        const auto third = reopened.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1 && third == first, "hits after reopening the file");
+
+        cache.GetOrCompile(shader, fog, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 2, "defines are part of the key");
+        cache.GetOrCompile(shader, no_defines, "PS", "ps_6_0", 0, compiler.Get());
+        Check(compiler.n_compile == 3, "target is part of the key");
+        cache.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 1, compiler.Get());
+        Check(compiler.n_compile == 4, "flags are part of the key");
+    }
+
+    std::printf("invalidation\n");
+    {
+        StubCompiler compiler;
+        ShaderCache cache(cache_file);
+        const uint64_t before = cache.Key(shader, no_defines, "PS", "ps_5_1");
+        WriteText(common, "float4 Tint() { return 0.5; }\n");
+        const uint64_t after = cache.Key(shader, no_defines, "PS", "ps_5_1");
+        const auto code = cache.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(before != after && compiler.n_compile == 1, "changing an included file misses");
+        Check(AsString(code).find("Tint()") != std::string::npos, "result of the compiler is returned");
+
+        // a dependency cycle is scanned once
+        WriteText(common, "#include \"color.hlsl\"\nfloat4 Tint() { return 0.5; }\n");
+        Check(ShaderCache::ScanDependencies(shader).size() == 2, "include cycles end");
+        WriteText(common, "float4 Tint() { return 0.5; }\n");
+    }
+
+    std::printf("append\n");
+    {
+        StubCompiler compiler;
+        ShaderCache cache(cache_file);
+        const uint64_t key = cache.Key(shader, no_defines, "PS", "ps_5_1");
+        ShaderCache::Entry before, after;
+        cache.Find(key, before);
+        const auto size_before = fs::file_size(cache_file);
+        cache.GetOrCompile(shader, no_defines, "VS", "vs_5_1", 0, compiler.Get());
+        ShaderCache reopened(cache_file);
+        Check(reopened.Find(key, after) && after.offset == before.offset, "existing blobs stay where they are");
+        Check(fs::file_size(cache_file) > size_before, "new blob is appended");
+    }
+
+    std::printf("corrupt files\n");
+    {
+        // cut the file short in its index
+        StubCompiler compiler;
+        const std::string content = ReadText(cache_file);
+        WriteText(cache_file, content.substr(0, content.size() - 8));
+        ShaderCache cut(cache_file);
+        const auto code = cut.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1 && AsString(code).find("PS|ps_5_1") != std::string::npos,
+            "a cut index is a miss");
+        ShaderCache reopened(cache_file);
+        reopened.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1, "the file is valid again after the next store");
+    }
+    {
+        // overwrite a byte of a blob, the index still points at it
+        StubCompiler compiler;
+        ShaderCache cache(cache_file);
+        ShaderCache::Entry entry;
+        const uint64_t key = cache.Key(shader, no_defines, "PS", "ps_5_1");
+        cache.Find(key, entry);
+        std::string content = ReadText(cache_file);
+        content[entry.offset] ^= 0x5a;
+        WriteText(cache_file, content);
+        Check(cache.Load(key).empty(), "a changed blob is not loaded");
+        const auto code = cache.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1 && code[0] == '#', "a changed blob is compiled again");
+        ShaderCache reopened(cache_file);
+        Check(reopened.Load(key) == code, "and stored again");
+    }
+    {
+        // not a cache file at all
+        StubCompiler compiler;
+        WriteText(cache_file, "this is not a cache file");
+        ShaderCache garbage(cache_file);
+        garbage.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        ShaderCache reopened(cache_file);
+        reopened.GetOrCompile(shader, no_defines, "PS", "ps_5_1", 0, compiler.Get());
+        Check(compiler.n_compile == 1, "a file that is no cache is replaced");
+    }
+
+    std::printf("stale indices\n");
+    {
+        fs::remove(cache_file);
+        ShaderCache cache(cache_file);
+        const int n = 300;
+        for (int i = 0; i < n; i++) {
+            const std::string blob(100, (char) i);
+            cache.Store(1000 + i, blob.data(), blob.size());
+        }
+        bool all_found = true;
+        ShaderCache reopened(cache_file);
+        for (int i = 0; i < n; i++) {
+            all_found = all_found && reopened.Load(1000 + i) == std::vector<char>(100, (char) i);
+        }
+        const auto size = fs::file_size(cache_file);
+        Check(all_found, "all entries survive compaction");
+        // without compaction every store leaves its index behind, n^2 / 2 entries
+        std::printf("  %d entries, file size %zu bytes\n", n, (size_t) size);
+        Check(size < 200 * 1024, "stale indices are dropped");
+    }
+
+    std::printf("concurrent stores\n");
+    {
+        // each cache has its own mutex, only the file lock keeps their appends apart
+        fs::remove(cache_file);
+        const int n_writer = 8;
+        const int n_store = 40;
+        std::vector<std::thread> writers;
+        for (int w = 0; w < n_writer; w++) {
+            writers.emplace_back([&cache_file, w]() {
+                ShaderCache cache(cache_file);
+                for (int i = 0; i < n_store; i++) {
+                    const std::string blob(64 + i, (char) (w * n_store + i));
+                    cache.Store(5000 + w * n_store + i, blob.data(), blob.size());
+                }
+            });
+        }
+        for (auto &writer : writers) {
+            writer.join();
+        }
+        int n_found = 0;
+        ShaderCache reopened(cache_file);
+        for (int w = 0; w < n_writer; w++) {
+            for (int i = 0; i < n_store; i++) {
+                const int k = w * n_store + i;
+                n_found += reopened.Load(5000 + k) == std::vector<char>(64 + i, (char) k) ? 1 : 0;
+            }
+        }
+        std::printf("  %d of %d entries found\n", n_found, n_writer * n_store);
+        Check(n_found == n_writer * n_store, "no store is lost or overwritten");
+    }
+
+    if (argc < 2) {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,378 @@
+// render the land & still water of ch08_lighting or the skull of ch11_stenciling on the cpu and write a ppm image,
+// or check both scenes at 160x96 against golden images, exits with 1 if a check fails
+// usage: soft_render land <out.ppm> [width height]
+//        soft_render skull <skull.txt> <out.ppm> [width height]
+//        soft_render check <skull.txt> <golden dir> [n_thread]
+// golden/land.ppm & golden/skull.ppm are the first two at 160x96, rendered again when the output changes on purpose
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GridMesh.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+#include "SoftRenderer.h"
+
+const float kPi = 3.1415926535f;
+const int kRuns = 5;
+const uint32_t kCheckWidth = 160;
+const uint32_t kCheckHeight = 96;
+// a pixel of a check differs from the golden image if a channel is off by more than this,
+// which may happen along edges when the compiler rounds differently
+const int kChannelTolerance = 2;
+// in 1/1000 of the pixels
+const int kDifferingPermille = 5;
+// LightSteelBlue, the clear color of the chapters
+const float kClearColor[4] = { 0.690196f, 0.768627f, 0.870588f, 1.0f };
+
+// pos & normal, as Vertex of the chapters
+struct Mesh {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    SoftMesh View() const {
+        SoftMesh mesh;
+        mesh.vertices = vertices.data();
+        mesh.stride = 6 * sizeof(float);
+        mesh.normal_offset = 3 * sizeof(float);
+        mesh.n_vertex = (uint32_t) (vertices.size() / 6);
+        mesh.indices = indices.data();
+        mesh.index32 = true;
+        mesh.n_index = (uint32_t) indices.size();
+        return mesh;
+    }
+};
+
+// GeometryGenerator::Grid(w, d, n, m), flat at y = 0
+Mesh BuildGrid(float w, float d, int n, int m) {
+    Mesh mesh;
+    mesh.vertices.resize(6 * (size_t) n * m);
+    GridVertices(w, d, n, m, [&mesh](int id, float x, float z, float, float) {
+        float *v = mesh.vertices.data() + 6 * (size_t) id;
+        v[0] = x;
+        v[1] = 0.0f;
+        v[2] = z;
+        v[3] = 0.0f;
+        v[4] = 1.0f;
+        v[5] = 0.0f;
+    });
+    mesh.indices = GridIndices(n, m);
+    return mesh;
+}
+
+bool LoadSkull(const std::string &filename, Mesh &mesh) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        return false;
+    }
+    size_t n_vertex = 0, n_triangle = 0;
+    std::string ignore;
+    fin >> ignore >> n_vertex;
+    fin >> ignore >> n_triangle;
+    fin >> ignore >> ignore >> ignore >> ignore;
+    mesh.vertices.resize(6 * n_vertex);
+    for (float &f : mesh.vertices) {
+        fin >> f;
+    }
+    fin >> ignore >> ignore >> ignore;
+    mesh.indices.resize(3 * n_triangle);
+    for (uint32_t &index : mesh.indices) {
+        fin >> index;
+    }
+    return !fin.fail();
+}
+
+void Multiply(const float a[4][4], const float b[4][4], float out[4][4]) {
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+        }
+    }
+}
+
+// XMMatrixLookAtRH & XMMatrixPerspectiveFovRH, eye at (radius, theta, phi) as the chapters' orbit camera
+void SetCamera(SoftPass &pass, float radius, float theta, float phi, float aspect) {
+    const float eye[3] = {
+        radius * std::sin(phi) * std::cos(theta),
+        radius * std::cos(phi),
+        radius * std::sin(phi) * std::sin(theta)
+    };
+    float z_axis[3] = { eye[0], eye[1], eye[2] };
+    const float z_len = std::sqrt(z_axis[0] * z_axis[0] + z_axis[1] * z_axis[1] + z_axis[2] * z_axis[2]);
+    for (float &f : z_axis) {
+        f /= z_len;
+    }
+    // up x z
+    float x_axis[3] = { z_axis[2], 0.0f, -z_axis[0] };
+    const float x_len = std::sqrt(x_axis[0] * x_axis[0] + x_axis[2] * x_axis[2]);
+    for (float &f : x_axis) {
+        f /= x_len;
+    }
+    const float y_axis[3] = {
+        z_axis[1] * x_axis[2] - z_axis[2] * x_axis[1],
+        z_axis[2] * x_axis[0] - z_axis[0] * x_axis[2],
+        z_axis[0] * x_axis[1] - z_axis[1] * x_axis[0]
+    };
+    const float *axes[3] = { x_axis, y_axis, z_axis };
+    std::memset(pass.view, 0, sizeof(pass.view));
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            pass.view[r][c] = axes[c][r];
+        }
+        pass.view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    pass.view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    std::memset(pass.proj, 0, sizeof(pass.proj));
+    pass.proj[0][0] = h / aspect;
+    pass.proj[1][1] = h;
+    pass.proj[2][2] = range;
+    pass.proj[2][3] = -1.0f;
+    pass.proj[3][2] = range * near_z;
+
+    Multiply(pass.view, pass.proj, pass.vp);
+    std::memcpy(pass.eye, eye, sizeof(pass.eye));
+    pass.near_z = near_z;
+    pass.far_z = far_z;
+}
+
+void SetMaterial(SoftMaterial &mat, float r, float g, float b, float r0, float roughness) {
+    mat.albedo[0] = r;
+    mat.albedo[1] = g;
+    mat.albedo[2] = b;
+    mat.albedo[3] = 1.0f;
+    mat.fresnel_r0[0] = mat.fresnel_r0[1] = mat.fresnel_r0[2] = r0;
+    mat.roughness = roughness;
+}
+
+void SetLight(SoftLight &light, float x, float y, float z, float strength) {
+    light.direction[0] = x;
+    light.direction[1] = y;
+    light.direction[2] = z;
+    light.strength[0] = light.strength[1] = light.strength[2] = strength;
+}
+
+struct Scene {
+    std::vector<Mesh> meshes;
+    std::vector<SoftDraw> draws;
+    SoftPass pass;
+    SoftLightCounts counts;
+};
+
+// land & water of ch08_lighting, the water at rest
+void BuildLand(float aspect, Scene &scene) {
+    Mesh land = BuildGrid(160.0f, 160.0f, 50, 50);
+    const size_t n_vertex = land.vertices.size() / 6;
+    std::vector<float> x(n_vertex), z(n_vertex), heights(n_vertex), normals(3 * n_vertex);
+    for (size_t i = 0; i < n_vertex; i++) {
+        x[i] = land.vertices[6 * i];
+        z[i] = land.vertices[6 * i + 2];
+    }
+    HillField::Evaluate(x.data(), z.data(), n_vertex, heights.data(), normals.data());
+    for (size_t i = 0; i < n_vertex; i++) {
+        land.vertices[6 * i + 1] = heights[i];
+        std::memcpy(&land.vertices[6 * i + 3], &normals[3 * i], 3 * sizeof(float));
+    }
+    scene.meshes.push_back(std::move(land));
+    scene.meshes.push_back(BuildGrid(127.0f, 127.0f, 128, 128));
+
+    scene.draws.resize(2);
+    SetMaterial(scene.draws[0].material, 0.2f, 0.6f, 0.2f, 0.01f, 0.125f);
+    SetMaterial(scene.draws[1].material, 0.0f, 0.2f, 0.6f, 0.1f, 0.0f);
+
+    SetCamera(scene.pass, 150.0f, 1.35f * kPi, 0.3f * kPi, aspect);
+    // -Spherical2Cartesian(1, sun_theta, sun_phi) with the initial sun of ch08_lighting
+    const float sun_theta = 1.25f * kPi, sun_phi = 0.25f * kPi;
+    SetLight(scene.pass.lights[0], -std::sin(sun_phi) * std::cos(sun_theta), -std::cos(sun_phi),
+        -std::sin(sun_phi) * std::sin(sun_theta), 1.0f);
+    scene.pass.lights[0].strength[2] = 0.9f;
+    scene.counts.n_dir = 1;
+}
+
+// skull of ch11_stenciling with its three lights, turned as there
+bool BuildSkull(const std::string &filename, float aspect, Scene &scene) {
+    Mesh skull;
+    if (!LoadSkull(filename, skull)) {
+        std::printf("failed to load '%s'\n", filename.c_str());
+        return false;
+    }
+    scene.meshes.push_back(std::move(skull));
+
+    scene.draws.resize(1);
+    SetMaterial(scene.draws[0].material, 1.0f, 1.0f, 1.0f, 0.05f, 0.3f);
+    // XMMatrixRotationY(0.5 * XM_PI), its own inverse transpose
+    const float rotate[4][4] = {
+        { 0.0f, 0.0f, -1.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    };
+    std::memcpy(scene.draws[0].object.model, rotate, sizeof(rotate));
+    std::memcpy(scene.draws[0].object.model_it, rotate, sizeof(rotate));
+
+    SetCamera(scene.pass, 20.0f, 1.25f * kPi, 0.25f * kPi, aspect);
+    SetLight(scene.pass.lights[0], 0.57735f, -0.57735f, 0.57735f, 0.6f);
+    SetLight(scene.pass.lights[1], -0.57735f, -0.57735f, 0.57735f, 0.3f);
+    SetLight(scene.pass.lights[2], 0.0f, -0.707f, -0.707f, 0.15f);
+    scene.counts.n_dir = 3;
+    return true;
+}
+
+// the ambient light of both scenes, and the meshes of the draws once all meshes are built
+void FinishScene(Scene &scene) {
+    scene.pass.ambient[0] = 0.25f;
+    scene.pass.ambient[1] = 0.25f;
+    scene.pass.ambient[2] = 0.35f;
+    for (size_t i = 0; i < scene.draws.size(); i++) {
+        scene.draws[i].mesh = scene.meshes[i].View();
+    }
+}
+
+void RenderScene(JobSystem &jobs, const Scene &scene, SoftRenderer &renderer) {
+    renderer.Clear(kClearColor);
+    renderer.Render(jobs, scene.pass, scene.counts, scene.draws.data(), scene.draws.size());
+}
+
+// binary ppm as SoftRenderer::WritePpm writes it, rgb
+bool ReadPpm(const std::string &filename, uint32_t &width, uint32_t &height, std::vector<uint8_t> &rgb) {
+    std::ifstream fin(filename, std::ios::binary);
+    std::string magic;
+    int max_value = 0;
+    fin >> magic >> width >> height >> max_value;
+    if (!fin || magic != "P6" || max_value != 255) {
+        return false;
+    }
+    fin.get();
+    rgb.resize(3 * (size_t) width * height);
+    fin.read(reinterpret_cast<char *>(rgb.data()), rgb.size());
+    return (bool) fin;
+}
+
+// render both scenes small with 1 and n threads and compare them with each other and with the golden images
+int Check(const std::string &skull_filename, const std::string &golden_dir, unsigned n_thread) {
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    for (const char *name : { "land", "skull" }) {
+        std::printf("%s, %ux%u, %u threads\n", name, kCheckWidth, kCheckHeight, jobs.ThreadCount());
+        Scene scene;
+        const float aspect = (float) kCheckWidth / kCheckHeight;
+        if (std::strcmp(name, "land") == 0) {
+            BuildLand(aspect, scene);
+        } else if (!BuildSkull(skull_filename, aspect, scene)) {
+            check(false, "skull loaded");
+            continue;
+        }
+        FinishScene(scene);
+
+        SoftRenderer renderer(kCheckWidth, kCheckHeight), one_thread(kCheckWidth, kCheckHeight);
+        RenderScene(jobs, scene, renderer);
+        RenderScene(single, scene, one_thread);
+        const size_t n_pixel = (size_t) kCheckWidth * kCheckHeight;
+        check(std::equal(renderer.Pixels(), renderer.Pixels() + n_pixel, one_thread.Pixels()),
+            "the same bytes with any thread count");
+        // a render of the same scene is drawn again the same
+        RenderScene(jobs, scene, one_thread);
+        check(std::equal(renderer.Pixels(), renderer.Pixels() + n_pixel, one_thread.Pixels()),
+            "the same bytes when rendered again");
+
+        const std::string golden_filename = golden_dir + "/" + name + ".ppm";
+        uint32_t golden_width = 0, golden_height = 0;
+        std::vector<uint8_t> golden;
+        if (!ReadPpm(golden_filename, golden_width, golden_height, golden) || golden_width != kCheckWidth ||
+            golden_height != kCheckHeight) {
+            std::printf("  failed to read a %ux%u image from '%s'\n", kCheckWidth, kCheckHeight,
+                golden_filename.c_str());
+            check(false, "golden image read");
+            continue;
+        }
+        size_t n_differing = 0;
+        int max_diff = 0;
+        for (size_t p = 0; p < n_pixel; p++) {
+            int pixel_diff = 0;
+            for (int c = 0; c < 3; c++) {
+                const int value = (renderer.Pixels()[p] >> (8 * c)) & 0xff;
+                pixel_diff = std::max(pixel_diff, std::abs(value - golden[3 * p + c]));
+            }
+            n_differing += pixel_diff > kChannelTolerance;
+            max_diff = std::max(max_diff, pixel_diff);
+        }
+        std::printf("  %zu of %zu pixels differ from the golden image by more than %d, by %d at most\n", n_differing,
+            n_pixel, kChannelTolerance, max_diff);
+        check(n_differing * 1000 <= n_pixel * kDifferingPermille, "matches the golden image");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && std::strcmp(argv[1], "check") == 0) {
+        // at least a few threads, so that tiles are shared out even on a single core
+        const unsigned n_thread = argc >= 5 ? (unsigned) std::atoi(argv[4]) :
+            std::max(4u, std::thread::hardware_concurrency());
+        return Check(argv[2], argv[3], n_thread);
+    }
+    const bool is_land = argc >= 3 && std::strcmp(argv[1], "land") == 0;
+    const bool is_skull = argc >= 4 && std::strcmp(argv[1], "skull") == 0;
+    if (!is_land && !is_skull) {
+        std::printf("usage: %s land <out.ppm> [width height]\n", argv[0]);
+        std::printf("       %s skull <skull.txt> <out.ppm> [width height]\n", argv[0]);
+        std::printf("       %s check <skull.txt> <golden dir> [n_thread]\n", argv[0]);
+        return 1;
+    }
+    const int arg_out = is_land ? 2 : 3;
+    uint32_t width = 1920, height = 1080;
+    if (argc >= arg_out + 3) {
+        width = (uint32_t) std::atoi(argv[arg_out + 1]);
+        height = (uint32_t) std::atoi(argv[arg_out + 2]);
+    }
+    if (width == 0 || width % 4 != 0 || height == 0) {
+        std::printf("width must be a positive multiple of 4 and height positive\n");
+        return 1;
+    }
+
+    Scene scene;
+    const float aspect = (float) width / height;
+    if (is_land) {
+        BuildLand(aspect, scene);
+    } else if (!BuildSkull(argv[2], aspect, scene)) {
+        return 1;
+    }
+    FinishScene(scene);
+
+    JobSystem jobs;
+    SoftRenderer renderer(width, height);
+    double best_ms = 0.0;
+    for (int run = 0; run < kRuns; run++) {
+        RenderScene(jobs, scene, renderer);
+        const SoftStats &stats = renderer.Stats();
+        best_ms = run == 0 ? stats.TotalMs() : std::min(best_ms, stats.TotalMs());
+        std::printf("run %d: %.2f ms (vertex %.2f, setup %.2f, raster %.2f)\n", run, stats.TotalMs(),
+            stats.vertex_ms, stats.setup_ms, stats.raster_ms);
+    }
+    const SoftStats &stats = renderer.Stats();
+    std::printf("%ux%u, %u threads, %zu draws, %zu triangles, %zu set up, best %.2f ms\n", width, height,
+        jobs.ThreadCount(), stats.n_draw, stats.n_triangle, stats.n_setup, best_ms);
+
+    if (!renderer.WritePpm(argv[arg_out])) {
+        std::printf("failed to write '%s'\n", argv[arg_out]);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
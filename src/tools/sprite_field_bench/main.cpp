@@ -0,0 +1,239 @@
+// check SpriteField scatter rules & culling against testing every sprite, and time both for 1..n threads,
+// exits with 1 if a check fails
+// the field is ch12_gs' trees on HillField, scaled up in candidates to see how culling grows
+// usage: sprite_field_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Frustum.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+#include "SpriteField.h"
+
+const float kPi = 3.14159265358979f;
+const int kRuns = 10;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// as BuildTreeSprites() of ch12_gs
+ScatterRule TreeRule(size_t n_candidate) {
+    ScatterRule rule;
+    rule.min_x = -75.0f;
+    rule.max_x = 75.0f;
+    rule.min_z = -75.0f;
+    rule.max_z = 75.0f;
+    rule.n_candidate = n_candidate;
+    rule.min_height = 1.0f;
+    rule.max_slope = 1.0f;
+    rule.density = 0.25f;
+    rule.min_size = 8.0f;
+    rule.max_size = 14.0f;
+    rule.n_variant = 3;
+    rule.seed = 12;
+    return rule;
+}
+
+// XMMatrixLookAtRH * XMMatrixPerspectiveFovRH as the chapters' camera, fov 0.25 pi, near 0.1, far 1000
+Frustum CameraFrustum(const float eye[3], const float target[3]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    float view[4][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f, aspect = 16.0f / 9.0f;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    float proj[4][4] = {};
+    proj[0][0] = h / aspect;
+    proj[1][1] = h;
+    proj[2][2] = range;
+    proj[2][3] = -1.0f;
+    proj[3][2] = range * near_z;
+
+    float vp[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            vp[r][c] = view[r][0] * proj[0][c] + view[r][1] * proj[1][c] + view[r][2] * proj[2][c] +
+                view[r][3] * proj[3][c];
+        }
+    }
+    return Frustum::FromViewProj(vp);
+}
+
+float Radius(const SpriteInstance &sprite) {
+    return 0.5f * std::sqrt(sprite.size[0] * sprite.size[0] + sprite.size[1] * sprite.size[1]);
+}
+
+// a sprite is visible if its bounding sphere passes, as culling of a cell crossing the frustum
+size_t CullEach(const std::vector<SpriteInstance> &sprites, const Frustum &frustum, SpriteInstance *out) {
+    size_t n_visible = 0;
+    for (const SpriteInstance &sprite : sprites) {
+        if (frustum.TestSphere(sprite.pos, Radius(sprite))) {
+            out[n_visible++] = sprite;
+        }
+    }
+    return n_visible;
+}
+
+bool SameSprite(const SpriteInstance &a, const SpriteInstance &b) {
+    return std::memcmp(&a, &b, sizeof(SpriteInstance)) == 0;
+}
+
+// visible sprites are in cell order, pass the sphere test, and include every sprite passing both the sphere test
+// and the test of its own box (whole cells inside are copied without the sphere test, but those pass it anyway)
+bool CullCorrect(const std::vector<SpriteInstance> &sprites, const Frustum &frustum, const SpriteInstance *visible,
+    size_t n_visible) {
+    size_t v = 0;
+    for (const SpriteInstance &sprite : sprites) {
+        const bool taken = v < n_visible && SameSprite(visible[v], sprite);
+        const bool sphere = frustum.TestSphere(sprite.pos, Radius(sprite));
+        const float half[3] = { 0.5f * sprite.size[0], 0.5f * sprite.size[1], 0.5f * sprite.size[0] };
+        const float min[3] = { sprite.pos[0] - half[0], sprite.pos[1] - half[1], sprite.pos[2] - half[2] };
+        const float max[3] = { sprite.pos[0] + half[0], sprite.pos[1] + half[1], sprite.pos[2] + half[2] };
+        const bool box = frustum.TestAabb(min, max) != Frustum::Result::Outside;
+        if (taken && !sphere) {
+            return false;
+        }
+        if (!taken && sphere && box) {
+            return false;
+        }
+        v += taken ? 1 : 0;
+    }
+    return v == n_visible;
+}
+
+int main(int argc, char **argv) {
+    const unsigned max_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem single(1);
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("scatter rules\n");
+    {
+        const ScatterRule rule = TreeRule(1 << 16);
+        SpriteField field, field_single;
+        JobSystem jobs(std::max(max_thread, 1u));
+        field.Scatter(jobs, rule, HillField::Evaluate);
+        field_single.Scatter(single, rule, HillField::Evaluate);
+        bool same = field.Count() == field_single.Count();
+        for (size_t i = 0; same && i < field.Count(); i++) {
+            same = SameSprite(field.Sprites()[i], field_single.Sprites()[i]);
+        }
+        check(same, "same sprites with 1 and n threads");
+
+        bool in_rule = true;
+        for (const SpriteInstance &sprite : field.Sprites()) {
+            const float x = sprite.pos[0], z = sprite.pos[2];
+            float normal[3];
+            HillField::Normal(x, z, normal);
+            // the quad is lifted by 0.4 of its size above the ground
+            const float ground = sprite.pos[1] - 0.4f * sprite.size[1];
+            in_rule = in_rule && x >= rule.min_x && x <= rule.max_x && z >= rule.min_z && z <= rule.max_z &&
+                std::abs(ground - HillField::Height(x, z)) < 1e-3f && ground >= rule.min_height - 1e-3f &&
+                normal[0] * normal[0] + normal[2] * normal[2] <= (1.0f + 1e-3f) * normal[1] * normal[1] &&
+                sprite.size[0] >= rule.min_size && sprite.size[0] <= rule.max_size && sprite.variant < rule.n_variant;
+        }
+        check(in_rule, "every sprite in the rectangle, on the ground, above min height & not too steep");
+        // density 0.25 of the candidates passing height & slope, about a third of the square is such land
+        const double kept = (double) field.Count() / rule.n_candidate;
+        check(kept > 0.02 && kept < 0.25, "a plausible share of candidates kept");
+        std::printf("  %zu of %zu candidates kept, %zu cells\n", field.Count(), rule.n_candidate, field.CellCount());
+    }
+
+    // looking across the field from its edge, down on all of it, and away from it
+    struct View {
+        const char *name;
+        float eye[3];
+        float target[3];
+    };
+    const View views[] = {
+        { "across", { -70.0f, 20.0f, -70.0f }, { 0.0f, 0.0f, 0.0f } },
+        { "center", { 0.0f, 15.0f, 0.0f }, { 30.0f, 5.0f, 10.0f } },
+        { "above ", { 0.0f, 300.0f, -1.0f }, { 0.0f, 0.0f, 0.0f } },
+        { "away  ", { -80.0f, 20.0f, -80.0f }, { -160.0f, 20.0f, -160.0f } },
+    };
+
+    std::printf("cull against testing every sprite\n");
+    for (size_t n_candidate : { (size_t) 1 << 16, (size_t) 1 << 20 }) {
+        JobSystem jobs(std::max(max_thread, 1u));
+        SpriteField field;
+        field.Scatter(jobs, TreeRule(n_candidate), HillField::Evaluate);
+        std::vector<SpriteInstance> visible(field.Count()), visible_each(field.Count());
+        for (const View &view : views) {
+            const Frustum frustum = CameraFrustum(view.eye, view.target);
+            const size_t n_visible = field.Cull(jobs, frustum, visible.data());
+            const size_t n_each = CullEach(field.Sprites(), frustum, visible_each.data());
+            const bool pass = CullCorrect(field.Sprites(), frustum, visible.data(), n_visible);
+            ok = ok && pass;
+
+            double cull_ms = 0.0, each_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                auto begin = std::chrono::steady_clock::now();
+                field.Cull(jobs, frustum, visible.data());
+                const double ms = Milliseconds(begin);
+                cull_ms = run == 0 ? ms : std::min(cull_ms, ms);
+                begin = std::chrono::steady_clock::now();
+                CullEach(field.Sprites(), frustum, visible_each.data());
+                const double ms_each = Milliseconds(begin);
+                each_ms = run == 0 ? ms_each : std::min(each_ms, ms_each);
+            }
+            std::printf("  %7zu sprites, %s: %7zu visible (%7zu by spheres), cull %7.3f ms, every sprite %7.3f ms %s\n",
+                field.Count(), view.name, n_visible, n_each, cull_ms, each_ms, pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf("scaling, 2^20 candidates, view across\n");
+    for (unsigned n_thread = 1; n_thread <= std::max(max_thread, 1u); n_thread *= 2) {
+        JobSystem jobs(n_thread);
+        SpriteField field;
+        const ScatterRule rule = TreeRule(1 << 20);
+        double scatter_ms = 0.0, cull_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            field.Scatter(jobs, rule, HillField::Evaluate);
+            const double ms = Milliseconds(begin);
+            scatter_ms = run == 0 ? ms : std::min(scatter_ms, ms);
+        }
+        std::vector<SpriteInstance> visible(field.Count());
+        const Frustum frustum = CameraFrustum(views[0].eye, views[0].target);
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            field.Cull(jobs, frustum, visible.data());
+            const double ms = Milliseconds(begin);
+            cull_ms = run == 0 ? ms : std::min(cull_ms, ms);
+        }
+        std::printf("  %2u threads: scatter %7.3f ms, cull %7.3f ms\n", n_thread, scatter_ms, cull_ms);
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
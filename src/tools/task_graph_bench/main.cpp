@@ -0,0 +1,180 @@
+// check TaskGraph on random graphs and time the Initialize() graph of ch12_gs with stand-in stages for 1..n threads,
+// exits with 1 if a check fails
+// stand-ins sleep for about the time the real stage takes with a warm shader cache, as loading textures and
+// compiling shaders mostly wait on the disk & the compiler; time to first frame of a chapter is printed by
+// D3DApp on Windows, run it with '--first-frame' to get it on stdout
+// usage: task_graph_bench [n_thread]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Random.h"
+#include "TaskGraph.h"
+
+const int kRandomGraphs = 50;
+const size_t kRandomStages = 200;
+
+struct StandIn {
+    const char *name;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    double ms;
+    bool serialized;
+};
+
+// stages of ch12_gs Initialize()
+const std::vector<StandIn> kInitStages = {
+    { "LoadTextures", {}, { "textures" }, 40.0, false },
+    { "BuildRootSignature", {}, { "root_signature" }, 2.0, false },
+    { "BuildDescriptorHeaps", { "textures" }, { "srv_heap" }, 1.0, false },
+    { "BuildShaderAndInputLayout", {}, { "shaders", "input_layout" }, 30.0, false },
+    { "BuildTerrain", {}, { "land_geo" }, 15.0, true },
+    { "BuildWaveGeometryBuffers", {}, { "water_geo" }, 3.0, true },
+    { "BuildBoxGeometry", {}, { "box_geo" }, 1.0, true },
+    { "BuildTreeSprites", {}, { "tree_geo" }, 1.0, true },
+    { "BuildMaterials", {}, { "materials" }, 0.5, false },
+    { "BuildRenderItems", { "land_geo", "water_geo", "box_geo", "tree_geo", "materials" }, { "render_items" }, 0.5,
+        false },
+    { "BuildFrameResources", { "render_items", "materials" }, { "frame_resources" }, 2.0, false },
+    { "BuildPSOs", { "root_signature", "shaders", "input_layout" }, { "psos" }, 20.0, false },
+};
+
+// every stage starts after its dependencies end and serialized stages never overlap
+bool OrderRespected(const TaskGraph &graph) {
+    const auto &stages = graph.Stages();
+    for (const auto &stage : stages) {
+        for (size_t d : stage.deps) {
+            if (stages[d].end_ms > stage.start_ms) {
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        for (size_t j = i + 1; j < stages.size(); j++) {
+            if (stages[i].serialized && stages[j].serialized && stages[i].start_ms < stages[j].end_ms &&
+                    stages[j].start_ms < stages[i].end_ms) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const unsigned max_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) :
+        std::max(4u, std::thread::hardware_concurrency());
+    bool ok = true;
+
+    std::printf("random graphs, %d x %zu stages, %u threads\n", kRandomGraphs, kRandomStages, max_thread);
+    {
+        bool all_once = true, order = true;
+        for (int g = 0; g < kRandomGraphs; g++) {
+            // stage i reads outputs of a few earlier stages, so the graph has no cycle
+            Random rng(g, 0);
+            std::vector<std::atomic<int>> n_run(kRandomStages);
+            TaskGraph graph;
+            for (size_t i = 0; i < kRandomStages; i++) {
+                std::vector<std::string> inputs;
+                const int n_input = i == 0 ? 0 : rng.RandI(0, 3);
+                for (int k = 0; k < n_input; k++) {
+                    inputs.push_back("r" + std::to_string(rng.RandI(0, (int) i - 1)));
+                }
+                // an input nobody writes is ready from the start
+                if (rng.RandI(0, 9) == 0) {
+                    inputs.push_back("device");
+                }
+                graph.AddStage("s" + std::to_string(i), inputs, { "r" + std::to_string(i) }, [&n_run, i]() {
+                    n_run[i]++;
+                }, rng.RandI(0, 3) == 0);
+            }
+            graph.Run(max_thread);
+            for (size_t i = 0; i < kRandomStages; i++) {
+                all_once = all_once && n_run[i] == 1;
+            }
+            order = order && OrderRespected(graph);
+        }
+        const bool pass = all_once && order;
+        ok = ok && pass;
+        std::printf("  every stage once: %s, dependencies & serialization: %s %s\n", all_once ? "yes" : "no",
+            order ? "respected" : "VIOLATED", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("exceptions\n");
+    {
+        TaskGraph graph;
+        std::atomic<bool> dependent_ran = false;
+        graph.AddStage("throws", {}, { "a" }, []() { throw std::runtime_error("stage failed"); });
+        graph.AddStage("after", { "a" }, { "b" }, [&dependent_ran]() { dependent_ran = true; });
+        graph.AddStage("independent", {}, { "c" }, []() {});
+        bool caught = false;
+        try {
+            graph.Run(max_thread);
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+        const bool pass = caught && !dependent_ran;
+        ok = ok && pass;
+        std::printf("  re-thrown by Run(): %s, dependent skipped: %s %s\n", caught ? "yes" : "no",
+            dependent_ran ? "no" : "yes", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("cycles\n");
+    {
+        // a -> b -> c -> a, d waits on the cycle, e is independent
+        TaskGraph graph;
+        std::atomic<int> n_ran = 0;
+        auto stage = [&n_ran]() { n_ran++; };
+        graph.AddStage("a", { "rc" }, { "ra" }, stage);
+        graph.AddStage("b", { "ra" }, { "rb" }, stage);
+        graph.AddStage("c", { "rb" }, { "rc" }, stage, true);
+        graph.AddStage("d", { "rc", "device" }, { "rd" }, stage);
+        graph.AddStage("e", {}, { "re" }, stage);
+        bool caught = false, named = false;
+        try {
+            graph.Run(max_thread);
+        } catch (const std::logic_error &e) {
+            caught = true;
+            const std::string what = e.what();
+            named = what.size() >= 12 && what.compare(what.size() - 12, 12, ": a, b, c, d") == 0;
+        }
+        const bool pass = caught && named && n_ran == 0;
+        ok = ok && pass;
+        std::printf("  thrown by Run(): %s, stages named: %s, stages run: %d %s\n", caught ? "yes" : "no",
+            named ? "yes" : "no", n_ran.load(), pass ? "ok" : "FAILED");
+    }
+
+    double sum_ms = 0.0;
+    for (const StandIn &stand_in : kInitStages) {
+        sum_ms += stand_in.ms;
+    }
+    std::printf("ch12_gs init with stand-in stages, %.1f ms in sequence\n", sum_ms);
+    for (unsigned n_thread = 1; n_thread <= max_thread; n_thread++) {
+        TaskGraph graph;
+        for (const StandIn &stand_in : kInitStages) {
+            const double ms = stand_in.ms;
+            graph.AddStage(stand_in.name, stand_in.inputs, stand_in.outputs, [ms]() {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+            }, stand_in.serialized);
+        }
+        graph.Run(n_thread);
+        double cp_ms = 0.0;
+        graph.CriticalPath(cp_ms);
+        const bool pass = OrderRespected(graph);
+        ok = ok && pass;
+        std::printf("  %2u threads: %7.2f ms, critical path %7.2f ms, %.2fx %s\n", n_thread, graph.WallTime(), cp_ms,
+            sum_ms / graph.WallTime(), pass ? "ok" : "FAILED");
+        if (n_thread == max_thread) {
+            std::printf("%s", graph.Report().c_str());
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
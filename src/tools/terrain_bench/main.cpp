@@ -0,0 +1,456 @@
+// check Terrain chunk selection (chunks tile the terrain, neighbors differ by one level at most, stitch masks),
+// that stitched chunks meet without cracks, and slot streaming, then time selection & streaming,
+// exits with 1 if a check fails
+// the terrain is ch12_gs' on HillField
+// usage: terrain_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Frustum.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+#include "Terrain.h"
+
+const float kPi = 3.14159265358979f;
+const int kRuns = 10;
+// of positions along & across a shared edge
+const float kEdgeTolerance = 1e-3f;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// as BuildTerrain() of ch12_gs
+TerrainDesc ChapterDesc() {
+    TerrainDesc desc;
+    desc.min_x = -160.0f;
+    desc.min_z = -160.0f;
+    desc.size = 320.0f;
+    desc.n_level = 4;
+    desc.chunk_quads = 32;
+    return desc;
+}
+
+// XMMatrixLookAtRH * XMMatrixPerspectiveFovRH as the chapters' camera, fov 0.25 pi, near 0.1, far 1000
+Frustum CameraFrustum(const float eye[3], const float target[3]) {
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    const float z_len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float &f : z) {
+        f /= z_len;
+    }
+    // up x z
+    float x[3] = { z[2], 0.0f, -z[0] };
+    const float x_len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    for (float &f : x) {
+        f /= x_len;
+    }
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float *axes[3] = { x, y, z };
+    float view[4][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            view[r][c] = axes[c][r];
+        }
+        view[3][c] = -(axes[c][0] * eye[0] + axes[c][1] * eye[1] + axes[c][2] * eye[2]);
+    }
+    view[3][3] = 1.0f;
+
+    const float near_z = 0.1f, far_z = 1000.0f, aspect = 16.0f / 9.0f;
+    const float h = 1.0f / std::tan(0.25f * kPi * 0.5f);
+    const float range = far_z / (near_z - far_z);
+    float proj[4][4] = {};
+    proj[0][0] = h / aspect;
+    proj[1][1] = h;
+    proj[2][2] = range;
+    proj[2][3] = -1.0f;
+    proj[3][2] = range * near_z;
+
+    float vp[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            vp[r][c] = view[r][0] * proj[0][c] + view[r][1] * proj[1][c] + view[r][2] * proj[2][c] +
+                view[r][3] * proj[3][c];
+        }
+    }
+    return Frustum::FromViewProj(vp);
+}
+
+// eye of ch12_gs' orbit camera
+void OrbitEye(float radius, float theta, float phi, float eye[3]) {
+    eye[0] = radius * std::sin(phi) * std::cos(theta);
+    eye[1] = radius * std::cos(phi);
+    eye[2] = radius * std::sin(phi) * std::sin(theta);
+}
+
+// index of the chunk covering every leaf cell, -1 if none, -2 if more than one
+std::vector<int> LeafOwners(const Terrain &terrain, const std::vector<TerrainChunk> &chunks) {
+    const int n_leaf = 1 << (terrain.Desc().n_level - 1);
+    std::vector<int> owners((size_t) n_leaf * n_leaf, -1);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const TerrainNode &node = chunks[i].node;
+        const int span = 1 << node.level;
+        for (int z = node.z * span; z < (node.z + 1) * span; z++) {
+            for (int x = node.x * span; x < (node.x + 1) * span; x++) {
+                int &owner = owners[(size_t) z * n_leaf + x];
+                owner = owner == -1 ? (int) i : -2;
+            }
+        }
+    }
+    return owners;
+}
+
+struct Side {
+    uint32_t bit;
+    uint32_t opposite;
+    int dx; // leaf step to the neighbor
+    int dz;
+};
+const Side kSides[] = {
+    { kTerrainNorth, kTerrainSouth, 0, 1 },
+    { kTerrainEast, kTerrainWest, 1, 0 },
+    { kTerrainSouth, kTerrainNorth, 0, -1 },
+    { kTerrainWest, kTerrainEast, -1, 0 },
+};
+
+// chunks tile the terrain, neighbors are at most one level apart, a stitch bit is set iff the neighbor is coarser
+bool SelectionCorrect(const Terrain &terrain, const std::vector<TerrainChunk> &chunks) {
+    const int n_leaf = 1 << (terrain.Desc().n_level - 1);
+    const std::vector<int> owners = LeafOwners(terrain, chunks);
+    for (int owner : owners) {
+        if (owner < 0) {
+            return false;
+        }
+    }
+    for (const TerrainChunk &chunk : chunks) {
+        const TerrainNode &node = chunk.node;
+        const int span = 1 << node.level;
+        for (const Side &side : kSides) {
+            bool coarser = false;
+            for (int k = 0; k < span; k++) {
+                // leaf cells just outside the side
+                int x = side.dx > 0 ? (node.x + 1) * span : side.dx < 0 ? node.x * span - 1 : node.x * span + k;
+                int z = side.dz > 0 ? (node.z + 1) * span : side.dz < 0 ? node.z * span - 1 : node.z * span + k;
+                if (x < 0 || z < 0 || x >= n_leaf || z >= n_leaf) {
+                    continue;
+                }
+                const int level = chunks[owners[(size_t) z * n_leaf + x]].node.level;
+                if (std::abs(level - node.level) > 1) {
+                    return false;
+                }
+                coarser = coarser || level > node.level;
+            }
+            if (coarser != ((chunk.stitch & side.bit) != 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// every index variant covers the chunk exactly once with triangles of the same winding and none degenerate
+bool IndicesCorrect(const TerrainIndices &indices, int n) {
+    for (uint32_t mask = 0; mask < kTerrainStitchCount; mask++) {
+        double area = 0.0;
+        for (uint32_t t = 0; t < indices.count[mask]; t += 3) {
+            const uint16_t *tri = indices.indices.data() + indices.start[mask] + t;
+            double r[3], c[3];
+            for (int k = 0; k < 3; k++) {
+                r[k] = tri[k] / (n + 1);
+                c[k] = tri[k] % (n + 1);
+            }
+            // rows go to -z, so counterclockwise on the grid is (c, -r)
+            const double signed_area = 0.5 * ((c[1] - c[0]) * (r[0] - r[2]) - (c[2] - c[0]) * (r[0] - r[1]));
+            if (signed_area >= 0.0) {
+                return false;
+            }
+            area -= signed_area;
+        }
+        if (std::abs(area - (double) n * n) > 1e-9) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// vertices on the outline of a chunk side as (position along the side, height), sorted along the side
+std::vector<std::pair<float, float>> SideOutline(const Terrain &terrain, const TerrainIndices &indices,
+    const TerrainChunk &chunk, uint32_t side, const std::vector<TerrainVertex> &vertices) {
+    const int n = terrain.Desc().chunk_quads;
+    auto on_side = [n, side](uint16_t v) {
+        const int r = v / (n + 1), c = v % (n + 1);
+        return (side == kTerrainNorth && r == 0) || (side == kTerrainSouth && r == n) ||
+            (side == kTerrainWest && c == 0) || (side == kTerrainEast && c == n);
+    };
+    // edges of a single triangle are on the outline
+    std::map<std::pair<uint16_t, uint16_t>, int> edge_count;
+    for (uint32_t t = 0; t < indices.count[chunk.stitch]; t += 3) {
+        const uint16_t *tri = indices.indices.data() + indices.start[chunk.stitch] + t;
+        for (int k = 0; k < 3; k++) {
+            const uint16_t a = std::min(tri[k], tri[(k + 1) % 3]), b = std::max(tri[k], tri[(k + 1) % 3]);
+            edge_count[{ a, b }]++;
+        }
+    }
+    std::set<uint16_t> outline;
+    for (const auto &[edge, count] : edge_count) {
+        if (count == 1 && on_side(edge.first) && on_side(edge.second)) {
+            outline.insert(edge.first);
+            outline.insert(edge.second);
+        }
+    }
+    const bool along_x = side == kTerrainNorth || side == kTerrainSouth;
+    std::vector<std::pair<float, float>> points;
+    for (uint16_t v : outline) {
+        points.push_back({ vertices[v].pos[along_x ? 0 : 2], vertices[v].pos[1] });
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+// neighbors along every side have the same outline vertices where they touch, so there are no t-junctions
+bool CrackFree(const Terrain &terrain, const TerrainIndices &indices, const std::vector<TerrainChunk> &chunks,
+    size_t &n_stitched_edge) {
+    const int n_leaf = 1 << (terrain.Desc().n_level - 1);
+    const std::vector<int> owners = LeafOwners(terrain, chunks);
+    std::vector<std::vector<TerrainVertex>> vertices(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        vertices[i].resize(terrain.VertexCountPerChunk());
+        terrain.GenerateChunk(chunks[i].node, vertices[i].data());
+    }
+    n_stitched_edge = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const TerrainNode &node = chunks[i].node;
+        const int span = 1 << node.level;
+        for (const Side &side : kSides) {
+            std::set<int> neighbors;
+            for (int k = 0; k < span; k++) {
+                int x = side.dx > 0 ? (node.x + 1) * span : side.dx < 0 ? node.x * span - 1 : node.x * span + k;
+                int z = side.dz > 0 ? (node.z + 1) * span : side.dz < 0 ? node.z * span - 1 : node.z * span + k;
+                if (x >= 0 && z >= 0 && x < n_leaf && z < n_leaf) {
+                    neighbors.insert(owners[(size_t) z * n_leaf + x]);
+                }
+            }
+            const auto outline = SideOutline(terrain, indices, chunks[i], side.bit, vertices[i]);
+            for (int j : neighbors) {
+                const auto other = SideOutline(terrain, indices, chunks[j], side.opposite, vertices[j]);
+                // compare where both sides overlap
+                const float lo = std::max(outline.front().first, other.front().first) - kEdgeTolerance;
+                const float hi = std::min(outline.back().first, other.back().first) + kEdgeTolerance;
+                std::vector<std::pair<float, float>> a, b;
+                std::copy_if(outline.begin(), outline.end(), std::back_inserter(a),
+                    [lo, hi](const auto &p) { return p.first >= lo && p.first <= hi; });
+                std::copy_if(other.begin(), other.end(), std::back_inserter(b),
+                    [lo, hi](const auto &p) { return p.first >= lo && p.first <= hi; });
+                if (a.size() != b.size() || a.size() < 2) {
+                    return false;
+                }
+                for (size_t k = 0; k < a.size(); k++) {
+                    if (std::abs(a[k].first - b[k].first) > kEdgeTolerance ||
+                        std::abs(a[k].second - b[k].second) > kEdgeTolerance) {
+                        return false;
+                    }
+                }
+                n_stitched_edge += (chunks[i].stitch & side.bit) ? 1 : 0;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("index variants\n");
+    for (int quads : { 2, 8, 32, 128 }) {
+        TerrainDesc desc = ChapterDesc();
+        desc.chunk_quads = quads;
+        Terrain terrain(jobs, desc, HillField::Evaluate, 1);
+        const bool pass = IndicesCorrect(terrain.BuildIndices(), quads);
+        ok = ok && pass;
+        std::printf("  %3d quads: cover the chunk once, same winding, no degenerate triangles %s\n", quads,
+            pass ? "ok" : "FAILED");
+    }
+
+    std::printf("selection & stitching\n");
+    const float eyes[][3] = {
+        { 0.0f, 30.0f, 0.0f }, { -150.0f, 10.0f, -150.0f }, { 37.5f, 20.0f, -81.0f }, { 159.0f, 5.0f, 3.0f },
+        { 400.0f, 50.0f, 0.0f }, { 80.0f, 80.0f, 80.0f }
+    };
+    for (int n_level : { 4, 6 }) {
+        for (float factor : { 1.5f, 2.0f, 3.0f }) {
+            TerrainDesc desc = ChapterDesc();
+            desc.n_level = n_level;
+            desc.lod_range_factor = factor;
+            desc.chunk_quads = 16;
+            Terrain terrain(jobs, desc, HillField::Evaluate, 1);
+            const TerrainIndices indices = terrain.BuildIndices();
+            bool selection = true, crack_free = true;
+            size_t n_chunk = 0, n_stitched = 0;
+            for (const auto &eye : eyes) {
+                std::vector<TerrainChunk> chunks;
+                terrain.Select(eye, nullptr, chunks);
+                size_t stitched = 0;
+                selection = selection && SelectionCorrect(terrain, chunks);
+                crack_free = crack_free && selection && CrackFree(terrain, indices, chunks, stitched);
+                n_chunk += chunks.size();
+                n_stitched += stitched;
+            }
+            const bool pass = selection && crack_free;
+            ok = ok && pass;
+            std::printf("  %d levels, range factor %.1f: %4zu chunks, %4zu stitched edges, %s, %s %s\n", n_level, factor,
+                n_chunk, n_stitched, selection ? "tiled & stitched" : "selection wrong",
+                crack_free ? "crack-free" : "cracks", pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf("culling\n");
+    {
+        Terrain terrain(jobs, ChapterDesc(), HillField::Evaluate, 1);
+        const float origin[3] = { 0.0f, 0.0f, 0.0f };
+        bool subset = true, fewer = false;
+        for (float theta = 0.0f; theta < 2.0f * kPi; theta += 0.5f) {
+            float eye[3];
+            OrbitEye(80.0f, theta, 0.3f * kPi, eye);
+            const Frustum frustum = CameraFrustum(eye, origin);
+            std::vector<TerrainChunk> all, visible;
+            terrain.Select(eye, nullptr, all);
+            terrain.Select(eye, &frustum, visible);
+            std::set<std::tuple<int, int, int, uint32_t>> all_set;
+            for (const TerrainChunk &chunk : all) {
+                all_set.insert({ chunk.node.level, chunk.node.x, chunk.node.z, chunk.stitch });
+            }
+            for (const TerrainChunk &chunk : visible) {
+                subset = subset && all_set.count({ chunk.node.level, chunk.node.x, chunk.node.z, chunk.stitch }) == 1;
+            }
+            fewer = fewer || visible.size() < all.size();
+        }
+        check(subset, "chunks in the frustum are chunks of the full selection with the same stitch masks");
+        check(fewer, "the frustum drops chunks behind the orbit camera");
+    }
+
+    std::printf("streaming\n");
+    for (int n_slot : { 256, 48 }) {
+        const uint64_t lag = 3;
+        Terrain terrain(jobs, ChapterDesc(), HillField::Evaluate, n_slot);
+        std::vector<TerrainVertex> slot_vertices((size_t) n_slot * terrain.VertexCountPerChunk());
+        std::vector<TerrainVertex> expected(terrain.VertexCountPerChunk());
+        std::vector<std::tuple<int, int, int>> slot_node(n_slot, { -1, 0, 0 });
+        std::vector<uint64_t> slot_used(n_slot, 0);
+        bool lag_respected = true, contents = true, unique = true;
+        size_t n_generated = 0, n_missing = 0;
+        const float origin[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint64_t frame = 1; frame <= 240; frame++) {
+            float eye[3];
+            OrbitEye(60.0f + 40.0f * std::sin(0.05f * frame), 0.03f * frame, 0.35f * kPi, eye);
+            const Frustum frustum = CameraFrustum(eye, origin);
+            std::vector<TerrainChunk> chunks;
+            terrain.Select(eye, &frustum, chunks);
+            n_generated += terrain.Stream(jobs, chunks, frame, lag, slot_vertices.data());
+
+            std::set<int> used;
+            for (const TerrainChunk &chunk : chunks) {
+                if (chunk.slot < 0) {
+                    n_missing++;
+                    continue;
+                }
+                unique = unique && used.insert(chunk.slot).second;
+                const std::tuple<int, int, int> node = { chunk.node.level, chunk.node.x, chunk.node.z };
+                // a slot given to another chunk was not used in the last lag frames
+                if (slot_node[chunk.slot] != node) {
+                    lag_respected = lag_respected && (std::get<0>(slot_node[chunk.slot]) < 0 ||
+                        slot_used[chunk.slot] + lag <= frame);
+                    slot_node[chunk.slot] = node;
+                }
+                slot_used[chunk.slot] = frame;
+                if (frame % 20 == 0) {
+                    terrain.GenerateChunk(chunk.node, expected.data());
+                    contents = contents && std::memcmp(expected.data(), slot_vertices.data() + (size_t) chunk.slot *
+                        terrain.VertexCountPerChunk(), expected.size() * sizeof(TerrainVertex)) == 0;
+                }
+            }
+        }
+        // standing still generates nothing
+        float eye[3];
+        OrbitEye(70.0f, 1.0f, 0.35f * kPi, eye);
+        std::vector<TerrainChunk> chunks;
+        terrain.Select(eye, nullptr, chunks);
+        terrain.Stream(jobs, chunks, 1000, lag, slot_vertices.data());
+        const bool still = chunks.size() > (size_t) n_slot ||
+            terrain.Stream(jobs, chunks, 1001, lag, slot_vertices.data()) == 0;
+
+        const bool pass = lag_respected && contents && unique && still;
+        ok = ok && pass;
+        std::printf("  %3d slots: %5zu chunks generated, %4zu without a slot, %s, %s, %s%s %s\n", n_slot, n_generated,
+            n_missing, lag_respected ? "lag respected" : "slot reused too early",
+            contents ? "vertices as generated" : "vertices differ", unique ? "slots unique" : "slot shared",
+            still ? "" : ", regenerates when still", pass ? "ok" : "FAILED");
+    }
+
+    std::printf("timing, %u threads\n", jobs.ThreadCount());
+    {
+        Terrain terrain(jobs, ChapterDesc(), HillField::Evaluate, 256);
+        const float origin[3] = { 0.0f, 0.0f, 0.0f };
+        float eye[3];
+        OrbitEye(80.0f, 0.7f, 0.3f * kPi, eye);
+        const Frustum frustum = CameraFrustum(eye, origin);
+        std::vector<TerrainChunk> chunks;
+        double select_ms = 0.0, cull_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            terrain.Select(eye, nullptr, chunks);
+            const double ms = Milliseconds(begin);
+            select_ms = run == 0 ? ms : std::min(select_ms, ms);
+        }
+        const size_t n_all = chunks.size();
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            terrain.Select(eye, &frustum, chunks);
+            const double ms = Milliseconds(begin);
+            cull_ms = run == 0 ? ms : std::min(cull_ms, ms);
+        }
+        std::printf("  select %zu chunks %.3f ms, %zu in the frustum %.3f ms\n", n_all, select_ms, chunks.size(),
+            cull_ms);
+
+        // every frame from scratch: a fresh terrain generates all selected chunks
+        double stream_ms = 0.0;
+        size_t n_generated = 0;
+        std::vector<TerrainVertex> slot_vertices((size_t) 256 * terrain.VertexCountPerChunk());
+        for (int run = 0; run < kRuns; run++) {
+            Terrain fresh(jobs, ChapterDesc(), HillField::Evaluate, 256);
+            std::vector<TerrainChunk> visible = chunks;
+            auto begin = std::chrono::steady_clock::now();
+            n_generated = fresh.Stream(jobs, visible, 1, 3, slot_vertices.data());
+            const double ms = Milliseconds(begin);
+            stream_ms = run == 0 ? ms : std::min(stream_ms, ms);
+        }
+        std::printf("  stream %zu chunks %.3f ms, %.3f ms per chunk\n", n_generated, stream_ms,
+            stream_ms / std::max<size_t>(n_generated, 1));
+
+        double indices_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            auto begin = std::chrono::steady_clock::now();
+            const TerrainIndices indices = terrain.BuildIndices();
+            const double ms = Milliseconds(begin);
+            indices_ms = run == 0 ? ms : std::min(indices_ms, ms);
+        }
+        std::printf("  build indices of 16 variants %.3f ms\n", indices_ms);
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
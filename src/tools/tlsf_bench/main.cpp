@@ -0,0 +1,386 @@
+// check TlsfAllocator (ranges aligned and disjoint, stats, coalescing, Defragment moves that pack and keep the data)
+// under random churn, and time it against a best-fit allocator on std::map, exits with 1 if a check fails
+// usage: tlsf_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include "Random.h"
+#include "Tlsf.h"
+
+const int kRuns = 5;
+const uint64_t kGranularity = 256;
+const uint64_t kCapacity = 64ull << 20;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// sizes spread over 256 B to 1 MB like meshes and constant buffers, aligns as buffers, textures and msaa want them
+struct Request {
+    uint64_t size;
+    uint64_t align;
+};
+
+Request RandomRequest(Random &rng) {
+    const int log2 = rng.RandI(8, 19);
+    const uint64_t size = (uint64_t) rng.RandI(1 << (log2 - 1), 1 << log2);
+    const int kind = rng.RandI(0, 15);
+    return { size, kind < 12 ? 256ull : kind < 15 ? 4096ull : 65536ull };
+}
+
+// offset -> end of the live allocations, to catch overlaps
+class Ranges {
+  public:
+    bool Insert(uint64_t offset, uint64_t end) {
+        auto next = live.lower_bound(offset);
+        if (next != live.end() && next->first < end) {
+            return false;
+        }
+        if (next != live.begin() && std::prev(next)->second > offset) {
+            return false;
+        }
+        live.emplace(offset, end);
+        return true;
+    }
+    void Erase(uint64_t offset) {
+        live.erase(offset);
+    }
+    void Clear() {
+        live.clear();
+    }
+
+  private:
+    std::map<uint64_t, uint64_t> live;
+};
+
+// the usual alternative: free blocks by size for best fit and by offset for coalescing
+class MapAllocator {
+  public:
+    explicit MapAllocator(uint64_t capacity) {
+        Add(0, capacity);
+    }
+    bool Allocate(uint64_t size, uint64_t align, uint64_t &offset) {
+        size = (size + kGranularity - 1) / kGranularity * kGranularity;
+        for (auto it = by_size.lower_bound(size); it != by_size.end(); ++it) {
+            const uint64_t begin = it->second, end = begin + it->first;
+            offset = (begin + align - 1) & ~(align - 1);
+            if (offset + size > end) {
+                continue;
+            }
+            Remove(begin, it->first);
+            if (offset > begin) {
+                Add(begin, offset - begin);
+            }
+            if (offset + size < end) {
+                Add(offset + size, end - offset - size);
+            }
+            sizes[offset] = size;
+            return true;
+        }
+        return false;
+    }
+    void Free(uint64_t offset) {
+        uint64_t size = sizes[offset];
+        sizes.erase(offset);
+        auto next = by_offset.lower_bound(offset);
+        if (next != by_offset.end() && next->first == offset + size) {
+            size += next->second;
+            Remove(next->first, next->second);
+            next = by_offset.lower_bound(offset);
+        }
+        if (next != by_offset.begin() && std::prev(next)->first + std::prev(next)->second == offset) {
+            const auto prev = *std::prev(next);
+            Remove(prev.first, prev.second);
+            offset = prev.first;
+            size += prev.second;
+        }
+        Add(offset, size);
+    }
+
+  private:
+    void Add(uint64_t offset, uint64_t size) {
+        by_size.emplace(size, offset);
+        by_offset.emplace(offset, size);
+    }
+    void Remove(uint64_t offset, uint64_t size) {
+        auto range = by_size.equal_range(size);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == offset) {
+                by_size.erase(it);
+                break;
+            }
+        }
+        by_offset.erase(offset);
+    }
+
+    std::multimap<uint64_t, uint64_t> by_size;
+    std::map<uint64_t, uint64_t> by_offset;
+    std::map<uint64_t, uint64_t> sizes;
+};
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("churn, %u MB in %u B units\n", (unsigned) (kCapacity >> 20), (unsigned) kGranularity);
+    {
+        Random rng(1, 0);
+        TlsfAllocator tlsf(kCapacity, kGranularity);
+        Ranges ranges;
+        // a byte per unit, set to the tag of the allocation owning it, so moves can be checked on real data
+        std::vector<uint8_t> memory(kCapacity / kGranularity, 0);
+        std::vector<TlsfAllocator::Handle> live;
+        std::vector<uint8_t> tags;
+        uint64_t used = 0;
+        bool placed = true, disjoint = true, stats = true, rounded = true, fits = true, kept = true;
+        bool packed = true, moved = true, stable = true, shrunk = true;
+        int n_failed = 0, n_defragment = 0;
+        float max_fragmentation = 0.0f;
+        for (int step = 1; step <= 200000; step++) {
+            // fills up to about 90% and churns there, so the heap runs full and fragments
+            if (rng.RandI(0, 99) < (used < kCapacity * 9 / 10 ? 60 : 45)) {
+                const Request request = RandomRequest(rng);
+                TlsfAllocator::Handle handle;
+                if (!tlsf.Allocate(request.size, request.align, handle)) {
+                    // a request is rounded up to the next of 32 classes per power of two, plus room for its align
+                    const TlsfAllocator::Stats s = tlsf.GetStats();
+                    const uint64_t worst = request.size + std::max(request.align, kGranularity) - kGranularity;
+                    fits = fits && s.largest_free * 32 < (worst + kGranularity) * 33;
+                    n_failed++;
+                    continue;
+                }
+                const uint64_t offset = tlsf.Offset(handle), size = tlsf.Size(handle);
+                placed = placed && offset % request.align == 0 && offset + size <= kCapacity;
+                rounded = rounded && size == (request.size + kGranularity - 1) / kGranularity * kGranularity;
+                disjoint = disjoint && ranges.Insert(offset, offset + size);
+                const uint8_t tag = (uint8_t) (step % 255 + 1);
+                std::fill(memory.begin() + offset / kGranularity, memory.begin() + (offset + size) / kGranularity, tag);
+                live.push_back(handle);
+                tags.push_back(tag);
+                used += size;
+            } else if (!live.empty()) {
+                const size_t k = (size_t) rng.RandI(0, (int) live.size() - 1);
+                const uint64_t offset = tlsf.Offset(live[k]), size = tlsf.Size(live[k]);
+                ranges.Erase(offset);
+                std::fill(memory.begin() + offset / kGranularity, memory.begin() + (offset + size) / kGranularity, 0);
+                tlsf.Free(live[k]);
+                used -= size;
+                live[k] = live.back();
+                live.pop_back();
+                tags[k] = tags.back();
+                tags.pop_back();
+            }
+
+            const TlsfAllocator::Stats s = tlsf.GetStats();
+            stats = stats && s.used == used && s.n_allocation == live.size() && s.capacity == kCapacity &&
+                s.largest_free <= kCapacity - used && (s.n_free_block > 0 || used == kCapacity);
+            max_fragmentation = std::max(max_fragmentation, s.Fragmentation());
+
+            if (step % 20000 != 0) {
+                continue;
+            }
+            // pack, replaying the moves on memory in order as the copies on the gpu would be
+            std::vector<TlsfAllocator::Move> moves;
+            tlsf.Defragment(moves);
+            n_defragment++;
+            uint64_t end = 0, prev_src = 0;
+            for (size_t m = 0; m < moves.size(); m++) {
+                const TlsfAllocator::Move &move = moves[m];
+                const uint64_t align_end = (end + kGranularity - 1) / kGranularity * kGranularity;
+                moved = moved && move.dst <= move.src && (m == 0 || move.src > prev_src) && move.dst >= align_end;
+                // only padding for alignment between packed allocations
+                packed = packed && move.dst - end < 65536 && move.dst % kGranularity == 0;
+                std::memmove(memory.data() + move.dst / kGranularity, memory.data() + move.src / kGranularity,
+                    move.size / kGranularity);
+                std::fill(memory.begin() + std::max(move.src, move.dst + move.size) / kGranularity,
+                    memory.begin() + (move.src + move.size) / kGranularity, 0);
+                end = move.dst + move.size;
+                prev_src = move.src;
+            }
+            moved = moved && moves.size() == live.size();
+            ranges.Clear();
+            for (size_t k = 0; k < live.size(); k++) {
+                const uint64_t offset = tlsf.Offset(live[k]), size = tlsf.Size(live[k]);
+                disjoint = disjoint && ranges.Insert(offset, offset + size);
+                const auto move = std::find_if(moves.begin(), moves.end(), [&](const TlsfAllocator::Move &mv) {
+                    return mv.handle == live[k];
+                });
+                stable = stable && move != moves.end() && move->dst == offset && move->size == size;
+                kept = kept && std::all_of(memory.begin() + offset / kGranularity,
+                    memory.begin() + (offset + size) / kGranularity, [&](uint8_t t) {
+                        return t == tags[k];
+                    });
+            }
+            const TlsfAllocator::Stats s_packed = tlsf.GetStats();
+            shrunk = shrunk && s_packed.used == used && s_packed.largest_free >= kCapacity - end &&
+                s_packed.n_free_block <= s.n_free_block;
+        }
+        check(placed, "ranges are aligned and inside the capacity");
+        check(rounded, "sizes are rounded up to the granularity");
+        check(disjoint, "ranges never overlap");
+        check(stats, "stats match the live allocations");
+        check(fits, "allocations fail only when no free block is large enough for the rounded request");
+        check(n_failed > 0, "the heap ran full now and then");
+        check(moved, "Defragment moves every allocation once, in address order and never up");
+        check(packed, "Defragment packs allocations to the beginning with only alignment padding between them");
+        check(stable, "handles stay valid across Defragment and point at where their data went");
+        check(kept, "replaying the moves keeps every allocation's data");
+        check(shrunk, "Defragment leaves one large free block at the end and fewer free blocks");
+        std::printf("  %d defragments, %d failed allocations, fragmentation up to %.2f\n", n_defragment, n_failed,
+            max_fragmentation);
+
+        for (TlsfAllocator::Handle handle : live) {
+            tlsf.Free(handle);
+        }
+        const TlsfAllocator::Stats s = tlsf.GetStats();
+        check(s.used == 0 && s.n_allocation == 0 && s.n_free_block == 1 && s.largest_free == kCapacity,
+            "freeing everything coalesces into one block");
+        TlsfAllocator::Handle all;
+        check(tlsf.Allocate(kCapacity, kGranularity, all) && tlsf.Offset(all) == 0,
+            "which fits the whole capacity again");
+    }
+
+    std::printf("fragmentation, long lived allocations among short lived ones\n");
+    {
+        Random rng(2, 0);
+        TlsfAllocator tlsf(kCapacity, kGranularity);
+        std::vector<TlsfAllocator::Handle> long_lived, short_lived;
+        for (int frame = 0; frame < 2000; frame++) {
+            // every frame frees the transient allocations of the last one and makes new ones, a few stay for good
+            for (TlsfAllocator::Handle handle : short_lived) {
+                tlsf.Free(handle);
+            }
+            short_lived.clear();
+            for (int k = 0; k < 40; k++) {
+                const Request request = RandomRequest(rng);
+                TlsfAllocator::Handle handle;
+                if (!tlsf.Allocate(request.size, request.align, handle)) {
+                    continue;
+                }
+                if (rng.RandI(0, 19) == 0 && tlsf.GetStats().used < kCapacity / 2) {
+                    long_lived.push_back(handle);
+                } else {
+                    short_lived.push_back(handle);
+                }
+            }
+        }
+        for (TlsfAllocator::Handle handle : short_lived) {
+            tlsf.Free(handle);
+        }
+        const TlsfAllocator::Stats s = tlsf.GetStats();
+        const float before = s.Fragmentation();
+        std::vector<TlsfAllocator::Move> moves;
+        tlsf.Defragment(moves);
+        const TlsfAllocator::Stats packed = tlsf.GetStats();
+        std::printf("  %u allocations, %.1f of %u MB used: %u free blocks, largest %.1f MB, fragmentation %.2f\n",
+            s.n_allocation, s.used / 1048576.0, (unsigned) (kCapacity >> 20), s.n_free_block,
+            s.largest_free / 1048576.0, before);
+        std::printf("  after Defragment: %u free blocks, largest %.1f MB, fragmentation %.2f\n", packed.n_free_block,
+            packed.largest_free / 1048576.0, packed.Fragmentation());
+        check(packed.Fragmentation() < 0.05f && packed.Fragmentation() <= before,
+            "Defragment turns the scattered free space into one block, but for alignment padding");
+    }
+
+    std::printf("allocate & free, %d churn steps\n", 1 << 19);
+    {
+        // the same requests and frees for both, from a heap kept about 75% full
+        Random rng(3, 0);
+        std::vector<Request> requests(1 << 19);
+        std::vector<uint32_t> victims(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            requests[i] = RandomRequest(rng);
+            victims[i] = (uint32_t) rng.RandI(0, INT32_MAX);
+        }
+        double tlsf_ms = 0.0, map_ms = 0.0;
+        size_t tlsf_failed = 0, map_failed = 0;
+        for (int run = 0; run < kRuns; run++) {
+            TlsfAllocator tlsf(kCapacity, kGranularity);
+            std::vector<TlsfAllocator::Handle> live;
+            uint64_t used = 0;
+            tlsf_failed = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < requests.size(); i++) {
+                TlsfAllocator::Handle handle;
+                if (tlsf.Allocate(requests[i].size, requests[i].align, handle)) {
+                    live.push_back(handle);
+                    used += tlsf.Size(handle);
+                } else {
+                    tlsf_failed++;
+                }
+                while (used > kCapacity * 3 / 4) {
+                    const size_t k = victims[i] % live.size();
+                    used -= tlsf.Size(live[k]);
+                    tlsf.Free(live[k]);
+                    live[k] = live.back();
+                    live.pop_back();
+                }
+            }
+            const double ms = Milliseconds(begin);
+            tlsf_ms = run == 0 ? ms : std::min(tlsf_ms, ms);
+
+            MapAllocator map(kCapacity);
+            std::vector<std::pair<uint64_t, uint64_t>> map_live;
+            used = 0;
+            map_failed = 0;
+            begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < requests.size(); i++) {
+                uint64_t offset;
+                if (map.Allocate(requests[i].size, requests[i].align, offset)) {
+                    const uint64_t size = (requests[i].size + kGranularity - 1) / kGranularity * kGranularity;
+                    map_live.emplace_back(offset, size);
+                    used += size;
+                } else {
+                    map_failed++;
+                }
+                while (used > kCapacity * 3 / 4) {
+                    const size_t k = victims[i] % map_live.size();
+                    used -= map_live[k].second;
+                    map.Free(map_live[k].first);
+                    map_live[k] = map_live.back();
+                    map_live.pop_back();
+                }
+            }
+            const double map_run_ms = Milliseconds(begin);
+            map_ms = run == 0 ? map_run_ms : std::min(map_ms, map_run_ms);
+        }
+        std::printf("  tlsf %8.3f ms, %6.1f ns per step, %zu failed\n", tlsf_ms, tlsf_ms * 1e6 / requests.size(),
+            tlsf_failed);
+        std::printf("  map  %8.3f ms, %6.1f ns per step, %zu failed (%.2fx)\n", map_ms,
+            map_ms * 1e6 / requests.size(), map_failed, map_ms / tlsf_ms);
+    }
+
+    std::printf("defragment\n");
+    for (size_t n : { (size_t) 1000, (size_t) 10000, (size_t) 100000 }) {
+        // n allocations with every other one freed, so half the moves are real
+        Random rng(4, n);
+        double best_ms = 0.0;
+        for (int run = 0; run < kRuns; run++) {
+            TlsfAllocator tlsf(kCapacity * 16, kGranularity);
+            std::vector<TlsfAllocator::Handle> handles(n);
+            for (TlsfAllocator::Handle &handle : handles) {
+                tlsf.Allocate((uint64_t) rng.RandI(1, 64) * kGranularity, kGranularity, handle);
+            }
+            for (size_t i = 0; i < n; i += 2) {
+                tlsf.Free(handles[i]);
+            }
+            std::vector<TlsfAllocator::Move> moves;
+            auto begin = std::chrono::steady_clock::now();
+            tlsf.Defragment(moves);
+            const double ms = Milliseconds(begin);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+        }
+        std::printf("  %6zu allocations: %7.3f ms\n", n, best_ms);
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
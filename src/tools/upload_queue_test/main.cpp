@@ -0,0 +1,237 @@
+// check UploadQueue against a mock device whose command lists run some frames later, as on a gpu: destinations end up
+// as uploaded, staging space is never reused or destroyed before the copies reading it ran, copies are coalesced and
+// come between the transitions of their destinations, exits with 1 if a check fails
+// usage: upload_queue_test
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "Random.h"
+#include "UploadQueue.h"
+
+const uint32_t kCopyDest = 1;
+const uint32_t kDestinations = 16;
+const uint64_t kDestinationSize = 1 << 16;
+
+// what a list does when it runs
+struct MockCommand {
+    enum Op {
+        ToCopy,
+        Copy,
+        FromCopy
+    } op;
+    uint32_t dst;
+    uint32_t state;
+    uint64_t dst_offset = 0;
+    uint32_t src = 0;
+    uint64_t src_offset = 0;
+    uint64_t size = 0;
+};
+
+struct MockList {
+    std::vector<MockCommand> commands;
+};
+
+// staging buffers live here, a destroyed one keeps its id so that copies reading it later are caught
+struct MockMemory {
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> buffers;
+    std::vector<bool> alive;
+    std::vector<std::vector<uint8_t>> destinations;
+    uint32_t n_alive = 0;
+};
+
+class MockDevice {
+  public:
+    using Buffer = uint32_t;
+    using Resource = uint32_t;
+    using State = uint32_t;
+    using CommandList = MockList;
+    using Destination = UploadDestination<Resource, State>;
+    static constexpr uint32_t kDefaultState = 0;
+
+    explicit MockDevice(MockMemory *memory) : memory(memory) {}
+
+    Buffer CreateBuffer(uint64_t capacity, uint8_t *&mapped_data) {
+        memory->buffers.push_back(std::make_unique<std::vector<uint8_t>>(capacity, 0));
+        memory->alive.push_back(true);
+        memory->n_alive++;
+        mapped_data = memory->buffers.back()->data();
+        return (Buffer) memory->buffers.size() - 1;
+    }
+    void DestroyBuffer(Buffer &buffer) {
+        memory->alive[buffer] = false;
+        memory->n_alive--;
+    }
+    void BeginCopies(MockList *list, const std::vector<Destination> &dsts) {
+        for (const Destination &dst : dsts) {
+            if (dst.state != kCopyDest) {
+                list->commands.push_back({ MockCommand::ToCopy, dst.resource, dst.state });
+            }
+        }
+    }
+    void Copy(MockList *list, Resource dst, uint64_t dst_offset, const Buffer &src, uint64_t src_offset,
+            uint64_t size) {
+        list->commands.push_back({ MockCommand::Copy, dst, 0, dst_offset, src, src_offset, size });
+    }
+    void EndCopies(MockList *list, const std::vector<Destination> &dsts) {
+        for (const Destination &dst : dsts) {
+            if (dst.state != kCopyDest) {
+                list->commands.push_back({ MockCommand::FromCopy, dst.resource, dst.state });
+            }
+        }
+    }
+
+  private:
+    MockMemory *memory;
+};
+
+// run a list, false if a copy reads a destroyed buffer or writes a destination that is not in the copy state
+bool Execute(MockMemory &memory, const MockList &list, std::vector<uint32_t> &states) {
+    bool valid = true;
+    for (const MockCommand &command : list.commands) {
+        if (command.op == MockCommand::ToCopy) {
+            valid = valid && states[command.dst] == command.state;
+            states[command.dst] = kCopyDest;
+        } else if (command.op == MockCommand::FromCopy) {
+            valid = valid && states[command.dst] == kCopyDest;
+            states[command.dst] = command.state;
+        } else {
+            valid = valid && memory.alive[command.src] && states[command.dst] == kCopyDest;
+            const std::vector<uint8_t> &src = *memory.buffers[command.src];
+            std::memcpy(memory.destinations[command.dst].data() + command.dst_offset, src.data() + command.src_offset,
+                command.size);
+        }
+    }
+    return valid;
+}
+
+int main() {
+    bool ok = true;
+    auto check = [&ok](bool pass, const char *what) {
+        ok = ok && pass;
+        std::printf("  %s: %s\n", what, pass ? "ok" : "FAILED");
+    };
+
+    std::printf("random uploads, lists run 0 to 3 frames late\n");
+    {
+        Random rng(1, 0);
+        MockMemory memory;
+        memory.destinations.assign(kDestinations, std::vector<uint8_t>(kDestinationSize, 0));
+        // what the destinations hold once all uploads so far ran, and the state each is kept in
+        std::vector<std::vector<uint8_t>> expected = memory.destinations;
+        std::vector<uint32_t> states(kDestinations), gpu_states(kDestinations);
+        for (uint32_t d = 0; d < kDestinations; d++) {
+            states[d] = gpu_states[d] = d % 4 == 0 ? kCopyDest : 2 + d % 3;
+        }
+
+        UploadQueue<MockDevice> queue(MockDevice(&memory), 4096);
+        std::deque<std::pair<uint64_t, MockList>> in_flight;
+        uint64_t completed = 0;
+        uint32_t n_upload = 0, n_copy = 0, peak_alive = 0;
+        bool valid = true, coalesced = true;
+        std::vector<uint8_t> data;
+        for (uint64_t frame = 1; frame <= 3000; frame++) {
+            // a few uploads per frame, now and then one larger than the ring, and runs of contiguous ones
+            uint32_t n_frame_upload = 0;
+            for (int k = rng.RandI(0, 8); k > 0; k--) {
+                const uint32_t d = (uint32_t) rng.RandI(0, kDestinations - 1);
+                const uint64_t size = (uint64_t) rng.RandI(1, rng.RandI(0, 49) == 0 ? 12000 : 600);
+                uint64_t dst_offset = (uint64_t) rng.RandI(0, (int) (kDestinationSize - size));
+                const int n_piece = rng.RandI(0, 3) == 0 ? rng.RandI(2, 4) : 1;
+                for (int piece = 0; piece < n_piece && dst_offset + size <= kDestinationSize; piece++) {
+                    data.resize(size);
+                    for (uint8_t &byte : data) {
+                        byte = (uint8_t) rng.RandI(0, 255);
+                    }
+                    queue.Upload(d, dst_offset, data.data(), size, states[d]);
+                    std::memcpy(expected[d].data() + dst_offset, data.data(), size);
+                    dst_offset += size;
+                    n_frame_upload++;
+                }
+            }
+            // data was copied into the ring, scribbling over the source changes nothing
+            std::fill(data.begin(), data.end(), 0xcd);
+
+            MockList list;
+            queue.Flush(&list, frame);
+            const uint32_t n_list_copy = (uint32_t) std::count_if(list.commands.begin(), list.commands.end(),
+                [](const MockCommand &c) {
+                    return c.op == MockCommand::Copy;
+                });
+            coalesced = coalesced && n_list_copy <= n_frame_upload;
+            n_upload += n_frame_upload;
+            n_copy += n_list_copy;
+            in_flight.emplace_back(frame, std::move(list));
+            peak_alive = std::max(peak_alive, memory.n_alive);
+
+            // the gpu runs the lists in order, 0 to 3 frames behind
+            const uint64_t target = frame - std::min<uint64_t>(frame, (uint64_t) rng.RandI(0, 3));
+            while (!in_flight.empty() && in_flight.front().first <= target) {
+                valid = Execute(memory, in_flight.front().second, gpu_states) && valid;
+                completed = in_flight.front().first;
+                in_flight.pop_front();
+            }
+            queue.Retire(completed);
+        }
+        while (!in_flight.empty()) {
+            valid = Execute(memory, in_flight.front().second, gpu_states) && valid;
+            completed = in_flight.front().first;
+            in_flight.pop_front();
+        }
+        queue.Retire(completed);
+
+        const auto &stats = queue.GetStats();
+        check(valid, "copies only read live staging buffers, destinations are in the copy state for them");
+        check(memory.destinations == expected, "destinations hold what was uploaded last, in upload order");
+        check(gpu_states == states, "destinations are back in their states after every list");
+        check(coalesced && n_copy < n_upload, "contiguous uploads to a destination are merged into one copy");
+        check(stats.n_upload == n_upload && stats.n_copy == n_copy, "stats count uploads and copies");
+        check(stats.n_upload_resource > 1 && stats.n_upload_resource == memory.buffers.size() &&
+            stats.capacity >= 12000, "a full ring is replaced by a larger one");
+        check(memory.n_alive == 1, "old rings are dropped once their copies ran");
+        std::printf("  %u uploads in %u copies, %u rings made, up to %u alive, last one %llu bytes, peak %llu bytes\n",
+            n_upload, n_copy, stats.n_upload_resource, peak_alive, (unsigned long long) stats.capacity,
+            (unsigned long long) stats.peak_used);
+    }
+
+    std::printf("one flush\n");
+    {
+        MockMemory memory;
+        memory.destinations.assign(3, std::vector<uint8_t>(256, 0));
+        UploadQueue<MockDevice> queue(MockDevice(&memory), 1024);
+        const uint8_t bytes[64] = { 1, 2, 3 };
+        // two uploads continuing each other in staging and destination, then others interleaved
+        queue.Upload(0, 0, bytes, 32, 2);
+        queue.Upload(0, 32, bytes, 32, 2);
+        queue.Upload(1, 0, bytes, 16, kCopyDest);
+        queue.Upload(2, 64, bytes, 16, 3);
+        queue.Upload(0, 128, bytes, 16, 2);
+        MockList list;
+        queue.Flush(&list, 1);
+        std::vector<MockCommand::Op> ops;
+        for (const MockCommand &command : list.commands) {
+            ops.push_back(command.op);
+        }
+        const std::vector<MockCommand::Op> expected_ops = { MockCommand::ToCopy, MockCommand::ToCopy,
+            MockCommand::Copy, MockCommand::Copy, MockCommand::Copy, MockCommand::Copy, MockCommand::FromCopy,
+            MockCommand::FromCopy };
+        check(ops == expected_ops,
+            "one transition pair per destination not already in the copy state, around the copies");
+        check(list.commands[2].dst == 0 && list.commands[2].size == 64 && list.commands[3].dst == 0 &&
+            list.commands[3].dst_offset == 128, "copies are grouped by destination and runs are merged");
+
+        MockList empty;
+        queue.Flush(&empty, 2);
+        check(empty.commands.empty(), "nothing pending, nothing recorded");
+        queue.Upload(0, 0, bytes, 0, 2);
+        queue.Flush(&empty, 2);
+        check(empty.commands.empty() && queue.GetStats().n_upload == 5, "empty uploads are dropped");
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
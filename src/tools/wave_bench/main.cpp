@@ -0,0 +1,197 @@
+// throughput of WaveInteraction on grids laid out as Wave's (xyz per cell), with checks against a direct
+// implementation, exits with 1 if a check fails
+// usage: wave_bench [n_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Random.h"
+#include "WaveInteraction.h"
+
+const int kRuns = 5;
+const size_t kQueries = 1 << 20;
+
+double Milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// xyz of every cell as Wave's solution, spacing 1 and centered at the origin
+struct Surface {
+    std::vector<float> xyz;
+    std::vector<float> normals;
+    WaveGrid grid;
+
+    explicit Surface(uint32_t n) : xyz(3 * (size_t) n * n, 0.0f), normals(3 * (size_t) n * n, 0.0f) {
+        grid.stride = 3;
+        grid.n_row = n;
+        grid.n_col = n;
+        grid.x0 = -0.5f * (n - 1);
+        grid.z0 = 0.5f * (n - 1);
+        grid.spacing = 1.0f;
+        grid.border = 1;
+        Bind();
+    }
+    Surface(const Surface &rhs) : xyz(rhs.xyz), normals(rhs.normals), grid(rhs.grid) {
+        Bind();
+    }
+    void Bind() {
+        grid.heights = xyz.data() + 1;
+        grid.normals = normals.data();
+    }
+    float Height(uint32_t i, uint32_t j) const {
+        return xyz[3 * ((size_t) i * grid.n_col + j) + 1];
+    }
+};
+
+// disturbances over the grid and a bit beyond its edges, so that clamping is exercised
+std::vector<WaveDisturbance> RandomDisturbances(const WaveGrid &grid, size_t n, uint64_t seed) {
+    Random rng(seed, n);
+    std::vector<WaveDisturbance> disturbances(n);
+    const float half = 0.5f * grid.n_col * grid.spacing + 4.0f;
+    for (WaveDisturbance &d : disturbances) {
+        d.x = rng.RandF(-half, half);
+        d.z = rng.RandF(-half, half);
+        d.radius = rng.RandF(1.0f, 4.0f) * grid.spacing;
+        d.magnitude = rng.RandF(-0.5f, 0.5f);
+        d.kernel = (WaveKernel) rng.RandI(0, 2);
+    }
+    return disturbances;
+}
+
+// one disturbance after another over the whole footprint
+void DisturbDirect(const WaveGrid &grid, const WaveDisturbance *disturbances, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        const WaveDisturbance &d = disturbances[k];
+        const float inv_r2 = 1.0f / (d.radius * d.radius);
+        for (uint32_t i = grid.border; i < grid.n_row - grid.border; i++) {
+            const float dz = grid.z0 - i * grid.spacing - d.z;
+            const float dz2 = dz * dz * inv_r2;
+            if (dz2 >= 1.0f) {
+                continue;
+            }
+            for (uint32_t j = grid.border; j < grid.n_col - grid.border; j++) {
+                const float dx = grid.x0 + j * grid.spacing - d.x;
+                const float t2 = dx * dx * inv_r2 + dz2;
+                if (t2 >= 1.0f) {
+                    continue;
+                }
+                float w = std::exp(-4.0f * t2);
+                if (d.kernel == WaveKernel::Cone) {
+                    w = 1.0f - std::sqrt(t2);
+                } else if (d.kernel == WaveKernel::Smooth) {
+                    w = (1.0f - t2) * (1.0f - t2);
+                }
+                grid.heights[((size_t) i * grid.n_col + j) * grid.stride] += d.magnitude * w;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const unsigned n_thread = argc >= 2 ? (unsigned) std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    JobSystem jobs(std::max(n_thread, 1u));
+    JobSystem single(1);
+    WaveInteraction interaction;
+    bool ok = true;
+
+    std::printf("disturb, %u threads\n", jobs.ThreadCount());
+    for (uint32_t n : { 128u, 512u, 2048u }) {
+        for (size_t n_disturbance : { (size_t) 1000, (size_t) 10000, (size_t) 100000 }) {
+            Surface surface(n);
+            const std::vector<WaveDisturbance> disturbances = RandomDisturbances(surface.grid, n_disturbance, n);
+
+            // same sums as the direct way, with any thread count, and the border untouched
+            Surface direct(surface), one_thread(surface);
+            DisturbDirect(direct.grid, disturbances.data(), n_disturbance);
+            interaction.Disturb(single, one_thread.grid, disturbances.data(), n_disturbance);
+            interaction.Disturb(jobs, surface.grid, disturbances.data(), n_disturbance);
+            double max_diff = 0.0;
+            bool border_at_rest = true;
+            for (uint32_t i = 0; i < n; i++) {
+                for (uint32_t j = 0; j < n; j++) {
+                    max_diff = std::max(max_diff, (double) std::abs(surface.Height(i, j) - direct.Height(i, j)));
+                    const bool is_border = i == 0 || j == 0 || i == n - 1 || j == n - 1;
+                    border_at_rest = border_at_rest && (!is_border || surface.Height(i, j) == 0.0f);
+                }
+            }
+            const bool same = surface.xyz == one_thread.xyz;
+            const bool pass = max_diff < 1e-5 && same && border_at_rest;
+            ok = ok && pass;
+
+            double best_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                auto begin = std::chrono::steady_clock::now();
+                interaction.Disturb(jobs, surface.grid, disturbances.data(), n_disturbance);
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            // the direct way walks the footprint rows over the whole grid, only time it where that is fair
+            char direct_time[32] = "       n/a";
+            if (n_disturbance <= 10000) {
+                auto begin = std::chrono::steady_clock::now();
+                DisturbDirect(direct.grid, disturbances.data(), n_disturbance);
+                std::snprintf(direct_time, sizeof(direct_time), "%7.3f ms", Milliseconds(begin));
+            }
+            std::printf("  %4u^2, %6zu: %7.3f ms, %6.2f M/s (direct %s), diff %.1e, %s %s\n", n, n_disturbance,
+                best_ms, n_disturbance / (best_ms * 1e3), direct_time, max_diff,
+                same ? "deterministic" : "differs across threads", pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf("sample %zu points, %u threads\n", kQueries, jobs.ThreadCount());
+    for (uint32_t n : { 128u, 512u, 2048u }) {
+        // a plane is reproduced exactly by bilinear sampling, and so are its normals
+        Surface surface(n);
+        const float a = 0.03f, b = -0.02f, c = 0.5f;
+        const float len_inv = 1.0f / std::sqrt(a * a + 1.0f + b * b);
+        for (uint32_t i = 0; i < n; i++) {
+            for (uint32_t j = 0; j < n; j++) {
+                float *cell = surface.xyz.data() + 3 * ((size_t) i * n + j);
+                cell[0] = surface.grid.x0 + j;
+                cell[2] = surface.grid.z0 - i;
+                cell[1] = a * cell[0] + b * cell[2] + c;
+                float *normal = surface.normals.data() + 3 * ((size_t) i * n + j);
+                normal[0] = -a * len_inv;
+                normal[1] = len_inv;
+                normal[2] = -b * len_inv;
+            }
+        }
+        std::vector<float> x(kQueries), z(kQueries), heights(kQueries), normals(3 * kQueries);
+        Random rng(3, n);
+        rng.FillF(x.data(), kQueries, -0.55f * n, 0.55f * n);
+        rng.FillF(z.data(), kQueries, -0.55f * n, 0.55f * n);
+
+        for (int use_normals = 1; use_normals >= 0; use_normals--) {
+            surface.grid.normals = use_normals ? surface.normals.data() : nullptr;
+            double best_ms = 0.0;
+            for (int run = 0; run < kRuns; run++) {
+                auto begin = std::chrono::steady_clock::now();
+                interaction.Sample(jobs, surface.grid, x.data(), z.data(), kQueries, heights.data(), normals.data());
+                const double ms = Milliseconds(begin);
+                best_ms = run == 0 ? ms : std::min(best_ms, ms);
+            }
+            double height_err = 0.0, normal_err = 0.0;
+            const float half = 0.5f * (n - 1);
+            for (size_t p = 0; p < kQueries; p++) {
+                const float px = std::clamp(x[p], -half, half), pz = std::clamp(z[p], -half, half);
+                height_err = std::max(height_err, (double) std::abs(heights[p] - (a * px + b * pz + c)));
+                normal_err = std::max({ normal_err, (double) std::abs(normals[3 * p] + a * len_inv),
+                    (double) std::abs(normals[3 * p + 1] - len_inv), (double) std::abs(normals[3 * p + 2] + b * len_inv) });
+            }
+            const bool pass = height_err < 1e-3 && normal_err < 1e-5;
+            ok = ok && pass;
+            std::printf("  %4u^2, %s normals: %7.3f ms, %6.2f M/s, height error %.1e, normal error %.1e %s\n", n,
+                use_normals ? "grid    " : "gradient", best_ms, kQueries / (best_ms * 1e3), height_err, normal_err,
+                pass ? "ok" : "FAILED");
+        }
+    }
+
+    std::printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file